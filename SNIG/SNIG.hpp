@@ -5,5 +5,9 @@
 #include "snig/snig.hpp"
 #include "gpipe/gpipe.hpp"
 #include "bf/bf.hpp"
-
-
+#include "snig_cpu/snig_cpu.hpp"
+#include "snig_cpu/snig_cpu_fixed.hpp"
+#include "snig_cpu/snig_cpu_server.hpp"
+#include "hybrid_cpu/hybrid_cpu.hpp"
+#include "sequential/sequential.hpp"
+#include "cpu_parallel/cpu_parallel.hpp"
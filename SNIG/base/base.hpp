@@ -1,6 +1,14 @@
 #pragma once
 
 #include <SNIG/utility/utility.hpp>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/sections.hpp>
+#include <SNIG/utility/category_bitset.hpp>
+#include <SNIG/utility/memory_tracker.hpp>
+#include <SNIG/utility/json.hpp>
+#include <SNIG/utility/metrics.hpp>
+#include <SNIG/utility/pipeline_stats.hpp>
+#include <SNIG/utility/affinity.hpp>
 #include <chrono>
 
 namespace snig {
@@ -14,14 +22,16 @@ class Base {
     T _bias;
     size_t _num_neurons;
     size_t _num_layers;
-    size_t _num_gpus;
-    size_t _num_inputs;
+    size_t _num_gpus{0};
+    size_t _num_inputs{0};
     
     //Both SNIG and BF use maximum external shared memory
     //_num_secs == N_SLAB
     //_sec_size == COL_BLK
+    //sections balanced by nnz differ in width, then _sec_size is the widest
     size_t _num_secs;
     size_t _sec_size;
+    SectionLayout _sections;
 
     //weights
     int* _host_pinned_weight;
@@ -35,12 +45,24 @@ class Base {
     //kernel configuration
     dim3 _threads{32, 32, 1};
 
+    //bytes held by the engine, by category and phase
+    MemoryTracker _memory;
+
+    //instrumentation points are no-ops unless a registry is attached
+    MetricsRegistry* _metrics{nullptr};
+    Histogram* _batch_latency{nullptr};
+
+    //placement of the workers of every pool the engine creates
+    ThreadPlacement _placement;
+
+    //a quiet engine logs nothing, not even while loading the weight
     Base(
       const dim3& threads,
       const std::fs::path& weight_path,
       const T bias,
       const size_t num_neurons,
-      const size_t num_layers
+      const size_t num_layers,
+      const bool quiet = false
     );
 
     virtual ~Base();
@@ -58,12 +80,50 @@ class Base {
     
     auto duration();
 
+    void _observe_batch(const double seconds);
+
+    void _publish_metrics(const int* results, const double infer_ms);
+
+    void _publish_metrics(const CategoryBitset& categories, const double infer_ms);
+
+    void _publish_pipeline(const PipelineStats& stats);
+
+    //engines whose kernels assume sections of _sec_size neurons
+    void _require_uniform_sections(const std::string& engine) const;
+
+  public:
+
+    const MemoryTracker& memory() const;
+
+    //write the engine section of the run report
+    //as fields of an already opened JSON object
+    virtual void report(JSONWriter& json) const;
+
+    //feed the instrumentation points of the engine into the registry
+    void attach_metrics(MetricsRegistry& registry);
+
+    //place the workers of the executor, OpenMP regions, and thread pools
+    void set_affinity(const AffinityPolicy policy);
+
+    //stop logging the phases of every run to std::cout,
+    //for callers that run the engine many times or embed it
+    void set_quiet(const bool quiet);
+
+    ThreadPlacement& placement();
+
+    const ThreadPlacement& placement() const;
+
+    //bytes of one padded layer of the packed host copy,
+    //the size of every weight copy to a device
+    size_t layer_bytes() const;
+
   private:
 
     std::chrono::time_point<std::chrono::steady_clock> _tic;
     std::chrono::time_point<std::chrono::steady_clock> _toc;
     bool _enable_counter{false};
     bool _enable_toc{false};
+    bool _is_quiet{false};
 
     void _load_weight(const std::fs::path& weight_path); 
 
@@ -100,21 +160,29 @@ Base<T>::Base(
   const std::fs::path& weight_path,
   const T bias,
   const size_t num_neurons,
-  const size_t num_layers
+  const size_t num_layers,
+  const bool quiet
 ) : 
   _bias{bias},
   _num_neurons{num_neurons},
   _num_layers{num_layers},
-  _threads{threads}
+  _threads{threads},
+  _is_quiet{quiet}
 {
-  _sec_size = get_sec_size<T>(Base<T>::_num_neurons);
-  _num_secs = (Base<T>::_num_neurons) / _sec_size;
+  //the section geometry is fixed when the model is converted,
+  //so take it from the first layer rather than from the current device
+  _num_secs = num_secs_of_layer_binary<T>(
+    weight_path / ("n" + std::to_string(_num_neurons) + "-l1.b")
+  );
+  _sections = read_model_header(weight_path, _num_neurons, _num_secs);
+  _sec_size = _sections.max_size();
   _load_weight(weight_path);
 }
 
 template <typename T>
 Base<T>::~Base() {
   checkCuda(cudaFreeHost(_host_pinned_weight));
+  _memory.deallocate("weight", _pp_wsize * _num_layers);
 }
 
 template <typename T>
@@ -122,6 +190,7 @@ void Base<T>::_load_weight(const std::fs::path& weight_path) {
   log("Loading the weight......");
 
   tic();
+  _memory.phase("load");
 
   _max_nnz = find_max_nnz_binary(
                weight_path,
@@ -152,6 +221,7 @@ void Base<T>::_load_weight(const std::fs::path& weight_path) {
     (void**)&_host_pinned_weight,
     _pp_wsize * _num_layers
   ));
+  _memory.allocate("weight", _pp_wsize * _num_layers);
 
   std::memset(
     _host_pinned_weight,
@@ -176,7 +246,9 @@ void Base<T>::_load_weight(const std::fs::path& weight_path) {
 template <typename T>
 template <typename... ArgsT>
 void Base<T>::log(ArgsT&&... args) const {
-  _cout(std::forward<ArgsT>(args)...);
+  if(!_is_quiet) {
+    _cout(std::forward<ArgsT>(args)...);
+  }
 }
 
 template<typename T>
@@ -218,6 +290,168 @@ void Base<T>::_cout(First&& item, Remain&&... remain) const {
   _cout(std::forward<Remain>(remain)...);
 }
 
+template <typename T>
+const MemoryTracker& Base<T>::memory() const {
+  return _memory;
+}
+
+template <typename T>
+void Base<T>::report(JSONWriter& json) const {
+  json.field("num_neurons", _num_neurons);
+  json.field("num_layers", _num_layers);
+  json.field("num_secs", _num_secs);
+  json.field("sec_size", _sec_size);
+  if(!_sections.is_uniform()) {
+    json.key("sec_offsets").begin_array();
+    for(auto o : _sections.offsets) {
+      json.value(o);
+    }
+    json.end_array();
+  }
+  json.field("max_nnz", _max_nnz);
+  json.field("bias", _bias);
+  json.field("num_gpus", _num_gpus);
+  json.field("num_inputs", _num_inputs);
+  json.key("memory");
+  _memory.dump(json);
+  json.key("affinity");
+  _placement.dump(json);
+}
+
+template <typename T>
+void Base<T>::_require_uniform_sections(const std::string& engine) const {
+  if(!_sections.is_uniform()) {
+    throw std::runtime_error(
+      engine + " needs equal sections, the model header has sections of different widths up to "
+      + std::to_string(_sec_size) + " neurons"
+    );
+  }
+}
+
+template <typename T>
+void Base<T>::set_affinity(const AffinityPolicy policy) {
+  log("Affinity policy : ", to_string(policy), "\n");
+  _placement.set_policy(policy);
+}
+
+template <typename T>
+void Base<T>::set_quiet(const bool quiet) {
+  _is_quiet = quiet;
+}
+
+template <typename T>
+ThreadPlacement& Base<T>::placement() {
+  return _placement;
+}
+
+template <typename T>
+const ThreadPlacement& Base<T>::placement() const {
+  return _placement;
+}
+
+template <typename T>
+size_t Base<T>::layer_bytes() const {
+  return _pp_wsize;
+}
+
+template <typename T>
+void Base<T>::attach_metrics(MetricsRegistry& registry) {
+  _metrics = &registry;
+  _batch_latency = &registry.histogram(
+    "snig_batch_latency_seconds",
+    "time to infer one input batch through all layers",
+    {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25}
+  );
+}
+
+template <typename T>
+void Base<T>::_observe_batch(const double seconds) {
+  if(_batch_latency) {
+    _batch_latency->observe(seconds);
+  }
+}
+
+template <typename T>
+void Base<T>::_publish_metrics(const int* results, const double infer_ms) {
+  if(!_metrics) {
+    return;
+  }
+  _publish_metrics(CategoryBitset(results, _num_inputs), infer_ms);
+}
+
+template <typename T>
+void Base<T>::_publish_metrics(const CategoryBitset& categories, const double infer_ms) {
+  if(!_metrics) {
+    return;
+  }
+
+  _metrics->counter(
+    "snig_inferences_total",
+    "number of inference calls"
+  ).add();
+
+  _metrics->counter(
+    "snig_inputs_total",
+    "number of inferred inputs"
+  ).add(_num_inputs);
+
+  _metrics->counter(
+    "snig_infer_seconds_total",
+    "time spent in inference"
+  ).add(infer_ms / 1000);
+
+  _metrics->gauge(
+    "snig_throughput_inputs_per_second",
+    "throughput of the last inference call"
+  ).set(infer_ms > 0 ? 1000 * _num_inputs / infer_ms : 0);
+
+  //an input is active if any neuron of the last layer is nonzero
+  size_t num_active = categories.count();
+  _metrics->gauge(
+    "snig_active_row_ratio",
+    "ratio of inputs with nonzero rows after the last layer"
+  ).set(_num_inputs ? double(num_active) / _num_inputs : 0);
+
+  for(const auto& c : _memory.categories()) {
+    std::string labels = "category=\"" + c.first + "\"";
+    _metrics->gauge(
+      "snig_memory_bytes",
+      "bytes currently held by the engine",
+      labels
+    ).set(c.second.current);
+    _metrics->gauge(
+      "snig_memory_peak_bytes",
+      "peak bytes held by the engine",
+      labels
+    ).set(c.second.peak);
+  }
+}
+
+template <typename T>
+void Base<T>::_publish_pipeline(const PipelineStats& stats) {
+  if(!_metrics) {
+    return;
+  }
+  for(const auto& s : stats.stages()) {
+    std::string labels = "stage=\"" + s.name + "\"";
+    _metrics->gauge(
+      "snig_stage_utilization",
+      "busy time over wall time of a stage in the last inference call",
+      labels
+    ).set(s.utilization(stats.wall_ms()));
+    _metrics->counter(
+      "snig_stage_producer_wait_seconds_total",
+      "time a stage was starved by its producer",
+      labels
+    ).add(s.producer_wait_ms / 1000);
+    _metrics->counter(
+      "snig_stage_consumer_wait_seconds_total",
+      "time a stage was blocked handing batches to its consumer",
+      labels
+    ).add(s.consumer_wait_ms / 1000);
+  }
+}
+
 template <typename T>
 size_t Base<T>::num_neurons() const {
    return _num_neurons; 
@@ -100,25 +100,31 @@ BF<T>::BF(
   Base<T>(threads, weight_path, bias, num_neurons, num_layers)
 {
   Base<T>::log("Constructing BF method......", "\n");
+  Base<T>::_require_uniform_sections("BF");
 }
 
 template <typename T>
 BF<T>:: ~BF() {
   for(auto& each_Y : _Y) {
     checkCuda(cudaFree(each_Y));
+    Base<T>::_memory.deallocate("activation", sizeof(T) * Base<T>::_num_inputs * Base<T>::_num_neurons);
   }
   for(auto& each_rowsY : _rowsY) {
     checkCuda(cudaFree(each_rowsY));
+    Base<T>::_memory.deallocate("row_index", sizeof(int) * Base<T>::_num_inputs);
   }
   for(auto& each_rlenY : _rlenY) {
     checkCuda(cudaFree(each_rlenY));
+    Base<T>::_memory.deallocate("row_index", sizeof(int) * Base<T>::_num_inputs);
   }
   for(auto& each_dev_W : _dev_W) {
     for(auto& w : each_dev_W) {
       checkCuda(cudaFree(w));
+      Base<T>::_memory.deallocate("device_weight", Base<T>::_pp_wsize);
     }
   }
   checkCuda(cudaFree(_results));
+  Base<T>::_memory.deallocate("result", sizeof(int) * Base<T>::_num_inputs);
 }
 
 template <typename T>
@@ -160,6 +166,7 @@ template <typename T>
 void BF<T>::_preprocess(const std::fs::path& input_path) {
   Base<T>::log("Preprocessing...... ");
   Base<T>::tic();
+  Base<T>::_memory.phase("preprocess");
 
   //weight allocation
   _weight_alloc();
@@ -182,6 +189,7 @@ template <typename T>
 void BF<T>::_infer() {
   Base<T>::log("Start inference...... ", "\n");
   Base<T>::tic();
+  Base<T>::_memory.phase("infer");
 
   //store results
   std::vector<int*> dev_results(Base<T>::_num_gpus);
@@ -201,6 +209,7 @@ void BF<T>::_infer() {
   #pragma omp parallel num_threads(Base<T>::_num_gpus)
   {
     int dev = omp_get_thread_num(); 
+    Base<T>::_placement.pin("omp", dev);
     checkCuda(cudaSetDevice(dev));
     checkCuda(cudaStreamCreate(&dev_stream[dev][0]));
     checkCuda(cudaStreamCreate(&dev_stream[dev][1]));
@@ -258,7 +267,12 @@ void BF<T>::_infer() {
   }
 
   Base<T>::toc();
-  Base<T>::log("Finish inference with ", Base<T>::duration(), " ms", "\n");
+  auto infer_ms = Base<T>::duration();
+  Base<T>::log("Finish inference with ", infer_ms, " ms", "\n");
+
+  //BF infers all inputs at once
+  Base<T>::_observe_batch(infer_ms / 1000.0);
+  Base<T>::_publish_metrics(_results, infer_ms);
 }
 
 template <typename T>
@@ -290,6 +304,7 @@ void BF<T>::_weight_alloc() {
       Base<T>::_pp_wsize,
       cudaMemcpyHostToDevice
     ));
+    Base<T>::_memory.allocate("device_weight", 2 * Base<T>::_pp_wsize);
     _dev_W.emplace_back(W);
   }
   checkCuda(cudaSetDevice(0));
@@ -306,6 +321,8 @@ void BF<T>::_input_alloc() {
     checkCuda(cudaMallocManaged(&_rlenY[buff], ry_size));
     checkCuda(cudaMallocManaged(&_Y[buff], ysize));
     checkCuda(cudaMemset(_rowsY[buff], 0, ry_size));
+    Base<T>::_memory.allocate("row_index", 2 * ry_size);
+    Base<T>::_memory.allocate("activation", ysize);
   }
   checkCuda(cudaMemset(_rlenY[0], 1, ry_size));
   checkCuda(cudaMemset(_rlenY[1], 0, ry_size));
@@ -371,6 +388,7 @@ void BF<T>::_result_alloc() {
   //final results allocation
   checkCuda(cudaMallocManaged(&_results, sizeof(int) * Base<T>::_num_inputs));
   checkCuda(cudaMemset(_results, 0, sizeof(int) * Base<T>::_num_inputs));
+  Base<T>::_memory.allocate("result", sizeof(int) * Base<T>::_num_inputs);
 }
 
 }// end of namespace snig ----------------------------------------------
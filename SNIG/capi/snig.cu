@@ -0,0 +1,257 @@
+#include <SNIG/capi/snig.h>
+#include <SNIG/snig_cpu/snig_cpu.hpp>
+#include <SNIG/utility/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <experimental/filesystem>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// libsnig, the C API of SNIG/capi/snig.h over SNIGCPU<float>
+//
+// No exception crosses the API, every entry point catches them
+// and keeps the message for snig_last_error. A std::invalid_argument
+// is a wrong call (SNIG_INVALID_ARGUMENT), any other exception an engine
+// failure (SNIG_ERROR). The engine is quiet from its
+// construction on, the library never writes to the caller's stdout.
+
+struct snig_engine {
+
+  snig_engine(
+    const char* weight_path,
+    const snig_options& options,
+    const snig::CPUSchedule schedule,
+    const snig::WeightLayout weight_layout
+  ):
+    engine{weight_path, options.bias, options.num_neurons, options.num_layers, true},
+    num_threads{options.num_threads > 0 ? options.num_threads : std::max(1u, std::thread::hardware_concurrency())},
+    batch_size{options.batch_size}
+  {
+    engine.set_schedule(schedule);
+    engine.set_weight_layout(weight_layout);
+  }
+
+  snig::SNIGCPU<float> engine;
+  size_t num_threads;
+  size_t batch_size;
+
+  double infer_ms{0};
+  size_t num_inferences{0};
+  size_t total_inputs{0};
+  double total_infer_ms{0};
+
+  //runs infer and counts it
+  template <typename F>
+  void timed(const size_t num_inputs, F&& infer) {
+    auto beg = std::chrono::steady_clock::now();
+    infer();
+    infer_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beg).count();
+    ++num_inferences;
+    total_inputs += num_inputs;
+    total_infer_ms += infer_ms;
+  }
+};
+
+namespace {
+
+thread_local std::string last_error;
+thread_local int last_status{SNIG_OK};
+
+//calls f and turns its exception into a snig_status and the message of snig_last_error
+template <typename F>
+int guarded(F&& f) {
+  try {
+    f();
+    return SNIG_OK;
+  }
+  catch(const std::invalid_argument& e) {
+    last_error = e.what();
+    last_status = SNIG_INVALID_ARGUMENT;
+  }
+  catch(const std::exception& e) {
+    last_error = e.what();
+    last_status = SNIG_ERROR;
+  }
+  catch(...) {
+    last_error = "unknown error";
+    last_status = SNIG_ERROR;
+  }
+  return last_status;
+}
+
+//a struct of another snig.h would be misread
+template <typename S>
+void check_struct_size(const S& s, const char* name) {
+  if(s.struct_size != sizeof(S)) {
+    throw std::invalid_argument(
+      std::string(name) + ".struct_size is " + std::to_string(s.struct_size) +
+      ", this libsnig takes " + std::to_string(sizeof(S))
+    );
+  }
+}
+
+//the engine reads every layer file without checking it is there
+void check_layer_files(const char* weight_path, const snig_options& options) {
+  if(options.num_neurons == 0 || options.num_layers == 0) {
+    throw std::invalid_argument("snig_options needs at least one neuron and one layer");
+  }
+  std::fs::path weight_dir(weight_path);
+  if(!std::fs::is_directory(weight_dir)) {
+    throw std::invalid_argument(weight_dir.string() + " is not a weight directory");
+  }
+  for(size_t l = 1; l <= options.num_layers; ++l) {
+    auto p = weight_dir / ("n" + std::to_string(options.num_neurons) + "-l" + std::to_string(l) + ".b");
+    if(!std::fs::is_regular_file(p)) {
+      throw std::invalid_argument(
+        "snig_options has " + std::to_string(options.num_layers) + " layers of " +
+        std::to_string(options.num_neurons) + " neurons, but " + p.string() + " (layer " +
+        std::to_string(l) + ") does not exist"
+      );
+    }
+  }
+}
+
+//an option the engine does not know is the caller's mistake
+template <typename F>
+auto parse_option(const char* name, const char* value, F&& parse) -> decltype(parse(value)) {
+  try {
+    return parse(value);
+  }
+  catch(const std::exception& e) {
+    throw std::invalid_argument(std::string("snig_options.") + name + ": " + e.what());
+  }
+}
+
+}// end of namespace ----------------------------------------------
+
+extern "C" {
+
+void snig_default_options(snig_options* options) {
+  options->struct_size = sizeof(snig_options);
+  options->num_neurons = 1024;
+  options->num_layers = 120;
+  options->bias = -0.3f;
+  options->num_threads = 0;
+  options->batch_size = 5000;
+  options->schedule = nullptr;
+  options->weight_layout = nullptr;
+}
+
+snig_engine* snig_create(const char* weight_path, const snig_options* options) {
+  snig_engine* engine{nullptr};
+  guarded([&]{
+    if(weight_path == nullptr || options == nullptr) {
+      throw std::invalid_argument("snig_create needs a weight path and options");
+    }
+    check_struct_size(*options, "snig_options");
+    if(options->batch_size == 0) {
+      throw std::invalid_argument("batch size must be positive");
+    }
+    auto schedule = options->schedule == nullptr ? snig::CPUSchedule::batch :
+      parse_option("schedule", options->schedule, [](const char* v){ return snig::to_cpu_schedule(v); });
+    auto weight_layout = options->weight_layout == nullptr ? snig::WeightLayout::split :
+      parse_option("weight_layout", options->weight_layout, [](const char* v){ return snig::to_weight_layout(v); });
+    check_layer_files(weight_path, *options);
+    engine = new snig_engine(weight_path, *options, schedule, weight_layout);
+  });
+  return engine;
+}
+
+void snig_destroy(snig_engine* engine) {
+  delete engine;
+}
+
+int snig_infer_dense(
+  snig_engine* engine,
+  const float* rows,
+  size_t num_inputs,
+  int* categories
+) {
+  return guarded([&]{
+    if(engine == nullptr || rows == nullptr) {
+      throw std::invalid_argument("snig_infer_dense needs an engine and rows");
+    }
+    engine->timed(num_inputs, [&]{
+      engine->engine.infer_dense(rows, num_inputs, engine->batch_size, engine->num_threads, categories);
+    });
+  });
+}
+
+int snig_infer_csr(
+  snig_engine* engine,
+  const size_t* row_ptr,
+  const int* col_idx,
+  const float* values,
+  size_t num_inputs,
+  int* categories
+) {
+  return guarded([&]{
+    if(engine == nullptr || row_ptr == nullptr || col_idx == nullptr || values == nullptr) {
+      throw std::invalid_argument("snig_infer_csr needs an engine, row_ptr, col_idx, and values");
+    }
+    engine->timed(num_inputs, [&]{
+      engine->engine.infer_csr(
+        row_ptr, col_idx, values, num_inputs, engine->batch_size, engine->num_threads, categories
+      );
+    });
+  });
+}
+
+int snig_get_stats(const snig_engine* engine, snig_stats* stats) {
+  return guarded([&]{
+    if(engine == nullptr || stats == nullptr) {
+      throw std::invalid_argument("snig_get_stats needs an engine and stats");
+    }
+    check_struct_size(*stats, "snig_stats");
+    const auto& latencies = engine->engine.batch_latencies();
+    stats->num_inputs = engine->engine.categories().num_inputs();
+    stats->num_active = engine->engine.categories().count();
+    stats->infer_ms = engine->infer_ms;
+    stats->num_batches = latencies.size();
+    stats->mean_batch_ms = latencies.empty() ? 0 :
+      1000 * std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+    stats->max_batch_ms = latencies.empty() ? 0 :
+      1000 * *std::max_element(latencies.begin(), latencies.end());
+    stats->num_inferences = engine->num_inferences;
+    stats->total_inputs = engine->total_inputs;
+    stats->total_infer_ms = engine->total_infer_ms;
+    stats->memory_bytes = engine->engine.memory().current();
+    stats->peak_memory_bytes = engine->engine.memory().peak();
+  });
+}
+
+size_t snig_report(const snig_engine* engine, char* buffer, size_t size) {
+  std::string report;
+  guarded([&]{
+    if(engine == nullptr) {
+      throw std::invalid_argument("snig_report needs an engine");
+    }
+    std::ostringstream os;
+    snig::JSONWriter json(os);
+    json.begin_object();
+    engine->engine.report(json);
+    json.end_object();
+    report = os.str();
+  });
+  if(buffer != nullptr && size > 0) {
+    size_t len = std::min(report.size(), size - 1);
+    std::memcpy(buffer, report.data(), len);
+    buffer[len] = '\0';
+  }
+  return report.size();
+}
+
+const char* snig_last_error(void) {
+  return last_error.c_str();
+}
+
+int snig_last_status(void) {
+  return last_status;
+}
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// libsnig is built with hidden visibility and exports only these functions
+#if defined(__GNUC__)
+#define SNIG_API __attribute__((visibility("default")))
+#else
+#define SNIG_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C API of libsnig
+//
+// An engine runs the SNIG_CPU engine in float on one packed model,
+// the weight directory written by to_binary or mtx_to_binary.
+// Inputs are read where the caller keeps them and categories are written
+// where the caller wants them, nothing is copied at the boundary.
+//
+// Functions returning int return SNIG_OK (0) on success and a negative
+// snig_status on failure, snig_last_error then tells why.
+// snig_create returns NULL on failure, snig_last_status tells which.
+// An engine runs one inference at a time, different engines may run
+// at the same time.
+//
+// snig_options and snig_stats start with their own size, so a library
+// built from a different snig.h refuses them instead of misreading them.
+// snig_default_options sets it, snig_stats needs it set before snig_get_stats.
+//
+// API: snig_options options;
+//      snig_default_options(&options);
+//      snig_engine* engine = snig_create("weight/neuron1024", &options);
+//      snig_infer_dense(engine, rows, 60000, categories);
+//      snig_stats stats;
+//      stats.struct_size = sizeof(stats);
+//      snig_get_stats(engine, &stats);
+//      snig_destroy(engine);
+
+typedef struct snig_engine snig_engine;
+
+typedef enum snig_status {
+  SNIG_OK = 0,
+
+  // the engine failed: a file it could not read, memory it could not get
+  SNIG_ERROR = -1,
+
+  // the call was wrong: a NULL argument, a struct_size of another snig.h,
+  // an unknown schedule or layout, a layer the weight directory does not hold
+  SNIG_INVALID_ARGUMENT = -2
+} snig_status;
+
+typedef struct snig_options {
+  // sizeof(snig_options)
+  size_t struct_size;
+
+  // neurons per layer and layers of the model
+  size_t num_neurons;
+  size_t num_layers;
+  float bias;
+
+  // 0 : the number of hardware threads
+  size_t num_threads;
+
+  // inputs a thread takes at a time
+  size_t batch_size;
+
+  // "batch" or "section", NULL : batch
+  const char* schedule;
+
+  // "split", "interleaved", "sell", "bsr", or "blocked", NULL : split
+  const char* weight_layout;
+} snig_options;
+
+typedef struct snig_stats {
+  // sizeof(snig_stats)
+  size_t struct_size;
+
+  // of the last inference
+  size_t num_inputs;
+  size_t num_active;
+  double infer_ms;
+  size_t num_batches;
+  double mean_batch_ms;
+  double max_batch_ms;
+
+  // of all inferences of the engine
+  size_t num_inferences;
+  size_t total_inputs;
+  double total_infer_ms;
+
+  // bytes held by the engine, the weights included
+  size_t memory_bytes;
+  size_t peak_memory_bytes;
+} snig_stats;
+
+// struct_size, 1024 neurons, 120 layers, bias -0.3, all hardware threads, batches of 5000
+SNIG_API void snig_default_options(snig_options* options);
+
+// loads the model, NULL on failure,
+// SNIG_INVALID_ARGUMENT if a layer file n<num_neurons>-l<i>.b is missing
+SNIG_API snig_engine* snig_create(const char* weight_path, const snig_options* options);
+
+SNIG_API void snig_destroy(snig_engine* engine);
+
+// infers num_inputs x num_neurons dense row-major rows,
+// categories, if not NULL, receives one int per input (1 if active)
+SNIG_API int snig_infer_dense(
+  snig_engine* engine,
+  const float* rows,
+  size_t num_inputs,
+  int* categories
+);
+
+// infers CSR rows, row i holds the columns col_idx[row_ptr[i] .. row_ptr[i + 1])
+// and their values, categories as snig_infer_dense
+SNIG_API int snig_infer_csr(
+  snig_engine* engine,
+  const size_t* row_ptr,
+  const int* col_idx,
+  const float* values,
+  size_t num_inputs,
+  int* categories
+);
+
+SNIG_API int snig_get_stats(const snig_engine* engine, snig_stats* stats);
+
+// writes the run report of the engine in JSON, as snprintf:
+// at most size bytes with the terminating zero, returns the length of the whole report
+SNIG_API size_t snig_report(const snig_engine* engine, char* buffer, size_t size);
+
+// why the last failing call of this thread failed
+SNIG_API const char* snig_last_error(void);
+
+// snig_status of the last failing call of this thread, SNIG_OK if none failed
+SNIG_API int snig_last_status(void);
+
+#ifdef __cplusplus
+}
+#endif
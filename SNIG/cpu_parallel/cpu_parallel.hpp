@@ -0,0 +1,264 @@
+#pragma once
+
+#include <Eigen/SparseCore>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/matrix_format.h>
+#include <SNIG/utility/cuda_error.hpp>
+#include <SNIG/utility/scoring.hpp>
+#include <SNIG/utility/thread_pool.hpp>
+#include <SNIG/sequential/kernel.hpp>
+#include <SNIG/base/base.hpp>
+#include <vector>
+#include <future>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig{
+
+template <typename T>
+class CPUParallel : public Base<T> {
+  //Data-parallel Eigen baseline
+  //every task runs a range of rows of the single CSR input through all layers.
+  //Tasks take row-range views of the input instead of copied slices,
+  //and write their categories straight into the shared results.
+
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  private:
+
+    Eigen::SparseMatrix<T, Eigen::RowMajor> _source_Y;
+
+    std::vector<PackedLayerView<T> > _weights;
+
+    std::vector<int> _results;
+
+    size_t _batch_size;
+    size_t _num_threads;
+
+    void _set_parameters(
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads
+    );
+
+    void _task(const size_t beg_inputs, const size_t num_rows);
+
+    void _preprocess(const std::fs::path& input_path);
+
+    void _infer();
+
+    void _weight_alloc();
+
+    void _input_alloc();
+
+    void _result_alloc();
+
+    size_t _input_bytes() const;
+
+  public:
+
+    CPUParallel(
+      const std::fs::path& weight_path,
+      const T bias = -.3f,
+      const size_t num_neurons_per_layer = 1024,
+      const size_t num_layers = 120
+    );
+
+    ~CPUParallel();
+
+    void report(JSONWriter& json) const override;
+
+    size_t num_threads() const;
+
+    Eigen::Matrix<int, Eigen::Dynamic, 1> infer(
+      const std::fs::path& input_path,
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads
+    );
+
+};
+
+// ----------------------------------------------------------------------------
+// Definition of CPUParallel
+// ----------------------------------------------------------------------------
+
+template <typename T>
+CPUParallel<T>::CPUParallel(
+  const std::fs::path& weight_path,
+  const T bias,
+  const size_t num_neurons_per_layer,
+  const size_t num_layers
+):
+  Base<T>(dim3{1, 1, 1}, weight_path, bias, num_neurons_per_layer, num_layers)
+{
+  Base<T>::log("Constructing CPUParallel engine......", "\n");
+}
+
+template <typename T>
+CPUParallel<T>::~CPUParallel() {
+  Base<T>::_memory.deallocate("input", _input_bytes());
+  Base<T>::_memory.deallocate("result", sizeof(int) * _results.size());
+}
+
+template <typename T>
+Eigen::Matrix<int, Eigen::Dynamic, 1> CPUParallel<T>::infer(
+  const std::fs::path& input_path,
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads
+) {
+  _set_parameters(
+    num_inputs,
+    batch_size,
+    num_threads
+  );
+
+  _preprocess(input_path);
+
+  _infer();
+
+  return arr_to_Eigen_int(_results.data(), Base<T>::_num_inputs);
+}
+
+template <typename T>
+void CPUParallel<T>::report(JSONWriter& json) const {
+  Base<T>::report(json);
+  json.field("batch_size", _batch_size);
+  json.field("num_threads", _num_threads);
+}
+
+template <typename T>
+size_t CPUParallel<T>::num_threads() const {
+  return _num_threads;
+}
+
+template <typename T>
+void CPUParallel<T>::_set_parameters(
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads
+) {
+  Base<T>::log("Using ", num_threads, " threads", "\n");
+  Base<T>::log("Total input size : ", num_inputs, "\n");
+  Base<T>::log("Input batch size : ", batch_size, "\n\n");
+
+  Base<T>::_num_inputs = num_inputs;
+  _batch_size = batch_size;
+  _num_threads = num_threads;
+}
+
+template <typename T>
+void CPUParallel<T>::_preprocess(const std::fs::path& input_path) {
+  Base<T>::log("Preprocessing...... ");
+  Base<T>::tic();
+  Base<T>::_memory.phase("preprocess");
+
+  //weight views over the packed host copy
+  _weight_alloc();
+  //read input
+  Base<T>::_memory.deallocate("input", _input_bytes());
+  _source_Y = read_input_binary_to_CSR<T>(input_path);
+  _input_alloc();
+  //final results allocation
+  _result_alloc();
+
+  Base<T>::toc();
+  Base<T>::log("Finish preprocessing with ", Base<T>::duration(), " ms", "\n");
+}
+
+template <typename T>
+void CPUParallel<T>::_infer() {
+  Base<T>::log("Start inference...... ", "\n");
+  Base<T>::tic();
+  Base<T>::_memory.phase("infer");
+
+  {
+    ThreadPool pool(_num_threads, &(Base<T>::_placement));
+    std::vector<std::future<void> > futures;
+    for(size_t beg_inputs = 0; beg_inputs < Base<T>::_num_inputs; beg_inputs += _batch_size) {
+      futures.emplace_back(pool.enqueue(
+        [this, beg_inputs]() {
+          _task(beg_inputs, std::min(_batch_size, Base<T>::_num_inputs - beg_inputs));
+        }
+      ));
+    }
+    for(auto& f : futures) {
+      f.get();
+    }
+  }
+
+  Base<T>::toc();
+  auto infer_ms = Base<T>::duration();
+  Base<T>::log("Finish inference with ", infer_ms, " ms", "\n");
+
+  Base<T>::_publish_metrics(_results.data(), infer_ms);
+}
+
+template <typename T>
+void CPUParallel<T>::_task(const size_t beg_inputs, const size_t num_rows) {
+  auto beg = std::chrono::steady_clock::now();
+
+  //rows of a row-major CSR matrix are contiguous, so the block is a view
+  Eigen::SparseMatrix<T, Eigen::RowMajor> y = eigen_inference<T>(
+    _source_Y.middleRows(beg_inputs, num_rows),
+    _weights[0],
+    Base<T>::_num_neurons,
+    Base<T>::_num_secs,
+    Base<T>::_bias
+  );
+  for(size_t cur_layer = 1; cur_layer < Base<T>::_num_layers; ++cur_layer) {
+    y = eigen_inference<T>(
+      y,
+      _weights[cur_layer],
+      Base<T>::_num_neurons,
+      Base<T>::_num_secs,
+      Base<T>::_bias
+    );
+  }
+
+  eigen_identify<T>(y, _results.data() + beg_inputs);
+
+  Base<T>::_observe_batch(std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - beg
+  ).count());
+}
+
+template <typename T>
+void CPUParallel<T>::_weight_alloc() {
+  _weights.clear();
+  for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+    _weights.emplace_back(packed_layer_view<T>(
+      Base<T>::_host_pinned_weight + l * Base<T>::_pp_wlen,
+      Base<T>::_num_neurons,
+      Base<T>::_num_secs,
+      Base<T>::_pp_w_index_len
+    ));
+  }
+}
+
+template <typename T>
+void CPUParallel<T>::_input_alloc() {
+  Base<T>::_memory.allocate("input", _input_bytes());
+}
+
+template <typename T>
+void CPUParallel<T>::_result_alloc() {
+  Base<T>::_memory.deallocate("result", sizeof(int) * _results.size());
+  _results.assign(Base<T>::_num_inputs, 0);
+  Base<T>::_memory.allocate("result", sizeof(int) * Base<T>::_num_inputs);
+}
+
+template <typename T>
+size_t CPUParallel<T>::_input_bytes() const {
+  //values, column indices, and row offsets of the CSR input
+  return _source_Y.outerSize() == 0 ? 0 :
+    (sizeof(T) + sizeof(int)) * _source_Y.nonZeros() + sizeof(int) * (_source_Y.outerSize() + 1);
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -9,6 +9,7 @@
 // use the same kernel as SNIG
 #include <SNIG/snig/kernel.hpp>
 #include <SNIG/base/base.hpp>
+#include <SNIG/utility/pipeline_stats.hpp>
 #include <vector>
 #include <queue>
 #include <mutex>
@@ -47,6 +48,9 @@ class GPipe : public Base<T> {
     size_t _batch_ysize;
     int* _results;
 
+    //queue occupancy and stalls of each device (stage)
+    PipelineStats _stats;
+
     void _set_parameters(
       const size_t num_inputs,
       const size_t batch_size,
@@ -75,6 +79,10 @@ class GPipe : public Base<T> {
 
     ~GPipe();
 
+    void report(JSONWriter& json) const override;
+
+    const PipelineStats& pipeline_stats() const;
+
     Eigen::Matrix<int, Eigen::Dynamic, 1> infer(
       const std::fs::path& input_path,
       const size_t num_inputs,
@@ -99,22 +107,29 @@ GPipe<T>::GPipe(
   Base<T>(threads, weight_path, bias, num_neurons_per_layer, num_layers)
 {
   Base<T>::log("Constructing GPipe......", "\n");
+  Base<T>::_require_uniform_sections("GPipe");
 }
 
 template <typename T>
 GPipe<T>::~GPipe() {
   checkCuda(cudaFree(_source_Y));
   checkCuda(cudaFree(_source_is_nonzero_row));
+  Base<T>::_memory.deallocate("input", sizeof(T) * Base<T>::_num_inputs * Base<T>::_num_neurons);
+  Base<T>::_memory.deallocate("row_mask", sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs);
   for(auto& W_in_dev : _dev_record_W) {
       checkCuda(cudaFree(W_in_dev));
+      Base<T>::_memory.deallocate("device_weight", Base<T>::_pp_wsize * _num_layers_per_gpu);
   }
   for(auto& Y_in_dev : _dev_Y) {
       checkCuda(cudaFree(Y_in_dev[1]));
+      Base<T>::_memory.deallocate("activation", _batch_ysize);
   }
   for(auto& rowsY_in_dev : _dev_is_nonzero_row) {
       checkCuda(cudaFree(rowsY_in_dev[1]));
+      Base<T>::_memory.deallocate("row_mask", sizeof(bool) * _batch_size * Base<T>::_num_secs);
   }
   checkCuda(cudaFree(_results));
+  Base<T>::_memory.deallocate("result", sizeof(int) * Base<T>::_num_inputs);
 }
 
 template <typename T>
@@ -137,6 +152,20 @@ Eigen::Matrix<int, Eigen::Dynamic, 1> GPipe<T>::infer(
   return arr_to_Eigen_int(_results, num_inputs);
 }
 
+template <typename T>
+void GPipe<T>::report(JSONWriter& json) const {
+  Base<T>::report(json);
+  json.field("batch_size", _batch_size);
+  json.field("num_layers_per_gpu", _num_layers_per_gpu);
+  json.key("pipeline");
+  _stats.dump(json);
+}
+
+template <typename T>
+const PipelineStats& GPipe<T>::pipeline_stats() const {
+  return _stats;
+}
+
 template <typename T>
 void GPipe<T>::_set_parameters(
   const size_t num_inputs,
@@ -164,6 +193,7 @@ template <typename T>
 void GPipe<T>::_preprocess(const std::fs::path& input_path) {
   Base<T>::log("Preprocessing...... ");
   Base<T>::tic();
+  Base<T>::_memory.phase("preprocess");
 
   //weight allocation
   _weight_alloc();
@@ -185,6 +215,7 @@ template <typename T>
 void GPipe<T>::_infer() {
   Base<T>::log("Start inference...... ", "\n");
   Base<T>::tic();
+  Base<T>::_memory.phase("infer");
 
   for(size_t dev = 0; dev < Base<T>::_num_gpus; ++dev) {
     cudaSetDevice(dev);
@@ -212,10 +243,22 @@ void GPipe<T>::_infer() {
 
   dim3 grid_dim(_batch_size, Base<T>::_num_secs, 1);
 
+  //time each batch enters the first device, for end-to-end batch latency
+  std::vector<PipelineStats::clock::time_point> batch_beg(num_batches);
+
+  _stats.reset(Base<T>::_num_gpus);
+  for(size_t dev = 0; dev < Base<T>::_num_gpus; ++dev) {
+    _stats[dev].name = "gpu" + std::to_string(dev);
+    _stats[dev].first_layer = dev * _num_layers_per_gpu;
+    _stats[dev].last_layer = (dev + 1) * _num_layers_per_gpu;
+  }
+  _stats.start();
+
   #pragma omp parallel num_threads(Base<T>::_num_gpus)
   {
     bool stop = false;
     int dev = omp_get_thread_num(); 
+    Base<T>::_placement.pin("omp", dev);
     checkCuda(cudaSetDevice(dev));
     cudaStream_t infer_stream;
     checkCuda(cudaStreamCreate(&infer_stream));
@@ -223,34 +266,35 @@ void GPipe<T>::_infer() {
     while(!stop) {
       size_t beg_inputs;
 
-      if(dev != 0) {
-        //check if current queue is empty
-        {
-          std::unique_lock<std::mutex> lock(dev_que_mutex[dev]);
-          dev_que_cv[dev].wait(lock, [&](){ return !dev_start_batch[dev].empty();});
-        }
-      }
-
+      auto wait_beg = PipelineStats::clock::now();
       {
         //get batch to infer
+        //the first device owns all batches and never waits
         std::unique_lock<std::mutex> lock(dev_que_mutex[dev]);
+        dev_que_cv[dev].wait(lock, [&](){ return !dev_start_batch[dev].empty();});
+        _stats.sample_depth(dev, dev_start_batch[dev].size());
         beg_inputs = dev_start_batch[dev].front();
         dev_start_batch[dev].pop();
       }
+      _stats.add_producer_wait(dev, wait_beg);
 
       if(beg_inputs == Base<T>::_num_inputs) {
         //notify next device to finish
         if(dev != Base<T>::_num_gpus - 1) {
           {
-            std::unique_lock<std::mutex> lock(dev_que_mutex[dev]);
+            std::unique_lock<std::mutex> lock(dev_que_mutex[dev + 1]);
             dev_start_batch[dev + 1].emplace(Base<T>::_num_inputs);
-            dev_que_cv[dev + 1].notify_one();
           }
+          dev_que_cv[dev + 1].notify_one();
         }
         //this device finished all batches
         stop = true;
         continue;
       }
+      auto busy_beg = PipelineStats::clock::now();
+      if(dev == 0) {
+        batch_beg[beg_inputs / _batch_size] = busy_beg;
+      }
       _dev_Y[dev][0] = _source_Y + beg_inputs * Base<T>::_num_neurons;
       _dev_is_nonzero_row[dev][0] = _source_is_nonzero_row + beg_inputs * Base<T>::_num_secs;
       dev_results[dev] = _results + beg_inputs;
@@ -276,25 +320,42 @@ void GPipe<T>::_infer() {
         checkCuda(cudaStreamSynchronize(infer_stream));
       }
       if(dev != Base<T>::_num_gpus - 1) {
+        _stats.add_busy(dev, busy_beg);
+        ++_stats[dev].num_batches;
+
         //notify next device to infer
+        //queues are unbounded, so handing over only waits on the lock of the next queue
+        auto push_beg = PipelineStats::clock::now();
         {
-          std::unique_lock<std::mutex> lock(dev_que_mutex[dev]);
+          std::unique_lock<std::mutex> lock(dev_que_mutex[dev + 1]);
           dev_start_batch[dev + 1].emplace(beg_inputs);
+          _stats.sample_depth(dev + 1, dev_start_batch[dev + 1].size());
         }
         dev_que_cv[dev + 1].notify_one();
+        _stats.add_consumer_wait(dev, push_beg);
       }
       else {
         //last device identify
         identify<T><<<16, 512, 0, infer_stream>>>(_dev_Y[dev][0], _batch_size, Base<T>::_num_neurons, dev_results[dev]);
         checkCuda(cudaStreamSynchronize(infer_stream));
+        _stats.add_busy(dev, busy_beg);
+        ++_stats[dev].num_batches;
+        Base<T>::_observe_batch(
+          std::chrono::duration<double>(PipelineStats::clock::now() - batch_beg[beg_inputs / _batch_size]).count()
+        );
       }
     }
   }
 
+  _stats.stop();
+
   checkCuda(cudaSetDevice(0));
 
   Base<T>::toc();
-  Base<T>::log("Finish inference with ", Base<T>::duration(), " ms", "\n");
+  auto infer_ms = Base<T>::duration();
+  Base<T>::log("Finish inference with ", infer_ms, " ms", "\n");
+  Base<T>::_publish_metrics(_results, infer_ms);
+  Base<T>::_publish_pipeline(_stats);
 }
 
 template <typename T>
@@ -306,6 +367,7 @@ void GPipe<T>::_weight_alloc() {
       &W,
       Base<T>::_pp_wsize * _num_layers_per_gpu
     ));
+    Base<T>::_memory.allocate("device_weight", Base<T>::_pp_wsize * _num_layers_per_gpu);
     _dev_record_W.emplace_back(W);
     for(size_t cur_layer = 0; cur_layer < _num_layers_per_gpu; ++cur_layer) {
       //record location of weight of each layer
@@ -323,6 +385,8 @@ void GPipe<T>::_input_alloc() {
   checkCuda(cudaMallocManaged(&_source_Y, ysize));
   checkCuda(cudaMallocManaged(&_source_is_nonzero_row, sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs));
   checkCuda(cudaMemset(_source_is_nonzero_row, 1, sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs));
+  Base<T>::_memory.allocate("input", ysize);
+  Base<T>::_memory.allocate("row_mask", sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs);
 
   std::vector<T*> Y{2, nullptr};
   std::vector<bool*> rowsY{2, nullptr};
@@ -332,6 +396,8 @@ void GPipe<T>::_input_alloc() {
     checkCuda(cudaMalloc(&rowsY[1], sizeof(bool) * _batch_size * Base<T>::_num_secs));
     checkCuda(cudaMemset(Y[1], 0, _batch_ysize));
     checkCuda(cudaMemset(rowsY[1], 0, sizeof(bool) * _batch_size * Base<T>::_num_secs));
+    Base<T>::_memory.allocate("activation", _batch_ysize);
+    Base<T>::_memory.allocate("row_mask", sizeof(bool) * _batch_size * Base<T>::_num_secs);
     _dev_Y.push_back(Y);
     _dev_is_nonzero_row.push_back(rowsY);
   }
@@ -342,6 +408,7 @@ template <typename T>
 void GPipe<T>::_result_alloc() {
   checkCuda(cudaMallocManaged(&_results, sizeof(int) * Base<T>::_num_inputs));
   checkCuda(cudaMemset(_results, 0, sizeof(int) * Base<T>::_num_inputs));
+  Base<T>::_memory.allocate("result", sizeof(int) * Base<T>::_num_inputs);
 }
 
 }// end of namespace snig ----------------------------------------------
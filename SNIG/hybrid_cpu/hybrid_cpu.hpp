@@ -0,0 +1,750 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/matrix_format.h>
+#include <SNIG/utility/cuda_error.hpp>
+#include <SNIG/utility/scoring.hpp>
+#include <SNIG/utility/roofline.hpp>
+#include <SNIG/snig_cpu/kernel.hpp>
+#include <SNIG/hybrid_cpu/kernel.hpp>
+#include <SNIG/base/base.hpp>
+#include <omp.h>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig{
+
+enum class LayerStrategy {
+  bf,
+  snig
+};
+
+inline
+std::string to_string(const LayerStrategy strategy);
+
+// what the hybrid engine did with one layer over all batches
+struct LayerStrategyLog {
+  size_t num_bf_batches{0};
+  size_t num_snig_batches{0};
+
+  //summed over batches, of the input of the layer
+  double sum_row_ratio{0};
+  double sum_section_ratio{0};
+
+  LayerStrategyLog& operator += (const LayerStrategyLog& rhs);
+
+  LayerStrategy majority() const;
+
+  double row_ratio() const;
+
+  double section_ratio() const;
+};
+
+template <typename T>
+class HybridCPU : public Base<T> {
+  //BF and SNIG on host cores, switched by depth
+  //every thread takes one batch at a time, the same as SNIGCPU.
+  //A batch starts with the BF kernel (compacted rows, full-width rows),
+  //which suits the dense early layers, and moves to the SNIG kernel
+  //(section-masked) for the remaining layers once the input of a layer has
+  //  surviving rows / rows                   <= row_ratio threshold and
+  //  active (row, section) / (rows * secs)   <= section_ratio threshold.
+  //The thresholds are set by hand or calibrated on the first batch
+  //by timing every layer with both kernels.
+
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  private:
+
+    size_t _batch_size;
+    size_t _num_threads;
+
+    double _row_ratio_threshold{0.5};
+    double _section_ratio_threshold{0.5};
+    bool _is_auto_calibrated{false};
+
+    //layer at which the calibration batch ran fastest switched, and its timings
+    size_t _calibrated_switch_layer{0};
+    std::vector<double> _calibration_bf_ms;
+    std::vector<double> _calibration_snig_ms;
+
+    std::vector<T> _source_Y;
+    std::unique_ptr<bool[]> _source_is_nonzero_row;
+    std::vector<std::vector<T> > _thread_Y;
+    std::vector<std::unique_ptr<bool[]> > _thread_is_nonzero_row;
+    std::vector<std::vector<int> > _thread_rows;
+    std::vector<std::vector<T> > _thread_results;
+
+    //one bit per input
+    CategoryBitset _results;
+
+    std::vector<LayerCounter> _layer_counters;
+    std::vector<LayerStrategyLog> _strategy_log;
+
+    void _set_parameters(
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads
+    );
+
+    //rows of infer_dense, copied into _source_Y by _preprocess instead of the file
+    const T* _caller_Y{nullptr};
+
+    void _preprocess(const std::fs::path& input_path);
+
+    void _calibrate();
+
+    void _infer();
+
+    //runs layers [0, num_layers) of one batch held in Y[0],
+    //switching from BF to SNIG at the first layer that passes the thresholds,
+    //or at switch_layer if given
+    void _infer_batch(
+      std::vector<T*>& Y,
+      std::vector<bool*>& is_nonzero_row,
+      int* rows,
+      T* results,
+      const size_t num_rows,
+      std::vector<LayerCounter>& counters,
+      std::vector<LayerStrategyLog>& strategy_log,
+      const size_t switch_layer = size_t(-1)
+    );
+
+    void _weight_alloc();
+
+    void _input_alloc();
+
+    void _input_free();
+
+    void _result_alloc();
+
+  public:
+
+    HybridCPU(
+      const std::fs::path& weight_path,
+      const T bias = -.3f,
+      const size_t num_neurons_per_layer = 1024,
+      const size_t num_layers = 120
+    );
+
+    ~HybridCPU();
+
+    void report(JSONWriter& json) const override;
+
+    //takes effect at the next infer and turns calibration off
+    void set_switch_thresholds(const double row_ratio, const double section_ratio);
+
+    //calibrate the thresholds on the first batch of every infer
+    void set_auto_calibrate(const bool is_auto_calibrated);
+
+    double row_ratio_threshold() const;
+
+    double section_ratio_threshold() const;
+
+    const std::vector<LayerStrategyLog>& strategy_log() const;
+
+    const std::vector<LayerCounter>& layer_counters() const;
+
+    //categories of the last run, one bit per input
+    const CategoryBitset& categories() const;
+
+    Eigen::Matrix<int, Eigen::Dynamic, 1> infer(
+      const std::fs::path& input_path,
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads
+    );
+
+    //infers num_inputs x num_neurons dense row-major rows of the caller,
+    //copied in since both kernels overwrite their input.
+    //categories, if not null, receives one int per input (1 if active)
+    const CategoryBitset& infer_dense(
+      const T* Y,
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads,
+      int* categories = nullptr
+    );
+
+};
+
+// ----------------------------------------------------------------------------
+// Definition of LayerStrategyLog
+// ----------------------------------------------------------------------------
+
+inline
+std::string to_string(const LayerStrategy strategy) {
+  return strategy == LayerStrategy::bf ? "BF" : "SNIG";
+}
+
+inline
+LayerStrategyLog& LayerStrategyLog::operator += (const LayerStrategyLog& rhs) {
+  num_bf_batches += rhs.num_bf_batches;
+  num_snig_batches += rhs.num_snig_batches;
+  sum_row_ratio += rhs.sum_row_ratio;
+  sum_section_ratio += rhs.sum_section_ratio;
+  return *this;
+}
+
+inline
+LayerStrategy LayerStrategyLog::majority() const {
+  return num_bf_batches >= num_snig_batches ? LayerStrategy::bf : LayerStrategy::snig;
+}
+
+inline
+double LayerStrategyLog::row_ratio() const {
+  size_t n = num_bf_batches + num_snig_batches;
+  return n > 0 ? sum_row_ratio / n : 0;
+}
+
+inline
+double LayerStrategyLog::section_ratio() const {
+  size_t n = num_bf_batches + num_snig_batches;
+  return n > 0 ? sum_section_ratio / n : 0;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of HybridCPU
+// ----------------------------------------------------------------------------
+
+template <typename T>
+HybridCPU<T>::HybridCPU(
+  const std::fs::path& weight_path,
+  const T bias,
+  const size_t num_neurons_per_layer,
+  const size_t num_layers
+):
+  Base<T>(dim3{1, 1, 1}, weight_path, bias, num_neurons_per_layer, num_layers)
+{
+  Base<T>::log("Constructing hybrid CPU engine......", "\n");
+}
+
+template <typename T>
+HybridCPU<T>::~HybridCPU() {
+  _input_free();
+  Base<T>::_memory.deallocate("result", _results.bytes());
+}
+
+template <typename T>
+Eigen::Matrix<int, Eigen::Dynamic, 1> HybridCPU<T>::infer(
+  const std::fs::path& input_path,
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads
+) {
+  _set_parameters(
+    num_inputs,
+    batch_size,
+    num_threads
+  );
+
+  _preprocess(input_path);
+
+  if(_is_auto_calibrated) {
+    _calibrate();
+  }
+
+  _infer();
+
+  return _results.to_Eigen();
+}
+
+template <typename T>
+const CategoryBitset& HybridCPU<T>::infer_dense(
+  const T* Y,
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads,
+  int* categories
+) {
+  _set_parameters(
+    num_inputs,
+    batch_size,
+    num_threads
+  );
+
+  _caller_Y = Y;
+  _preprocess({});
+  _caller_Y = nullptr;
+
+  if(_is_auto_calibrated) {
+    _calibrate();
+  }
+
+  _infer();
+
+  if(categories != nullptr) {
+    for(size_t i = 0; i < num_inputs; ++i) {
+      categories[i] = _results.test(i) ? 1 : 0;
+    }
+  }
+  return _results;
+}
+
+template <typename T>
+const CategoryBitset& HybridCPU<T>::categories() const {
+  return _results;
+}
+
+template <typename T>
+void HybridCPU<T>::report(JSONWriter& json) const {
+  Base<T>::report(json);
+  json.field("batch_size", _batch_size);
+  json.field("num_threads", _num_threads);
+  json.field("auto_calibrated", _is_auto_calibrated);
+  json.field("row_ratio_threshold", _row_ratio_threshold);
+  json.field("section_ratio_threshold", _section_ratio_threshold);
+  if(_is_auto_calibrated) {
+    json.key("calibration").begin_object();
+    json.field("switch_layer", _calibrated_switch_layer);
+    json.field("bf_ms", std::accumulate(_calibration_bf_ms.begin(), _calibration_bf_ms.end(), 0.0));
+    json.field("snig_ms", std::accumulate(_calibration_snig_ms.begin(), _calibration_snig_ms.end(), 0.0));
+    json.end_object();
+  }
+  json.key("layers").begin_array();
+  for(size_t l = 0; l < _strategy_log.size(); ++l) {
+    const auto& s = _strategy_log[l];
+    json.begin_object();
+    json.field("layer", l);
+    json.field("strategy", to_string(s.majority()));
+    json.field("num_bf_batches", s.num_bf_batches);
+    json.field("num_snig_batches", s.num_snig_batches);
+    json.field("row_ratio", s.row_ratio());
+    json.field("section_ratio", s.section_ratio());
+    if(l < _layer_counters.size()) {
+      json.field("ms", 1000 * _layer_counters[l].seconds);
+    }
+    json.end_object();
+  }
+  json.end_array();
+}
+
+template <typename T>
+void HybridCPU<T>::set_switch_thresholds(const double row_ratio, const double section_ratio) {
+  _row_ratio_threshold = row_ratio;
+  _section_ratio_threshold = section_ratio;
+  _is_auto_calibrated = false;
+}
+
+template <typename T>
+void HybridCPU<T>::set_auto_calibrate(const bool is_auto_calibrated) {
+  _is_auto_calibrated = is_auto_calibrated;
+}
+
+template <typename T>
+double HybridCPU<T>::row_ratio_threshold() const {
+  return _row_ratio_threshold;
+}
+
+template <typename T>
+double HybridCPU<T>::section_ratio_threshold() const {
+  return _section_ratio_threshold;
+}
+
+template <typename T>
+const std::vector<LayerStrategyLog>& HybridCPU<T>::strategy_log() const {
+  return _strategy_log;
+}
+
+template <typename T>
+const std::vector<LayerCounter>& HybridCPU<T>::layer_counters() const {
+  return _layer_counters;
+}
+
+template <typename T>
+void HybridCPU<T>::_set_parameters(
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads
+) {
+  Base<T>::log("Using ", num_threads, " threads", "\n");
+  Base<T>::log("Total input size : ", num_inputs, "\n");
+  Base<T>::log("Input batch size : ", batch_size, "\n\n");
+
+  Base<T>::_num_inputs = num_inputs;
+  //a run smaller than a batch needs no full-sized buffers
+  _batch_size = std::max<size_t>(1, std::min(batch_size, num_inputs));
+  _num_threads = num_threads;
+}
+
+template <typename T>
+void HybridCPU<T>::_preprocess(const std::fs::path& input_path) {
+  Base<T>::log("Preprocessing...... ");
+  Base<T>::tic();
+  Base<T>::_memory.phase("preprocess");
+
+  //weights stay in the packed host copy
+  _weight_alloc();
+  //input allocation
+  _input_alloc();
+  //final results allocation
+  _result_alloc();
+
+  //read input
+  if(_caller_Y != nullptr) {
+    std::copy(_caller_Y, _caller_Y + _source_Y.size(), _source_Y.begin());
+  }
+  else {
+    read_input_binary<T>(input_path, _source_Y.data());
+  }
+
+  Base<T>::toc();
+  Base<T>::log("Finish preprocessing with ", Base<T>::duration(), " ms", "\n");
+}
+
+template <typename T>
+void HybridCPU<T>::_calibrate() {
+  Base<T>::log("Calibrating switch thresholds...... ");
+  Base<T>::tic();
+
+  const size_t num_layers = Base<T>::_num_layers;
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+  const size_t num_rows = std::min(_batch_size, Base<T>::_num_inputs);
+
+  //time every layer of the first batch with BF only, then with SNIG only
+  //the kernels overwrite both buffers, so each run starts from a copy
+  std::vector<T> Y_0(_source_Y.begin(), _source_Y.begin() + num_rows * num_neurons);
+  std::unique_ptr<bool[]> is_nonzero_row_0(new bool[num_rows * num_secs]);
+  std::vector<T*> Y(2);
+  std::vector<bool*> is_nonzero_row(2);
+
+  auto run = [&](const size_t switch_layer, std::vector<LayerCounter>& counters, std::vector<LayerStrategyLog>& log) {
+    Y_0.assign(_source_Y.begin(), _source_Y.begin() + num_rows * num_neurons);
+    std::fill(is_nonzero_row_0.get(), is_nonzero_row_0.get() + num_rows * num_secs, true);
+    Y[0] = Y_0.data();
+    is_nonzero_row[0] = is_nonzero_row_0.get();
+    Y[1] = _thread_Y[0].data();
+    is_nonzero_row[1] = _thread_is_nonzero_row[0].get();
+    _infer_batch(
+      Y, is_nonzero_row, _thread_rows[0].data(), _thread_results[0].data(),
+      num_rows, counters, log, switch_layer
+    );
+  };
+
+  std::vector<LayerCounter> bf_counters(num_layers);
+  std::vector<LayerCounter> snig_counters(num_layers);
+  std::vector<LayerStrategyLog> bf_log(num_layers);
+  std::vector<LayerStrategyLog> snig_log(num_layers);
+  run(num_layers, bf_counters, bf_log);
+  run(0, snig_counters, snig_log);
+
+  _calibration_bf_ms.resize(num_layers);
+  _calibration_snig_ms.resize(num_layers);
+  for(size_t l = 0; l < num_layers; ++l) {
+    _calibration_bf_ms[l] = 1000 * bf_counters[l].seconds;
+    _calibration_snig_ms[l] = 1000 * snig_counters[l].seconds;
+  }
+
+  //switch layer of the least total time, BF before it and SNIG from it on
+  double best_ms = std::accumulate(_calibration_snig_ms.begin(), _calibration_snig_ms.end(), 0.0);
+  double total_ms = best_ms;
+  _calibrated_switch_layer = 0;
+  for(size_t l = 0; l < num_layers; ++l) {
+    total_ms += _calibration_bf_ms[l] - _calibration_snig_ms[l];
+    if(total_ms < best_ms) {
+      best_ms = total_ms;
+      _calibrated_switch_layer = l + 1;
+    }
+  }
+
+  //the thresholds are the ratios of the input of the switch layer
+  if(_calibrated_switch_layer == 0) {
+    _row_ratio_threshold = 1;
+    _section_ratio_threshold = 1;
+  }
+  else if(_calibrated_switch_layer == num_layers) {
+    _row_ratio_threshold = -1;
+    _section_ratio_threshold = -1;
+  }
+  else {
+    _row_ratio_threshold = snig_log[_calibrated_switch_layer].row_ratio();
+    _section_ratio_threshold = snig_log[_calibrated_switch_layer].section_ratio();
+  }
+
+  Base<T>::toc();
+  Base<T>::log(
+    "switch at layer ", _calibrated_switch_layer,
+    " (row ratio <= ", _row_ratio_threshold,
+    ", section ratio <= ", _section_ratio_threshold,
+    ") with ", Base<T>::duration(), " ms", "\n"
+  );
+}
+
+template <typename T>
+void HybridCPU<T>::_infer_batch(
+  std::vector<T*>& Y,
+  std::vector<bool*>& is_nonzero_row,
+  int* rows,
+  T* results,
+  const size_t num_rows,
+  std::vector<LayerCounter>& counters,
+  std::vector<LayerStrategyLog>& strategy_log,
+  const size_t switch_layer
+) {
+  const size_t num_layers = Base<T>::_num_layers;
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  //second buffer starts zeroed for every batch
+  std::fill(Y[1], Y[1] + num_rows * num_neurons, T(0));
+  std::fill(is_nonzero_row[1], is_nonzero_row[1] + num_rows * num_secs, false);
+
+  //every row survives and every section is flagged at the input
+  std::iota(rows, rows + num_rows, 0);
+  size_t num_listed_rows = num_rows;
+  size_t num_active_secs = num_rows * num_secs;
+  bool is_snig = false;
+
+  for(size_t cur_layer = 0; cur_layer < num_layers; ++cur_layer) {
+    const int* W = Base<T>::_host_pinned_weight + cur_layer * Base<T>::_pp_wlen;
+    const int* row_w = W + num_neurons * num_secs + 1;
+    const T* val_w = (const T*)(W + Base<T>::_pp_w_index_len);
+    auto layer_beg = std::chrono::steady_clock::now();
+
+    double row_ratio = double(num_listed_rows) / num_rows;
+    double section_ratio = double(num_active_secs) / (num_rows * num_secs);
+    if(!is_snig) {
+      is_snig = switch_layer != size_t(-1) ?
+        cur_layer >= switch_layer :
+        row_ratio <= _row_ratio_threshold && section_ratio <= _section_ratio_threshold;
+    }
+    strategy_log[cur_layer].sum_row_ratio += row_ratio;
+    strategy_log[cur_layer].sum_section_ratio += section_ratio;
+
+    if(is_snig) {
+      ++strategy_log[cur_layer].num_snig_batches;
+      snig_cpu_inference<T>(
+        Y[cur_layer % 2],
+        is_nonzero_row[cur_layer % 2],
+        num_rows,
+        Base<T>::_sections.offsets.data(),
+        num_secs,
+        num_neurons,
+        W,
+        row_w,
+        val_w,
+        Base<T>::_bias,
+        is_nonzero_row[(cur_layer + 1) % 2],
+        Y[(cur_layer + 1) % 2],
+        results,
+        counters[cur_layer]
+      );
+      //the ratios of the next layer come from the flags, a single cheap scan
+      const bool* is_nonzero_1 = is_nonzero_row[(cur_layer + 1) % 2];
+      num_active_secs = std::count(is_nonzero_1, is_nonzero_1 + num_rows * num_secs, true);
+      num_listed_rows = 0;
+      for(size_t r = 0; r < num_rows; ++r) {
+        num_listed_rows += std::any_of(
+          is_nonzero_1 + r * num_secs, is_nonzero_1 + (r + 1) * num_secs, [](bool b){ return b; }
+        );
+      }
+    }
+    else {
+      ++strategy_log[cur_layer].num_bf_batches;
+      num_active_secs = 0;
+      //compacting in place is safe since row l is read before row l is written
+      num_listed_rows = bf_cpu_inference<T>(
+        Y[cur_layer % 2],
+        is_nonzero_row[cur_layer % 2],
+        rows,
+        num_listed_rows,
+        Base<T>::_sections.offsets.data(),
+        num_secs,
+        num_neurons,
+        W,
+        row_w,
+        val_w,
+        Base<T>::_bias,
+        is_nonzero_row[(cur_layer + 1) % 2],
+        Y[(cur_layer + 1) % 2],
+        rows,
+        results,
+        num_active_secs,
+        counters[cur_layer]
+      );
+    }
+
+    counters[cur_layer].seconds += std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - layer_beg
+    ).count();
+  }
+}
+
+template <typename T>
+void HybridCPU<T>::_infer() {
+  Base<T>::log("Start inference...... ", "\n");
+  Base<T>::tic();
+  Base<T>::_memory.phase("infer");
+
+  const size_t num_layers = Base<T>::_num_layers;
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  std::vector<std::vector<LayerCounter> > thread_counters(
+    _num_threads,
+    std::vector<LayerCounter>(num_layers)
+  );
+  std::vector<std::vector<LayerStrategyLog> > thread_log(
+    _num_threads,
+    std::vector<LayerStrategyLog>(num_layers)
+  );
+
+  std::atomic<size_t> finished_inputs{0};
+
+  #pragma omp parallel num_threads(_num_threads)
+  {
+    const int tid = omp_get_thread_num();
+    Base<T>::_placement.pin("omp", tid);
+
+    std::vector<T*> Y(2);
+    std::vector<bool*> is_nonzero_row(2);
+    Y[1] = _thread_Y[tid].data();
+    is_nonzero_row[1] = _thread_is_nonzero_row[tid].get();
+
+    size_t beg_inputs;
+    while((beg_inputs = finished_inputs.fetch_add(_batch_size)) < Base<T>::_num_inputs) {
+      auto batch_beg = std::chrono::steady_clock::now();
+      size_t num_rows = std::min(_batch_size, Base<T>::_num_inputs - beg_inputs);
+
+      Y[0] = _source_Y.data() + beg_inputs * num_neurons;
+      is_nonzero_row[0] = _source_is_nonzero_row.get() + beg_inputs * num_secs;
+
+      _infer_batch(
+        Y,
+        is_nonzero_row,
+        _thread_rows[tid].data(),
+        _thread_results[tid].data(),
+        num_rows,
+        thread_counters[tid],
+        thread_log[tid]
+      );
+
+      //identify
+      const T* final_Y = Y[num_layers % 2];
+      for(size_t i = 0; i < num_rows; ++i) {
+        //threads identifying neighbouring inputs share words of the bitset
+        if(std::any_of(
+          final_Y + i * num_neurons,
+          final_Y + (i + 1) * num_neurons,
+          [](T v){ return v != 0; }
+        )) {
+          _results.set_atomic(beg_inputs + i);
+        }
+      }
+
+      Base<T>::_observe_batch(std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - batch_beg
+      ).count());
+    }
+  }
+
+  _layer_counters.assign(num_layers, LayerCounter{});
+  _strategy_log.assign(num_layers, LayerStrategyLog{});
+  for(size_t t = 0; t < _num_threads; ++t) {
+    for(size_t l = 0; l < num_layers; ++l) {
+      _layer_counters[l] += thread_counters[t][l];
+      _strategy_log[l] += thread_log[t][l];
+    }
+  }
+
+  Base<T>::toc();
+  auto infer_ms = Base<T>::duration();
+  Base<T>::log("Finish inference with ", infer_ms, " ms", "\n");
+
+  //per-layer strategy, one line per run of layers with the same majority
+  for(size_t beg = 0; beg < num_layers; ) {
+    size_t end = beg + 1;
+    while(end < num_layers && _strategy_log[end].majority() == _strategy_log[beg].majority()) {
+      ++end;
+    }
+    Base<T>::log(
+      "  layers ", beg, "-", end - 1, " : ", to_string(_strategy_log[beg].majority()),
+      " (row ratio ", _strategy_log[beg].row_ratio(), " -> ", _strategy_log[end - 1].row_ratio(),
+      ", section ratio ", _strategy_log[beg].section_ratio(), " -> ", _strategy_log[end - 1].section_ratio(), ")", "\n"
+    );
+    beg = end;
+  }
+
+  Base<T>::_publish_metrics(_results, infer_ms);
+}
+
+template <typename T>
+void HybridCPU<T>::_weight_alloc() {
+  //both kernels read the layers directly from Base<T>::_host_pinned_weight
+}
+
+template <typename T>
+void HybridCPU<T>::_input_alloc() {
+  //buffers of a previous run are released first
+  _input_free();
+
+  size_t ylen = Base<T>::_num_inputs * Base<T>::_num_neurons;
+  size_t mask_len = Base<T>::_num_inputs * Base<T>::_num_secs;
+
+  _source_Y.assign(ylen, T(0));
+  _source_is_nonzero_row.reset(new bool[mask_len]);
+  std::fill(_source_is_nonzero_row.get(), _source_is_nonzero_row.get() + mask_len, true);
+  Base<T>::_memory.allocate("input", sizeof(T) * ylen);
+  Base<T>::_memory.allocate("row_mask", sizeof(bool) * mask_len);
+
+  _thread_Y.resize(_num_threads);
+  _thread_is_nonzero_row.resize(_num_threads);
+  _thread_rows.resize(_num_threads);
+  _thread_results.resize(_num_threads);
+  for(size_t t = 0; t < _num_threads; ++t) {
+    _thread_Y[t].assign(_batch_size * Base<T>::_num_neurons, T(0));
+    _thread_is_nonzero_row[t].reset(new bool[_batch_size * Base<T>::_num_secs]());
+    _thread_rows[t].assign(_batch_size, 0);
+    //BF rows are full width, SNIG sections use the front
+    _thread_results[t].assign(Base<T>::_num_neurons, T(0));
+    Base<T>::_memory.allocate("activation", sizeof(T) * _thread_Y[t].size());
+    Base<T>::_memory.allocate("row_mask", sizeof(bool) * _batch_size * Base<T>::_num_secs);
+    Base<T>::_memory.allocate("row_mask", sizeof(int) * _thread_rows[t].size());
+    Base<T>::_memory.allocate("activation", sizeof(T) * _thread_results[t].size());
+  }
+}
+
+template <typename T>
+void HybridCPU<T>::_input_free() {
+  const size_t num_secs = Base<T>::_num_secs;
+
+  Base<T>::_memory.deallocate("input", sizeof(T) * _source_Y.size());
+  Base<T>::_memory.deallocate("row_mask", sizeof(bool) * _source_Y.size() / Base<T>::_num_neurons * num_secs);
+  for(const auto& Y : _thread_Y) {
+    Base<T>::_memory.deallocate("activation", sizeof(T) * Y.size());
+    Base<T>::_memory.deallocate("row_mask", sizeof(bool) * Y.size() / Base<T>::_num_neurons * num_secs);
+  }
+  for(const auto& rows : _thread_rows) {
+    Base<T>::_memory.deallocate("row_mask", sizeof(int) * rows.size());
+  }
+  for(const auto& r : _thread_results) {
+    Base<T>::_memory.deallocate("activation", sizeof(T) * r.size());
+  }
+
+  _source_Y.clear();
+  _source_is_nonzero_row.reset();
+  _thread_Y.clear();
+  _thread_is_nonzero_row.clear();
+  _thread_rows.clear();
+  _thread_results.clear();
+}
+
+template <typename T>
+void HybridCPU<T>::_result_alloc() {
+  Base<T>::_memory.deallocate("result", _results.bytes());
+  _results.assign(Base<T>::_num_inputs);
+  Base<T>::_memory.allocate("result", _results.bytes());
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,121 @@
+#pragma once
+#include <SNIG/utility/roofline.hpp>
+#include <algorithm>
+
+namespace snig{
+
+// CPU port of bf_inference
+// only the rows listed in rows_0 are computed, each at full width:
+// one sweep over the nonzero inputs of a row scatters into all output sections,
+// with results as a scratch of num_neurons T instead of one section.
+//
+// Rows are never masked by section, but the section flags of Y_1 are written
+// so a SNIG-style layer can follow.
+// Rows that come out all zero are dropped from the list, and their Y_0 is
+// zeroed as well, so a row missing from the list is zero in both buffers.
+// Returns the number of rows written to rows_1.
+template <typename T>
+size_t bf_cpu_inference(
+  T* Y_0,
+  bool* is_nonzero_row_0,
+  const int* rows_0,
+  const size_t num_listed_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  int* rows_1,
+  T* results,
+  size_t& num_active_secs,
+  LayerCounter& counter
+);
+
+//-----------------------------------------------------------------------------
+//Definition of kernel function
+//-----------------------------------------------------------------------------
+
+template <typename T>
+size_t bf_cpu_inference(
+  T* Y_0,
+  bool* is_nonzero_row_0,
+  const int* rows_0,
+  const size_t num_listed_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  int* rows_1,
+  T* results,
+  size_t& num_active_secs,
+  LayerCounter& counter
+) {
+  size_t num_rows_1{0};
+  size_t num_nnz{0};
+  size_t num_cols{0};
+
+  for(size_t l = 0; l < num_listed_rows; ++l) {
+    const int r = rows_0[l];
+    T* y_0 = Y_0 + r * num_neurons;
+    T* y_1 = Y_1 + r * num_neurons;
+    bool* is_nonzero_1 = is_nonzero_row_1 + r * num_secs;
+
+    std::fill(results, results + num_neurons, bias);
+
+    for(size_t j = 0; j < num_neurons; ++j) {
+      T valY = y_0[j];
+      if(valY == 0) {
+        continue;
+      }
+      for(size_t s = 0; s < num_secs; ++s) {
+        int beg_w = col_w[s * num_neurons + j];
+        int end_w = col_w[s * num_neurons + j + 1];
+        for(int k = beg_w; k < end_w; ++k) {
+          results[row_w[k]] += valY * val_w[k];
+        }
+        num_nnz += end_w - beg_w;
+      }
+      num_cols += num_secs;
+    }
+
+    bool is_nonzero_row = false;
+    for(size_t s = 0; s < num_secs; ++s) {
+      bool is_nonzero = false;
+      for(int i = sec_offsets[s]; i < sec_offsets[s + 1]; ++i) {
+        T v = std::min(T(32), std::max(results[i], T(0)));
+        y_1[i] = v;
+        is_nonzero |= (v != 0);
+      }
+      is_nonzero_1[s] = is_nonzero;
+      num_active_secs += is_nonzero;
+      is_nonzero_row |= is_nonzero;
+    }
+
+    if(is_nonzero_row) {
+      rows_1[num_rows_1++] = r;
+    }
+    else {
+      //Y_0 is the Y_1 of the next layer, which skips this row from now on
+      std::fill(y_0, y_0 + num_neurons, T(0));
+      std::fill(is_nonzero_row_0 + r * num_secs, is_nonzero_row_0 + (r + 1) * num_secs, false);
+    }
+  }
+
+  counter.flops += 2.0 * num_nnz;
+  counter.bytes += double(num_nnz) * (sizeof(int) + sizeof(T))
+                 + double(num_cols) * 2 * sizeof(int)
+                 + double(num_listed_rows) * 2 * num_neurons * sizeof(T);
+  counter.weight_bytes += double(num_nnz) * (sizeof(int) + sizeof(T));
+  return num_rows_1;
+}
+
+}// end of namespace snig ----------------------------------------------
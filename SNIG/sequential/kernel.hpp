@@ -0,0 +1,105 @@
+#pragma once
+#include <Eigen/SparseCore>
+#include <algorithm>
+
+namespace snig{
+
+// non-owning view of one packed layer as a row-major CSR matrix
+// of num_neurons * num_secs rows and num_neurons columns
+// row s * num_neurons + j holds the weights from input neuron j to output section s
+template <typename T>
+using PackedLayerView = Eigen::Map<const Eigen::SparseMatrix<T, Eigen::RowMajor, int> >;
+
+template <typename T>
+PackedLayerView<T> packed_layer_view(
+  const int* W,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const size_t w_index_len
+);
+
+template <typename T, typename Y>
+Eigen::SparseMatrix<T, Eigen::RowMajor> eigen_inference(
+  const Eigen::SparseMatrixBase<Y>& y,
+  const PackedLayerView<T>& w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const T bias
+);
+
+template <typename T>
+void eigen_identify(
+  const Eigen::SparseMatrix<T, Eigen::RowMajor>& y,
+  int* results
+);
+
+//-----------------------------------------------------------------------------
+//Definition of kernel function
+//-----------------------------------------------------------------------------
+
+template <typename T>
+PackedLayerView<T> packed_layer_view(
+  const int* W,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const size_t w_index_len
+) {
+  const int* col_w = W;
+  const int* row_w = W + num_neurons * num_secs + 1;
+  const T* val_w = (const T*)(W + w_index_len);
+  return PackedLayerView<T>(
+    num_neurons * num_secs,
+    num_neurons,
+    col_w[num_neurons * num_secs],
+    col_w,
+    row_w,
+    val_w
+  );
+}
+
+// one layer of the Eigen baseline
+// y * W is the sum of y times the rows of every output section
+// bias is only added to the nonzeros of y * W,
+// which is exact as long as bias <= 0 (zeros stay zero after the ReLU)
+template <typename T, typename Y>
+Eigen::SparseMatrix<T, Eigen::RowMajor> eigen_inference(
+  const Eigen::SparseMatrixBase<Y>& y,
+  const PackedLayerView<T>& w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const T bias
+) {
+  Eigen::SparseMatrix<T, Eigen::RowMajor> z = y.derived() * w.middleRows(0, num_neurons);
+  for(size_t s = 1; s < num_secs; ++s) {
+    Eigen::SparseMatrix<T, Eigen::RowMajor> z_s = y.derived() * w.middleRows(s * num_neurons, num_neurons);
+    z += z_s;
+  }
+  z = z.pruned();
+  z.coeffs() += bias;
+
+  Eigen::SparseMatrix<T, Eigen::RowMajor> next = z.unaryExpr([] (T a) {
+    if(a < 0) return T(0);
+    else if(a > 32) return T(32);
+    return a;
+  }).pruned();
+
+  return next;
+}
+
+template <typename T>
+void eigen_identify(
+  const Eigen::SparseMatrix<T, Eigen::RowMajor>& y,
+  int* results
+) {
+  for(Eigen::Index i = 0; i < y.outerSize(); ++i) {
+    results[i] = 0;
+    for(typename Eigen::SparseMatrix<T, Eigen::RowMajor>::InnerIterator it(y, i); it; ++it) {
+      if(it.value() > 0) {
+        results[i] = 1;
+        break;
+      }
+    }
+  }
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <Eigen/SparseCore>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/matrix_format.h>
+#include <SNIG/utility/cuda_error.hpp>
+#include <SNIG/utility/scoring.hpp>
+#include <SNIG/sequential/kernel.hpp>
+#include <SNIG/base/base.hpp>
+#include <vector>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig{
+
+template <typename T>
+class Sequential : public Base<T> {
+  //Single-threaded Eigen baseline
+  //the whole input is one row-major CSR matrix multiplied through every layer.
+  //Layers are read in place from the packed weight of Base<T>.
+
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  private:
+
+    Eigen::SparseMatrix<T, Eigen::RowMajor> _source_Y;
+
+    std::vector<PackedLayerView<T> > _weights;
+
+    std::vector<int> _results;
+
+    void _set_parameters(const size_t num_inputs);
+
+    void _preprocess(const std::fs::path& input_path);
+
+    void _infer();
+
+    void _weight_alloc();
+
+    void _input_alloc();
+
+    void _result_alloc();
+
+    size_t _input_bytes() const;
+
+  public:
+
+    Sequential(
+      const std::fs::path& weight_path,
+      const T bias = -.3f,
+      const size_t num_neurons_per_layer = 1024,
+      const size_t num_layers = 120
+    );
+
+    ~Sequential();
+
+    Eigen::Matrix<int, Eigen::Dynamic, 1> infer(
+      const std::fs::path& input_path,
+      const size_t num_inputs
+    );
+
+};
+
+// ----------------------------------------------------------------------------
+// Definition of Sequential
+// ----------------------------------------------------------------------------
+
+template <typename T>
+Sequential<T>::Sequential(
+  const std::fs::path& weight_path,
+  const T bias,
+  const size_t num_neurons_per_layer,
+  const size_t num_layers
+):
+  Base<T>(dim3{1, 1, 1}, weight_path, bias, num_neurons_per_layer, num_layers)
+{
+  Base<T>::log("Constructing Sequential engine......", "\n");
+}
+
+template <typename T>
+Sequential<T>::~Sequential() {
+  Base<T>::_memory.deallocate("input", _input_bytes());
+  Base<T>::_memory.deallocate("result", sizeof(int) * _results.size());
+}
+
+template <typename T>
+Eigen::Matrix<int, Eigen::Dynamic, 1> Sequential<T>::infer(
+  const std::fs::path& input_path,
+  const size_t num_inputs
+) {
+  _set_parameters(num_inputs);
+
+  _preprocess(input_path);
+
+  _infer();
+
+  return arr_to_Eigen_int(_results.data(), Base<T>::_num_inputs);
+}
+
+template <typename T>
+void Sequential<T>::_set_parameters(const size_t num_inputs) {
+  Base<T>::log("Total input size : ", num_inputs, "\n\n");
+
+  Base<T>::_num_inputs = num_inputs;
+}
+
+template <typename T>
+void Sequential<T>::_preprocess(const std::fs::path& input_path) {
+  Base<T>::log("Preprocessing...... ");
+  Base<T>::tic();
+  Base<T>::_memory.phase("preprocess");
+
+  //weight views over the packed host copy
+  _weight_alloc();
+  //read input
+  Base<T>::_memory.deallocate("input", _input_bytes());
+  _source_Y = read_input_binary_to_CSR<T>(input_path);
+  _input_alloc();
+  //final results allocation
+  _result_alloc();
+
+  Base<T>::toc();
+  Base<T>::log("Finish preprocessing with ", Base<T>::duration(), " ms", "\n");
+}
+
+template <typename T>
+void Sequential<T>::_infer() {
+  Base<T>::log("Start inference...... ", "\n");
+  Base<T>::tic();
+  Base<T>::_memory.phase("infer");
+
+  auto beg = std::chrono::steady_clock::now();
+
+  Eigen::SparseMatrix<T, Eigen::RowMajor> y = eigen_inference<T>(
+    _source_Y,
+    _weights[0],
+    Base<T>::_num_neurons,
+    Base<T>::_num_secs,
+    Base<T>::_bias
+  );
+  for(size_t cur_layer = 1; cur_layer < Base<T>::_num_layers; ++cur_layer) {
+    y = eigen_inference<T>(
+      y,
+      _weights[cur_layer],
+      Base<T>::_num_neurons,
+      Base<T>::_num_secs,
+      Base<T>::_bias
+    );
+  }
+
+  eigen_identify<T>(y, _results.data());
+
+  //the whole input is a single batch
+  Base<T>::_observe_batch(std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - beg
+  ).count());
+
+  Base<T>::toc();
+  auto infer_ms = Base<T>::duration();
+  Base<T>::log("Finish inference with ", infer_ms, " ms", "\n");
+
+  Base<T>::_publish_metrics(_results.data(), infer_ms);
+}
+
+template <typename T>
+void Sequential<T>::_weight_alloc() {
+  _weights.clear();
+  for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+    _weights.emplace_back(packed_layer_view<T>(
+      Base<T>::_host_pinned_weight + l * Base<T>::_pp_wlen,
+      Base<T>::_num_neurons,
+      Base<T>::_num_secs,
+      Base<T>::_pp_w_index_len
+    ));
+  }
+}
+
+template <typename T>
+void Sequential<T>::_input_alloc() {
+  Base<T>::_memory.allocate("input", _input_bytes());
+}
+
+template <typename T>
+void Sequential<T>::_result_alloc() {
+  Base<T>::_memory.deallocate("result", sizeof(int) * _results.size());
+  _results.assign(Base<T>::_num_inputs, 0);
+  Base<T>::_memory.allocate("result", sizeof(int) * Base<T>::_num_inputs);
+}
+
+template <typename T>
+size_t Sequential<T>::_input_bytes() const {
+  //values, column indices, and row offsets of the CSR input
+  return _source_Y.outerSize() == 0 ? 0 :
+    (sizeof(T) + sizeof(int)) * _source_Y.nonZeros() + sizeof(int) * (_source_Y.outerSize() + 1);
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -8,6 +8,9 @@
 #include <SNIG/snig/kernel.hpp>
 #include <SNIG/utility/scoring.hpp>
 #include <SNIG/base/base.hpp>
+#include <SNIG/utility/pipeline_stats.hpp>
+#include <SNIG/utility/executor_affinity.hpp>
+#include <atomic>
 #include <vector>
 
 namespace std {
@@ -26,17 +29,44 @@ class SNIG : public Base<T> {
   
   private:
     
-    size_t _batch_size;
-    size_t _num_weight_buffers;
-    T* _source_Y;
-    bool* _source_is_nonzero_row;
+    size_t _batch_size{0};
+    size_t _num_weight_buffers{0};
+    T* _source_Y{nullptr};
+    bool* _source_is_nonzero_row{nullptr};
     std::vector<std::vector<T*> > _dev_Y;
     std::vector<std::vector<bool*> > _dev_is_nonzero_row;
     std::vector<std::vector<int*> > _dev_W;
 
     size_t _batch_ylen;
     size_t _batch_ysize;
-    int* _results;
+    int* _results{nullptr};
+
+    //fetch stalls and occupancy of each device (stage)
+    PipelineStats _stats;
+
+    //the executor lives as long as the engine,
+    //and the task graph is built once per number of GPUs.
+    //Tasks read batch size, buffers, and weights from the members at run time,
+    //so later calls only rebind buffers and rerun the graph.
+    tf::Executor _executor;
+    tf::Taskflow _taskflow{"SNIG"};
+    size_t _graph_num_gpus{0};
+
+    //policy the executor workers are pinned under
+    AffinityPolicy _executor_policy{AffinityPolicy::none};
+
+    //state shared by the tasks of one run
+    std::atomic<size_t> _finished_inputs{0};
+    std::vector<int*> _dev_results;
+    std::vector<PipelineStats::clock::time_point> _fetch_end;
+
+    size_t _num_remaining_batches(const size_t beg_inputs) const;
+
+    int _fetch(const size_t dev);
+
+    void _build_graph();
+
+    void _free();
 
     void _set_parameters(
       const size_t num_inputs,
@@ -67,6 +97,10 @@ class SNIG : public Base<T> {
 
     ~SNIG();
 
+    void report(JSONWriter& json) const override;
+
+    const PipelineStats& pipeline_stats() const;
+
     Eigen::Matrix<int, Eigen::Dynamic, 1> infer(
       const std::fs::path& input_path,
       const size_t num_inputs,
@@ -92,27 +126,49 @@ SNIG<T>::SNIG(
   Base<T>(threads, weight_path, bias, num_neurons_per_layer, num_layers)
 {
   Base<T>::log("Constructing SNIG engine......", "\n");
+  Base<T>::_require_uniform_sections("SNIG");
 }
 
 template <typename T>
 SNIG<T>::~SNIG() {
+  _free();
+}
+
+template <typename T>
+void SNIG<T>::_free() {
+  if(_source_Y == nullptr) {
+    return;
+  }
 
   checkCuda(cudaFree(_source_Y));
   checkCuda(cudaFree(_source_is_nonzero_row));
+  Base<T>::_memory.deallocate("input", sizeof(T) * Base<T>::_num_inputs * Base<T>::_num_neurons);
+  Base<T>::_memory.deallocate("row_mask", sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs);
 
   for(auto& W_in_dev : _dev_W) {
     for(auto& each_W : W_in_dev) {
       checkCuda(cudaFree(each_W));
+      Base<T>::_memory.deallocate("device_weight", Base<T>::_pp_wsize);
     }
   }
   for(auto& Y_in_dev : _dev_Y) {
       checkCuda(cudaFree(Y_in_dev[1]));
+      Base<T>::_memory.deallocate("activation", _batch_ysize);
   }
   for(auto& rowsY_in_dev : _dev_is_nonzero_row) {
       checkCuda(cudaFree(rowsY_in_dev[1]));
+      Base<T>::_memory.deallocate("row_mask", sizeof(bool) * _batch_size * Base<T>::_num_secs);
   }
 
   checkCuda(cudaFree(_results));
+  Base<T>::_memory.deallocate("result", sizeof(int) * Base<T>::_num_inputs);
+
+  _dev_W.clear();
+  _dev_Y.clear();
+  _dev_is_nonzero_row.clear();
+  _source_Y = nullptr;
+  _source_is_nonzero_row = nullptr;
+  _results = nullptr;
 }
 
 template <typename T>
@@ -143,6 +199,28 @@ Eigen::Matrix<int, Eigen::Dynamic, 1> SNIG<T>::infer(
   return arr_to_Eigen_int(_results, Base<T>::_num_inputs);
 }
 
+template <typename T>
+void SNIG<T>::report(JSONWriter& json) const {
+  Base<T>::report(json);
+  json.field("batch_size", _batch_size);
+  json.field("num_weight_buffers", _num_weight_buffers);
+  json.key("pipeline");
+  _stats.dump(json);
+}
+
+template <typename T>
+const PipelineStats& SNIG<T>::pipeline_stats() const {
+  return _stats;
+}
+
+template <typename T>
+size_t SNIG<T>::_num_remaining_batches(const size_t beg_inputs) const {
+  if(beg_inputs >= Base<T>::_num_inputs) {
+    return 0;
+  }
+  return (Base<T>::_num_inputs - beg_inputs + _batch_size - 1) / _batch_size;
+}
+
 template <typename T>
 void SNIG<T>::_set_parameters(
   const size_t num_inputs,
@@ -150,6 +228,16 @@ void SNIG<T>::_set_parameters(
   const size_t num_weight_buffers,
   const size_t num_gpus
 ) {
+  //buffers of a previous call are reused if the shape is unchanged
+  bool is_same_shape = _source_Y != nullptr &&
+                       num_inputs == Base<T>::_num_inputs &&
+                       batch_size == _batch_size &&
+                       num_weight_buffers == _num_weight_buffers &&
+                       num_gpus == Base<T>::_num_gpus;
+  if(!is_same_shape) {
+    _free();
+  }
+
   Base<T>::_num_inputs = num_inputs;
   Base<T>::_num_gpus = num_gpus;
   _num_weight_buffers = num_weight_buffers;
@@ -161,19 +249,29 @@ void SNIG<T>::_set_parameters(
   _dev_W.reserve(Base<T>::_num_gpus);
   _dev_Y.reserve(Base<T>::_num_gpus);
   _dev_is_nonzero_row.reserve(Base<T>::_num_gpus);
+  _dev_results.assign(Base<T>::_num_gpus, nullptr);
+  _fetch_end.assign(Base<T>::_num_gpus, PipelineStats::clock::now());
 }
 
 template <typename T>
 void SNIG<T>::_preprocess(const std::fs::path& input_path) {
   Base<T>::log("Preprocessing...... ");
   Base<T>::tic();
-
-  //weight allocation
-  _weight_alloc();
-  //input allocation
-  _input_alloc();
-  //final results allocation
-  _result_alloc();
+  Base<T>::_memory.phase("preprocess");
+
+  if(_source_Y == nullptr) {
+    //weight allocation
+    _weight_alloc();
+    //input allocation
+    _input_alloc();
+    //final results allocation
+    _result_alloc();
+  }
+  else {
+    //the previous call overwrote the source with activations
+    checkCuda(cudaMemset(_source_is_nonzero_row, 1, sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs));
+    checkCuda(cudaMemset(_results, 0, sizeof(int) * Base<T>::_num_inputs));
+  }
   
   //read input
   read_input_binary<T>(input_path, _source_Y);
@@ -186,10 +284,69 @@ template <typename T>
 void SNIG<T>::_infer() {
   Base<T>::log("Start inference...... ", "\n");
   Base<T>::tic();
+  Base<T>::_memory.phase("infer");
 
+  if(_graph_num_gpus != Base<T>::_num_gpus) {
+    _build_graph();
+  }
+
+  //a new observer places every worker again on its next task,
+  //under AffinityPolicy::none it returns workers pinned before to the process mask
+  if(_executor_policy != Base<T>::_placement.policy()) {
+    _executor_policy = Base<T>::_placement.policy();
+    _executor.make_observer<ExecutorAffinity>(Base<T>::_placement, "executor");
+  }
+
+  _finished_inputs = 0;
+
+  //every device runs all layers
+  //a device is busy from the end of one fetch to the start of the next one
+  _stats.reset(Base<T>::_num_gpus);
+  for(size_t dev = 0; dev < Base<T>::_num_gpus; ++dev) {
+    _stats[dev].name = "gpu" + std::to_string(dev);
+    _stats[dev].last_layer = Base<T>::_num_layers;
+  }
+
+  _stats.start();
+  _executor.run(_taskflow).wait();
+  _stats.stop();
+
+  checkCuda(cudaSetDevice(0));
+
+  Base<T>::toc();
+  auto infer_ms = Base<T>::duration();
+  Base<T>::log("Finish inference with ", infer_ms, " ms", "\n");
+  Base<T>::_publish_metrics(_results, infer_ms);
+  Base<T>::_publish_pipeline(_stats);
+}
+
+template <typename T>
+int SNIG<T>::_fetch(const size_t dev) {
+  auto fetch_beg = PipelineStats::clock::now();
+  cudaSetDevice(dev);
+  int is_end = 1;
+  size_t beg_inputs = _finished_inputs.fetch_add(_batch_size);
+  if(beg_inputs < Base<T>::_num_inputs) {
+    _dev_Y[dev][0] = _source_Y + beg_inputs * Base<T>::_num_neurons;
+    _dev_is_nonzero_row[dev][0] = _source_is_nonzero_row + beg_inputs * Base<T>::_num_secs;
+    _dev_results[dev] = _results + beg_inputs;
+    checkCuda(cudaMemPrefetchAsync(_dev_Y[dev][0], _batch_ysize, dev, NULL));
+    checkCuda(cudaMemPrefetchAsync(_dev_is_nonzero_row[dev][0], sizeof(bool) * _batch_size * Base<T>::_num_secs, dev, NULL));
+    checkCuda(cudaMemPrefetchAsync(_dev_results[dev], sizeof(int) * _batch_size, dev, NULL));
+    is_end = 0;
+  }
+  _stats.sample_depth(dev, _num_remaining_batches(beg_inputs));
+  _stats.add_producer_wait(dev, fetch_beg);
+  _fetch_end[dev] = PipelineStats::clock::now();
+  return is_end;
+}
+
+template <typename T>
+void SNIG<T>::_build_graph() {
   //Use taskflow and cudaGraph to implement task graph
-  tf::Taskflow taskflow("SNIG");
-  tf::Executor executor;
+  _taskflow.clear();
+  _graph_num_gpus = Base<T>::_num_gpus;
+
   std::vector<tf::Task> first_fetchs;
   std::vector<tf::Task> cudaflows;
   std::vector<tf::Task> fetchs;
@@ -197,33 +354,18 @@ void SNIG<T>::_infer() {
   cudaflows.reserve(Base<T>::_num_gpus);
   fetchs.reserve(Base<T>::_num_gpus);
 
-  std::atomic<size_t> finished_inputs{0};
-  std::vector<int*> dev_results(Base<T>::_num_gpus, nullptr);
-
-  dim3 grid_dim(_batch_size, Base<T>::_num_secs, 1);
-
-  tf::Task start = taskflow.emplace([](){
+  tf::Task start = _taskflow.emplace([](){
   }).name("start");
 
   for(size_t dev = 0; dev < Base<T>::_num_gpus; ++dev) {
-    first_fetchs.emplace_back(taskflow.emplace([&, dev](){
-      cudaSetDevice(dev);
-      int is_end = 1;
-      size_t beg_inputs = finished_inputs.fetch_add(_batch_size);
-      if(beg_inputs < Base<T>::_num_inputs) {
-        _dev_Y[dev][0] = _source_Y + beg_inputs * Base<T>::_num_neurons;
-        _dev_is_nonzero_row[dev][0] = _source_is_nonzero_row + beg_inputs * Base<T>::_num_secs;
-        dev_results[dev] = _results + beg_inputs;
-        checkCuda(cudaMemPrefetchAsync(_dev_Y[dev][0], _batch_ysize, dev, NULL));
-        checkCuda(cudaMemPrefetchAsync(_dev_is_nonzero_row[dev][0], sizeof(bool) * _batch_size * Base<T>::_num_secs, dev, NULL));
-        checkCuda(cudaMemPrefetchAsync(dev_results[dev], sizeof(int) * _batch_size, dev, NULL));
-        is_end = 0;
-      }
-      return is_end;
+    first_fetchs.emplace_back(_taskflow.emplace([this, dev](){
+      return _fetch(dev);
     }).name("first_fetch"));
 
-    cudaflows.emplace_back(taskflow.emplace([&, dev](tf::cudaFlow& cf){
+    //the cudaFlow is rebuilt from the current buffers whenever the task runs
+    cudaflows.emplace_back(_taskflow.emplace([this, dev](tf::cudaFlow& cf){
       cf.device(dev);
+      dim3 grid_dim(_batch_size, Base<T>::_num_secs, 1);
       std::vector<tf::cudaTask> weight_copies;
       std::vector<tf::cudaTask> infers;
       weight_copies.reserve(Base<T>::_num_layers);
@@ -263,7 +405,7 @@ void SNIG<T>::_infer() {
       }
 
       // TODO: consider parameterizing the thread numbers
-      tf::cudaTask ident = cf.kernel(16, 512, 0, identify<T>, _dev_Y[dev][0], _batch_size, Base<T>::_num_neurons, dev_results[dev]);
+      tf::cudaTask ident = cf.kernel(16, 512, 0, identify<T>, _dev_Y[dev][0], _batch_size, Base<T>::_num_neurons, _dev_results[dev]);
 
       //dependencies of cudaflow
       for(size_t cur_layer = 0; cur_layer < Base<T>::_num_layers; ++cur_layer) {
@@ -279,25 +421,19 @@ void SNIG<T>::_infer() {
       infers[Base<T>::_num_layers - 1].precede(ident);
     }).name("GPU"));
 
-    fetchs.emplace_back(taskflow.emplace([&, dev](){
-      cudaSetDevice(dev);
-      int is_end = 1;
-      size_t beg_inputs = finished_inputs.fetch_add(_batch_size);
-      if(beg_inputs < Base<T>::_num_inputs) {
-        _dev_Y[dev][0] = _source_Y + beg_inputs * Base<T>::_num_neurons;
-        _dev_is_nonzero_row[dev][0] = _source_is_nonzero_row + beg_inputs * Base<T>::_num_secs;
-        dev_results[dev] = _results + beg_inputs;
-        checkCuda(cudaMemPrefetchAsync(_dev_Y[dev][0], _batch_ysize, dev, NULL));
-        checkCuda(cudaMemPrefetchAsync(_dev_is_nonzero_row[dev][0], sizeof(bool) * _batch_size * Base<T>::_num_secs, dev, NULL));
-        checkCuda(cudaMemPrefetchAsync(dev_results[dev], sizeof(int) * _batch_size, dev, NULL));
-        is_end = 0;
-      }
-      return is_end;
+    fetchs.emplace_back(_taskflow.emplace([this, dev](){
+      //the previous batch ran on this device since the last fetch
+      _stats.add_busy(dev, _fetch_end[dev]);
+      ++_stats[dev].num_batches;
+      Base<T>::_observe_batch(
+        std::chrono::duration<double>(PipelineStats::clock::now() - _fetch_end[dev]).count()
+      );
+      return _fetch(dev);
     }).name("fetch"));
 
   }
 
-  tf::Task stop = taskflow.emplace([](){}).name("stop");
+  tf::Task stop = _taskflow.emplace([](){}).name("stop");
 
   //dependencies of taskflow
   for(size_t dev = 0; dev < Base<T>::_num_gpus; ++dev) {
@@ -306,13 +442,6 @@ void SNIG<T>::_infer() {
     cudaflows[dev].precede(fetchs[dev]);
     fetchs[dev].precede(cudaflows[dev], stop);
   }
-  
-  executor.run(taskflow).wait();
-
-  checkCuda(cudaSetDevice(0));
-
-  Base<T>::toc();
-  Base<T>::log("Finish inference with ", Base<T>::duration(), " ms", "\n");
 }
 
 template <typename T>
@@ -326,6 +455,7 @@ void SNIG<T>::_weight_alloc() {
         &each_W,
         Base<T>::_pp_wsize
       ));
+      Base<T>::_memory.allocate("device_weight", Base<T>::_pp_wsize);
     }
     _dev_W.push_back(W);
   }
@@ -340,6 +470,8 @@ void SNIG<T>::_input_alloc() {
   checkCuda(cudaMallocManaged(&_source_Y, ysize));
   checkCuda(cudaMallocManaged(&_source_is_nonzero_row, sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs));
   checkCuda(cudaMemset(_source_is_nonzero_row, 1, sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs));
+  Base<T>::_memory.allocate("input", ysize);
+  Base<T>::_memory.allocate("row_mask", sizeof(bool) * Base<T>::_num_inputs * Base<T>::_num_secs);
 
   std::vector<T*> Y{2, nullptr};
   std::vector<bool*> is_nonzero_row{2, nullptr};
@@ -349,6 +481,8 @@ void SNIG<T>::_input_alloc() {
     checkCuda(cudaMalloc(&is_nonzero_row[1], sizeof(bool) * _batch_size * Base<T>::_num_secs));
     checkCuda(cudaMemset(Y[1], 0, _batch_ysize));
     checkCuda(cudaMemset(is_nonzero_row[1], 0, sizeof(bool) * _batch_size * Base<T>::_num_secs));
+    Base<T>::_memory.allocate("activation", _batch_ysize);
+    Base<T>::_memory.allocate("row_mask", sizeof(bool) * _batch_size * Base<T>::_num_secs);
     _dev_Y.push_back(Y);
     _dev_is_nonzero_row.push_back(is_nonzero_row);
   }
@@ -359,6 +493,7 @@ template <typename T>
 void SNIG<T>::_result_alloc() {
   checkCuda(cudaMallocManaged(&_results, sizeof(int) * Base<T>::_num_inputs));
   checkCuda(cudaMemset(_results, 0, sizeof(int) * Base<T>::_num_inputs));
+  Base<T>::_memory.allocate("result", sizeof(int) * Base<T>::_num_inputs);
 }
 
 }// end of namespace snig ----------------------------------------------
@@ -0,0 +1,262 @@
+#pragma once
+#include <SNIG/utility/sections.hpp>
+#include <SNIG/utility/affinity.hpp>
+#include <SNIG/utility/json.hpp>
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace snig{
+
+// Two-level cache blocking of the packed CPU kernel
+//
+// A section is the L2 tile: its weights are read by every row of a batch.
+// It is cut into sub-blocks of sub_size output neurons, the L1 tile:
+// the sub_size accumulators stay in L1 and a sub-block holds few enough
+// weights to stay in L1 or L2 while row_block rows run through it in turn,
+// instead of every row streaming the whole section.
+struct CacheBlocking {
+  size_t sub_size{0};
+  size_t row_block{1};
+};
+
+inline
+std::string to_string(const CacheBlocking& blocking);
+
+// "auto" leaves the blocking to the autotuner (sub_size 0),
+// otherwise "<sub_size>x<row_block>"
+inline
+CacheBlocking to_cache_blocking(const std::string& name);
+
+// data cache sizes of the host, read from /sys,
+// 32 KB and 1 MB where the kernel does not expose them
+struct HostCaches {
+  size_t l1d_bytes{32 << 10};
+  size_t l2_bytes{1 << 20};
+
+  void dump(JSONWriter& json) const;
+};
+
+inline
+HostCaches host_caches();
+
+// blockings worth timing on this host:
+// sub-blocks of 16 neurons up to the widest section with accumulators filling
+// no more than half of L1, and row blocks of 1 to 32 rows with input rows
+// filling no more than half of L2
+template <typename T>
+std::vector<CacheBlocking> blocking_candidates(
+  const SectionLayout& sections,
+  const size_t num_neurons,
+  const HostCaches& caches
+);
+
+// packed layer re-cut into sub-blocks, the same way the sections cut it:
+// col_ptr[q * num_neurons + j] starts the weights of input neuron j
+// into sub-block q, ordered by output neuron
+template <typename T>
+struct BlockedLayer {
+  size_t num_neurons{0};
+  size_t sub_size{0};
+
+  //num_subs + 1 boundaries of the sub-blocks, never across a section
+  std::vector<int> sub_offsets;
+
+  //first sub-block of every section, num_secs + 1 entries
+  std::vector<int> sec_subs;
+
+  std::vector<int> col_ptr;
+  std::vector<int> row;
+  std::vector<T> val;
+
+  size_t num_subs() const;
+
+  size_t bytes() const;
+};
+
+template <typename T>
+BlockedLayer<T> packed_to_blocked(
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const size_t num_neurons,
+  const SectionLayout& sections,
+  const size_t sub_size
+);
+
+// ----------------------------------------------------------------------------
+// Definition of CacheBlocking
+// ----------------------------------------------------------------------------
+
+inline
+std::string to_string(const CacheBlocking& blocking) {
+  if(blocking.sub_size == 0) {
+    return "auto";
+  }
+  return std::to_string(blocking.sub_size) + "x" + std::to_string(blocking.row_block);
+}
+
+inline
+CacheBlocking to_cache_blocking(const std::string& name) {
+  if(name == "auto") {
+    return CacheBlocking{};
+  }
+  auto x = name.find('x');
+  try {
+    CacheBlocking blocking{std::stoul(name.substr(0, x)), std::stoul(name.substr(x + 1))};
+    if(x != std::string::npos && blocking.sub_size > 0 && blocking.row_block > 0) {
+      return blocking;
+    }
+  }
+  catch(const std::exception&) {
+  }
+  throw std::runtime_error("unknown cache blocking " + name + " (auto or <sub_size>x<row_block>)");
+}
+
+inline
+void HostCaches::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("l1d_bytes", l1d_bytes);
+  json.field("l2_bytes", l2_bytes);
+  json.end_object();
+}
+
+inline
+HostCaches host_caches() {
+  HostCaches caches;
+  for(int i = 0; ; ++i) {
+    std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i) + "/";
+    std::string level;
+    std::string type;
+    std::string size;
+    if(!detail::read_sysfs(dir + "level", level) ||
+       !detail::read_sysfs(dir + "type", type) ||
+       !detail::read_sysfs(dir + "size", size)) {
+      break;
+    }
+    //sizes read like "48K" or "2048K"
+    size_t bytes = std::stoul(size);
+    if(size.back() == 'K') {
+      bytes <<= 10;
+    }
+    else if(size.back() == 'M') {
+      bytes <<= 20;
+    }
+    if(level == "1" && type != "Instruction") {
+      caches.l1d_bytes = bytes;
+    }
+    else if(level == "2") {
+      caches.l2_bytes = bytes;
+    }
+  }
+  return caches;
+}
+
+template <typename T>
+std::vector<CacheBlocking> blocking_candidates(
+  const SectionLayout& sections,
+  const size_t num_neurons,
+  const HostCaches& caches
+) {
+  const size_t max_sec_size = sections.max_size();
+
+  std::vector<size_t> sub_sizes;
+  for(size_t sub = 16; sub < max_sec_size && sub * sizeof(T) <= caches.l1d_bytes / 2; sub *= 2) {
+    sub_sizes.push_back(sub);
+  }
+  //whole sections, the unblocked kernel
+  sub_sizes.push_back(max_sec_size);
+
+  std::vector<size_t> row_blocks{1};
+  for(size_t rows = 2; rows <= 32 && rows * num_neurons * sizeof(T) <= caches.l2_bytes / 2; rows *= 2) {
+    row_blocks.push_back(rows);
+  }
+
+  std::vector<CacheBlocking> candidates;
+  for(auto sub : sub_sizes) {
+    for(auto rows : row_blocks) {
+      candidates.push_back(CacheBlocking{sub, rows});
+    }
+  }
+  return candidates;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of BlockedLayer
+// ----------------------------------------------------------------------------
+
+template <typename T>
+size_t BlockedLayer<T>::num_subs() const {
+  return sub_offsets.empty() ? 0 : sub_offsets.size() - 1;
+}
+
+template <typename T>
+size_t BlockedLayer<T>::bytes() const {
+  return sizeof(int) * (sub_offsets.size() + sec_subs.size() + col_ptr.size() + row.size())
+       + sizeof(T) * val.size();
+}
+
+template <typename T>
+BlockedLayer<T> packed_to_blocked(
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const size_t num_neurons,
+  const SectionLayout& sections,
+  const size_t sub_size
+) {
+  if(sub_size == 0) {
+    throw std::runtime_error("sub-blocks need at least one neuron");
+  }
+
+  const size_t num_secs = sections.num_secs();
+
+  BlockedLayer<T> layer;
+  layer.num_neurons = num_neurons;
+  layer.sub_size = sub_size;
+  layer.sub_offsets.push_back(0);
+  for(size_t s = 0; s < num_secs; ++s) {
+    layer.sec_subs.push_back(layer.sub_offsets.size() - 1);
+    for(int beg = sections.offsets[s]; beg < sections.offsets[s + 1]; beg += sub_size) {
+      layer.sub_offsets.push_back(std::min(beg + int(sub_size), sections.offsets[s + 1]));
+    }
+  }
+  layer.sec_subs.push_back(layer.sub_offsets.size() - 1);
+
+  const size_t nnz = col_w[num_neurons * num_secs];
+  layer.col_ptr.assign(layer.num_subs() * num_neurons + 1, 0);
+  layer.row.resize(nnz);
+  layer.val.resize(nnz);
+
+  auto sub_of = [&](const size_t s, const int neuron) {
+    return layer.sec_subs[s] + (neuron - sections.offsets[s]) / int(sub_size);
+  };
+
+  //count, then place: the weights of (section, input neuron) are ordered by
+  //output neuron, so every sub-block keeps them in that order
+  for(size_t s = 0; s < num_secs; ++s) {
+    for(size_t j = 0; j < num_neurons; ++j) {
+      for(int k = col_w[s * num_neurons + j]; k < col_w[s * num_neurons + j + 1]; ++k) {
+        ++layer.col_ptr[sub_of(s, row_w[k]) * num_neurons + j + 1];
+      }
+    }
+  }
+  std::partial_sum(layer.col_ptr.begin(), layer.col_ptr.end(), layer.col_ptr.begin());
+
+  std::vector<int> cursor(layer.col_ptr.begin(), layer.col_ptr.end() - 1);
+  for(size_t s = 0; s < num_secs; ++s) {
+    for(size_t j = 0; j < num_neurons; ++j) {
+      for(int k = col_w[s * num_neurons + j]; k < col_w[s * num_neurons + j + 1]; ++k) {
+        int& c = cursor[sub_of(s, row_w[k]) * num_neurons + j];
+        layer.row[c] = row_w[k];
+        layer.val[c] = val_w[k];
+        ++c;
+      }
+    }
+  }
+  return layer;
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,141 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <stdexcept>
+
+namespace snig{
+
+// Fixed-point representation of the CPU path
+//
+// Activations live in [0, 32] and are stored as uint16_t with frac_bits
+// fractional bits, so frac_bits is at most 10 (32 << 10 == 32768).
+// Weights are int16_t with weight_frac_bits fractional bits,
+// and a neuron accumulates int16 x uint16 products in int32
+// with frac_bits + weight_frac_bits fractional bits, starting from the bias.
+using FixedActivation = uint16_t;
+using FixedWeight = int16_t;
+
+constexpr int max_activation_frac_bits = 10;
+
+struct FixedPointFormat {
+  int frac_bits{8};
+  int weight_frac_bits{0};
+
+  int acc_frac_bits() const;
+
+  //32 in activation units
+  int32_t max_activation() const;
+
+  void dump(JSONWriter& json) const;
+};
+
+// how far the quantized model is from the floating-point one
+struct QuantizationError {
+  size_t num_weights{0};
+  size_t num_inexact_weights{0};
+  double max_weight_error{0};
+  double bias_error{0};
+
+  void dump(JSONWriter& json) const;
+};
+
+// largest weight_frac_bits such that every weight fits int16_t and no
+// accumulation can overflow int32_t, given the largest |weight| and the
+// largest sum of |weight| into one output neuron over all layers
+inline
+int choose_weight_frac_bits(
+  const int frac_bits,
+  const double max_abs_weight,
+  const double max_abs_row_sum,
+  const double bias
+);
+
+template <typename T>
+FixedWeight quantize_weight(const T w, const int weight_frac_bits);
+
+template <typename T>
+FixedActivation quantize_activation(const T a, const int frac_bits);
+
+template <typename T>
+int32_t quantize_bias(const T bias, const FixedPointFormat& format);
+
+// ----------------------------------------------------------------------------
+// Definition of FixedPointFormat
+// ----------------------------------------------------------------------------
+
+inline
+int FixedPointFormat::acc_frac_bits() const {
+  return frac_bits + weight_frac_bits;
+}
+
+inline
+int32_t FixedPointFormat::max_activation() const {
+  return int32_t(32) << frac_bits;
+}
+
+inline
+void FixedPointFormat::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("frac_bits", frac_bits);
+  json.field("weight_frac_bits", weight_frac_bits);
+  json.field("activation_bytes", sizeof(FixedActivation));
+  json.field("weight_bytes", sizeof(FixedWeight));
+  json.end_object();
+}
+
+inline
+void QuantizationError::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("num_weights", num_weights);
+  json.field("num_inexact_weights", num_inexact_weights);
+  json.field("max_weight_error", max_weight_error);
+  json.field("bias_error", bias_error);
+  json.end_object();
+}
+
+inline
+int choose_weight_frac_bits(
+  const int frac_bits,
+  const double max_abs_weight,
+  const double max_abs_row_sum,
+  const double bias
+) {
+  if(frac_bits < 0 || frac_bits > max_activation_frac_bits) {
+    throw std::runtime_error(
+      "activation frac_bits must be in [0, " + std::to_string(max_activation_frac_bits) + "]"
+    );
+  }
+  const double max_acc = double(std::numeric_limits<int32_t>::max());
+  for(int w = 15; w >= 0; --w) {
+    double scale = std::ldexp(1.0, w);
+    double acc = (std::fabs(bias) + max_abs_row_sum * 32) * std::ldexp(scale, frac_bits);
+    if(max_abs_weight * scale <= std::numeric_limits<FixedWeight>::max() && acc < max_acc) {
+      return w;
+    }
+  }
+  throw std::runtime_error(
+    "weights too large for int16 fixed point with " + std::to_string(frac_bits) + " fractional bits"
+  );
+}
+
+template <typename T>
+FixedWeight quantize_weight(const T w, const int weight_frac_bits) {
+  return FixedWeight(std::lround(std::ldexp(double(w), weight_frac_bits)));
+}
+
+template <typename T>
+FixedActivation quantize_activation(const T a, const int frac_bits) {
+  double v = std::min(32.0, std::max(double(a), 0.0));
+  return FixedActivation(std::lround(std::ldexp(v, frac_bits)));
+}
+
+template <typename T>
+int32_t quantize_bias(const T bias, const FixedPointFormat& format) {
+  return int32_t(std::lround(std::ldexp(double(bias), format.acc_frac_bits())));
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,866 @@
+#pragma once
+#include <SNIG/utility/roofline.hpp>
+#include <SNIG/snig_cpu/weight_layout.hpp>
+#include <SNIG/utility/sell.hpp>
+#include <SNIG/utility/bsr.hpp>
+#include <SNIG/snig_cpu/blocking.hpp>
+#include <SNIG/snig_cpu/fixed_point.hpp>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <stdexcept>
+
+namespace snig{
+
+// sec_offsets holds the num_secs + 1 section boundaries of SectionLayout,
+// the SELL and BSR variants take equal sections of sec_size neurons
+template <typename T>
+void snig_cpu_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+);
+
+// same as above with the nonzeros read through a weight accessor
+// (SplitWeight, InterleavedWeight, or ConstantWeight)
+template <typename T, typename W>
+void snig_cpu_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const W& weight,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+);
+
+// same as above for the output sections [sec_beg, sec_end) only
+// disjoint section ranges write disjoint parts of Y_1 and is_nonzero_row_1,
+// so threads can split one layer by output section
+template <typename T, typename W>
+void snig_cpu_section_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const W& weight,
+  const T bias,
+  const size_t sec_beg,
+  const size_t sec_end,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+);
+
+// SELL-C-sigma variant, pulls C output neurons per SIMD instruction
+template <typename T>
+void snig_cpu_sell_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const size_t sec_size,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const SELLLayer<T>& weight,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+);
+
+// BSR variant, runs the register-blocked micro-kernel of the block shape
+// of a blocked layer (weight.is_blocked())
+template <typename T>
+void snig_cpu_bsr_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const size_t sec_size,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const BSRLayer<T>& weight,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  LayerCounter& counter
+);
+
+// two-level blocked variant for the output sections [sec_beg, sec_end)
+// row_block rows run through one sub-block of a section before the next
+// sub-block, results holds the accumulators of one sub-block
+template <typename T>
+void snig_cpu_blocked_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const BlockedLayer<T>& weight,
+  const T bias,
+  const size_t sec_beg,
+  const size_t sec_end,
+  const size_t row_block,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+);
+
+// approximate mode: zeroes the activations of Y_1 below threshold
+// in the output sections [sec_beg, sec_end)
+// and clears the flags of sections left all zero
+// returns the number of activations zeroed
+template <typename T>
+size_t snig_cpu_threshold(
+  T* Y_1,
+  bool* is_nonzero_row_1,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const T threshold,
+  const size_t sec_beg,
+  const size_t sec_end,
+  LayerCounter& counter
+);
+
+// fixed-point variant on the packed CSC
+// results is a scratch of int32_t accumulators as wide as the widest section
+inline
+void snig_cpu_fixed_inference(
+  const FixedActivation* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const int* row_w,
+  const FixedWeight* val_w,
+  const int32_t bias,
+  const FixedPointFormat& format,
+  bool* is_nonzero_row_1,
+  FixedActivation* Y_1,
+  int32_t* results,
+  LayerCounter& counter
+);
+
+//-----------------------------------------------------------------------------
+//Definition of kernel function
+//-----------------------------------------------------------------------------
+
+template <typename T>
+void snig_cpu_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+) {
+  snig_cpu_inference<T>(
+    Y_0,
+    is_nonzero_row_0,
+    num_rows,
+    sec_offsets,
+    num_secs,
+    num_neurons,
+    col_w,
+    SplitWeight<T>{row_w, val_w},
+    bias,
+    is_nonzero_row_1,
+    Y_1,
+    results,
+    counter
+  );
+}
+
+// CPU port of snig_inference
+// one call computes num_rows rows of a batch for one layer
+// each (row, output section) pair corresponds to a thread block of the GPU kernel
+// results is a scratch of T as wide as the widest section,
+// the counterpart of the shared memory
+template <typename T, typename W>
+void snig_cpu_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const W& weight,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+) {
+  snig_cpu_section_inference<T>(
+    Y_0,
+    is_nonzero_row_0,
+    num_rows,
+    sec_offsets,
+    num_secs,
+    num_neurons,
+    col_w,
+    weight,
+    bias,
+    0,
+    num_secs,
+    is_nonzero_row_1,
+    Y_1,
+    results,
+    counter
+  );
+}
+
+template <typename T, typename W>
+void snig_cpu_section_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const W& weight,
+  const T bias,
+  const size_t sec_beg,
+  const size_t sec_end,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+) {
+  //counted per column rather than per nonzero to keep the inner loop clean
+  size_t num_nnz{0};
+  size_t num_cols{0};
+  size_t num_scanned{0};
+  size_t num_written{0};
+  size_t num_weight_bytes{0};
+  size_t num_weight_lines{0};
+
+  for(size_t r = 0; r < num_rows; ++r) {
+    const T* y_0 = Y_0 + r * num_neurons;
+    const bool* is_nonzero_0 = is_nonzero_row_0 + r * num_secs;
+    T* y_1 = Y_1 + r * num_neurons;
+    bool* is_nonzero_1 = is_nonzero_row_1 + r * num_secs;
+
+    bool is_all_zero = std::none_of(is_nonzero_0, is_nonzero_0 + num_secs, [](bool b){ return b; });
+
+    if(is_all_zero) {
+      //incremental memory resetting
+      for(size_t s_o = sec_beg; s_o < sec_end; ++s_o) {
+        if(is_nonzero_1[s_o]) {
+          std::fill(y_1 + sec_offsets[s_o], y_1 + sec_offsets[s_o + 1], T(0));
+          is_nonzero_1[s_o] = false;
+          num_written += sec_offsets[s_o + 1] - sec_offsets[s_o];
+        }
+      }
+      continue;
+    }
+
+    for(size_t s_o = sec_beg; s_o < sec_end; ++s_o) {
+      const int sec_offset = sec_offsets[s_o];
+      const size_t sec_size = sec_offsets[s_o + 1] - sec_offset;
+
+      //set results to bias directly
+      std::fill(results, results + sec_size, bias);
+
+      const int* col_w_sec = col_w + s_o * num_neurons;
+
+      for(size_t s_i = 0; s_i < num_secs; ++s_i) {
+        if(!is_nonzero_0[s_i]) {
+          continue;
+        }
+        num_scanned += sec_offsets[s_i + 1] - sec_offsets[s_i];
+        for(int j = sec_offsets[s_i]; j < sec_offsets[s_i + 1]; ++j) {
+          T valY = y_0[j];
+          if(valY == 0) {
+            continue;
+          }
+          int beg_w = col_w_sec[j];
+          int end_w = col_w_sec[j + 1];
+          for(int k = beg_w; k < end_w; ++k) {
+            results[weight.index(k) - sec_offset] += valY * weight.value(k);
+          }
+          num_nnz += end_w - beg_w;
+          ++num_cols;
+          num_weight_bytes += weight.bytes(beg_w, end_w);
+          num_weight_lines += weight.lines(beg_w, end_w);
+        }
+      }
+
+      bool is_nonzero = false;
+      for(size_t i = 0; i < sec_size; ++i) {
+        T v = std::min(T(32), std::max(results[i], T(0)));
+        y_1[sec_offset + i] = v;
+        is_nonzero |= (v != 0);
+      }
+      is_nonzero_1[s_o] = is_nonzero;
+      num_written += sec_size;
+    }
+  }
+
+  counter.flops += 2.0 * num_nnz;
+  counter.bytes += double(num_weight_bytes)
+                 + double(num_cols) * 2 * sizeof(int)
+                 + double(num_scanned + num_written) * sizeof(T);
+  counter.weight_bytes += num_weight_bytes;
+  counter.weight_lines += num_weight_lines;
+}
+
+// every chunk gathers Y_0 through the input neurons of its slots
+// accumulation starts from bias and follows ascending input neurons,
+// the order of snig_cpu_inference, and padding slots add 0 * Y_0[0],
+// so both kernels round the same way
+// results holds the C accumulators of a chunk
+template <typename T>
+void snig_cpu_sell_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const size_t sec_size,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const SELLLayer<T>& weight,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+) {
+  const size_t C = weight.C;
+  const size_t chunks_per_sec = sec_size / C;
+  const int* col = weight.col.data();
+  const T* val = weight.val.data();
+  const int* perm = weight.perm.data();
+
+  size_t num_slots{0};
+  size_t num_nnz{0};
+  size_t num_lines{0};
+  size_t num_written{0};
+
+  for(size_t r = 0; r < num_rows; ++r) {
+    const T* y_0 = Y_0 + r * num_neurons;
+    const bool* is_nonzero_0 = is_nonzero_row_0 + r * num_secs;
+    T* y_1 = Y_1 + r * num_neurons;
+    bool* is_nonzero_1 = is_nonzero_row_1 + r * num_secs;
+
+    bool is_all_zero = std::none_of(is_nonzero_0, is_nonzero_0 + num_secs, [](bool b){ return b; });
+
+    if(is_all_zero) {
+      //incremental memory resetting
+      for(size_t s_o = 0; s_o < num_secs; ++s_o) {
+        if(is_nonzero_1[s_o]) {
+          std::fill(y_1 + s_o * sec_size, y_1 + (s_o + 1) * sec_size, T(0));
+          is_nonzero_1[s_o] = false;
+          num_written += sec_size;
+        }
+      }
+      continue;
+    }
+
+    for(size_t s_o = 0; s_o < num_secs; ++s_o) {
+      bool is_nonzero = false;
+      for(size_t q = s_o * chunks_per_sec; q < (s_o + 1) * chunks_per_sec; ++q) {
+        const int beg = weight.chunk_ptr[q];
+        const int len = weight.chunk_len[q];
+
+        std::fill(results, results + C, bias);
+        for(int k = 0; k < len; ++k) {
+          const int* col_k = col + beg + k * C;
+          const T* val_k = val + beg + k * C;
+          #pragma omp simd
+          for(size_t c = 0; c < C; ++c) {
+            results[c] += y_0[col_k[c]] * val_k[c];
+          }
+        }
+
+        for(size_t c = 0; c < C; ++c) {
+          T v = std::min(T(32), std::max(results[c], T(0)));
+          y_1[perm[q * C + c]] = v;
+          is_nonzero |= (v != 0);
+        }
+
+        num_slots += len * C;
+        num_nnz += weight.chunk_nnz[q];
+        num_lines += cache_lines(col + beg, len * C * sizeof(int))
+                   + cache_lines(val + beg, len * C * sizeof(T));
+      }
+      is_nonzero_1[s_o] = is_nonzero;
+      num_written += sec_size;
+    }
+  }
+
+  //padding slots are computed like real ones
+  counter.flops += 2.0 * num_slots;
+  counter.bytes += double(num_slots) * (sizeof(int) + 2 * sizeof(T))
+                 + double(num_written) * sizeof(T);
+  counter.weight_bytes += double(num_nnz) * (sizeof(int) + sizeof(T));
+  counter.weight_lines += num_lines;
+}
+
+// every output neuron still accumulates from bias in ascending input order,
+// so the blocked kernel rounds the same way as snig_cpu_inference
+template <typename T>
+void snig_cpu_blocked_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const BlockedLayer<T>& weight,
+  const T bias,
+  const size_t sec_beg,
+  const size_t sec_end,
+  const size_t row_block,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter
+) {
+  const int* col_ptr = weight.col_ptr.data();
+  const int* row = weight.row.data();
+  const T* val = weight.val.data();
+
+  size_t num_nnz{0};
+  size_t num_cols{0};
+  size_t num_scanned{0};
+  size_t num_written{0};
+  size_t num_weight_lines{0};
+
+  auto is_all_zero = [&](const size_t r) {
+    const bool* is_nonzero_0 = is_nonzero_row_0 + r * num_secs;
+    return std::none_of(is_nonzero_0, is_nonzero_0 + num_secs, [](bool b){ return b; });
+  };
+
+  for(size_t rb = 0; rb < num_rows; rb += row_block) {
+    const size_t rb_end = std::min(rb + row_block, num_rows);
+
+    //incremental memory resetting
+    for(size_t r = rb; r < rb_end; ++r) {
+      if(!is_all_zero(r)) {
+        continue;
+      }
+      T* y_1 = Y_1 + r * num_neurons;
+      bool* is_nonzero_1 = is_nonzero_row_1 + r * num_secs;
+      for(size_t s_o = sec_beg; s_o < sec_end; ++s_o) {
+        if(is_nonzero_1[s_o]) {
+          std::fill(y_1 + sec_offsets[s_o], y_1 + sec_offsets[s_o + 1], T(0));
+          is_nonzero_1[s_o] = false;
+          num_written += sec_offsets[s_o + 1] - sec_offsets[s_o];
+        }
+      }
+    }
+
+    for(size_t s_o = sec_beg; s_o < sec_end; ++s_o) {
+      for(size_t r = rb; r < rb_end; ++r) {
+        if(!is_all_zero(r)) {
+          is_nonzero_row_1[r * num_secs + s_o] = false;
+        }
+      }
+
+      for(int q = weight.sec_subs[s_o]; q < weight.sec_subs[s_o + 1]; ++q) {
+        const int sub_offset = weight.sub_offsets[q];
+        const size_t sub_size = weight.sub_offsets[q + 1] - sub_offset;
+        const int* col_ptr_sub = col_ptr + q * num_neurons;
+
+        //the rows of the block reuse the weights of this sub-block while hot
+        for(size_t r = rb; r < rb_end; ++r) {
+          if(is_all_zero(r)) {
+            continue;
+          }
+          const T* y_0 = Y_0 + r * num_neurons;
+          const bool* is_nonzero_0 = is_nonzero_row_0 + r * num_secs;
+
+          std::fill(results, results + sub_size, bias);
+
+          for(size_t s_i = 0; s_i < num_secs; ++s_i) {
+            if(!is_nonzero_0[s_i]) {
+              continue;
+            }
+            num_scanned += sec_offsets[s_i + 1] - sec_offsets[s_i];
+            for(int j = sec_offsets[s_i]; j < sec_offsets[s_i + 1]; ++j) {
+              T valY = y_0[j];
+              if(valY == 0) {
+                continue;
+              }
+              int beg_w = col_ptr_sub[j];
+              int end_w = col_ptr_sub[j + 1];
+              for(int k = beg_w; k < end_w; ++k) {
+                results[row[k] - sub_offset] += valY * val[k];
+              }
+              num_nnz += end_w - beg_w;
+              ++num_cols;
+              num_weight_lines += cache_lines(row + beg_w, (end_w - beg_w) * sizeof(int))
+                                + cache_lines(val + beg_w, (end_w - beg_w) * sizeof(T));
+            }
+          }
+
+          T* y_1 = Y_1 + r * num_neurons + sub_offset;
+          bool is_nonzero = false;
+          for(size_t i = 0; i < sub_size; ++i) {
+            T v = std::min(T(32), std::max(results[i], T(0)));
+            y_1[i] = v;
+            is_nonzero |= (v != 0);
+          }
+          is_nonzero_row_1[r * num_secs + s_o] |= is_nonzero;
+          num_written += sub_size;
+        }
+      }
+    }
+  }
+
+  counter.flops += 2.0 * num_nnz;
+  counter.bytes += double(num_nnz) * (sizeof(int) + sizeof(T))
+                 + double(num_cols) * 2 * sizeof(int)
+                 + double(num_scanned + num_written) * sizeof(T);
+  counter.weight_bytes += double(num_nnz) * (sizeof(int) + sizeof(T));
+  counter.weight_lines += num_weight_lines;
+}
+
+template <typename T>
+size_t snig_cpu_threshold(
+  T* Y_1,
+  bool* is_nonzero_row_1,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const T threshold,
+  const size_t sec_beg,
+  const size_t sec_end,
+  LayerCounter& counter
+) {
+  size_t num_zeroed{0};
+  size_t num_scanned{0};
+
+  for(size_t r = 0; r < num_rows; ++r) {
+    T* y_1 = Y_1 + r * num_neurons;
+    bool* is_nonzero_1 = is_nonzero_row_1 + r * num_secs;
+
+    //sections already flagged zero hold no activation to drop
+    for(size_t s = sec_beg; s < sec_end; ++s) {
+      if(!is_nonzero_1[s]) {
+        continue;
+      }
+      bool is_nonzero = false;
+      for(int i = sec_offsets[s]; i < sec_offsets[s + 1]; ++i) {
+        if(y_1[i] != 0 && y_1[i] < threshold) {
+          y_1[i] = T(0);
+          ++num_zeroed;
+        }
+        is_nonzero |= (y_1[i] != 0);
+      }
+      is_nonzero_1[s] = is_nonzero;
+      num_scanned += sec_offsets[s + 1] - sec_offsets[s];
+    }
+  }
+
+  counter.bytes += 2.0 * num_scanned * sizeof(T);
+  return num_zeroed;
+}
+
+// same structure as snig_cpu_inference with integer arithmetic
+// products of int16 weights and uint16 activations are summed in int32
+// and rounded back to activation units when the section is written
+inline
+void snig_cpu_fixed_inference(
+  const FixedActivation* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const int* sec_offsets,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const int* col_w,
+  const int* row_w,
+  const FixedWeight* val_w,
+  const int32_t bias,
+  const FixedPointFormat& format,
+  bool* is_nonzero_row_1,
+  FixedActivation* Y_1,
+  int32_t* results,
+  LayerCounter& counter
+) {
+  const int shift = format.weight_frac_bits;
+  const int32_t half = shift > 0 ? int32_t(1) << (shift - 1) : 0;
+  const int32_t max_activation = format.max_activation();
+
+  size_t num_nnz{0};
+  size_t num_cols{0};
+  size_t num_scanned{0};
+  size_t num_written{0};
+  size_t num_weight_lines{0};
+
+  for(size_t r = 0; r < num_rows; ++r) {
+    const FixedActivation* y_0 = Y_0 + r * num_neurons;
+    const bool* is_nonzero_0 = is_nonzero_row_0 + r * num_secs;
+    FixedActivation* y_1 = Y_1 + r * num_neurons;
+    bool* is_nonzero_1 = is_nonzero_row_1 + r * num_secs;
+
+    bool is_all_zero = std::none_of(is_nonzero_0, is_nonzero_0 + num_secs, [](bool b){ return b; });
+
+    if(is_all_zero) {
+      //incremental memory resetting
+      for(size_t s_o = 0; s_o < num_secs; ++s_o) {
+        if(is_nonzero_1[s_o]) {
+          std::fill(y_1 + sec_offsets[s_o], y_1 + sec_offsets[s_o + 1], FixedActivation(0));
+          is_nonzero_1[s_o] = false;
+          num_written += sec_offsets[s_o + 1] - sec_offsets[s_o];
+        }
+      }
+      continue;
+    }
+
+    for(size_t s_o = 0; s_o < num_secs; ++s_o) {
+      const int sec_offset = sec_offsets[s_o];
+      const size_t sec_size = sec_offsets[s_o + 1] - sec_offset;
+
+      std::fill(results, results + sec_size, bias);
+
+      const int* col_w_sec = col_w + s_o * num_neurons;
+
+      for(size_t s_i = 0; s_i < num_secs; ++s_i) {
+        if(!is_nonzero_0[s_i]) {
+          continue;
+        }
+        num_scanned += sec_offsets[s_i + 1] - sec_offsets[s_i];
+        for(int j = sec_offsets[s_i]; j < sec_offsets[s_i + 1]; ++j) {
+          const int32_t valY = y_0[j];
+          if(valY == 0) {
+            continue;
+          }
+          int beg_w = col_w_sec[j];
+          int end_w = col_w_sec[j + 1];
+          for(int k = beg_w; k < end_w; ++k) {
+            results[row_w[k] - sec_offset] += valY * int32_t(val_w[k]);
+          }
+          num_nnz += end_w - beg_w;
+          ++num_cols;
+          num_weight_lines += cache_lines(row_w + beg_w, (end_w - beg_w) * sizeof(int))
+                            + cache_lines(val_w + beg_w, (end_w - beg_w) * sizeof(FixedWeight));
+        }
+      }
+
+      bool is_nonzero = false;
+      for(size_t i = 0; i < sec_size; ++i) {
+        int32_t v = std::min(max_activation, std::max((results[i] + half) >> shift, int32_t(0)));
+        y_1[sec_offset + i] = FixedActivation(v);
+        is_nonzero |= (v != 0);
+      }
+      is_nonzero_1[s_o] = is_nonzero;
+      num_written += sec_size;
+    }
+  }
+
+  counter.flops += 2.0 * num_nnz;
+  counter.bytes += double(num_nnz) * (sizeof(int) + sizeof(FixedWeight))
+                 + double(num_cols) * 2 * sizeof(int)
+                 + double(num_scanned + num_written) * sizeof(FixedActivation);
+  counter.weight_bytes += double(num_nnz) * (sizeof(int) + sizeof(FixedWeight));
+  counter.weight_lines += num_weight_lines;
+}
+
+namespace detail {
+
+// one block row of R output neurons
+// the R accumulators stay in registers across all blocks of the row,
+// and blocks whose C inputs are all zero are skipped
+template <typename T, size_t R, size_t C>
+size_t bsr_block_row(
+  const T* y_0,
+  const int* block_col,
+  const T* val,
+  const int beg,
+  const int end,
+  const T bias,
+  T* y_1
+) {
+  T acc[R];
+  for(size_t r = 0; r < R; ++r) {
+    acc[r] = bias;
+  }
+
+  size_t num_blocks{0};
+  for(int b = beg; b < end; ++b) {
+    const T* x = y_0 + size_t(block_col[b]) * C;
+    bool is_zero = true;
+    for(size_t c = 0; c < C; ++c) {
+      is_zero &= (x[c] == 0);
+    }
+    if(is_zero) {
+      continue;
+    }
+    const T* v = val + size_t(b) * R * C;
+    for(size_t c = 0; c < C; ++c) {
+      #pragma omp simd
+      for(size_t r = 0; r < R; ++r) {
+        acc[r] += v[c * R + r] * x[c];
+      }
+    }
+    ++num_blocks;
+  }
+
+  for(size_t r = 0; r < R; ++r) {
+    y_1[r] = std::min(T(32), std::max(acc[r], T(0)));
+  }
+  return num_blocks;
+}
+
+// blocks of a row are ordered by block column and the weights of a block
+// by input neuron, so every output neuron accumulates from bias in ascending
+// input order as in snig_cpu_inference, and zeros of a block add nothing
+template <typename T, size_t R, size_t C>
+void bsr_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const size_t sec_size,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const BSRLayer<T>& weight,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  LayerCounter& counter
+) {
+  const int* block_row_ptr = weight.block_row_ptr.data();
+  const int* block_col = weight.block_col.data();
+  const T* val = weight.val.data();
+
+  size_t num_blocks{0};
+  size_t num_written{0};
+
+  for(size_t r = 0; r < num_rows; ++r) {
+    const T* y_0 = Y_0 + r * num_neurons;
+    const bool* is_nonzero_0 = is_nonzero_row_0 + r * num_secs;
+    T* y_1 = Y_1 + r * num_neurons;
+    bool* is_nonzero_1 = is_nonzero_row_1 + r * num_secs;
+
+    bool is_all_zero = std::none_of(is_nonzero_0, is_nonzero_0 + num_secs, [](bool b){ return b; });
+
+    if(is_all_zero) {
+      //incremental memory resetting
+      for(size_t s_o = 0; s_o < num_secs; ++s_o) {
+        if(is_nonzero_1[s_o]) {
+          std::fill(y_1 + s_o * sec_size, y_1 + (s_o + 1) * sec_size, T(0));
+          is_nonzero_1[s_o] = false;
+          num_written += sec_size;
+        }
+      }
+      continue;
+    }
+
+    for(size_t s_o = 0; s_o < num_secs; ++s_o) {
+      for(size_t ib = s_o * sec_size / R; ib < (s_o + 1) * sec_size / R; ++ib) {
+        num_blocks += bsr_block_row<T, R, C>(
+          y_0, block_col, val, block_row_ptr[ib], block_row_ptr[ib + 1], bias, y_1 + ib * R
+        );
+      }
+      is_nonzero_1[s_o] = std::any_of(
+        y_1 + s_o * sec_size, y_1 + (s_o + 1) * sec_size, [](T v){ return v != 0; }
+      );
+      num_written += sec_size;
+    }
+  }
+
+  //zeros inside the blocks are computed like weights
+  const double block_bytes = sizeof(int) + sizeof(T) * R * C;
+  counter.flops += 2.0 * num_blocks * R * C;
+  counter.bytes += num_blocks * (block_bytes + sizeof(T) * C)
+                 + double(num_written) * sizeof(T);
+  counter.weight_bytes += num_blocks * (sizeof(int) + sizeof(T) * R * C * weight.fill_ratio());
+  counter.weight_lines += num_blocks * block_bytes / cache_line_size;
+}
+
+}// end of namespace detail
+
+template <typename T>
+void snig_cpu_bsr_inference(
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const size_t sec_size,
+  const size_t num_secs,
+  const size_t num_neurons,
+  const BSRLayer<T>& weight,
+  const T bias,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  LayerCounter& counter
+) {
+  using Kernel = void (*)(
+    const T*, const bool*, const size_t, const size_t, const size_t, const size_t,
+    const BSRLayer<T>&, const T, bool*, T*, LayerCounter&
+  );
+
+  //one micro-kernel per shape of bsr_block_shapes()
+  static const std::map<std::pair<size_t, size_t>, Kernel> kernels{
+    {{8, 4}, &detail::bsr_inference<T, 8, 4>},
+    {{4, 4}, &detail::bsr_inference<T, 4, 4>},
+    {{8, 1}, &detail::bsr_inference<T, 8, 1>},
+    {{4, 2}, &detail::bsr_inference<T, 4, 2>},
+    {{2, 4}, &detail::bsr_inference<T, 2, 4>},
+    {{4, 1}, &detail::bsr_inference<T, 4, 1>},
+    {{2, 2}, &detail::bsr_inference<T, 2, 2>},
+    {{1, 4}, &detail::bsr_inference<T, 1, 4>}
+  };
+
+  auto it = kernels.find({weight.R, weight.C});
+  if(it != kernels.end()) {
+    it->second(
+      Y_0,
+      is_nonzero_row_0,
+      num_rows,
+      sec_size,
+      num_secs,
+      num_neurons,
+      weight,
+      bias,
+      is_nonzero_row_1,
+      Y_1,
+      counter
+    );
+    return;
+  }
+
+  throw std::runtime_error(
+    "no BSR micro-kernel for " + std::to_string(weight.R) + "x" + std::to_string(weight.C) + " blocks"
+  );
+}
+
+}// end of namespace snig ----------------------------------------------
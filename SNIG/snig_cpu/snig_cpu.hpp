@@ -0,0 +1,1508 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/matrix_format.h>
+#include <SNIG/utility/cuda_error.hpp>
+#include <SNIG/utility/scoring.hpp>
+#include <SNIG/utility/roofline.hpp>
+#include <SNIG/snig_cpu/kernel.hpp>
+#include <SNIG/snig_cpu/weight_layout.hpp>
+#include <SNIG/base/base.hpp>
+#include <omp.h>
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig{
+
+// How SNIGCPU spreads a run over its threads
+//   batch   : every thread takes one batch at a time through all layers
+//   section : all threads run one batch together, every layer split by
+//             output section with a barrier between layers,
+//             which keeps all cores busy on small batches
+enum class CPUSchedule {
+  batch,
+  section
+};
+
+inline
+CPUSchedule to_cpu_schedule(const std::string& name);
+
+inline
+std::string to_string(const CPUSchedule schedule);
+
+// scratch type in which a thread accumulates one output section
+// of activations of type A, T unless a representation says otherwise
+template <typename T, typename A>
+struct CPUAccumulator {
+  using type = T;
+};
+
+template <typename T, typename A = T>
+class SNIGCPU : public Base<T> {
+  //SNIG on host cores
+  //each thread takes one input batch at a time and runs it through all layers,
+  //the same as one device of SNIG does with its cudaFlow.
+  //Every layer is timed and counted so the run can be placed on the host roofline.
+  //
+  //The buffers of the schedule hold activations of type A.
+  //The weight layouts, the section schedule, and the approximate mode
+  //run A == T only; other representations derive from SNIGCPU
+  //and bring their own kernel to _infer_by_batch (see SNIGCPUFixed).
+
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  protected:
+
+    using Acc = typename CPUAccumulator<T, A>::type;
+
+    size_t _batch_size;
+    size_t _num_threads;
+
+    //the first buffer of every batch is its slice of the source
+    std::vector<A> _source_Y;
+    std::unique_ptr<bool[]> _source_is_nonzero_row;
+    size_t _source_mask_len{0};
+
+    //rows of infer_dense and infer_csr, read in place from the caller,
+    //all null for the input file of infer
+    const A* _caller_Y{nullptr};
+    const size_t* _caller_row_ptr{nullptr};
+    const int* _caller_col_idx{nullptr};
+    const A* _caller_values{nullptr};
+
+    //categories of infer_dense and infer_csr, one int per input, written in place
+    int* _caller_categories{nullptr};
+
+    //first buffers of the batches of caller rows, which layers 1, 3, ... overwrite
+    std::vector<std::vector<A> > _thread_first_Y;
+    std::vector<std::unique_ptr<bool[]> > _thread_first_is_nonzero_row;
+
+    std::vector<std::vector<A> > _thread_Y;
+    std::vector<std::unique_ptr<bool[]> > _thread_is_nonzero_row;
+    std::vector<std::vector<Acc> > _thread_results;
+
+    //one bit per input
+    CategoryBitset _results;
+
+    //per-layer work summed over all threads
+    std::vector<LayerCounter> _layer_counters;
+
+    WeightLayout _weight_layout{WeightLayout::split};
+
+    //WeightLayout::interleaved only
+    //constant-valued layers keep no pairs and read row_w of the packed copy
+    std::vector<std::vector<IndexValue<T> > > _interleaved_weight;
+    std::vector<bool> _is_constant_layer;
+
+    //WeightLayout::sell only
+    std::fs::path _weight_path;
+    std::vector<SELLLayer<T> > _sell_weight;
+
+    //WeightLayout::bsr only
+    std::vector<BSRLayer<T> > _bsr_weight;
+
+    //WeightLayout::blocked only
+    //a sub_size of 0 asks for the blocking to be tuned on the input
+    CacheBlocking _blocking;
+    CacheBlocking _blocking_in_use;
+    std::vector<BlockedLayer<T> > _blocked_weight;
+    std::vector<std::pair<CacheBlocking, double> > _blocking_trials;
+
+    //approximate mode only, one threshold per layer
+    //empty runs the exact inference
+    std::vector<T> _thresholds;
+    std::vector<size_t> _layer_thresholded;
+
+    CPUSchedule _schedule{CPUSchedule::batch};
+
+    //seconds of every batch of the last infer
+    std::vector<double> _batch_latencies;
+
+    void _free_interleaved_weight();
+
+    void _free_sell_weight();
+
+    void _free_bsr_weight();
+
+    void _free_blocked_weight();
+
+    void _build_blocked_weight(const size_t sub_size);
+
+    //times every candidate of blocking_candidates on the first rows of the
+    //input through the first layers, one thread, and keeps the fastest
+    void _autotune_blocking();
+
+    void _set_parameters(
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads
+    );
+
+    //an empty input_path leaves the rows to the caller
+    void _preprocess(const std::fs::path& input_path);
+
+    void _infer();
+
+    //the weight layouts, the section schedule, and the approximate mode
+    //run activations of type T only, other representations override
+    //_preprocess and _infer and never reach the false_type overloads
+    void _preprocess(const std::fs::path& input_path, std::true_type);
+
+    void _preprocess(const std::fs::path& input_path, std::false_type);
+
+    void _infer(std::true_type);
+
+    void _infer(std::false_type);
+
+    //logs and times one run: schedule(thread_counters, thread_latencies)
+    //runs its batches, then the counters and latencies of all threads are summed
+    template <typename S>
+    void _timed_infer(S&& schedule);
+
+    //every infer sets the rows it reads, a run of the input file clears them
+    void _set_caller_input(
+      const A* Y,
+      const size_t* row_ptr,
+      const int* col_idx,
+      const A* values,
+      int* categories
+    );
+
+    bool _is_caller_input() const;
+
+    //points Y[0] and is_nonzero_row[0] at the first buffers of the batch from beg_inputs
+    //and returns the rows and row mask the first layer reads,
+    //which are the first buffers unless dense caller rows are read in place
+    std::pair<const A*, const bool*> _first_buffers(
+      const size_t buffer,
+      const size_t beg_inputs,
+      std::vector<A*>& Y,
+      std::vector<bool*>& is_nonzero_row
+    );
+
+    //zeroes rows [r_beg, r_end) of the batch from beg_inputs in Y,
+    //scatters their CSR entries, and marks the sections holding any
+    void _scatter_csr_rows(
+      const size_t beg_inputs,
+      const size_t r_beg,
+      const size_t r_end,
+      A* Y,
+      bool* is_nonzero_row
+    );
+
+    //marks the category of an input in the bitset and the caller categories
+    void _identify(const size_t input, const A* final_Y);
+
+    //every thread takes one batch at a time through all layers,
+    //layer(tid, cur_layer, Y_0, is_nonzero_row_0, num_rows, is_nonzero_row_1, Y_1, counter)
+    //runs one layer of a batch of the thread
+    template <typename L>
+    void _infer_by_batch(
+      std::vector<std::vector<LayerCounter> >& thread_counters,
+      std::vector<std::vector<double> >& thread_latencies,
+      L&& layer
+    );
+
+    void _infer_by_section(
+      std::vector<std::vector<LayerCounter> >& thread_counters,
+      std::vector<std::vector<size_t> >& thread_thresholded,
+      std::vector<std::vector<double> >& thread_latencies
+    );
+
+    //runs one layer in the weight layout of the engine
+    //split, interleaved, and constant-valued layers go through
+    //generic_inference(weight accessor)
+    template <typename F>
+    void _layer_inference(
+      const size_t cur_layer,
+      const T* Y_0,
+      const bool* is_nonzero_row_0,
+      const size_t num_rows,
+      const size_t sec_beg,
+      const size_t sec_end,
+      bool* is_nonzero_row_1,
+      T* Y_1,
+      T* results,
+      LayerCounter& counter,
+      F&& generic_inference
+    );
+
+    void _weight_alloc();
+
+    void _input_alloc();
+
+    void _input_free();
+
+    void _result_alloc();
+
+  public:
+
+    SNIGCPU(
+      const std::fs::path& weight_path,
+      const T bias = -.3f,
+      const size_t num_neurons_per_layer = 1024,
+      const size_t num_layers = 120,
+      const bool quiet = false
+    );
+
+    ~SNIGCPU();
+
+    void report(JSONWriter& json) const override;
+
+    const std::vector<LayerCounter>& layer_counters() const;
+
+    size_t num_threads() const;
+
+    //takes effect at the next infer
+    void set_weight_layout(const WeightLayout layout);
+
+    WeightLayout weight_layout() const;
+
+    //blocking of WeightLayout::blocked, takes effect at the next infer
+    //a sub_size of 0 tunes it on the first rows of the input
+    void set_cache_blocking(const CacheBlocking& blocking);
+
+    //the blocking of the last infer
+    const CacheBlocking& cache_blocking() const;
+
+    //opt-in approximate inference: activations below the threshold of a layer
+    //are zeroed before the next layer, which trades accuracy for sparsity.
+    //Takes one threshold for all layers or one per layer,
+    //an empty vector restores the exact inference
+    void set_thresholds(const std::vector<T>& thresholds);
+
+    const std::vector<T>& thresholds() const;
+
+    bool is_approximate() const;
+
+    //takes effect at the next infer
+    void set_schedule(const CPUSchedule schedule);
+
+    CPUSchedule schedule() const;
+
+    const std::vector<double>& batch_latencies() const;
+
+    //categories of the last run, one bit per input
+    const CategoryBitset& categories() const;
+
+    Eigen::Matrix<int, Eigen::Dynamic, 1> infer(
+      const std::fs::path& input_path,
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads
+    );
+
+    //infers num_inputs x num_neurons dense row-major rows of the caller in place,
+    //the first layer reads them and no copy is made.
+    //categories, if not null, receives one int per input (1 if active)
+    const CategoryBitset& infer_dense(
+      const T* Y,
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads,
+      int* categories = nullptr
+    );
+
+    //infers CSR rows of the caller in place,
+    //row i holds col_idx[row_ptr[i] .. row_ptr[i + 1]) and the same values,
+    //every batch is scattered into the first buffer of its thread
+    const CategoryBitset& infer_csr(
+      const size_t* row_ptr,
+      const int* col_idx,
+      const T* values,
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads,
+      int* categories = nullptr
+    );
+
+};
+
+// ----------------------------------------------------------------------------
+// Definition of CPUSchedule
+// ----------------------------------------------------------------------------
+
+inline
+CPUSchedule to_cpu_schedule(const std::string& name) {
+  if(name == "batch") {
+    return CPUSchedule::batch;
+  }
+  if(name == "section") {
+    return CPUSchedule::section;
+  }
+  throw std::runtime_error("unknown CPU schedule " + name + " (batch or section)");
+}
+
+inline
+std::string to_string(const CPUSchedule schedule) {
+  return schedule == CPUSchedule::section ? "section" : "batch";
+}
+
+// ----------------------------------------------------------------------------
+// Definition of SNIGCPU
+// ----------------------------------------------------------------------------
+
+template <typename T, typename A>
+SNIGCPU<T, A>::SNIGCPU(
+  const std::fs::path& weight_path,
+  const T bias,
+  const size_t num_neurons_per_layer,
+  const size_t num_layers,
+  const bool quiet
+):
+  Base<T>(dim3{1, 1, 1}, weight_path, bias, num_neurons_per_layer, num_layers, quiet),
+  _weight_path{weight_path}
+{
+  Base<T>::log("Constructing SNIG CPU engine......", "\n");
+}
+
+template <typename T, typename A>
+SNIGCPU<T, A>::~SNIGCPU() {
+  _input_free();
+  Base<T>::_memory.deallocate("result", _results.bytes());
+  _free_interleaved_weight();
+  _free_sell_weight();
+  _free_bsr_weight();
+  _free_blocked_weight();
+}
+
+template <typename T, typename A>
+Eigen::Matrix<int, Eigen::Dynamic, 1> SNIGCPU<T, A>::infer(
+  const std::fs::path& input_path,
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads
+) {
+  _set_parameters(
+    num_inputs,
+    batch_size,
+    num_threads
+  );
+
+  _set_caller_input(nullptr, nullptr, nullptr, nullptr, nullptr);
+
+  _preprocess(input_path);
+
+  _infer();
+
+  return _results.to_Eigen();
+}
+
+template <typename T, typename A>
+const CategoryBitset& SNIGCPU<T, A>::infer_dense(
+  const T* Y,
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads,
+  int* categories
+) {
+  _set_parameters(
+    num_inputs,
+    batch_size,
+    num_threads
+  );
+
+  _set_caller_input(Y, nullptr, nullptr, nullptr, categories);
+
+  _preprocess({});
+
+  _infer();
+
+  return _results;
+}
+
+template <typename T, typename A>
+const CategoryBitset& SNIGCPU<T, A>::infer_csr(
+  const size_t* row_ptr,
+  const int* col_idx,
+  const T* values,
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads,
+  int* categories
+) {
+  //the scatter of the batches trusts the rows
+  for(size_t i = 0; i < num_inputs; ++i) {
+    if(row_ptr[i] > row_ptr[i + 1]) {
+      throw std::runtime_error("row_ptr of CSR rows decreases at row " + std::to_string(i));
+    }
+  }
+  for(size_t k = row_ptr[0]; k < row_ptr[num_inputs]; ++k) {
+    if(col_idx[k] < 0 || size_t(col_idx[k]) >= Base<T>::_num_neurons) {
+      throw std::runtime_error(
+        "column " + std::to_string(col_idx[k]) + " of CSR rows is not a neuron of " + std::to_string(Base<T>::_num_neurons)
+      );
+    }
+  }
+
+  _set_parameters(
+    num_inputs,
+    batch_size,
+    num_threads
+  );
+
+  _set_caller_input(nullptr, row_ptr, col_idx, values, categories);
+
+  _preprocess({});
+
+  _infer();
+
+  return _results;
+}
+
+template <typename T, typename A>
+const CategoryBitset& SNIGCPU<T, A>::categories() const {
+  return _results;
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::report(JSONWriter& json) const {
+  Base<T>::report(json);
+  json.field("batch_size", _batch_size);
+  json.field("num_threads", _num_threads);
+  json.field("schedule", to_string(_schedule));
+  json.field("weight_layout", to_string(_weight_layout));
+  if(!_batch_latencies.empty()) {
+    json.key("batch_latency_ms").begin_object();
+    json.field("num_batches", _batch_latencies.size());
+    json.field("mean", 1000 * std::accumulate(_batch_latencies.begin(), _batch_latencies.end(), 0.0) / _batch_latencies.size());
+    json.field("max", 1000 * *std::max_element(_batch_latencies.begin(), _batch_latencies.end()));
+    json.end_object();
+  }
+  json.field("approximate", is_approximate());
+  if(is_approximate()) {
+    json.key("thresholds").begin_array();
+    for(auto t : _thresholds) {
+      json.value(t);
+    }
+    json.end_array();
+    json.key("num_thresholded").begin_array();
+    for(auto n : _layer_thresholded) {
+      json.value(n);
+    }
+    json.end_array();
+  }
+  if(_weight_layout == WeightLayout::interleaved) {
+    json.field("num_constant_layers", std::count(_is_constant_layer.begin(), _is_constant_layer.end(), true));
+  }
+  LayerCounter total;
+  for(const auto& c : _layer_counters) {
+    total += c;
+  }
+  if(_weight_layout == WeightLayout::sell && !_sell_weight.empty()) {
+    size_t nnz{0};
+    size_t num_slots{0};
+    json.key("sell").begin_object();
+    json.field("C", _sell_weight[0].C);
+    json.field("sigma", _sell_weight[0].sigma);
+    json.key("layers").begin_array();
+    for(size_t l = 0; l < _sell_weight.size(); ++l) {
+      const auto& w = _sell_weight[l];
+      json.begin_object();
+      json.field("layer", l);
+      json.field("nnz", w.nnz);
+      json.field("num_slots", w.num_slots());
+      json.field("padding_overhead", w.padding_overhead());
+      json.end_object();
+      nnz += w.nnz;
+      num_slots += w.num_slots();
+    }
+    json.end_array();
+    json.field("padding_overhead", nnz > 0 ? double(num_slots - nnz) / nnz : 0);
+    json.end_object();
+  }
+  if(_weight_layout == WeightLayout::bsr && !_bsr_weight.empty()) {
+    json.key("bsr").begin_object();
+    json.field("num_blocked_layers", std::count_if(
+      _bsr_weight.begin(), _bsr_weight.end(), [](const BSRLayer<T>& w){ return w.is_blocked(); }
+    ));
+    json.key("layers").begin_array();
+    for(size_t l = 0; l < _bsr_weight.size(); ++l) {
+      const auto& w = _bsr_weight[l];
+      json.begin_object();
+      json.field("layer", l);
+      json.field("nnz", w.nnz);
+      json.field("block", w.is_blocked() ? std::to_string(w.R) + "x" + std::to_string(w.C) : "packed");
+      if(w.is_blocked()) {
+        json.field("num_blocks", w.num_blocks());
+        json.field("fill_ratio", w.fill_ratio());
+      }
+      json.end_object();
+    }
+    json.end_array();
+    json.end_object();
+  }
+  if(_weight_layout == WeightLayout::blocked && !_blocked_weight.empty()) {
+    json.key("cache_blocking").begin_object();
+    json.field("sub_size", _blocking_in_use.sub_size);
+    json.field("row_block", _blocking_in_use.row_block);
+    json.field("autotuned", _blocking.sub_size == 0);
+    json.key("caches");
+    host_caches().dump(json);
+    json.key("trials").begin_array();
+    for(const auto& t : _blocking_trials) {
+      json.begin_object();
+      json.field("blocking", to_string(t.first));
+      json.field("ms", t.second);
+      json.end_object();
+    }
+    json.end_array();
+    json.end_object();
+  }
+  json.field("weight_bytes", total.weight_bytes);
+  json.field("weight_lines", total.weight_lines);
+  json.field("line_utilization", total.line_utilization());
+}
+
+template <typename T, typename A>
+const std::vector<LayerCounter>& SNIGCPU<T, A>::layer_counters() const {
+  return _layer_counters;
+}
+
+template <typename T, typename A>
+size_t SNIGCPU<T, A>::num_threads() const {
+  return _num_threads;
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::set_weight_layout(const WeightLayout layout) {
+  if(layout != WeightLayout::interleaved) {
+    _free_interleaved_weight();
+  }
+  if(layout != WeightLayout::sell) {
+    _free_sell_weight();
+  }
+  if(layout != WeightLayout::bsr) {
+    _free_bsr_weight();
+  }
+  if(layout != WeightLayout::blocked) {
+    _free_blocked_weight();
+  }
+  _weight_layout = layout;
+}
+
+template <typename T, typename A>
+WeightLayout SNIGCPU<T, A>::weight_layout() const {
+  return _weight_layout;
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::set_cache_blocking(const CacheBlocking& blocking) {
+  _free_blocked_weight();
+  _blocking = blocking;
+}
+
+template <typename T, typename A>
+const CacheBlocking& SNIGCPU<T, A>::cache_blocking() const {
+  return _blocking_in_use;
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::set_thresholds(const std::vector<T>& thresholds) {
+  if(thresholds.size() > 1 && thresholds.size() != Base<T>::_num_layers) {
+    throw std::runtime_error(
+      "expect 1 or " + std::to_string(Base<T>::_num_layers) + " thresholds, got " + std::to_string(thresholds.size())
+    );
+  }
+  if(std::all_of(thresholds.begin(), thresholds.end(), [](T t){ return t <= 0; })) {
+    //zero thresholds drop nothing the ReLU has not already dropped
+    _thresholds.clear();
+  }
+  else if(thresholds.size() == 1) {
+    _thresholds.assign(Base<T>::_num_layers, thresholds[0]);
+  }
+  else {
+    _thresholds = thresholds;
+  }
+  _layer_thresholded.clear();
+}
+
+template <typename T, typename A>
+const std::vector<T>& SNIGCPU<T, A>::thresholds() const {
+  return _thresholds;
+}
+
+template <typename T, typename A>
+bool SNIGCPU<T, A>::is_approximate() const {
+  return !_thresholds.empty();
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::set_schedule(const CPUSchedule schedule) {
+  _schedule = schedule;
+}
+
+template <typename T, typename A>
+CPUSchedule SNIGCPU<T, A>::schedule() const {
+  return _schedule;
+}
+
+template <typename T, typename A>
+const std::vector<double>& SNIGCPU<T, A>::batch_latencies() const {
+  return _batch_latencies;
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_set_parameters(
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads
+) {
+  Base<T>::log("Using ", num_threads, " threads", "\n");
+  Base<T>::log("Total input size : ", num_inputs, "\n");
+  Base<T>::log("Input batch size : ", batch_size, "\n\n");
+
+  Base<T>::_num_inputs = num_inputs;
+  //a run of fewer inputs than a batch sizes its buffers to its inputs
+  _batch_size = std::max<size_t>(1, std::min(batch_size, num_inputs));
+  _num_threads = num_threads;
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_preprocess(const std::fs::path& input_path) {
+  _preprocess(input_path, std::is_same<A, T>{});
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_preprocess(const std::fs::path&, std::false_type) {
+  throw std::runtime_error("SNIG_CPU with activations of another type must read its own input");
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_preprocess(const std::fs::path& input_path, std::true_type) {
+  Base<T>::log("Preprocessing...... ");
+  Base<T>::tic();
+  Base<T>::_memory.phase("preprocess");
+
+  //weights stay in the packed host copy
+  _weight_alloc();
+  //input allocation
+  _input_alloc();
+  //final results allocation
+  _result_alloc();
+
+  //read input, caller rows are read where they are
+  if(!_is_caller_input()) {
+    read_input_binary<T>(input_path, _source_Y.data());
+  }
+
+  //tuning runs on the input, so it waits until the input is read
+  if(_weight_layout == WeightLayout::blocked && _blocked_weight.empty()) {
+    _autotune_blocking();
+  }
+
+  Base<T>::toc();
+  Base<T>::log("Finish preprocessing with ", Base<T>::duration(), " ms", "\n");
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_set_caller_input(
+  const A* Y,
+  const size_t* row_ptr,
+  const int* col_idx,
+  const A* values,
+  int* categories
+) {
+  _caller_Y = Y;
+  _caller_row_ptr = row_ptr;
+  _caller_col_idx = col_idx;
+  _caller_values = values;
+  _caller_categories = categories;
+}
+
+template <typename T, typename A>
+bool SNIGCPU<T, A>::_is_caller_input() const {
+  return _caller_Y != nullptr || _caller_row_ptr != nullptr;
+}
+
+template <typename T, typename A>
+std::pair<const A*, const bool*> SNIGCPU<T, A>::_first_buffers(
+  const size_t buffer,
+  const size_t beg_inputs,
+  std::vector<A*>& Y,
+  std::vector<bool*>& is_nonzero_row
+) {
+  if(!_is_caller_input()) {
+    Y[0] = _source_Y.data() + beg_inputs * Base<T>::_num_neurons;
+    is_nonzero_row[0] = _source_is_nonzero_row.get() + beg_inputs * Base<T>::_num_secs;
+    return {Y[0], is_nonzero_row[0]};
+  }
+
+  Y[0] = _thread_first_Y[buffer].data();
+  is_nonzero_row[0] = _thread_first_is_nonzero_row[buffer].get();
+  if(_caller_Y != nullptr) {
+    //every section of a dense row counts as nonzero, as for the input file
+    return {_caller_Y + beg_inputs * Base<T>::_num_neurons, _source_is_nonzero_row.get()};
+  }
+  return {Y[0], is_nonzero_row[0]};
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_scatter_csr_rows(
+  const size_t beg_inputs,
+  const size_t r_beg,
+  const size_t r_end,
+  A* Y,
+  bool* is_nonzero_row
+) {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  std::fill(Y + r_beg * num_neurons, Y + r_end * num_neurons, A(0));
+  std::fill(is_nonzero_row + r_beg * num_secs, is_nonzero_row + r_end * num_secs, false);
+  for(size_t r = r_beg; r < r_end; ++r) {
+    const size_t input = beg_inputs + r;
+    for(size_t k = _caller_row_ptr[input]; k < _caller_row_ptr[input + 1]; ++k) {
+      const int c = _caller_col_idx[k];
+      Y[r * num_neurons + c] = _caller_values[k];
+      is_nonzero_row[r * num_secs + Base<T>::_sections.section_of(c)] = true;
+    }
+  }
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_identify(const size_t input, const A* final_Y) {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  bool is_active = std::any_of(
+    final_Y,
+    final_Y + num_neurons,
+    [](A v){ return v != 0; }
+  );
+  //threads identifying neighbouring inputs share words of the bitset
+  if(is_active) {
+    _results.set_atomic(input);
+  }
+  if(_caller_categories != nullptr) {
+    _caller_categories[input] = is_active ? 1 : 0;
+  }
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_infer() {
+  _infer(std::is_same<A, T>{});
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_infer(std::false_type) {
+  throw std::runtime_error("SNIG_CPU with activations of another type must run its own kernel");
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_infer(std::true_type) {
+  const size_t num_layers = Base<T>::_num_layers;
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  std::vector<std::vector<size_t> > thread_thresholded(
+    _num_threads,
+    std::vector<size_t>(is_approximate() ? num_layers : 0, 0)
+  );
+
+  _timed_infer([&](auto& thread_counters, auto& thread_latencies) {
+    if(_schedule == CPUSchedule::section) {
+      _infer_by_section(thread_counters, thread_thresholded, thread_latencies);
+    }
+    else {
+      _infer_by_batch(thread_counters, thread_latencies, [&](
+        const size_t tid,
+        const size_t cur_layer,
+        const T* Y_0,
+        const bool* is_nonzero_0,
+        const size_t num_rows,
+        bool* is_nonzero_1,
+        T* Y_1,
+        LayerCounter& counter
+      ) {
+        const int* W = Base<T>::_host_pinned_weight + cur_layer * Base<T>::_pp_wlen;
+
+        _layer_inference(
+          cur_layer,
+          Y_0,
+          is_nonzero_0,
+          num_rows,
+          0,
+          num_secs,
+          is_nonzero_1,
+          Y_1,
+          _thread_results[tid].data(),
+          counter,
+          [&](const auto& weight) {
+            snig_cpu_inference<T>(
+              Y_0,
+              is_nonzero_0,
+              num_rows,
+              Base<T>::_sections.offsets.data(),
+              num_secs,
+              num_neurons,
+              W,
+              weight,
+              Base<T>::_bias,
+              is_nonzero_1,
+              Y_1,
+              _thread_results[tid].data(),
+              counter
+            );
+          }
+        );
+
+        if(is_approximate() && _thresholds[cur_layer] > 0) {
+          thread_thresholded[tid][cur_layer] += snig_cpu_threshold<T>(
+            Y_1,
+            is_nonzero_1,
+            num_rows,
+            Base<T>::_sections.offsets.data(),
+            num_secs,
+            num_neurons,
+            _thresholds[cur_layer],
+            0,
+            num_secs,
+            counter
+          );
+        }
+      });
+    }
+
+    _layer_thresholded.assign(is_approximate() ? num_layers : 0, 0);
+    for(const auto& thresholded : thread_thresholded) {
+      for(size_t l = 0; l < thresholded.size(); ++l) {
+        _layer_thresholded[l] += thresholded[l];
+      }
+    }
+  });
+}
+
+template <typename T, typename A>
+template <typename S>
+void SNIGCPU<T, A>::_timed_infer(S&& schedule) {
+  Base<T>::log("Start inference...... ", "\n");
+  Base<T>::tic();
+  Base<T>::_memory.phase("infer");
+
+  const size_t num_layers = Base<T>::_num_layers;
+
+  std::vector<std::vector<LayerCounter> > thread_counters(
+    _num_threads,
+    std::vector<LayerCounter>(num_layers)
+  );
+
+  std::vector<std::vector<double> > thread_latencies(_num_threads);
+
+  schedule(thread_counters, thread_latencies);
+
+  _layer_counters.assign(num_layers, LayerCounter{});
+  for(const auto& counters : thread_counters) {
+    for(size_t l = 0; l < num_layers; ++l) {
+      _layer_counters[l] += counters[l];
+    }
+  }
+
+  _batch_latencies.clear();
+  for(const auto& latencies : thread_latencies) {
+    _batch_latencies.insert(_batch_latencies.end(), latencies.begin(), latencies.end());
+  }
+
+  Base<T>::toc();
+  auto infer_ms = Base<T>::duration();
+  Base<T>::log("Finish inference with ", infer_ms, " ms", "\n");
+
+  Base<T>::_publish_metrics(_results, infer_ms);
+}
+
+template <typename T, typename A>
+template <typename F>
+void SNIGCPU<T, A>::_layer_inference(
+  const size_t cur_layer,
+  const T* Y_0,
+  const bool* is_nonzero_row_0,
+  const size_t num_rows,
+  const size_t sec_beg,
+  const size_t sec_end,
+  bool* is_nonzero_row_1,
+  T* Y_1,
+  T* results,
+  LayerCounter& counter,
+  F&& generic_inference
+) {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+  const int* W = Base<T>::_host_pinned_weight + cur_layer * Base<T>::_pp_wlen;
+  const int* row_w = W + num_neurons * num_secs + 1;
+  const T* val_w = (const T*)(W + Base<T>::_pp_w_index_len);
+
+  if(_weight_layout == WeightLayout::split ||
+     (_weight_layout == WeightLayout::bsr && !_bsr_weight[cur_layer].is_blocked())) {
+    generic_inference(SplitWeight<T>{row_w, val_w});
+  }
+  else if(_weight_layout == WeightLayout::bsr) {
+    snig_cpu_bsr_inference<T>(
+      Y_0,
+      is_nonzero_row_0,
+      num_rows,
+      Base<T>::_sec_size,
+      num_secs,
+      num_neurons,
+      _bsr_weight[cur_layer],
+      Base<T>::_bias,
+      is_nonzero_row_1,
+      Y_1,
+      counter
+    );
+  }
+  else if(_weight_layout == WeightLayout::blocked) {
+    snig_cpu_blocked_inference<T>(
+      Y_0,
+      is_nonzero_row_0,
+      num_rows,
+      Base<T>::_sections.offsets.data(),
+      num_secs,
+      num_neurons,
+      _blocked_weight[cur_layer],
+      Base<T>::_bias,
+      sec_beg,
+      sec_end,
+      _blocking_in_use.row_block,
+      is_nonzero_row_1,
+      Y_1,
+      results,
+      counter
+    );
+  }
+  else if(_weight_layout == WeightLayout::sell) {
+    snig_cpu_sell_inference<T>(
+      Y_0,
+      is_nonzero_row_0,
+      num_rows,
+      Base<T>::_sec_size,
+      num_secs,
+      num_neurons,
+      _sell_weight[cur_layer],
+      Base<T>::_bias,
+      is_nonzero_row_1,
+      Y_1,
+      results,
+      counter
+    );
+  }
+  else if(_is_constant_layer[cur_layer]) {
+    generic_inference(ConstantWeight<T>{row_w, val_w[0]});
+  }
+  else {
+    generic_inference(InterleavedWeight<T>{_interleaved_weight[cur_layer].data()});
+  }
+}
+
+template <typename T, typename A>
+template <typename L>
+void SNIGCPU<T, A>::_infer_by_batch(
+  std::vector<std::vector<LayerCounter> >& thread_counters,
+  std::vector<std::vector<double> >& thread_latencies,
+  L&& layer
+) {
+  const size_t num_layers = Base<T>::_num_layers;
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  std::atomic<size_t> finished_inputs{0};
+
+  #pragma omp parallel num_threads(_num_threads)
+  {
+    const int tid = omp_get_thread_num();
+    Base<T>::_placement.pin("omp", tid);
+    auto& counters = thread_counters[tid];
+
+    std::vector<A*> Y(2);
+    std::vector<bool*> is_nonzero_row(2);
+    Y[1] = _thread_Y[tid].data();
+    is_nonzero_row[1] = _thread_is_nonzero_row[tid].get();
+
+    size_t beg_inputs;
+    while((beg_inputs = finished_inputs.fetch_add(_batch_size)) < Base<T>::_num_inputs) {
+      auto batch_beg = std::chrono::steady_clock::now();
+      size_t num_rows = std::min(_batch_size, Base<T>::_num_inputs - beg_inputs);
+
+      const auto source = _first_buffers(tid, beg_inputs, Y, is_nonzero_row);
+      if(_caller_row_ptr != nullptr) {
+        _scatter_csr_rows(beg_inputs, 0, num_rows, Y[0], is_nonzero_row[0]);
+      }
+
+      //second buffer starts zeroed for every batch
+      std::fill(Y[1], Y[1] + num_rows * num_neurons, A(0));
+      std::fill(is_nonzero_row[1], is_nonzero_row[1] + num_rows * num_secs, false);
+
+      for(size_t cur_layer = 0; cur_layer < num_layers; ++cur_layer) {
+        auto layer_beg = std::chrono::steady_clock::now();
+
+        layer(
+          size_t(tid),
+          cur_layer,
+          cur_layer == 0 ? source.first : Y[cur_layer % 2],
+          cur_layer == 0 ? source.second : is_nonzero_row[cur_layer % 2],
+          num_rows,
+          is_nonzero_row[(cur_layer + 1) % 2],
+          Y[(cur_layer + 1) % 2],
+          counters[cur_layer]
+        );
+
+        counters[cur_layer].seconds += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - layer_beg
+        ).count();
+      }
+
+      //identify
+      const A* final_Y = Y[num_layers % 2];
+      for(size_t i = 0; i < num_rows; ++i) {
+        _identify(beg_inputs + i, final_Y + i * num_neurons);
+      }
+
+      double latency = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - batch_beg
+      ).count();
+      thread_latencies[tid].push_back(latency);
+      Base<T>::_observe_batch(latency);
+    }
+  }
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_infer_by_section(
+  std::vector<std::vector<LayerCounter> >& thread_counters,
+  std::vector<std::vector<size_t> >& thread_thresholded,
+  std::vector<std::vector<double> >& thread_latencies
+) {
+  if(_weight_layout == WeightLayout::sell || _weight_layout == WeightLayout::bsr) {
+    throw std::runtime_error(
+      "the section schedule runs the split, interleaved, and blocked layouts only, not " + to_string(_weight_layout)
+    );
+  }
+
+  const size_t num_layers = Base<T>::_num_layers;
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+  const int* sec_offsets = Base<T>::_sections.offsets.data();
+
+  //all threads run every batch together on one pair of buffers
+  #pragma omp parallel num_threads(_num_threads)
+  {
+    const size_t tid = omp_get_thread_num();
+    Base<T>::_placement.pin("omp", tid);
+    auto& counters = thread_counters[tid];
+    auto& thresholded = thread_thresholded[tid];
+    T* results = _thread_results[tid].data();
+
+    std::vector<T*> Y(2);
+    std::vector<bool*> is_nonzero_row(2);
+    Y[1] = _thread_Y[0].data();
+    is_nonzero_row[1] = _thread_is_nonzero_row[0].get();
+
+    for(size_t beg_inputs = 0; beg_inputs < Base<T>::_num_inputs; beg_inputs += _batch_size) {
+      auto batch_beg = std::chrono::steady_clock::now();
+      const size_t num_rows = std::min(_batch_size, Base<T>::_num_inputs - beg_inputs);
+
+      const auto source = _first_buffers(0, beg_inputs, Y, is_nonzero_row);
+
+      //(output section, row) pairs in section-major order, split evenly over threads
+      //so batches with fewer rows than threads still keep every section busy.
+      //A thread owns the same pairs in every layer.
+      const size_t num_items = num_secs * num_rows;
+      const size_t item_beg = tid * num_items / _num_threads;
+      const size_t item_end = (tid + 1) * num_items / _num_threads;
+
+      //calls f(section, first row, end row) for the pairs of this thread
+      auto for_each_owned = [&](auto&& f) {
+        for(size_t item = item_beg; item < item_end; ) {
+          size_t s = item / num_rows;
+          size_t r_end = std::min(item_end - s * num_rows, num_rows);
+          f(s, item - s * num_rows, r_end);
+          item = s * num_rows + r_end;
+        }
+      };
+
+      //second buffer starts zeroed for every batch
+      for_each_owned([&](size_t s, size_t r_beg, size_t r_end) {
+        for(size_t r = r_beg; r < r_end; ++r) {
+          std::fill(Y[1] + r * num_neurons + sec_offsets[s], Y[1] + r * num_neurons + sec_offsets[s + 1], T(0));
+          is_nonzero_row[1][r * num_secs + s] = false;
+        }
+      });
+
+      //CSR rows are scattered by rows, and every section of them is read by the first layer
+      if(_caller_row_ptr != nullptr) {
+        _scatter_csr_rows(
+          beg_inputs,
+          tid * num_rows / _num_threads,
+          (tid + 1) * num_rows / _num_threads,
+          Y[0],
+          is_nonzero_row[0]
+        );
+        #pragma omp barrier
+      }
+
+      for(size_t cur_layer = 0; cur_layer < num_layers; ++cur_layer) {
+        const int* W = Base<T>::_host_pinned_weight + cur_layer * Base<T>::_pp_wlen;
+        const T* Y_0 = cur_layer == 0 ? source.first : Y[cur_layer % 2];
+        const bool* is_nonzero_0 = cur_layer == 0 ? source.second : is_nonzero_row[cur_layer % 2];
+        T* Y_1 = Y[(cur_layer + 1) % 2];
+        bool* is_nonzero_1 = is_nonzero_row[(cur_layer + 1) % 2];
+        auto layer_beg = std::chrono::steady_clock::now();
+
+        for_each_owned([&](size_t s, size_t r_beg, size_t r_end) {
+          _layer_inference(
+            cur_layer,
+            Y_0 + r_beg * num_neurons,
+            is_nonzero_0 + r_beg * num_secs,
+            r_end - r_beg,
+            s,
+            s + 1,
+            is_nonzero_1 + r_beg * num_secs,
+            Y_1 + r_beg * num_neurons,
+            results,
+            counters[cur_layer],
+            [&](const auto& weight) {
+              snig_cpu_section_inference<T>(
+                Y_0 + r_beg * num_neurons,
+                is_nonzero_0 + r_beg * num_secs,
+                r_end - r_beg,
+                sec_offsets,
+                num_secs,
+                num_neurons,
+                W,
+                weight,
+                Base<T>::_bias,
+                s,
+                s + 1,
+                is_nonzero_1 + r_beg * num_secs,
+                Y_1 + r_beg * num_neurons,
+                results,
+                counters[cur_layer]
+              );
+            }
+          );
+
+          if(is_approximate() && _thresholds[cur_layer] > 0) {
+            thresholded[cur_layer] += snig_cpu_threshold<T>(
+              Y_1 + r_beg * num_neurons,
+              is_nonzero_1 + r_beg * num_secs,
+              r_end - r_beg,
+              sec_offsets,
+              num_secs,
+              num_neurons,
+              _thresholds[cur_layer],
+              s,
+              s + 1,
+              counters[cur_layer]
+            );
+          }
+        });
+
+        //the next layer reads every section of Y_1
+        #pragma omp barrier
+
+        counters[cur_layer].seconds += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - layer_beg
+        ).count();
+      }
+
+      //identify, split by rows
+      const T* final_Y = Y[num_layers % 2];
+      for(size_t i = tid * num_rows / _num_threads; i < (tid + 1) * num_rows / _num_threads; ++i) {
+        _identify(beg_inputs + i, final_Y + i * num_neurons);
+      }
+
+      //the next batch overwrites the shared buffer
+      #pragma omp barrier
+
+      if(tid == 0) {
+        double latency = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - batch_beg
+        ).count();
+        thread_latencies[tid].push_back(latency);
+        Base<T>::_observe_batch(latency);
+      }
+    }
+  }
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_weight_alloc() {
+  //SELL chunks and BSR block rows tile sections of one width
+  if(_weight_layout == WeightLayout::sell || _weight_layout == WeightLayout::bsr) {
+    Base<T>::_require_uniform_sections("SNIG_CPU with the " + to_string(_weight_layout) + " layout");
+  }
+
+  if(_weight_layout == WeightLayout::sell && _sell_weight.empty()) {
+    for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+      auto p = sell_layer_path(_weight_path, Base<T>::_num_neurons, l);
+      _sell_weight.push_back(read_sell_binary<T>(p));
+      const auto& w = _sell_weight.back();
+      if(w.num_neurons != Base<T>::_num_neurons || w.num_secs != Base<T>::_num_secs) {
+        throw std::runtime_error(p.string() + " does not match the sections of the packed model");
+      }
+      Base<T>::_memory.allocate("weight", (sizeof(int) + sizeof(T)) * w.num_slots());
+    }
+  }
+
+  if(_weight_layout == WeightLayout::blocked && _blocked_weight.empty() && _blocking.sub_size > 0) {
+    _build_blocked_weight(_blocking.sub_size);
+    _blocking_in_use = _blocking;
+    _blocking_trials.clear();
+  }
+
+  if(_weight_layout == WeightLayout::bsr && _bsr_weight.empty()) {
+    for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+      auto p = bsr_layer_path(_weight_path, Base<T>::_num_neurons, l);
+      _bsr_weight.push_back(read_bsr_binary<T>(p, Base<T>::_num_neurons, Base<T>::_num_secs));
+      Base<T>::_memory.allocate("weight", _bsr_weight.back().bytes());
+    }
+  }
+
+  //split layout reads the layers directly from Base<T>::_host_pinned_weight
+  if(_weight_layout != WeightLayout::interleaved || !_interleaved_weight.empty()) {
+    return;
+  }
+
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  _interleaved_weight.resize(Base<T>::_num_layers);
+  _is_constant_layer.assign(Base<T>::_num_layers, false);
+  for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+    const int* W = Base<T>::_host_pinned_weight + l * Base<T>::_pp_wlen;
+    const int* row_w = W + num_neurons * num_secs + 1;
+    const T* val_w = (const T*)(W + Base<T>::_pp_w_index_len);
+    size_t nnz = W[num_neurons * num_secs];
+
+    _is_constant_layer[l] = is_constant_valued(val_w, nnz);
+    if(!_is_constant_layer[l]) {
+      _interleaved_weight[l] = interleave_weight(row_w, val_w, nnz);
+      Base<T>::_memory.allocate("weight", sizeof(IndexValue<T>) * nnz);
+    }
+  }
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_free_interleaved_weight() {
+  for(const auto& w : _interleaved_weight) {
+    Base<T>::_memory.deallocate("weight", sizeof(IndexValue<T>) * w.size());
+  }
+  _interleaved_weight.clear();
+  _is_constant_layer.clear();
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_free_bsr_weight() {
+  for(const auto& w : _bsr_weight) {
+    Base<T>::_memory.deallocate("weight", w.bytes());
+  }
+  _bsr_weight.clear();
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_free_blocked_weight() {
+  for(const auto& w : _blocked_weight) {
+    Base<T>::_memory.deallocate("weight", w.bytes());
+  }
+  _blocked_weight.clear();
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_build_blocked_weight(const size_t sub_size) {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  _free_blocked_weight();
+  for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+    const int* W = Base<T>::_host_pinned_weight + l * Base<T>::_pp_wlen;
+    _blocked_weight.push_back(packed_to_blocked<T>(
+      W,
+      W + num_neurons * num_secs + 1,
+      (const T*)(W + Base<T>::_pp_w_index_len),
+      num_neurons,
+      Base<T>::_sections,
+      sub_size
+    ));
+    Base<T>::_memory.allocate("weight", _blocked_weight.back().bytes());
+  }
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_autotune_blocking() {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+  const size_t num_rows = std::min({_batch_size, Base<T>::_num_inputs, size_t(512)});
+  const size_t num_layers = std::min(Base<T>::_num_layers, size_t(8));
+  const int* sec_offsets = Base<T>::_sections.offsets.data();
+
+  auto candidates = blocking_candidates<T>(Base<T>::_sections, num_neurons, host_caches());
+
+  std::vector<T> Y_0(num_rows * num_neurons);
+  std::vector<T> Y_1(num_rows * num_neurons);
+  std::unique_ptr<bool[]> is_nonzero_row_0(new bool[num_rows * num_secs]);
+  std::unique_ptr<bool[]> is_nonzero_row_1(new bool[num_rows * num_secs]);
+  std::vector<T> results(Base<T>::_sec_size);
+  std::vector<BlockedLayer<T> > layers;
+  LayerCounter counter;
+
+  _blocking_trials.clear();
+  double best_ms = std::numeric_limits<double>::max();
+  for(const auto& c : candidates) {
+    if(layers.empty() || layers[0].sub_size != c.sub_size) {
+      layers.clear();
+      for(size_t l = 0; l < num_layers; ++l) {
+        const int* W = Base<T>::_host_pinned_weight + l * Base<T>::_pp_wlen;
+        layers.push_back(packed_to_blocked<T>(
+          W,
+          W + num_neurons * num_secs + 1,
+          (const T*)(W + Base<T>::_pp_w_index_len),
+          num_neurons,
+          Base<T>::_sections,
+          c.sub_size
+        ));
+      }
+    }
+
+    //the kernel overwrites both buffers, so every trial starts from the input
+    if(_caller_row_ptr != nullptr) {
+      _scatter_csr_rows(0, 0, num_rows, Y_0.data(), is_nonzero_row_0.get());
+    }
+    else {
+      const T* rows = _caller_Y != nullptr ? _caller_Y : _source_Y.data();
+      std::copy(rows, rows + num_rows * num_neurons, Y_0.begin());
+      std::fill(is_nonzero_row_0.get(), is_nonzero_row_0.get() + num_rows * num_secs, true);
+    }
+    std::fill(Y_1.begin(), Y_1.end(), T(0));
+    std::fill(is_nonzero_row_1.get(), is_nonzero_row_1.get() + num_rows * num_secs, false);
+    std::vector<T*> Y{Y_0.data(), Y_1.data()};
+    std::vector<bool*> is_nonzero_row{is_nonzero_row_0.get(), is_nonzero_row_1.get()};
+
+    auto beg = std::chrono::steady_clock::now();
+    for(size_t l = 0; l < num_layers; ++l) {
+      snig_cpu_blocked_inference<T>(
+        Y[l % 2],
+        is_nonzero_row[l % 2],
+        num_rows,
+        sec_offsets,
+        num_secs,
+        num_neurons,
+        layers[l],
+        Base<T>::_bias,
+        0,
+        num_secs,
+        c.row_block,
+        is_nonzero_row[(l + 1) % 2],
+        Y[(l + 1) % 2],
+        results.data(),
+        counter
+      );
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - beg).count();
+    _blocking_trials.emplace_back(c, ms);
+    if(ms < best_ms) {
+      best_ms = ms;
+      _blocking_in_use = c;
+    }
+  }
+
+  Base<T>::log("cache blocking ", to_string(_blocking_in_use), " of ", candidates.size(), " tuned...... ");
+  _build_blocked_weight(_blocking_in_use.sub_size);
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_free_sell_weight() {
+  for(const auto& w : _sell_weight) {
+    Base<T>::_memory.deallocate("weight", (sizeof(int) + sizeof(T)) * w.num_slots());
+  }
+  _sell_weight.clear();
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_input_alloc() {
+  //an engine infers many times, the buffers of the last run are replaced
+  _input_free();
+
+  //caller rows need no copy of the source, dense ones share a mask of one batch
+  size_t ylen = _is_caller_input() ? 0 : Base<T>::_num_inputs * Base<T>::_num_neurons;
+  _source_mask_len = (_is_caller_input() ? _batch_size : Base<T>::_num_inputs) * Base<T>::_num_secs;
+
+  _source_Y.assign(ylen, A(0));
+  _source_is_nonzero_row.reset(new bool[_source_mask_len]);
+  std::fill(_source_is_nonzero_row.get(), _source_is_nonzero_row.get() + _source_mask_len, true);
+  Base<T>::_memory.allocate("input", sizeof(A) * ylen);
+  Base<T>::_memory.allocate("row_mask", sizeof(bool) * _source_mask_len);
+
+  //the section schedule shares one second buffer among all threads
+  const size_t num_buffers = _schedule == CPUSchedule::section ? 1 : _num_threads;
+  _thread_Y.resize(num_buffers);
+  _thread_is_nonzero_row.resize(num_buffers);
+  for(size_t t = 0; t < num_buffers; ++t) {
+    _thread_Y[t].assign(_batch_size * Base<T>::_num_neurons, A(0));
+    _thread_is_nonzero_row[t].reset(new bool[_batch_size * Base<T>::_num_secs]());
+    Base<T>::_memory.allocate("activation", sizeof(A) * _thread_Y[t].size());
+    Base<T>::_memory.allocate("row_mask", sizeof(bool) * _batch_size * Base<T>::_num_secs);
+  }
+
+  //and so does its first buffer
+  _thread_first_Y.resize(_is_caller_input() ? num_buffers : 0);
+  _thread_first_is_nonzero_row.resize(_thread_first_Y.size());
+  for(size_t t = 0; t < _thread_first_Y.size(); ++t) {
+    _thread_first_Y[t].assign(_batch_size * Base<T>::_num_neurons, A(0));
+    _thread_first_is_nonzero_row[t].reset(new bool[_batch_size * Base<T>::_num_secs]());
+    Base<T>::_memory.allocate("activation", sizeof(A) * _thread_first_Y[t].size());
+    Base<T>::_memory.allocate("row_mask", sizeof(bool) * _batch_size * Base<T>::_num_secs);
+  }
+
+  _thread_results.resize(_num_threads);
+  for(size_t t = 0; t < _num_threads; ++t) {
+    //counterpart of the shared memory of a thread block
+    _thread_results[t].assign(Base<T>::_sec_size, Acc(0));
+    Base<T>::_memory.allocate("activation", sizeof(Acc) * _thread_results[t].size());
+  }
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_input_free() {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  Base<T>::_memory.deallocate("input", sizeof(A) * _source_Y.size());
+  Base<T>::_memory.deallocate("row_mask", sizeof(bool) * _source_mask_len);
+  for(const auto* buffers : {&_thread_Y, &_thread_first_Y}) {
+    for(const auto& Y : *buffers) {
+      Base<T>::_memory.deallocate("activation", sizeof(A) * Y.size());
+      Base<T>::_memory.deallocate("row_mask", sizeof(bool) * Y.size() / num_neurons * num_secs);
+    }
+  }
+  for(const auto& r : _thread_results) {
+    Base<T>::_memory.deallocate("activation", sizeof(Acc) * r.size());
+  }
+
+  _source_Y.clear();
+  _source_is_nonzero_row.reset();
+  _source_mask_len = 0;
+  _thread_Y.clear();
+  _thread_is_nonzero_row.clear();
+  _thread_first_Y.clear();
+  _thread_first_is_nonzero_row.clear();
+  _thread_results.clear();
+}
+
+template <typename T, typename A>
+void SNIGCPU<T, A>::_result_alloc() {
+  Base<T>::_memory.deallocate("result", _results.bytes());
+  _results.assign(Base<T>::_num_inputs);
+  Base<T>::_memory.allocate("result", _results.bytes());
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/snig_cpu/kernel.hpp>
+#include <SNIG/snig_cpu/fixed_point.hpp>
+#include <SNIG/snig_cpu/snig_cpu.hpp>
+#include <vector>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig{
+
+// a section of fixed-point activations accumulates in int32_t
+template <typename T>
+struct CPUAccumulator<T, FixedActivation> {
+  using type = int32_t;
+};
+
+template <typename T>
+class SNIGCPUFixed : public SNIGCPU<T, FixedActivation> {
+  //SNIG on host cores with fixed-point activations
+  //the schedule is the one of SNIGCPU, but activations are uint16_t
+  //and weights int16_t (see fixed_point.hpp),
+  //so every activation buffer is half the size of the float one.
+  //Weights are quantized once in the constructor from the packed host copy.
+  //Runs the split layout with the batch schedule and the exact inference only.
+
+  using Schedule = SNIGCPU<T, FixedActivation>;
+
+  private:
+
+    FixedPointFormat _format;
+    QuantizationError _error;
+    int32_t _bias_q;
+
+    //quantized val_w of every layer, row_w and col_w stay in the packed copy
+    std::vector<std::vector<FixedWeight> > _weight_q;
+
+    void _quantize_weight();
+
+    //reads the input file and quantizes it into the source buffer
+    void _preprocess(const std::fs::path& input_path);
+
+    void _infer();
+
+  public:
+
+    SNIGCPUFixed(
+      const std::fs::path& weight_path,
+      const T bias = -.3f,
+      const size_t num_neurons_per_layer = 1024,
+      const size_t num_layers = 120,
+      const int frac_bits = 8
+    );
+
+    ~SNIGCPUFixed();
+
+    void report(JSONWriter& json) const override;
+
+    const FixedPointFormat& format() const;
+
+    const QuantizationError& quantization_error() const;
+
+    Eigen::Matrix<int, Eigen::Dynamic, 1> infer(
+      const std::fs::path& input_path,
+      const size_t num_inputs,
+      const size_t batch_size,
+      const size_t num_threads
+    );
+
+};
+
+// ----------------------------------------------------------------------------
+// Definition of SNIGCPUFixed
+// ----------------------------------------------------------------------------
+
+template <typename T>
+SNIGCPUFixed<T>::SNIGCPUFixed(
+  const std::fs::path& weight_path,
+  const T bias,
+  const size_t num_neurons_per_layer,
+  const size_t num_layers,
+  const int frac_bits
+):
+  Schedule(weight_path, bias, num_neurons_per_layer, num_layers)
+{
+  Base<T>::log("Constructing SNIG CPU fixed-point engine......", "\n");
+  _format.frac_bits = frac_bits;
+  _quantize_weight();
+}
+
+template <typename T>
+SNIGCPUFixed<T>::~SNIGCPUFixed() {
+  for(const auto& w : _weight_q) {
+    Base<T>::_memory.deallocate("weight", sizeof(FixedWeight) * w.size());
+  }
+}
+
+template <typename T>
+Eigen::Matrix<int, Eigen::Dynamic, 1> SNIGCPUFixed<T>::infer(
+  const std::fs::path& input_path,
+  const size_t num_inputs,
+  const size_t batch_size,
+  const size_t num_threads
+) {
+  if(
+    Schedule::weight_layout() != WeightLayout::split ||
+    Schedule::schedule() != CPUSchedule::batch ||
+    Schedule::is_approximate()
+  ) {
+    throw std::runtime_error(
+      "SNIG_CPU with fixed point runs the split layout with the batch schedule and no thresholds only"
+    );
+  }
+
+  Schedule::_set_parameters(
+    num_inputs,
+    batch_size,
+    num_threads
+  );
+
+  Schedule::_set_caller_input(nullptr, nullptr, nullptr, nullptr, nullptr);
+
+  _preprocess(input_path);
+
+  _infer();
+
+  return Schedule::_results.to_Eigen();
+}
+
+template <typename T>
+void SNIGCPUFixed<T>::report(JSONWriter& json) const {
+  Schedule::report(json);
+  json.key("fixed_point");
+  _format.dump(json);
+  json.key("quantization_error");
+  _error.dump(json);
+}
+
+template <typename T>
+const FixedPointFormat& SNIGCPUFixed<T>::format() const {
+  return _format;
+}
+
+template <typename T>
+const QuantizationError& SNIGCPUFixed<T>::quantization_error() const {
+  return _error;
+}
+
+template <typename T>
+void SNIGCPUFixed<T>::_quantize_weight() {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  //the scale is shared by all layers, so the bounds are taken over the model
+  double max_abs_weight{0};
+  double max_abs_row_sum{0};
+  std::vector<double> row_sum(num_neurons);
+  for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+    const int* W = Base<T>::_host_pinned_weight + l * Base<T>::_pp_wlen;
+    const int* row_w = W + num_neurons * num_secs + 1;
+    const T* val_w = (const T*)(W + Base<T>::_pp_w_index_len);
+    size_t nnz = W[num_neurons * num_secs];
+
+    std::fill(row_sum.begin(), row_sum.end(), 0.0);
+    for(size_t k = 0; k < nnz; ++k) {
+      max_abs_weight = std::max(max_abs_weight, std::fabs(double(val_w[k])));
+      row_sum[row_w[k]] += std::fabs(double(val_w[k]));
+    }
+    max_abs_row_sum = std::max(max_abs_row_sum, *std::max_element(row_sum.begin(), row_sum.end()));
+  }
+
+  _format.weight_frac_bits = choose_weight_frac_bits(
+    _format.frac_bits, max_abs_weight, max_abs_row_sum, Base<T>::_bias
+  );
+  _bias_q = quantize_bias(Base<T>::_bias, _format);
+
+  _error = QuantizationError{};
+  _error.bias_error = std::fabs(
+    std::ldexp(double(_bias_q), -_format.acc_frac_bits()) - double(Base<T>::_bias)
+  );
+
+  _weight_q.resize(Base<T>::_num_layers);
+  for(size_t l = 0; l < Base<T>::_num_layers; ++l) {
+    const int* W = Base<T>::_host_pinned_weight + l * Base<T>::_pp_wlen;
+    const T* val_w = (const T*)(W + Base<T>::_pp_w_index_len);
+    size_t nnz = W[num_neurons * num_secs];
+
+    _weight_q[l].resize(nnz);
+    for(size_t k = 0; k < nnz; ++k) {
+      _weight_q[l][k] = quantize_weight(val_w[k], _format.weight_frac_bits);
+      double err = std::fabs(
+        std::ldexp(double(_weight_q[l][k]), -_format.weight_frac_bits) - double(val_w[k])
+      );
+      _error.num_inexact_weights += (err != 0);
+      _error.max_weight_error = std::max(_error.max_weight_error, err);
+    }
+    _error.num_weights += nnz;
+    Base<T>::_memory.allocate("weight", sizeof(FixedWeight) * nnz);
+  }
+
+  Base<T>::log(
+    "Fixed point : ", _format.frac_bits, " activation / ",
+    _format.weight_frac_bits, " weight fractional bits, ",
+    _error.num_inexact_weights, " of ", _error.num_weights, " weights inexact", "\n"
+  );
+}
+
+template <typename T>
+void SNIGCPUFixed<T>::_preprocess(const std::fs::path& input_path) {
+  Base<T>::log("Preprocessing...... ");
+  Base<T>::tic();
+  Base<T>::_memory.phase("preprocess");
+
+  //input allocation
+  Schedule::_input_alloc();
+  //final results allocation
+  Schedule::_result_alloc();
+
+  //read input, then quantize it into the source buffer
+  std::vector<T> input(Base<T>::_num_inputs * Base<T>::_num_neurons);
+  read_input_binary<T>(input_path, input.data());
+  std::transform(input.begin(), input.end(), Schedule::_source_Y.begin(), [&](T v){
+    return quantize_activation(v, _format.frac_bits);
+  });
+
+  Base<T>::toc();
+  Base<T>::log("Finish preprocessing with ", Base<T>::duration(), " ms", "\n");
+}
+
+template <typename T>
+void SNIGCPUFixed<T>::_infer() {
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+
+  Schedule::_timed_infer([&](auto& thread_counters, auto& thread_latencies) {
+    Schedule::_infer_by_batch(thread_counters, thread_latencies, [&](
+      const size_t tid,
+      const size_t cur_layer,
+      const FixedActivation* Y_0,
+      const bool* is_nonzero_0,
+      const size_t num_rows,
+      bool* is_nonzero_1,
+      FixedActivation* Y_1,
+      LayerCounter& counter
+    ) {
+      const int* W = Base<T>::_host_pinned_weight + cur_layer * Base<T>::_pp_wlen;
+
+      snig_cpu_fixed_inference(
+        Y_0,
+        is_nonzero_0,
+        num_rows,
+        Base<T>::_sections.offsets.data(),
+        num_secs,
+        num_neurons,
+        W,
+        W + num_neurons * num_secs + 1,
+        _weight_q[cur_layer].data(),
+        _bias_q,
+        _format,
+        is_nonzero_1,
+        Y_1,
+        Schedule::_thread_results[tid].data(),
+        counter
+      );
+    });
+  });
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/matrix_format.h>
+#include <SNIG/utility/cuda_error.hpp>
+#include <SNIG/utility/request_scheduler.hpp>
+#include <SNIG/utility/traffic_log.hpp>
+#include <SNIG/snig_cpu/kernel.hpp>
+#include <SNIG/base/base.hpp>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig{
+
+struct InferenceResponse {
+  Admission admission{Admission::accepted};
+
+  //one category per input row, empty unless accepted
+  std::vector<int> categories;
+
+  //arrival to completion
+  double latency_ms{0};
+  bool is_deadline_missed{false};
+};
+
+template <typename T>
+class SNIGCPUServer : public Base<T> {
+  //SNIG_CPU serving inference requests
+  //requests of any number of dense input rows are queued in a RequestScheduler
+  //and served by worker threads, one unit (a slice of a request) at a time,
+  //through all layers with the packed CSC kernel.
+
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+  private:
+
+    struct Job {
+      std::vector<T> input;
+      std::vector<int> categories;
+      std::promise<InferenceResponse> promise;
+
+      //first failure of any unit, guarded by _error_mutex
+      std::exception_ptr error;
+    };
+
+    std::mutex _error_mutex;
+
+    std::unique_ptr<RequestScheduler<Job> > _scheduler;
+    std::vector<std::thread> _workers;
+
+    //log of the submitted requests, null unless capture is on
+    std::unique_ptr<TrafficWriter> _capture;
+
+    //two activation buffers, two row masks, and one section scratch per worker
+    std::vector<std::vector<T> > _worker_Y;
+    std::vector<std::unique_ptr<bool[]> > _worker_is_nonzero_row;
+    std::vector<std::vector<T> > _worker_results;
+
+    void _serve(const size_t worker);
+
+    void _run_unit(const size_t worker, typename RequestScheduler<Job>::Unit& unit);
+
+    //the engine has no file-based run, weights stay in the packed host copy
+    void _preprocess(const std::fs::path&) {}
+
+    void _weight_alloc() {}
+
+    void _input_alloc();
+
+    void _result_alloc() {}
+
+    void _infer() {}
+
+  public:
+
+    SNIGCPUServer(
+      const std::fs::path& weight_path,
+      const T bias = -.3f,
+      const size_t num_neurons_per_layer = 1024,
+      const size_t num_layers = 120
+    );
+
+    ~SNIGCPUServer();
+
+    //starts options.num_workers workers
+    void start(const SchedulerOptions& options);
+
+    //logs every submitted request, admitted or not, with its inputs,
+    //arrival, priority, and deadline to path for replay
+    void capture(const std::fs::path& path);
+
+    //input holds num_rows x num_neurons dense activations
+    //the future is ready at once if the request is not admitted,
+    //and holds the exception if serving any of its rows failed
+    std::future<InferenceResponse> submit(
+      std::vector<T>&& input,
+      const size_t priority,
+      const clock::time_point deadline = clock::time_point::max()
+    );
+
+    //serves what is queued, then joins the workers
+    void stop();
+
+    const RequestScheduler<Job>& scheduler() const;
+
+    void report(JSONWriter& json) const override;
+};
+
+// ----------------------------------------------------------------------------
+// Definition of SNIGCPUServer
+// ----------------------------------------------------------------------------
+
+template <typename T>
+SNIGCPUServer<T>::SNIGCPUServer(
+  const std::fs::path& weight_path,
+  const T bias,
+  const size_t num_neurons_per_layer,
+  const size_t num_layers
+):
+  Base<T>(dim3{1, 1, 1}, weight_path, bias, num_neurons_per_layer, num_layers)
+{
+  Base<T>::log("Constructing SNIG CPU server......", "\n");
+}
+
+template <typename T>
+SNIGCPUServer<T>::~SNIGCPUServer() {
+  stop();
+  for(size_t w = 0; w < _worker_results.size(); ++w) {
+    Base<T>::_memory.deallocate("activation", sizeof(T) * _worker_Y[2 * w].size() * 2);
+    Base<T>::_memory.deallocate("row_mask", sizeof(bool) * _scheduler->options().unit_rows * Base<T>::_num_secs * 2);
+    Base<T>::_memory.deallocate("activation", sizeof(T) * _worker_results[w].size());
+  }
+}
+
+template <typename T>
+void SNIGCPUServer<T>::start(const SchedulerOptions& options) {
+  if(_scheduler) {
+    throw std::runtime_error("SNIG CPU server is already started");
+  }
+  Base<T>::log("Serving with ", options.num_workers, " workers", "\n");
+  Base<T>::_memory.phase("infer");
+
+  _scheduler = std::make_unique<RequestScheduler<Job> >(options);
+  _input_alloc();
+
+  for(size_t w = 0; w < options.num_workers; ++w) {
+    _workers.emplace_back([this, w]{
+      Base<T>::_placement.pin("server", w);
+      _serve(w);
+    });
+  }
+}
+
+template <typename T>
+std::future<InferenceResponse> SNIGCPUServer<T>::submit(
+  std::vector<T>&& input,
+  const size_t priority,
+  const clock::time_point deadline
+) {
+  if(!_scheduler) {
+    throw std::runtime_error("SNIG CPU server is not started");
+  }
+  if(input.size() % Base<T>::_num_neurons != 0) {
+    throw std::runtime_error("input is not a whole number of rows of " + std::to_string(Base<T>::_num_neurons));
+  }
+
+  const size_t num_rows = input.size() / Base<T>::_num_neurons;
+  if(_capture) {
+    _capture->append(clock::now(), input.data(), num_rows, priority, deadline);
+  }
+
+  Job job;
+  job.input = std::move(input);
+  job.categories.assign(num_rows, 0);
+  auto future = job.promise.get_future();
+
+  Job rejected;
+  auto admission = _scheduler->submit(std::move(job), num_rows, priority, deadline, &rejected);
+  if(admission != Admission::accepted) {
+    InferenceResponse response;
+    response.admission = admission;
+    rejected.promise.set_value(std::move(response));
+  }
+  return future;
+}
+
+template <typename T>
+void SNIGCPUServer<T>::stop() {
+  if(!_scheduler) {
+    return;
+  }
+  _scheduler->close();
+  for(auto& w : _workers) {
+    w.join();
+  }
+  _workers.clear();
+  if(_capture) {
+    _capture->flush();
+  }
+}
+
+template <typename T>
+void SNIGCPUServer<T>::capture(const std::fs::path& path) {
+  Base<T>::log("Capturing requests to ", path.string(), "\n");
+  _capture = std::make_unique<TrafficWriter>(path, Base<T>::_num_neurons);
+}
+
+template <typename T>
+const RequestScheduler<typename SNIGCPUServer<T>::Job>& SNIGCPUServer<T>::scheduler() const {
+  return *_scheduler;
+}
+
+template <typename T>
+void SNIGCPUServer<T>::report(JSONWriter& json) const {
+  Base<T>::report(json);
+  if(_scheduler) {
+    json.field("num_workers", _scheduler->options().num_workers);
+    json.key("scheduler");
+    _scheduler->dump(json);
+  }
+  if(_capture) {
+    json.key("capture").begin_object();
+    json.field("num_requests", _capture->num_requests());
+    json.field("bytes", _capture->bytes());
+    json.end_object();
+  }
+}
+
+template <typename T>
+void SNIGCPUServer<T>::_serve(const size_t worker) {
+  typename RequestScheduler<Job>::Unit unit;
+  while(_scheduler->pop(unit)) {
+    //a failed unit still completes, so the request is answered and the
+    //worker keeps serving instead of the exception ending the process
+    try {
+      _run_unit(worker, unit);
+      Base<T>::_observe_batch(std::chrono::duration<double>(clock::now() - unit.start).count());
+    }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(_error_mutex);
+      if(!unit.request->payload.error) {
+        unit.request->payload.error = std::current_exception();
+      }
+    }
+
+    if(_scheduler->complete(unit)) {
+      auto& request = *unit.request;
+      if(request.payload.error) {
+        request.payload.promise.set_exception(request.payload.error);
+        unit.request.reset();
+        continue;
+      }
+      InferenceResponse response;
+      response.categories = std::move(request.payload.categories);
+      response.latency_ms = std::chrono::duration<double, std::milli>(clock::now() - request.arrival).count();
+      response.is_deadline_missed = clock::now() > request.deadline;
+      request.payload.promise.set_value(std::move(response));
+    }
+    unit.request.reset();
+  }
+}
+
+template <typename T>
+void SNIGCPUServer<T>::_run_unit(
+  const size_t worker,
+  typename RequestScheduler<Job>::Unit& unit
+) {
+  const size_t num_layers = Base<T>::_num_layers;
+  const size_t num_neurons = Base<T>::_num_neurons;
+  const size_t num_secs = Base<T>::_num_secs;
+  const size_t num_rows = unit.end - unit.beg;
+  auto& job = unit.request->payload;
+
+  //the kernel writes both buffers, so the input is copied in
+  std::vector<T*> Y{_worker_Y[2 * worker].data(), _worker_Y[2 * worker + 1].data()};
+  std::vector<bool*> is_nonzero_row{
+    _worker_is_nonzero_row[2 * worker].get(),
+    _worker_is_nonzero_row[2 * worker + 1].get()
+  };
+  std::copy(
+    job.input.begin() + unit.beg * num_neurons,
+    job.input.begin() + unit.end * num_neurons,
+    Y[0]
+  );
+  std::fill(is_nonzero_row[0], is_nonzero_row[0] + num_rows * num_secs, true);
+  std::fill(Y[1], Y[1] + num_rows * num_neurons, T(0));
+  std::fill(is_nonzero_row[1], is_nonzero_row[1] + num_rows * num_secs, false);
+
+  LayerCounter counter;
+  for(size_t cur_layer = 0; cur_layer < num_layers; ++cur_layer) {
+    const int* W = Base<T>::_host_pinned_weight + cur_layer * Base<T>::_pp_wlen;
+    snig_cpu_inference<T>(
+      Y[cur_layer % 2],
+      is_nonzero_row[cur_layer % 2],
+      num_rows,
+      Base<T>::_sections.offsets.data(),
+      num_secs,
+      num_neurons,
+      W,
+      W + num_neurons * num_secs + 1,
+      (const T*)(W + Base<T>::_pp_w_index_len),
+      Base<T>::_bias,
+      is_nonzero_row[(cur_layer + 1) % 2],
+      Y[(cur_layer + 1) % 2],
+      _worker_results[worker].data(),
+      counter
+    );
+  }
+
+  //identify
+  const T* final_Y = Y[num_layers % 2];
+  for(size_t i = 0; i < num_rows; ++i) {
+    job.categories[unit.beg + i] = std::any_of(
+      final_Y + i * num_neurons,
+      final_Y + (i + 1) * num_neurons,
+      [](T v){ return v != 0; }
+    ) ? 1 : 0;
+  }
+}
+
+template <typename T>
+void SNIGCPUServer<T>::_input_alloc() {
+  const size_t num_workers = _scheduler->options().num_workers;
+  const size_t unit_rows = _scheduler->options().unit_rows;
+
+  _worker_Y.resize(2 * num_workers);
+  _worker_is_nonzero_row.resize(2 * num_workers);
+  _worker_results.resize(num_workers);
+  for(size_t w = 0; w < num_workers; ++w) {
+    for(size_t b = 2 * w; b < 2 * w + 2; ++b) {
+      _worker_Y[b].assign(unit_rows * Base<T>::_num_neurons, T(0));
+      _worker_is_nonzero_row[b].reset(new bool[unit_rows * Base<T>::_num_secs]());
+    }
+    //counterpart of the shared memory of a thread block
+    _worker_results[w].assign(Base<T>::_sec_size, T(0));
+    Base<T>::_memory.allocate("activation", sizeof(T) * _worker_Y[2 * w].size() * 2);
+    Base<T>::_memory.allocate("row_mask", sizeof(bool) * unit_rows * Base<T>::_num_secs * 2);
+    Base<T>::_memory.allocate("activation", sizeof(T) * _worker_results[w].size());
+  }
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,159 @@
+#pragma once
+#include <SNIG/utility/roofline.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace snig{
+
+// How the nonzeros of a packed layer are laid out for the CPU kernels
+//   split       : all row_w indices, then all val_w values (the .b layout)
+//   interleaved : one (index, value) pair per nonzero,
+//                 and only the index for layers whose weights share one value
+//   sell        : SELL-C-sigma files written by the converter (see sell.hpp)
+//   bsr         : block sparse files written by the converter (see bsr.hpp),
+//                 layers the converter left unblocked run with split
+//   blocked     : split re-cut into L1-sized sub-blocks of every section,
+//                 run by blocks of rows (see blocking.hpp)
+enum class WeightLayout {
+  split,
+  interleaved,
+  sell,
+  bsr,
+  blocked
+};
+
+inline
+WeightLayout to_weight_layout(const std::string& name);
+
+inline
+std::string to_string(const WeightLayout layout);
+
+template <typename T>
+struct IndexValue {
+  int index;
+  T value;
+};
+
+// accessors of the nonzeros of one layer, k indexes the packed nonzeros
+template <typename T>
+struct SplitWeight {
+  const int* row_w;
+  const T* val_w;
+
+  int index(const int k) const { return row_w[k]; }
+  T value(const int k) const { return val_w[k]; }
+
+  size_t bytes(const int beg, const int end) const {
+    return (end - beg) * (sizeof(int) + sizeof(T));
+  }
+  size_t lines(const int beg, const int end) const {
+    return cache_lines(row_w + beg, (end - beg) * sizeof(int))
+         + cache_lines(val_w + beg, (end - beg) * sizeof(T));
+  }
+};
+
+template <typename T>
+struct InterleavedWeight {
+  const IndexValue<T>* entries;
+
+  int index(const int k) const { return entries[k].index; }
+  T value(const int k) const { return entries[k].value; }
+
+  size_t bytes(const int beg, const int end) const {
+    return (end - beg) * (sizeof(int) + sizeof(T));
+  }
+  size_t lines(const int beg, const int end) const {
+    return cache_lines(entries + beg, (end - beg) * sizeof(IndexValue<T>));
+  }
+};
+
+template <typename T>
+struct ConstantWeight {
+  const int* row_w;
+  T val;
+
+  int index(const int k) const { return row_w[k]; }
+  T value(const int) const { return val; }
+
+  size_t bytes(const int beg, const int end) const {
+    return (end - beg) * sizeof(int);
+  }
+  size_t lines(const int beg, const int end) const {
+    return cache_lines(row_w + beg, (end - beg) * sizeof(int));
+  }
+};
+
+template <typename T>
+bool is_constant_valued(const T* val_w, const size_t nnz);
+
+// pairs row_w[k] with val_w[k], keeping the order of the packed layer
+// so the col_w offsets stay valid
+template <typename T>
+std::vector<IndexValue<T> > interleave_weight(
+  const int* row_w,
+  const T* val_w,
+  const size_t nnz
+);
+
+// ----------------------------------------------------------------------------
+// Definition of WeightLayout
+// ----------------------------------------------------------------------------
+
+inline
+WeightLayout to_weight_layout(const std::string& name) {
+  if(name == "split") {
+    return WeightLayout::split;
+  }
+  if(name == "interleaved") {
+    return WeightLayout::interleaved;
+  }
+  if(name == "sell") {
+    return WeightLayout::sell;
+  }
+  if(name == "bsr") {
+    return WeightLayout::bsr;
+  }
+  if(name == "blocked") {
+    return WeightLayout::blocked;
+  }
+  throw std::runtime_error("unknown weight layout " + name + " (split, interleaved, sell, bsr, or blocked)");
+}
+
+inline
+std::string to_string(const WeightLayout layout) {
+  switch(layout) {
+    case WeightLayout::interleaved:
+      return "interleaved";
+    case WeightLayout::sell:
+      return "sell";
+    case WeightLayout::bsr:
+      return "bsr";
+    case WeightLayout::blocked:
+      return "blocked";
+    default:
+      return "split";
+  }
+}
+
+template <typename T>
+bool is_constant_valued(const T* val_w, const size_t nnz) {
+  return nnz > 0 && std::all_of(val_w, val_w + nnz, [&](T v){ return v == val_w[0]; });
+}
+
+template <typename T>
+std::vector<IndexValue<T> > interleave_weight(
+  const int* row_w,
+  const T* val_w,
+  const size_t nnz
+) {
+  std::vector<IndexValue<T> > entries(nnz);
+  for(size_t k = 0; k < nnz; ++k) {
+    entries[k].index = row_w[k];
+    entries[k].value = val_w[k];
+  }
+  return entries;
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,437 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <tuple>
+#include <stdexcept>
+
+namespace snig {
+
+// Where a pool places its i-th worker
+//   none    : let the OS place threads (default)
+//   compact : fill SMT siblings of a core, then the next core of the same node
+//   scatter : spread over NUMA nodes and physical cores before using SMT siblings
+//   numa    : bind worker i to every cpu of NUMA node i % num_nodes
+//   no_smt  : like compact but only the first hardware thread of every core
+enum class AffinityPolicy {
+  none,
+  compact,
+  scatter,
+  numa,
+  no_smt
+};
+
+inline
+AffinityPolicy to_affinity_policy(const std::string& name);
+
+inline
+std::string to_string(const AffinityPolicy policy);
+
+// Hardware threads the process may run on, read from /sys
+struct CPUTopology {
+
+  struct CPU {
+    int id{0};
+    int core{0};
+    int package{0};
+    int node{0};
+
+    //index among the SMT siblings of its core
+    int smt_rank{0};
+  };
+
+  std::vector<CPU> cpus;
+
+  //ids of the NUMA nodes, ascending
+  std::vector<int> nodes() const;
+
+  size_t num_nodes() const;
+
+  size_t num_cores() const;
+
+  static CPUTopology detect();
+};
+
+// Applies an AffinityPolicy to the workers of every pool of an engine
+// and records the placement of each pinned worker for the run report
+//
+// API: placement.set_policy(AffinityPolicy::scatter);
+//      placement.pin("omp", omp_get_thread_num());   (on the worker thread)
+class ThreadPlacement {
+
+  public:
+
+    ThreadPlacement();
+
+    explicit ThreadPlacement(CPUTopology topology);
+
+    void set_policy(const AffinityPolicy policy);
+
+    AffinityPolicy policy() const;
+
+    bool is_enabled() const;
+
+    const CPUTopology& topology() const;
+
+    //cpus worker index of a pool may run on
+    std::vector<int> cpus_of(const size_t index) const;
+
+    //pin the calling thread as worker index of pool
+    //under AffinityPolicy::none, a thread pinned by an earlier policy
+    //may run on every cpu of the process again, others are left alone
+    void pin(const std::string& pool, const size_t index);
+
+    void dump(JSONWriter& json) const;
+
+  private:
+
+    mutable std::mutex _mutex;
+
+    AffinityPolicy _policy{AffinityPolicy::none};
+
+    CPUTopology _topology;
+
+    //one order of cpus per policy, worker i takes _order[i % size]
+    std::vector<int> _order;
+
+    //(pool, index) -> cpus
+    std::map<std::pair<std::string, size_t>, std::vector<int> > _pinned;
+
+    //whether any thread was pinned since construction, whatever the policy now
+    bool _has_pinned{false};
+
+    void _build_order();
+};
+
+// ----------------------------------------------------------------------------
+// Definition of AffinityPolicy
+// ----------------------------------------------------------------------------
+
+inline
+AffinityPolicy to_affinity_policy(const std::string& name) {
+  if(name == "none") {
+    return AffinityPolicy::none;
+  }
+  if(name == "compact") {
+    return AffinityPolicy::compact;
+  }
+  if(name == "scatter") {
+    return AffinityPolicy::scatter;
+  }
+  if(name == "numa") {
+    return AffinityPolicy::numa;
+  }
+  if(name == "no_smt") {
+    return AffinityPolicy::no_smt;
+  }
+  throw std::runtime_error("unknown affinity policy " + name + " (none, compact, scatter, numa, or no_smt)");
+}
+
+inline
+std::string to_string(const AffinityPolicy policy) {
+  switch(policy) {
+    case AffinityPolicy::compact:
+      return "compact";
+    case AffinityPolicy::scatter:
+      return "scatter";
+    case AffinityPolicy::numa:
+      return "numa";
+    case AffinityPolicy::no_smt:
+      return "no_smt";
+    default:
+      return "none";
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Definition of CPUTopology
+// ----------------------------------------------------------------------------
+
+namespace detail {
+
+// parse a sysfs cpu (or node) list such as "0-3,8,10-11"
+inline
+std::vector<int> parse_cpu_list(const std::string& s) {
+  std::vector<int> cpus;
+  std::stringstream ss(s);
+  std::string range;
+  while(std::getline(ss, range, ',')) {
+    if(range.empty() || range == "\n") {
+      continue;
+    }
+    auto dash = range.find('-');
+    int beg = std::stoi(range.substr(0, dash));
+    int end = dash == std::string::npos ? beg : std::stoi(range.substr(dash + 1));
+    for(int c = beg; c <= end; ++c) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+inline
+bool read_sysfs(const std::string& path, std::string& s) {
+  std::ifstream in(path);
+  return static_cast<bool>(std::getline(in, s));
+}
+
+}// end of namespace detail
+
+inline
+std::vector<int> CPUTopology::nodes() const {
+  std::vector<int> ids;
+  for(const auto& c : cpus) {
+    ids.push_back(c.node);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+inline
+size_t CPUTopology::num_nodes() const {
+  return nodes().size();
+}
+
+inline
+size_t CPUTopology::num_cores() const {
+  return std::count_if(cpus.begin(), cpus.end(), [](const CPU& c){ return c.smt_rank == 0; });
+}
+
+inline
+CPUTopology CPUTopology::detect() {
+  CPUTopology topology;
+
+  //only cpus the process is allowed to run on
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    for(unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c) {
+      CPU_SET(c, &allowed);
+    }
+  }
+
+  std::map<int, int> node_of;
+  std::string s;
+  if(detail::read_sysfs("/sys/devices/system/node/online", s)) {
+    for(auto n : detail::parse_cpu_list(s)) {
+      std::string cpulist;
+      if(detail::read_sysfs("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist", cpulist)) {
+        for(auto c : detail::parse_cpu_list(cpulist)) {
+          node_of[c] = n;
+        }
+      }
+    }
+  }
+
+  for(int c = 0; c < CPU_SETSIZE; ++c) {
+    if(!CPU_ISSET(c, &allowed)) {
+      continue;
+    }
+    CPU cpu;
+    cpu.id = c;
+    cpu.core = c;
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+    if(detail::read_sysfs(dir + "core_id", s)) {
+      cpu.core = std::stoi(s);
+    }
+    if(detail::read_sysfs(dir + "physical_package_id", s)) {
+      cpu.package = std::stoi(s);
+    }
+    if(detail::read_sysfs(dir + "thread_siblings_list", s)) {
+      auto siblings = detail::parse_cpu_list(s);
+      cpu.smt_rank = std::find(siblings.begin(), siblings.end(), c) - siblings.begin();
+      if(cpu.smt_rank == int(siblings.size())) {
+        cpu.smt_rank = 0;
+      }
+    }
+    auto it = node_of.find(c);
+    cpu.node = it == node_of.end() ? 0 : it->second;
+    topology.cpus.push_back(cpu);
+  }
+
+  return topology;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of ThreadPlacement
+// ----------------------------------------------------------------------------
+
+inline
+ThreadPlacement::ThreadPlacement() : _topology{CPUTopology::detect()} {
+}
+
+inline
+ThreadPlacement::ThreadPlacement(CPUTopology topology) : _topology{std::move(topology)} {
+}
+
+inline
+void ThreadPlacement::set_policy(const AffinityPolicy policy) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _policy = policy;
+  _pinned.clear();
+  _build_order();
+}
+
+inline
+AffinityPolicy ThreadPlacement::policy() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _policy;
+}
+
+inline
+bool ThreadPlacement::is_enabled() const {
+  return policy() != AffinityPolicy::none;
+}
+
+inline
+const CPUTopology& ThreadPlacement::topology() const {
+  return _topology;
+}
+
+inline
+std::vector<int> ThreadPlacement::cpus_of(const size_t index) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if(_policy == AffinityPolicy::none || _order.empty()) {
+    return {};
+  }
+  if(_policy == AffinityPolicy::numa) {
+    //_order holds the node ids, a worker may run on any cpu of its node
+    int node = _order[index % _order.size()];
+    std::vector<int> cpus;
+    for(const auto& c : _topology.cpus) {
+      if(c.node == node) {
+        cpus.push_back(c.id);
+      }
+    }
+    return cpus;
+  }
+  return {_order[index % _order.size()]};
+}
+
+inline
+void ThreadPlacement::pin(const std::string& pool, const size_t index) {
+  auto cpus = cpus_of(index);
+  const bool is_unpin = cpus.empty();
+  if(is_unpin) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(!_has_pinned) {
+        return;
+      }
+    }
+    //the topology holds the cpus the process was allowed at detection
+    for(const auto& c : _topology.cpus) {
+      cpus.push_back(c.id);
+    }
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for(auto c : cpus) {
+    CPU_SET(c, &set);
+  }
+  if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    throw std::runtime_error(
+      std::string("failed to ") + (is_unpin ? "unpin " : "pin ") + pool + " worker " + std::to_string(index)
+    );
+  }
+
+  if(!is_unpin) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pinned[{pool, index}] = std::move(cpus);
+    _has_pinned = true;
+  }
+}
+
+inline
+void ThreadPlacement::dump(JSONWriter& json) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  json.begin_object();
+  json.field("policy", to_string(_policy));
+  json.field("num_cpus", _topology.cpus.size());
+  json.field("num_cores", _topology.num_cores());
+  json.field("num_nodes", _topology.num_nodes());
+  json.key("workers").begin_array();
+  for(const auto& p : _pinned) {
+    json.begin_object();
+    json.field("pool", p.first.first);
+    json.field("index", p.first.second);
+    json.key("cpus").begin_array();
+    for(auto c : p.second) {
+      json.value(c);
+    }
+    json.end_array();
+    json.end_object();
+  }
+  json.end_array();
+  json.end_object();
+}
+
+inline
+void ThreadPlacement::_build_order() {
+  using CPU = CPUTopology::CPU;
+  auto cpus = _topology.cpus;
+  _order.clear();
+
+  switch(_policy) {
+    case AffinityPolicy::compact:
+    case AffinityPolicy::no_smt:
+      std::sort(cpus.begin(), cpus.end(), [](const CPU& a, const CPU& b){
+        return std::tie(a.node, a.package, a.core, a.smt_rank) <
+               std::tie(b.node, b.package, b.core, b.smt_rank);
+      });
+      for(const auto& c : cpus) {
+        if(_policy == AffinityPolicy::compact || c.smt_rank == 0) {
+          _order.push_back(c.id);
+        }
+      }
+    break;
+
+    case AffinityPolicy::scatter: {
+      //for every SMT rank, take one core of each node in turn
+      std::sort(cpus.begin(), cpus.end(), [](const CPU& a, const CPU& b){
+        return std::tie(a.smt_rank, a.package, a.core) <
+               std::tie(b.smt_rank, b.package, b.core);
+      });
+      std::map<int, std::map<int, std::vector<int> > > by_rank_node;
+      for(const auto& c : cpus) {
+        by_rank_node[c.smt_rank][c.node].push_back(c.id);
+      }
+      for(const auto& rank : by_rank_node) {
+        size_t num_rounds{0};
+        for(const auto& node : rank.second) {
+          num_rounds = std::max(num_rounds, node.second.size());
+        }
+        for(size_t i = 0; i < num_rounds; ++i) {
+          for(const auto& node : rank.second) {
+            if(i < node.second.size()) {
+              _order.push_back(node.second[i]);
+            }
+          }
+        }
+      }
+    }
+    break;
+
+    case AffinityPolicy::numa:
+      _order = _topology.nodes();
+    break;
+
+    default:
+    break;
+  }
+}
+
+}// end of namespace snig ----------------------------------------------
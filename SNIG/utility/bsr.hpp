@@ -0,0 +1,378 @@
+#pragma once
+#include <experimental/filesystem>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include <SNIG/utility/reader.hpp>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Block sparse row (BSR) layout of one packed layer
+//
+// The layer is seen as a num_neurons x num_neurons matrix of
+// output neurons (rows) by input neurons (columns) and tiled into R x C blocks.
+// A block is kept if it holds at least one weight and is stored column-major,
+// so the R weights of one input neuron are contiguous.
+// Block rows never cross an output section since R divides sec_size.
+//
+// R == 0 marks a layer whose blocks are too sparse,
+// which the engine runs with the packed CSC instead.
+template <typename T>
+struct BSRLayer {
+  size_t num_neurons{0};
+  size_t num_secs{0};
+  size_t R{0};
+  size_t C{0};
+
+  //real weights, without the zeros of the blocks
+  size_t nnz{0};
+
+  //num_neurons / R + 1 offsets into block_col
+  std::vector<int> block_row_ptr;
+  std::vector<int> block_col;
+
+  //R * C values per block
+  std::vector<T> val;
+
+  bool is_blocked() const;
+
+  size_t num_blocks() const;
+
+  //fraction of stored block entries that are weights
+  double fill_ratio() const;
+
+  //bytes of the arrays
+  size_t bytes() const;
+};
+
+// block shapes tried during conversion, larger blocks first
+inline
+const std::vector<std::pair<size_t, size_t> >& bsr_block_shapes();
+
+// number of R x C blocks with at least one weight
+inline
+size_t count_blocks(
+  const int* col_w,
+  const int* row_w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const size_t R,
+  const size_t C
+);
+
+// blocks the packed (.b) arrays of a layer with the shape of bsr_block_shapes
+// that stores the fewest entries among the shapes reaching min_fill,
+// or returns an unblocked layer if no shape does
+template <typename T>
+BSRLayer<T> packed_to_bsr(
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const double min_fill
+);
+
+inline
+std::fs::path bsr_layer_path(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t layer
+);
+
+template <typename T>
+void write_bsr_binary(const std::fs::path& path, const BSRLayer<T>& layer);
+
+// reads a layer converted for a model of num_neurons in num_secs sections,
+// checking the header against the model and the kernels before allocating
+// and the block indices after reading
+template <typename T>
+BSRLayer<T> read_bsr_binary(
+  const std::fs::path& path,
+  const size_t num_neurons,
+  const size_t num_secs
+);
+
+// writes n{num_neurons}-l{i}.bsr next to every packed n{num_neurons}-l{i}.b
+template <typename T>
+void packed_binary_to_bsr_file(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers,
+  const double min_fill
+);
+
+//-----------------------------------------------------------------------------
+//Definition of BSRLayer
+//-----------------------------------------------------------------------------
+
+template <typename T>
+bool BSRLayer<T>::is_blocked() const {
+  return R > 0;
+}
+
+template <typename T>
+size_t BSRLayer<T>::num_blocks() const {
+  return block_col.size();
+}
+
+template <typename T>
+double BSRLayer<T>::fill_ratio() const {
+  return num_blocks() > 0 ? double(nnz) / (num_blocks() * R * C) : 0;
+}
+
+template <typename T>
+size_t BSRLayer<T>::bytes() const {
+  return sizeof(int) * (block_row_ptr.size() + block_col.size()) + sizeof(T) * val.size();
+}
+
+inline
+const std::vector<std::pair<size_t, size_t> >& bsr_block_shapes() {
+  //every shape needs a micro-kernel in snig_cpu/kernel.hpp
+  static const std::vector<std::pair<size_t, size_t> > shapes{
+    {8, 4}, {4, 4}, {8, 1}, {4, 2}, {2, 4}, {4, 1}, {2, 2}, {1, 4}
+  };
+  return shapes;
+}
+
+inline
+size_t count_blocks(
+  const int* col_w,
+  const int* row_w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const size_t R,
+  const size_t C
+) {
+  //block column of the last weight seen in every block row
+  std::vector<int> last(num_neurons / R, -1);
+  size_t num_blocks{0};
+  for(size_t jb = 0; jb < num_neurons / C; ++jb) {
+    for(size_t s = 0; s < num_secs; ++s) {
+      for(size_t j = jb * C; j < (jb + 1) * C; ++j) {
+        for(int k = col_w[s * num_neurons + j]; k < col_w[s * num_neurons + j + 1]; ++k) {
+          int& l = last[row_w[k] / R];
+          if(l != int(jb)) {
+            l = jb;
+            ++num_blocks;
+          }
+        }
+      }
+    }
+  }
+  return num_blocks;
+}
+
+template <typename T>
+BSRLayer<T> packed_to_bsr(
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const double min_fill
+) {
+  const size_t sec_size = num_neurons / num_secs;
+
+  BSRLayer<T> layer;
+  layer.num_neurons = num_neurons;
+  layer.num_secs = num_secs;
+  layer.nnz = col_w[num_neurons * num_secs];
+
+  //ties go to the larger block
+  size_t best_entries{0};
+  for(const auto& shape : bsr_block_shapes()) {
+    if(layer.nnz == 0 || sec_size % shape.first != 0 || num_neurons % shape.second != 0) {
+      continue;
+    }
+    size_t entries = count_blocks(col_w, row_w, num_neurons, num_secs, shape.first, shape.second)
+                   * shape.first * shape.second;
+    if(entries * min_fill <= layer.nnz && (!layer.is_blocked() || entries < best_entries)) {
+      best_entries = entries;
+      layer.R = shape.first;
+      layer.C = shape.second;
+    }
+  }
+
+  if(!layer.is_blocked()) {
+    return layer;
+  }
+
+  const size_t R = layer.R;
+  const size_t C = layer.C;
+
+  //(block row, block column) -> values, ordered as BSR
+  std::map<std::pair<int, int>, std::vector<T> > blocks;
+  for(size_t s = 0; s < num_secs; ++s) {
+    for(size_t j = 0; j < num_neurons; ++j) {
+      for(int k = col_w[s * num_neurons + j]; k < col_w[s * num_neurons + j + 1]; ++k) {
+        auto& b = blocks[{row_w[k] / int(R), int(j / C)}];
+        b.resize(R * C, T(0));
+        b[(j % C) * R + row_w[k] % R] = val_w[k];
+      }
+    }
+  }
+
+  layer.block_row_ptr.assign(num_neurons / R + 1, 0);
+  for(const auto& b : blocks) {
+    ++layer.block_row_ptr[b.first.first + 1];
+    layer.block_col.push_back(b.first.second);
+    layer.val.insert(layer.val.end(), b.second.begin(), b.second.end());
+  }
+  for(size_t i = 0; i < num_neurons / R; ++i) {
+    layer.block_row_ptr[i + 1] += layer.block_row_ptr[i];
+  }
+
+  return layer;
+}
+
+inline
+std::fs::path bsr_layer_path(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t layer
+) {
+  std::fs::path p = weight_dir;
+  p /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(layer + 1) + ".bsr";
+  return p;
+}
+
+template <typename T>
+void write_bsr_binary(const std::fs::path& path, const BSRLayer<T>& layer) {
+  std::ofstream out(path, std::ios::out | std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("cannot write " + path.string());
+  }
+
+  size_t header[6] = {
+    layer.num_neurons, layer.num_secs, layer.R, layer.C, layer.nnz, layer.num_blocks()
+  };
+  out.write((char*)header, sizeof(header));
+  out.write((char*)layer.block_row_ptr.data(), sizeof(int) * layer.block_row_ptr.size());
+  out.write((char*)layer.block_col.data(), sizeof(int) * layer.block_col.size());
+  out.write((char*)layer.val.data(), sizeof(T) * layer.val.size());
+}
+
+template <typename T>
+BSRLayer<T> read_bsr_binary(
+  const std::fs::path& path,
+  const size_t num_neurons,
+  const size_t num_secs
+) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + path.string() + ", convert the model with --bsr_min_fill first");
+  }
+
+  size_t header[6];
+  in.read((char*)header, sizeof(header));
+  if(!in) {
+    throw std::runtime_error(path.string() + " is truncated");
+  }
+
+  BSRLayer<T> layer;
+  layer.num_neurons = header[0];
+  layer.num_secs = header[1];
+  layer.R = header[2];
+  layer.C = header[3];
+  layer.nnz = header[4];
+  const size_t num_blocks = header[5];
+
+  auto invalid = [&](const std::string& why) {
+    return std::runtime_error(path.string() + " " + why + ", convert the model again with --bsr_min_fill");
+  };
+
+  if(layer.num_neurons != num_neurons || layer.num_secs != num_secs) {
+    throw invalid(
+      "holds " + std::to_string(layer.num_neurons) + " neurons in " + std::to_string(layer.num_secs) +
+      " sections but the model has " + std::to_string(num_neurons) + " in " + std::to_string(num_secs)
+    );
+  }
+
+  //an unblocked layer is the header alone
+  const size_t file_size = std::fs::file_size(path);
+  size_t expected_size = sizeof(header);
+  if(layer.is_blocked()) {
+    const auto& shapes = bsr_block_shapes();
+    if(std::find(shapes.begin(), shapes.end(), std::make_pair(layer.R, layer.C)) == shapes.end()) {
+      throw invalid("has " + std::to_string(layer.R) + "x" + std::to_string(layer.C) + " blocks, which no kernel runs");
+    }
+    if(num_secs == 0 || num_neurons % num_secs != 0 || (num_neurons / num_secs) % layer.R != 0 || num_neurons % layer.C != 0) {
+      throw invalid("has blocks that do not tile the sections of the model");
+    }
+    //bounded by the file first so that the sizes below cannot overflow
+    const size_t block_bytes = sizeof(int) + sizeof(T) * layer.R * layer.C;
+    if(num_blocks > file_size / block_bytes || layer.nnz > num_blocks * layer.R * layer.C) {
+      throw invalid("has " + std::to_string(num_blocks) + " blocks for " + std::to_string(layer.nnz) + " weights");
+    }
+    expected_size += sizeof(int) * (num_neurons / layer.R + 1) + block_bytes * num_blocks;
+  }
+  else if(layer.C != 0 || num_blocks != 0) {
+    throw invalid("is unblocked but holds blocks");
+  }
+  if(file_size != expected_size) {
+    throw invalid("has " + std::to_string(file_size) + " bytes but its header gives " + std::to_string(expected_size));
+  }
+
+  if(layer.is_blocked()) {
+    layer.block_row_ptr.resize(num_neurons / layer.R + 1);
+    layer.block_col.resize(num_blocks);
+    layer.val.resize(num_blocks * layer.R * layer.C);
+    in.read((char*)layer.block_row_ptr.data(), sizeof(int) * layer.block_row_ptr.size());
+    in.read((char*)layer.block_col.data(), sizeof(int) * layer.block_col.size());
+    in.read((char*)layer.val.data(), sizeof(T) * layer.val.size());
+    if(!in) {
+      throw std::runtime_error(path.string() + " is truncated");
+    }
+
+    //the kernels index blocks and input neurons with these unchecked
+    if(
+      layer.block_row_ptr.front() != 0 ||
+      size_t(layer.block_row_ptr.back()) != num_blocks ||
+      !std::is_sorted(layer.block_row_ptr.begin(), layer.block_row_ptr.end())
+    ) {
+      throw invalid("has block row offsets that do not cover its " + std::to_string(num_blocks) + " blocks");
+    }
+    const int num_block_cols = num_neurons / layer.C;
+    auto bad_col = std::find_if(layer.block_col.begin(), layer.block_col.end(), [&](const int c) {
+      return c < 0 || c >= num_block_cols;
+    });
+    if(bad_col != layer.block_col.end()) {
+      throw invalid("holds block column " + std::to_string(*bad_col) + " of " + std::to_string(num_block_cols));
+    }
+  }
+
+  return layer;
+}
+
+template <typename T>
+void packed_binary_to_bsr_file(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers,
+  const double min_fill
+) {
+  for(size_t i = 0; i < num_layers; ++i) {
+    std::fs::path p = weight_dir;
+    p /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(i + 1) + ".b";
+    auto layer = read_packed_layer_binary<T>(p);
+
+    write_bsr_binary(
+      bsr_layer_path(weight_dir, num_neurons, i),
+      packed_to_bsr(
+        layer.col_w.data(), layer.row_w.data(), layer.val_w.data(),
+        layer.rows, layer.num_secs, min_fill
+      )
+    );
+  }
+}
+
+}// end of namespace snig ----------------------------------------------
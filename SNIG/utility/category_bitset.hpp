@@ -0,0 +1,280 @@
+#pragma once
+#include <Eigen/Dense>
+#include <experimental/filesystem>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Categories of all inputs, one bit per input
+//
+// Bit i of word i / 64 is set if input i is active (any neuron of the last
+// layer is nonzero). Bits past num_inputs in the last word stay zero,
+// so whole words can be compared and counted.
+class CategoryBitset {
+
+  public:
+
+    using Word = uint64_t;
+
+    static constexpr size_t word_bits = 64;
+
+    CategoryBitset() = default;
+
+    explicit CategoryBitset(const size_t num_inputs);
+
+    explicit CategoryBitset(const Eigen::Matrix<int, Eigen::Dynamic, 1>& categories);
+
+    CategoryBitset(const int* categories, const size_t num_inputs);
+
+    //all inputs inactive
+    void assign(const size_t num_inputs);
+
+    void set(const size_t input, const bool is_active);
+
+    //sets the bit of an active input while other threads set bits of the same word
+    void set_atomic(const size_t input);
+
+    bool test(const size_t input) const;
+
+    size_t num_inputs() const;
+
+    size_t num_words() const;
+
+    size_t bytes() const;
+
+    //number of active inputs
+    size_t count() const;
+
+    const Word* words() const;
+
+    Word* words();
+
+    Eigen::Matrix<int, Eigen::Dynamic, 1> to_Eigen() const;
+
+  private:
+
+    size_t _num_inputs{0};
+    std::vector<Word> _words;
+};
+
+// number of inputs whose categories differ, popcount of the XOR of the words
+inline
+size_t num_different_categories(const CategoryBitset& output, const CategoryBitset& golden);
+
+// inputs whose categories differ in increasing order, at most max_mismatches,
+// found with a count of trailing zeros of every nonzero XOR word
+inline
+std::vector<size_t> different_categories(
+  const CategoryBitset& output,
+  const CategoryBitset& golden,
+  const size_t max_mismatches = std::numeric_limits<size_t>::max()
+);
+
+// bitset golden (.b) file: the magic, num_inputs (size_t), then the words
+//
+// Golden .b files written before the bitset hold num_inputs (size_t) and
+// one int per input; read_category_bitset reads both.
+constexpr char category_bitset_magic[8] = {'S', 'N', 'I', 'G', 'B', 'I', 'T', 'S'};
+
+inline
+void write_category_bitset(const std::fs::path& path, const CategoryBitset& categories);
+
+inline
+CategoryBitset read_category_bitset(const std::fs::path& path);
+
+// ----------------------------------------------------------------------------
+// Definition of CategoryBitset
+// ----------------------------------------------------------------------------
+
+inline
+CategoryBitset::CategoryBitset(const size_t num_inputs) {
+  assign(num_inputs);
+}
+
+inline
+CategoryBitset::CategoryBitset(const Eigen::Matrix<int, Eigen::Dynamic, 1>& categories) :
+  CategoryBitset(categories.data(), categories.rows())
+{
+}
+
+inline
+CategoryBitset::CategoryBitset(const int* categories, const size_t num_inputs) {
+  assign(num_inputs);
+  //whole words at a time, no read-modify-write of a word per input
+  for(size_t w = 0; w < _words.size(); ++w) {
+    size_t beg = w * word_bits;
+    size_t end = std::min(beg + word_bits, num_inputs);
+    Word word{0};
+    for(size_t i = beg; i < end; ++i) {
+      word |= Word(categories[i] != 0) << (i - beg);
+    }
+    _words[w] = word;
+  }
+}
+
+inline
+void CategoryBitset::assign(const size_t num_inputs) {
+  _num_inputs = num_inputs;
+  _words.assign((num_inputs + word_bits - 1) / word_bits, 0);
+}
+
+inline
+void CategoryBitset::set(const size_t input, const bool is_active) {
+  Word mask = Word(1) << (input % word_bits);
+  Word& word = _words[input / word_bits];
+  word = is_active ? (word | mask) : (word & ~mask);
+}
+
+inline
+void CategoryBitset::set_atomic(const size_t input) {
+  __atomic_fetch_or(&_words[input / word_bits], Word(1) << (input % word_bits), __ATOMIC_RELAXED);
+}
+
+inline
+bool CategoryBitset::test(const size_t input) const {
+  return (_words[input / word_bits] >> (input % word_bits)) & 1;
+}
+
+inline
+size_t CategoryBitset::num_inputs() const {
+  return _num_inputs;
+}
+
+inline
+size_t CategoryBitset::num_words() const {
+  return _words.size();
+}
+
+inline
+size_t CategoryBitset::bytes() const {
+  return sizeof(Word) * _words.size();
+}
+
+inline
+size_t CategoryBitset::count() const {
+  size_t n{0};
+  for(auto w : _words) {
+    n += __builtin_popcountll(w);
+  }
+  return n;
+}
+
+inline
+const CategoryBitset::Word* CategoryBitset::words() const {
+  return _words.data();
+}
+
+inline
+CategoryBitset::Word* CategoryBitset::words() {
+  return _words.data();
+}
+
+inline
+Eigen::Matrix<int, Eigen::Dynamic, 1> CategoryBitset::to_Eigen() const {
+  Eigen::Matrix<int, Eigen::Dynamic, 1> categories(_num_inputs, 1);
+  for(size_t i = 0; i < _num_inputs; ++i) {
+    categories(i, 0) = test(i) ? 1 : 0;
+  }
+  return categories;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of bitset functions
+// ----------------------------------------------------------------------------
+
+inline
+size_t num_different_categories(const CategoryBitset& output, const CategoryBitset& golden) {
+  if(output.num_inputs() != golden.num_inputs()) {
+    throw std::runtime_error(
+      "cannot compare " + std::to_string(output.num_inputs()) + " categories with "
+      + std::to_string(golden.num_inputs()) + " golden categories"
+    );
+  }
+  const auto* a = output.words();
+  const auto* b = golden.words();
+  size_t n{0};
+  for(size_t w = 0; w < output.num_words(); ++w) {
+    n += __builtin_popcountll(a[w] ^ b[w]);
+  }
+  return n;
+}
+
+inline
+std::vector<size_t> different_categories(
+  const CategoryBitset& output,
+  const CategoryBitset& golden,
+  const size_t max_mismatches
+) {
+  if(output.num_inputs() != golden.num_inputs()) {
+    throw std::runtime_error(
+      "cannot compare " + std::to_string(output.num_inputs()) + " categories with "
+      + std::to_string(golden.num_inputs()) + " golden categories"
+    );
+  }
+  std::vector<size_t> mismatches;
+  const auto* a = output.words();
+  const auto* b = golden.words();
+  for(size_t w = 0; w < output.num_words() && mismatches.size() < max_mismatches; ++w) {
+    //clear the lowest set bit until the word is empty
+    for(auto x = a[w] ^ b[w]; x != 0 && mismatches.size() < max_mismatches; x &= x - 1) {
+      mismatches.push_back(w * CategoryBitset::word_bits + __builtin_ctzll(x));
+    }
+  }
+  return mismatches;
+}
+
+inline
+void write_category_bitset(const std::fs::path& path, const CategoryBitset& categories) {
+  std::ofstream out(path, std::ios::out | std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("cannot write " + path.string());
+  }
+  size_t num_inputs = categories.num_inputs();
+  out.write(category_bitset_magic, sizeof(category_bitset_magic));
+  out.write((char*)&num_inputs, sizeof(size_t));
+  out.write((char*)categories.words(), categories.bytes());
+}
+
+inline
+CategoryBitset read_category_bitset(const std::fs::path& path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + path.string());
+  }
+
+  char magic[sizeof(category_bitset_magic)];
+  in.read(magic, sizeof(magic));
+  if(in && std::memcmp(magic, category_bitset_magic, sizeof(magic)) == 0) {
+    size_t num_inputs;
+    in.read((char*)&num_inputs, sizeof(size_t));
+    CategoryBitset categories(num_inputs);
+    in.read((char*)categories.words(), categories.bytes());
+    if(!in) {
+      throw std::runtime_error(path.string() + " is a truncated category bitset");
+    }
+    return categories;
+  }
+
+  //an int per input, the magic was the number of inputs
+  size_t num_inputs;
+  std::memcpy(&num_inputs, magic, sizeof(size_t));
+  if(!in || std::fs::file_size(path) != sizeof(size_t) + sizeof(int) * num_inputs) {
+    throw std::runtime_error(path.string() + " is neither a category bitset nor an int golden file");
+  }
+  std::vector<int> ints(num_inputs);
+  in.read((char*)ints.data(), sizeof(int) * num_inputs);
+  return CategoryBitset(ints.data(), num_inputs);
+}
+
+}// end of namespace snig ----------------------------------------------
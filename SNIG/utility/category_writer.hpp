@@ -0,0 +1,260 @@
+#pragma once
+#include <SNIG/utility/category_bitset.hpp>
+#include <experimental/filesystem>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <omp.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// File formats of the categories of a run
+//
+// tsv    : the challenge format, 1-based ids of the active inputs, one per line
+//          (like neuron1024-l120-categories.tsv)
+// binary : num_inputs (size_t), then one int per input
+// bitset : the bitset golden format of write_category_bitset
+enum class CategoryFormat {
+  tsv,
+  binary,
+  bitset
+};
+
+inline
+std::string to_string(const CategoryFormat format);
+
+inline
+CategoryFormat to_category_format(const std::string& name);
+
+// decimal digits of v > 0, from the bit length without a loop
+inline
+size_t num_decimal_digits(const uint64_t v);
+
+// writes v > 0 in decimal at out, two digits at a time,
+// and returns the number of characters written
+inline
+size_t format_decimal(uint64_t v, char* out);
+
+// 1-based ids of the active inputs of words [beg_word, end_word), one per line,
+// out holds at least 21 characters per active input
+inline
+size_t format_category_tsv(
+  const CategoryBitset& categories,
+  const size_t beg_word,
+  const size_t end_word,
+  char* out
+);
+
+// Writes the categories in format with one open and one writev pass
+//
+// The TSV text is formatted by num_threads threads, each into its own buffer
+// of a contiguous range of words, and the buffers are written in order
+// by a single writev.
+inline
+void write_categories(
+  const std::fs::path& path,
+  const CategoryBitset& categories,
+  const CategoryFormat format,
+  const size_t num_threads = 1
+);
+
+// ----------------------------------------------------------------------------
+// Definition of CategoryFormat
+// ----------------------------------------------------------------------------
+
+inline
+std::string to_string(const CategoryFormat format) {
+  switch(format) {
+    case CategoryFormat::tsv:    return "tsv";
+    case CategoryFormat::binary: return "binary";
+    case CategoryFormat::bitset: return "bitset";
+  }
+  return "unknown";
+}
+
+inline
+CategoryFormat to_category_format(const std::string& name) {
+  if(name == "tsv") {
+    return CategoryFormat::tsv;
+  }
+  if(name == "binary") {
+    return CategoryFormat::binary;
+  }
+  if(name == "bitset") {
+    return CategoryFormat::bitset;
+  }
+  throw std::runtime_error("unknown category format " + name + " (tsv, binary, or bitset)");
+}
+
+// ----------------------------------------------------------------------------
+// Definition of category writer functions
+// ----------------------------------------------------------------------------
+
+inline
+size_t num_decimal_digits(const uint64_t v) {
+  static const uint64_t powers_of_10[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+  };
+  //1233 / 4096 approximates log10(2), t is the digits or one less
+  size_t t = ((64 - __builtin_clzll(v | 1)) * 1233) >> 12;
+  return t + 1 - (v < powers_of_10[t]);
+}
+
+inline
+size_t format_decimal(uint64_t v, char* out) {
+  static const char pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+  const size_t len = num_decimal_digits(v);
+  char* p = out + len;
+  while(v >= 100) {
+    const size_t pair = 2 * (v % 100);
+    v /= 100;
+    *--p = pairs[pair + 1];
+    *--p = pairs[pair];
+  }
+  //one or two leading digits
+  if(v >= 10) {
+    *--p = pairs[2 * v + 1];
+    *--p = pairs[2 * v];
+  }
+  else {
+    *--p = char('0' + v);
+  }
+  return len;
+}
+
+inline
+size_t format_category_tsv(
+  const CategoryBitset& categories,
+  const size_t beg_word,
+  const size_t end_word,
+  char* out
+) {
+  const auto* words = categories.words();
+  char* p = out;
+  for(size_t w = beg_word; w < end_word; ++w) {
+    for(auto x = words[w]; x != 0; x &= x - 1) {
+      p += format_decimal(w * CategoryBitset::word_bits + __builtin_ctzll(x) + 1, p);
+      *p++ = '\n';
+    }
+  }
+  return p - out;
+}
+
+namespace detail {
+
+// writes all of iov with as few writev calls as the kernel allows
+inline
+void writev_all(const int fd, std::vector<iovec> iov, const std::fs::path& path) {
+  size_t beg{0};
+  while(beg < iov.size()) {
+    int count = std::min<size_t>(iov.size() - beg, IOV_MAX);
+    ssize_t written = ::writev(fd, iov.data() + beg, count);
+    if(written < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("cannot write " + path.string() + ": " + std::strerror(errno));
+    }
+    //skip what a short write has written
+    while(beg < iov.size() && size_t(written) >= iov[beg].iov_len) {
+      written -= iov[beg].iov_len;
+      ++beg;
+    }
+    if(beg < iov.size()) {
+      iov[beg].iov_base = (char*)iov[beg].iov_base + written;
+      iov[beg].iov_len -= written;
+    }
+  }
+}
+
+}// end of namespace detail ----------------------------------------------
+
+inline
+void write_categories(
+  const std::fs::path& path,
+  const CategoryBitset& categories,
+  const CategoryFormat format,
+  const size_t num_threads
+) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0) {
+    throw std::runtime_error("cannot open " + path.string() + ": " + std::strerror(errno));
+  }
+
+  size_t num_inputs = categories.num_inputs();
+  std::vector<iovec> iov;
+  std::vector<std::vector<char> > chunks;
+  std::vector<int> ints;
+
+  try {
+    if(format == CategoryFormat::tsv) {
+      //contiguous ranges of words, so the chunks are in order
+      const size_t num_chunks = std::max<size_t>(1, std::min(num_threads, categories.num_words()));
+      chunks.resize(num_chunks);
+      std::vector<size_t> lengths(num_chunks, 0);
+
+      #pragma omp parallel for num_threads(num_chunks) schedule(static, 1)
+      for(size_t c = 0; c < num_chunks; ++c) {
+        size_t beg = c * categories.num_words() / num_chunks;
+        size_t end = (c + 1) * categories.num_words() / num_chunks;
+        size_t num_active{0};
+        for(size_t w = beg; w < end; ++w) {
+          num_active += __builtin_popcountll(categories.words()[w]);
+        }
+        //20 digits and a newline bound every id
+        chunks[c].resize(num_active * 21);
+        lengths[c] = format_category_tsv(categories, beg, end, chunks[c].data());
+      }
+
+      for(size_t c = 0; c < num_chunks; ++c) {
+        if(lengths[c] > 0) {
+          iov.push_back(iovec{chunks[c].data(), lengths[c]});
+        }
+      }
+    }
+    else if(format == CategoryFormat::binary) {
+      ints.resize(num_inputs);
+      for(size_t i = 0; i < num_inputs; ++i) {
+        ints[i] = categories.test(i) ? 1 : 0;
+      }
+      iov.push_back(iovec{&num_inputs, sizeof(size_t)});
+      iov.push_back(iovec{ints.data(), sizeof(int) * num_inputs});
+    }
+    else {
+      iov.push_back(iovec{(void*)category_bitset_magic, sizeof(category_bitset_magic)});
+      iov.push_back(iovec{&num_inputs, sizeof(size_t)});
+      iov.push_back(iovec{(void*)categories.words(), categories.bytes()});
+    }
+
+    detail::writev_all(fd, std::move(iov), path);
+  }
+  catch(...) {
+    ::close(fd);
+    throw;
+  }
+
+  if(::close(fd) != 0) {
+    throw std::runtime_error("cannot close " + path.string() + ": " + std::strerror(errno));
+  }
+}
+
+}// end of namespace snig ----------------------------------------------
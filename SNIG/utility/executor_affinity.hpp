@@ -0,0 +1,65 @@
+#pragma once
+#include <taskflow/taskflow.hpp>
+#include <SNIG/utility/affinity.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace snig {
+
+// Taskflow executor observer pinning every worker
+// to its place under a ThreadPlacement when it runs its first task,
+// or back to the process mask if the policy became AffinityPolicy::none
+//
+// API: executor.make_observer<ExecutorAffinity>(placement, "executor");
+class ExecutorAffinity : public tf::ExecutorObserverInterface {
+
+  public:
+
+    ExecutorAffinity(ThreadPlacement& placement, const std::string& pool);
+
+    void set_up(unsigned num_workers) override;
+
+    void on_entry(unsigned worker_id, tf::TaskView task_view) override;
+
+    void on_exit(unsigned worker_id, tf::TaskView task_view) override;
+
+  private:
+
+    ThreadPlacement& _placement;
+    std::string _pool;
+    std::unique_ptr<std::atomic<bool>[]> _is_pinned;
+};
+
+// ----------------------------------------------------------------------------
+// Definition of ExecutorAffinity
+// ----------------------------------------------------------------------------
+
+inline
+ExecutorAffinity::ExecutorAffinity(ThreadPlacement& placement, const std::string& pool) :
+  _placement{placement},
+  _pool{pool}
+{
+}
+
+inline
+void ExecutorAffinity::set_up(unsigned num_workers) {
+  _is_pinned.reset(new std::atomic<bool>[num_workers]);
+  for(unsigned w = 0; w < num_workers; ++w) {
+    _is_pinned[w] = false;
+  }
+}
+
+inline
+void ExecutorAffinity::on_entry(unsigned worker_id, tf::TaskView) {
+  //each worker id belongs to exactly one thread
+  if(!_is_pinned[worker_id].exchange(true)) {
+    _placement.pin(_pool, worker_id);
+  }
+}
+
+inline
+void ExecutorAffinity::on_exit(unsigned, tf::TaskView) {
+}
+
+}// end of namespace snig ----------------------------------------------
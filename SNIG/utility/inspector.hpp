@@ -0,0 +1,339 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <SNIG/utility/reader.hpp>
+#include <experimental/filesystem>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Structure of a packed binary model (.b) and of its input
+//
+// Rows and columns follow the packed layout read by the kernels:
+// column j holds the weights leaving input neuron j (col_w),
+// and its entries are output neurons (row_w).
+// Output neurons are split into num_secs sections of sec_size neurons,
+// and every column is stored once per section.
+
+// value -> number of occurrences
+using CountHistogram = std::map<size_t, size_t>;
+
+struct LayerProfile {
+  size_t layer{0};
+  size_t nnz{0};
+
+  //nnz per column (input neuron) and per row (output neuron)
+  CountHistogram col_degree;
+  CountHistogram row_degree;
+
+  //number of output sections each column has at least one entry in
+  CountHistogram sections_per_column;
+
+  size_t num_empty_cols{0};
+  size_t num_empty_rows{0};
+
+  //columns with the same set of output rows
+  size_t num_distinct_col_patterns{0};
+
+  //columns with the same output rows relative to the column index (mod num_neurons)
+  size_t num_distinct_shifted_col_patterns{0};
+
+  //all weights of the layer share one value
+  bool is_constant_valued{false};
+  double constant_value{0};
+
+  uint64_t pattern_hash{0};
+  uint64_t value_hash{0};
+};
+
+struct InputProfile {
+  size_t num_inputs{0};
+  size_t num_features{0};
+  size_t nnz{0};
+  size_t num_empty_rows{0};
+
+  //nonzero features per input
+  CountHistogram row_nnz;
+
+  //number of sections with a nonzero feature per input
+  CountHistogram nonzero_sections_per_row;
+
+  double density() const;
+};
+
+template <typename T>
+LayerProfile inspect_layer_binary(
+  const std::fs::path& layer_path,
+  const size_t layer,
+  const size_t num_neurons,
+  const size_t num_secs
+);
+
+template <typename T>
+InputProfile inspect_input_binary(
+  const std::fs::path& input_path,
+  const size_t sec_size
+);
+
+// groups of layers with identical sparsity pattern (and identical values)
+// a group holds at least two layers
+inline
+std::vector<std::vector<size_t> > duplicate_layers(
+  const std::vector<LayerProfile>& layers,
+  const bool compare_values
+);
+
+inline
+void dump_histogram(JSONWriter& json, const CountHistogram& histogram);
+
+inline
+void dump_layer_profile(JSONWriter& json, const LayerProfile& profile);
+
+inline
+void dump_input_profile(JSONWriter& json, const InputProfile& profile);
+
+//-----------------------------------------------------------------------------
+//Definition of inspector functions
+//-----------------------------------------------------------------------------
+
+namespace detail {
+
+// 64-bit FNV-1a over a byte range, chained through h
+inline
+uint64_t fnv1a(const void* data, const size_t bytes, uint64_t h = 14695981039346656037ull) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for(size_t i = 0; i < bytes; ++i) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+}// end of namespace detail
+
+inline
+double InputProfile::density() const {
+  return num_inputs * num_features == 0 ? 0.0 : double(nnz) / (num_inputs * num_features);
+}
+
+template <typename T>
+LayerProfile inspect_layer_binary(
+  const std::fs::path& layer_path,
+  const size_t layer,
+  const size_t num_neurons,
+  const size_t num_secs
+) {
+  auto packed = read_packed_layer_binary<T>(layer_path);
+  if(packed.rows != num_neurons || packed.num_secs != num_secs) {
+    throw std::runtime_error(
+      layer_path.string() + " has " + std::to_string(packed.rows) + " neurons in " +
+      std::to_string(packed.num_secs) + " sections, expected " + std::to_string(num_neurons) +
+      " in " + std::to_string(num_secs)
+    );
+  }
+  const size_t nnz = packed.row_w.size();
+  const auto& col_w = packed.col_w;
+  const auto& row_w = packed.row_w;
+  const auto& val_w = packed.val_w;
+
+  //rows index the degree counts below
+  auto bad_row = std::find_if(row_w.begin(), row_w.end(), [&](int r){ return r < 0 || size_t(r) >= num_neurons; });
+  if(bad_row != row_w.end()) {
+    throw std::runtime_error(
+      layer_path.string() + " holds output neuron " + std::to_string(*bad_row) + " of " + std::to_string(num_neurons)
+    );
+  }
+
+  LayerProfile profile;
+  profile.layer = layer;
+  profile.nnz = nnz;
+
+  std::vector<size_t> row_degree(num_neurons, 0);
+
+  //hash of each column's rows, plain and relative to the column index
+  std::unordered_map<uint64_t, size_t> col_patterns;
+  std::unordered_map<uint64_t, size_t> shifted_col_patterns;
+
+  for(size_t j = 0; j < num_neurons; ++j) {
+    size_t degree{0};
+    size_t num_touched{0};
+    uint64_t h = detail::fnv1a(nullptr, 0);
+    uint64_t sh = h;
+    for(size_t s = 0; s < num_secs; ++s) {
+      int beg = col_w[s * num_neurons + j];
+      int end = col_w[s * num_neurons + j + 1];
+      if(end > beg) {
+        ++num_touched;
+      }
+      degree += end - beg;
+      for(int k = beg; k < end; ++k) {
+        int r = row_w[k];
+        ++row_degree[r];
+        int shifted = (r - int(j) + int(num_neurons)) % int(num_neurons);
+        h = detail::fnv1a(&r, sizeof(int), h);
+        sh = detail::fnv1a(&shifted, sizeof(int), sh);
+      }
+    }
+    ++profile.col_degree[degree];
+    ++profile.sections_per_column[num_touched];
+    profile.num_empty_cols += (degree == 0);
+    ++col_patterns[h];
+    ++shifted_col_patterns[sh];
+  }
+
+  for(auto d : row_degree) {
+    ++profile.row_degree[d];
+    profile.num_empty_rows += (d == 0);
+  }
+
+  profile.num_distinct_col_patterns = col_patterns.size();
+  profile.num_distinct_shifted_col_patterns = shifted_col_patterns.size();
+
+  profile.is_constant_valued = nnz > 0 && std::all_of(
+    val_w.begin(), val_w.end(), [&](T v){ return v == val_w[0]; }
+  );
+  profile.constant_value = profile.is_constant_valued ? double(val_w[0]) : 0.0;
+
+  profile.pattern_hash = detail::fnv1a(col_w.data(), sizeof(int) * col_w.size());
+  profile.pattern_hash = detail::fnv1a(row_w.data(), sizeof(int) * nnz, profile.pattern_hash);
+  profile.value_hash = detail::fnv1a(val_w.data(), sizeof(T) * nnz);
+
+  return profile;
+}
+
+template <typename T>
+InputProfile inspect_input_binary(
+  const std::fs::path& input_path,
+  const size_t sec_size
+) {
+  std::ifstream in(input_path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + input_path.string());
+  }
+
+  InputProfile profile;
+  in.read((char*)&profile.num_inputs, sizeof(size_t));
+  in.read((char*)&profile.num_features, sizeof(size_t));
+  //a row is allocated before the file can say it is too short
+  if(!in || profile.num_features > std::fs::file_size(input_path) / sizeof(T)) {
+    throw std::runtime_error(input_path.string() + " is not a dense input file of data type size " + std::to_string(sizeof(T)));
+  }
+
+  //one input at a time, inputs of the challenge are dense arrays
+  auto row = std::make_unique<T[]>(profile.num_features);
+  for(size_t i = 0; i < profile.num_inputs; ++i) {
+    in.read((char*)row.get(), sizeof(T) * profile.num_features);
+    if(!in) {
+      throw std::runtime_error(
+        input_path.string() + " is truncated at input " + std::to_string(i) + " of " + std::to_string(profile.num_inputs)
+      );
+    }
+    size_t row_nnz{0};
+    size_t num_nonzero_secs{0};
+    for(size_t beg = 0; beg < profile.num_features; beg += sec_size) {
+      size_t end = std::min(beg + sec_size, profile.num_features);
+      size_t sec_nnz = std::count_if(row.get() + beg, row.get() + end, [](T v){ return v != 0; });
+      row_nnz += sec_nnz;
+      num_nonzero_secs += (sec_nnz > 0);
+    }
+    profile.nnz += row_nnz;
+    profile.num_empty_rows += (row_nnz == 0);
+    ++profile.row_nnz[row_nnz];
+    ++profile.nonzero_sections_per_row[num_nonzero_secs];
+  }
+
+  return profile;
+}
+
+inline
+std::vector<std::vector<size_t> > duplicate_layers(
+  const std::vector<LayerProfile>& layers,
+  const bool compare_values
+) {
+  std::map<std::pair<uint64_t, uint64_t>, std::vector<size_t> > groups;
+  for(const auto& l : layers) {
+    groups[{l.pattern_hash, compare_values ? l.value_hash : 0}].push_back(l.layer);
+  }
+
+  std::vector<std::vector<size_t> > duplicates;
+  for(auto& g : groups) {
+    if(g.second.size() > 1) {
+      duplicates.push_back(std::move(g.second));
+    }
+  }
+  std::sort(duplicates.begin(), duplicates.end());
+  return duplicates;
+}
+
+inline
+void dump_histogram(JSONWriter& json, const CountHistogram& histogram) {
+  size_t count{0};
+  double sum{0};
+  for(const auto& h : histogram) {
+    count += h.second;
+    sum += double(h.first) * h.second;
+  }
+
+  json.begin_object();
+  json.field("min", histogram.empty() ? 0 : histogram.begin()->first);
+  json.field("max", histogram.empty() ? 0 : histogram.rbegin()->first);
+  json.field("mean", count ? sum / count : 0.0);
+  json.key("histogram").begin_array();
+  for(const auto& h : histogram) {
+    json.begin_object();
+    json.field("value", h.first);
+    json.field("count", h.second);
+    json.end_object();
+  }
+  json.end_array();
+  json.end_object();
+}
+
+inline
+void dump_layer_profile(JSONWriter& json, const LayerProfile& profile) {
+  json.begin_object();
+  json.field("layer", profile.layer);
+  json.field("nnz", profile.nnz);
+  json.field("num_empty_cols", profile.num_empty_cols);
+  json.field("num_empty_rows", profile.num_empty_rows);
+  json.field("num_distinct_col_patterns", profile.num_distinct_col_patterns);
+  json.field("num_distinct_shifted_col_patterns", profile.num_distinct_shifted_col_patterns);
+  json.field("is_constant_valued", profile.is_constant_valued);
+  if(profile.is_constant_valued) {
+    json.field("constant_value", profile.constant_value);
+  }
+  json.key("col_degree");
+  dump_histogram(json, profile.col_degree);
+  json.key("row_degree");
+  dump_histogram(json, profile.row_degree);
+  json.key("sections_per_column");
+  dump_histogram(json, profile.sections_per_column);
+  json.end_object();
+}
+
+inline
+void dump_input_profile(JSONWriter& json, const InputProfile& profile) {
+  json.begin_object();
+  json.field("num_inputs", profile.num_inputs);
+  json.field("num_features", profile.num_features);
+  json.field("nnz", profile.nnz);
+  json.field("density", profile.density());
+  json.field("num_empty_rows", profile.num_empty_rows);
+  json.key("row_nnz");
+  dump_histogram(json, profile.row_nnz);
+  json.key("nonzero_sections_per_row");
+  dump_histogram(json, profile.nonzero_sections_per_row);
+  json.end_object();
+}
+
+}// end of namespace snig ----------------------------------------------
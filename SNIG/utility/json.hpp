@@ -0,0 +1,197 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <type_traits>
+
+namespace snig {
+
+// A minimal streaming JSON writer used by the run report
+//
+// API: json.begin_object();
+//      json.field("num_layers", 120);
+//      json.key("memory").begin_object();
+//      ...
+//      json.end_object();
+//      json.end_object();
+class JSONWriter {
+
+  public:
+
+    explicit JSONWriter(std::ostream& os);
+
+    JSONWriter& begin_object();
+
+    JSONWriter& end_object();
+
+    JSONWriter& begin_array();
+
+    JSONWriter& end_array();
+
+    JSONWriter& key(const std::string& name);
+
+    JSONWriter& value(const std::string& v);
+
+    JSONWriter& value(const char* v);
+
+    JSONWriter& value(const bool v);
+
+    template <typename V>
+    std::enable_if_t<std::is_arithmetic<V>::value, JSONWriter&> value(const V v);
+
+    template <typename V>
+    JSONWriter& field(const std::string& name, V&& v);
+
+  private:
+
+    std::ostream& _os;
+
+    //one entry per open object/array
+    //true if nothing has been written in it yet
+    std::vector<bool> _is_first;
+
+    bool _after_key{false};
+
+    void _separate();
+
+    void _indent();
+
+    void _write_string(const std::string& s);
+};
+
+// ----------------------------------------------------------------------------
+// Definition of JSONWriter
+// ----------------------------------------------------------------------------
+
+inline
+JSONWriter::JSONWriter(std::ostream& os) : _os{os} {
+}
+
+inline
+JSONWriter& JSONWriter::begin_object() {
+  _separate();
+  _os << '{';
+  _is_first.push_back(true);
+  return *this;
+}
+
+inline
+JSONWriter& JSONWriter::end_object() {
+  bool is_empty = _is_first.back();
+  _is_first.pop_back();
+  if(!is_empty) {
+    _indent();
+  }
+  _os << '}';
+  if(_is_first.empty()) {
+    _os << '\n' << std::flush;
+  }
+  return *this;
+}
+
+inline
+JSONWriter& JSONWriter::begin_array() {
+  _separate();
+  _os << '[';
+  _is_first.push_back(true);
+  return *this;
+}
+
+inline
+JSONWriter& JSONWriter::end_array() {
+  bool is_empty = _is_first.back();
+  _is_first.pop_back();
+  if(!is_empty) {
+    _indent();
+  }
+  _os << ']';
+  return *this;
+}
+
+inline
+JSONWriter& JSONWriter::key(const std::string& name) {
+  _separate();
+  _write_string(name);
+  _os << ": ";
+  _after_key = true;
+  return *this;
+}
+
+inline
+JSONWriter& JSONWriter::value(const std::string& v) {
+  _separate();
+  _write_string(v);
+  return *this;
+}
+
+inline
+JSONWriter& JSONWriter::value(const char* v) {
+  return value(std::string(v));
+}
+
+inline
+JSONWriter& JSONWriter::value(const bool v) {
+  _separate();
+  _os << (v ? "true" : "false");
+  return *this;
+}
+
+template <typename V>
+std::enable_if_t<std::is_arithmetic<V>::value, JSONWriter&> JSONWriter::value(const V v) {
+  _separate();
+  //JSON has no representation of nan and inf
+  if(std::is_floating_point<V>::value && !std::isfinite(double(v))) {
+    _os << "null";
+  }
+  else {
+    _os << v;
+  }
+  return *this;
+}
+
+template <typename V>
+JSONWriter& JSONWriter::field(const std::string& name, V&& v) {
+  key(name);
+  return value(std::forward<V>(v));
+}
+
+inline
+void JSONWriter::_separate() {
+  //value of a key follows the key directly
+  if(_after_key) {
+    _after_key = false;
+    return;
+  }
+  if(_is_first.empty()) {
+    return;
+  }
+  if(!_is_first.back()) {
+    _os << ',';
+  }
+  _is_first.back() = false;
+  _indent();
+}
+
+inline
+void JSONWriter::_indent() {
+  _os << '\n' << std::string(2 * _is_first.size(), ' ');
+}
+
+inline
+void JSONWriter::_write_string(const std::string& s) {
+  _os << '"';
+  for(const char c : s) {
+    switch(c) {
+      case '"':  _os << "\\\""; break;
+      case '\\': _os << "\\\\"; break;
+      case '\n': _os << "\\n";  break;
+      case '\t': _os << "\\t";  break;
+      case '\r': _os << "\\r";  break;
+      default:   _os << c;
+    }
+  }
+  _os << '"';
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <vector>
 
 namespace snig{
 
@@ -41,6 +43,17 @@ namespace snig{
 
   };
 
+  //a packed .b layer held on the host
+  //col_w has rows * num_secs + 1 offsets into row_w and val_w
+  template <typename T>
+  struct PackedLayer{
+    size_t rows;
+    size_t num_secs;
+    std::vector<int> col_w;
+    std::vector<int> row_w;
+    std::vector<T> val_w;
+  };
+
 }// end of namespace snig ----------------------------------------------
 
 
@@ -0,0 +1,201 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+namespace snig {
+
+// Records every allocation of an engine by category
+// (e.g. weight, input, activation, result)
+// and keeps the current and peak bytes of each category,
+// both over the whole run and within each phase (load, preprocess, infer, ...)
+//
+// API: tracker.phase("preprocess");
+//      tracker.allocate("input", bytes);
+//      tracker.deallocate("input", bytes);
+class MemoryTracker {
+
+  public:
+
+    struct Usage {
+      size_t current{0};
+      size_t peak{0};
+    };
+
+    struct Phase {
+      std::string name;
+      Usage total;
+      std::map<std::string, Usage> categories;
+    };
+
+    MemoryTracker() = default;
+
+    void phase(const std::string& name);
+
+    void allocate(const std::string& category, const size_t bytes);
+
+    void deallocate(const std::string& category, const size_t bytes);
+
+    size_t current() const;
+
+    size_t peak() const;
+
+    size_t current(const std::string& category) const;
+
+    size_t peak(const std::string& category) const;
+
+    std::map<std::string, Usage> categories() const;
+
+    std::vector<Phase> phases() const;
+
+    void dump(JSONWriter& json) const;
+
+  private:
+
+    mutable std::mutex _mutex;
+
+    Usage _total;
+    std::map<std::string, Usage> _categories;
+    std::vector<Phase> _phases;
+
+    static void _add(Usage& usage, const size_t bytes);
+
+    static void _sub(Usage& usage, const size_t bytes);
+
+    static void _dump(JSONWriter& json, const Usage& usage);
+};
+
+// ----------------------------------------------------------------------------
+// Definition of MemoryTracker
+// ----------------------------------------------------------------------------
+
+inline
+void MemoryTracker::phase(const std::string& name) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  //a new phase starts with whatever is still allocated
+  Phase p;
+  p.name = name;
+  p.total.current = p.total.peak = _total.current;
+  for(const auto& c : _categories) {
+    p.categories[c.first].current = c.second.current;
+    p.categories[c.first].peak = c.second.current;
+  }
+  _phases.push_back(std::move(p));
+}
+
+inline
+void MemoryTracker::allocate(const std::string& category, const size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _add(_total, bytes);
+  _add(_categories[category], bytes);
+  if(!_phases.empty()) {
+    _add(_phases.back().total, bytes);
+    _add(_phases.back().categories[category], bytes);
+  }
+}
+
+inline
+void MemoryTracker::deallocate(const std::string& category, const size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _sub(_total, bytes);
+  _sub(_categories[category], bytes);
+  if(!_phases.empty()) {
+    _sub(_phases.back().total, bytes);
+    _sub(_phases.back().categories[category], bytes);
+  }
+}
+
+inline
+size_t MemoryTracker::current() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _total.current;
+}
+
+inline
+size_t MemoryTracker::peak() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _total.peak;
+}
+
+inline
+size_t MemoryTracker::current(const std::string& category) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _categories.find(category);
+  return it == _categories.end() ? 0 : it->second.current;
+}
+
+inline
+size_t MemoryTracker::peak(const std::string& category) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _categories.find(category);
+  return it == _categories.end() ? 0 : it->second.peak;
+}
+
+inline
+std::map<std::string, MemoryTracker::Usage> MemoryTracker::categories() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _categories;
+}
+
+inline
+std::vector<MemoryTracker::Phase> MemoryTracker::phases() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _phases;
+}
+
+inline
+void MemoryTracker::dump(JSONWriter& json) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  json.begin_object();
+  _dump(json, _total);
+
+  json.key("categories").begin_object();
+  for(const auto& c : _categories) {
+    json.key(c.first).begin_object();
+    _dump(json, c.second);
+    json.end_object();
+  }
+  json.end_object();
+
+  json.key("phases").begin_array();
+  for(const auto& p : _phases) {
+    json.begin_object();
+    json.field("name", p.name);
+    _dump(json, p.total);
+    json.key("categories").begin_object();
+    for(const auto& c : p.categories) {
+      json.key(c.first).begin_object();
+      _dump(json, c.second);
+      json.end_object();
+    }
+    json.end_object();
+    json.end_object();
+  }
+  json.end_array();
+
+  json.end_object();
+}
+
+inline
+void MemoryTracker::_add(Usage& usage, const size_t bytes) {
+  usage.current += bytes;
+  usage.peak = std::max(usage.peak, usage.current);
+}
+
+inline
+void MemoryTracker::_sub(Usage& usage, const size_t bytes) {
+  usage.current -= std::min(usage.current, bytes);
+}
+
+inline
+void MemoryTracker::_dump(JSONWriter& json, const Usage& usage) {
+  json.field("current_bytes", usage.current);
+  json.field("peak_bytes", usage.peak);
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,507 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <limits>
+#include <experimental/filesystem>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Lightweight metrics registry exported in Prometheus text format
+//
+// Updates are relaxed atomic operations on per-thread shards,
+// so instrumentation points cost a few instructions.
+// Shards are only summed up when the metrics are written (scraped).
+//
+// API: MetricsRegistry registry;
+//      auto& c = registry.counter("snig_inputs_total", "number of inferred inputs");
+//      auto& h = registry.histogram("snig_batch_latency_seconds", "batch latency", {0.01, 0.1, 1});
+//      c.add(5000);
+//      h.observe(0.02);
+//      registry.write_file("metrics.prom");
+
+constexpr size_t NUM_METRIC_SHARDS = 16;
+
+// index of the shard owned by the calling thread
+inline
+size_t metric_shard();
+
+// add v to an atomic double
+inline
+void atomic_add(std::atomic<double>& target, const double v);
+
+class Counter {
+
+  public:
+
+    void add(const double v = 1);
+
+    double value() const;
+
+  private:
+
+    struct alignas(64) Shard {
+      std::atomic<double> value{0};
+    };
+
+    std::array<Shard, NUM_METRIC_SHARDS> _shards;
+};
+
+class Gauge {
+
+  public:
+
+    void set(const double v);
+
+    void add(const double v);
+
+    double value() const;
+
+  private:
+
+    std::atomic<double> _value{0};
+};
+
+class Histogram {
+
+  public:
+
+    //upper bounds of buckets, +Inf is implied
+    explicit Histogram(const std::vector<double>& bounds);
+
+    void observe(const double v);
+
+    const std::vector<double>& bounds() const;
+
+    //cumulative count of each bucket, the last one is +Inf
+    std::vector<uint64_t> cumulative_counts() const;
+
+    double sum() const;
+
+    uint64_t count() const;
+
+  private:
+
+    struct alignas(64) Shard {
+      std::unique_ptr<std::atomic<uint64_t>[]> counts;
+      std::atomic<double> sum{0};
+    };
+
+    std::vector<double> _bounds;
+    std::array<Shard, NUM_METRIC_SHARDS> _shards;
+};
+
+class MetricsRegistry {
+
+  public:
+
+    //returns the existing metric if name and labels were registered before
+    //labels are given in Prometheus syntax without braces, e.g. stage="gpu0"
+    Counter& counter(
+      const std::string& name,
+      const std::string& help,
+      const std::string& labels = ""
+    );
+
+    Gauge& gauge(
+      const std::string& name,
+      const std::string& help,
+      const std::string& labels = ""
+    );
+
+    Histogram& histogram(
+      const std::string& name,
+      const std::string& help,
+      const std::vector<double>& bounds,
+      const std::string& labels = ""
+    );
+
+    void write_prometheus(std::ostream& os) const;
+
+    std::string to_prometheus() const;
+
+    //write to a temporary file and rename it
+    //so that a reader never sees a partial file
+    void write_file(const std::fs::path& path) const;
+
+  private:
+
+    struct Family {
+      std::string help;
+      std::string type;
+      std::map<std::string, std::unique_ptr<Counter> > counters;
+      std::map<std::string, std::unique_ptr<Gauge> > gauges;
+      std::map<std::string, std::unique_ptr<Histogram> > histograms;
+    };
+
+    mutable std::mutex _mutex;
+    std::map<std::string, Family> _families;
+
+    Family& _family(
+      const std::string& name,
+      const std::string& help,
+      const std::string& type
+    );
+
+    static std::string _braces(const std::string& labels);
+
+    static std::string _join(const std::string& labels, const std::string& label);
+};
+
+// Minimal HTTP listener on localhost serving the registry to scrapers
+// Nothing is serialized until a scraper connects
+class MetricsServer {
+
+  public:
+
+    MetricsServer(const MetricsRegistry& registry, const unsigned short port);
+
+    ~MetricsServer();
+
+    unsigned short port() const;
+
+  private:
+
+    const MetricsRegistry& _registry;
+    int _fd{-1};
+    unsigned short _port;
+    std::atomic<bool> _stop{false};
+    std::thread _thread;
+
+    void _serve();
+};
+
+//-----------------------------------------------------------------------------
+//Definition of metric functions
+//-----------------------------------------------------------------------------
+
+inline
+size_t metric_shard() {
+  static std::atomic<size_t> next{0};
+  thread_local size_t shard = next.fetch_add(1, std::memory_order_relaxed) % NUM_METRIC_SHARDS;
+  return shard;
+}
+
+inline
+void atomic_add(std::atomic<double>& target, const double v) {
+  double old = target.load(std::memory_order_relaxed);
+  while(!target.compare_exchange_weak(old, old + v, std::memory_order_relaxed)) {
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Definition of Counter, Gauge, and Histogram
+// ----------------------------------------------------------------------------
+
+inline
+void Counter::add(const double v) {
+  atomic_add(_shards[metric_shard()].value, v);
+}
+
+inline
+double Counter::value() const {
+  double v{0};
+  for(const auto& s : _shards) {
+    v += s.value.load(std::memory_order_relaxed);
+  }
+  return v;
+}
+
+inline
+void Gauge::set(const double v) {
+  _value.store(v, std::memory_order_relaxed);
+}
+
+inline
+void Gauge::add(const double v) {
+  atomic_add(_value, v);
+}
+
+inline
+double Gauge::value() const {
+  return _value.load(std::memory_order_relaxed);
+}
+
+inline
+Histogram::Histogram(const std::vector<double>& bounds) : _bounds{bounds} {
+  std::sort(_bounds.begin(), _bounds.end());
+  for(auto& s : _shards) {
+    s.counts.reset(new std::atomic<uint64_t>[_bounds.size() + 1]);
+    for(size_t b = 0; b <= _bounds.size(); ++b) {
+      s.counts[b].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+inline
+void Histogram::observe(const double v) {
+  auto& s = _shards[metric_shard()];
+  size_t b = std::lower_bound(_bounds.begin(), _bounds.end(), v) - _bounds.begin();
+  s.counts[b].fetch_add(1, std::memory_order_relaxed);
+  atomic_add(s.sum, v);
+}
+
+inline
+const std::vector<double>& Histogram::bounds() const {
+  return _bounds;
+}
+
+inline
+std::vector<uint64_t> Histogram::cumulative_counts() const {
+  std::vector<uint64_t> counts(_bounds.size() + 1, 0);
+  for(const auto& s : _shards) {
+    for(size_t b = 0; b <= _bounds.size(); ++b) {
+      counts[b] += s.counts[b].load(std::memory_order_relaxed);
+    }
+  }
+  std::partial_sum(counts.begin(), counts.end(), counts.begin());
+  return counts;
+}
+
+inline
+double Histogram::sum() const {
+  double v{0};
+  for(const auto& s : _shards) {
+    v += s.sum.load(std::memory_order_relaxed);
+  }
+  return v;
+}
+
+inline
+uint64_t Histogram::count() const {
+  return cumulative_counts().back();
+}
+
+// ----------------------------------------------------------------------------
+// Definition of MetricsRegistry
+// ----------------------------------------------------------------------------
+
+inline
+Counter& MetricsRegistry::counter(
+  const std::string& name,
+  const std::string& help,
+  const std::string& labels
+) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto& m = _family(name, help, "counter").counters[labels];
+  if(!m) {
+    m = std::make_unique<Counter>();
+  }
+  return *m;
+}
+
+inline
+Gauge& MetricsRegistry::gauge(
+  const std::string& name,
+  const std::string& help,
+  const std::string& labels
+) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto& m = _family(name, help, "gauge").gauges[labels];
+  if(!m) {
+    m = std::make_unique<Gauge>();
+  }
+  return *m;
+}
+
+inline
+Histogram& MetricsRegistry::histogram(
+  const std::string& name,
+  const std::string& help,
+  const std::vector<double>& bounds,
+  const std::string& labels
+) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto& m = _family(name, help, "histogram").histograms[labels];
+  if(!m) {
+    m = std::make_unique<Histogram>(bounds);
+  }
+  return *m;
+}
+
+inline
+void MetricsRegistry::write_prometheus(std::ostream& os) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  os.precision(std::numeric_limits<double>::digits10);
+  for(const auto& f : _families) {
+    const auto& name = f.first;
+    os << "# HELP " << name << ' ' << f.second.help << '\n';
+    os << "# TYPE " << name << ' ' << f.second.type << '\n';
+    for(const auto& m : f.second.counters) {
+      os << name << _braces(m.first) << ' ' << m.second->value() << '\n';
+    }
+    for(const auto& m : f.second.gauges) {
+      os << name << _braces(m.first) << ' ' << m.second->value() << '\n';
+    }
+    for(const auto& m : f.second.histograms) {
+      const auto& bounds = m.second->bounds();
+      auto counts = m.second->cumulative_counts();
+      for(size_t b = 0; b < bounds.size(); ++b) {
+        std::ostringstream le;
+        le << "le=\"" << bounds[b] << '"';
+        os << name << "_bucket" << _braces(_join(m.first, le.str())) << ' ' << counts[b] << '\n';
+      }
+      os << name << "_bucket" << _braces(_join(m.first, "le=\"+Inf\"")) << ' ' << counts.back() << '\n';
+      os << name << "_sum" << _braces(m.first) << ' ' << m.second->sum() << '\n';
+      os << name << "_count" << _braces(m.first) << ' ' << counts.back() << '\n';
+    }
+  }
+}
+
+inline
+std::string MetricsRegistry::to_prometheus() const {
+  std::ostringstream os;
+  write_prometheus(os);
+  return os.str();
+}
+
+inline
+void MetricsRegistry::write_file(const std::fs::path& path) const {
+  using namespace std::literals::string_literals;
+
+  std::fs::path tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream f{tmp};
+    if(!f) {
+      throw std::runtime_error("cannot open the file"s + tmp.c_str());
+    }
+    write_prometheus(f);
+  }
+  std::fs::rename(tmp, path);
+}
+
+inline
+MetricsRegistry::Family& MetricsRegistry::_family(
+  const std::string& name,
+  const std::string& help,
+  const std::string& type
+) {
+  auto& f = _families[name];
+  if(f.type.empty()) {
+    f.help = help;
+    f.type = type;
+  }
+  else if(f.type != type) {
+    throw std::runtime_error("metric " + name + " is already registered as a " + f.type);
+  }
+  return f;
+}
+
+inline
+std::string MetricsRegistry::_braces(const std::string& labels) {
+  return labels.empty() ? "" : "{" + labels + "}";
+}
+
+inline
+std::string MetricsRegistry::_join(const std::string& labels, const std::string& label) {
+  return labels.empty() ? label : labels + "," + label;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of MetricsServer
+// ----------------------------------------------------------------------------
+
+inline
+MetricsServer::MetricsServer(const MetricsRegistry& registry, const unsigned short port)
+: _registry{registry},
+  _port{port}
+{
+  _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if(_fd < 0) {
+    throw std::runtime_error("cannot create the metrics socket");
+  }
+  int on = 1;
+  ::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(_port);
+  if(::bind(_fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(_fd, 8) != 0) {
+    ::close(_fd);
+    throw std::runtime_error("cannot listen on metrics port " + std::to_string(_port));
+  }
+
+  //port 0 picks a free port
+  socklen_t len = sizeof(addr);
+  ::getsockname(_fd, (sockaddr*)&addr, &len);
+  _port = ntohs(addr.sin_port);
+
+  _thread = std::thread([this](){ _serve(); });
+}
+
+inline
+MetricsServer::~MetricsServer() {
+  _stop = true;
+  _thread.join();
+  ::close(_fd);
+}
+
+inline
+unsigned short MetricsServer::port() const {
+  return _port;
+}
+
+inline
+void MetricsServer::_serve() {
+  pollfd pfd{_fd, POLLIN, 0};
+  char request[1024];
+  while(!_stop) {
+    //wake up periodically to check for stop
+    if(::poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    int client = ::accept(_fd, nullptr, nullptr);
+    if(client < 0) {
+      continue;
+    }
+    //a client that connects and stays silent must not block the listener
+    //or delay the destructor, so both directions time out after a second
+    timeval timeout{1, 0};
+    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    //every request is answered with the metrics
+    if(::recv(client, request, sizeof(request), 0) <= 0) {
+      ::close(client);
+      continue;
+    }
+    std::string body = _registry.to_prometheus();
+    std::string response =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: " + std::to_string(body.size()) + "\r\n"
+      "Connection: close\r\n\r\n" + body;
+    size_t sent{0};
+    while(sent < response.size()) {
+      ssize_t n = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+      if(n <= 0) {
+        break;
+      }
+      sent += n;
+    }
+    ::close(client);
+  }
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,641 @@
+#pragma once
+#include <SNIG/utility/sections.hpp>
+#include <experimental/filesystem>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <omp.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Matrix Market (.mtx) coordinate files
+//
+// %%MatrixMarket matrix coordinate <real|integer|pattern> <general|symmetric|skew-symmetric>
+// % comments
+// <rows> <cols> <entries>
+// <row> <col> [<value>]      one entry per line, 1-based
+//
+// Symmetric files hold the lower triangle, and the importer mirrors every
+// off-diagonal entry (negated for skew-symmetric). Pattern entries take the
+// value given to the importer.
+enum class MtxField {
+  real,
+  integer,
+  pattern
+};
+
+enum class MtxSymmetry {
+  general,
+  symmetric,
+  skew_symmetric
+};
+
+struct MtxHeader {
+  size_t rows{0};
+  size_t cols{0};
+
+  //entries stored in the file, before mirroring
+  size_t num_entries{0};
+
+  MtxField field{MtxField::real};
+  MtxSymmetry symmetry{MtxSymmetry::general};
+
+  //byte offset of the first entry
+  size_t data_offset{0};
+};
+
+// A whole file mapped read-only
+class MappedFile {
+
+  public:
+
+    explicit MappedFile(const std::fs::path& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    const char* data() const;
+
+    size_t size() const;
+
+  private:
+
+    const char* _data{nullptr};
+    size_t _size{0};
+};
+
+inline
+MtxHeader parse_mtx_header(const char* data, const size_t size, const std::string& name);
+
+// entries of a coordinate file parsed by num_threads threads, each over its
+// own range of lines, as calls f(thread, row, col, value) with 0-based ids;
+// mirrored entries of symmetric files follow their stored entry
+template <typename T, typename F>
+void parse_mtx_entries(
+  const MappedFile& file,
+  const MtxHeader& header,
+  const T pattern_value,
+  const size_t num_threads,
+  F&& f
+);
+
+// One weight layer of a manifest
+//
+// A transposed layer stores the matrix of output by input neurons,
+// as frameworks keep their weights; the challenge layers are input by output.
+struct ManifestLayer {
+  std::fs::path path;
+  bool is_transposed{false};
+};
+
+// Layer files of a model, mapped by a manifest instead of by file name
+//
+// # comment
+// layer <index> <path> [transposed]     one per layer, indices 1 to num_layers
+// input <path>                          optional: inputs by features
+//
+// Relative paths are relative to the manifest.
+struct MtxManifest {
+  std::vector<ManifestLayer> layers;
+  std::fs::path input;
+};
+
+inline
+MtxManifest read_mtx_manifest(const std::fs::path& path);
+
+// Imports one coordinate file as a packed layer file with the sections of
+// layout, the format of tsv_file_to_binary_file: the weights of every
+// (section, input neuron) are ordered by output neuron
+template <typename T>
+void mtx_file_to_packed_binary_file(
+  const std::fs::path& mtx_path,
+  const std::fs::path& output_file,
+  const SectionLayout& layout,
+  const bool is_transposed,
+  const T pattern_value,
+  const size_t num_threads
+);
+
+// Imports every layer of the manifest into weight_dir as n<num_neurons>-l<i>.b
+// with the sections of layout; a model header is written for sections
+// of different widths
+template <typename T>
+void mtx_manifest_to_binary_files(
+  const MtxManifest& manifest,
+  const std::fs::path& weight_dir,
+  const SectionLayout& layout,
+  const T pattern_value,
+  const size_t num_threads
+);
+
+// Imports a coordinate file of inputs by features as a dense input file,
+// the format of tsv_file_to_binary_file for inputs
+template <typename T>
+void mtx_file_to_input_binary_file(
+  const std::fs::path& mtx_path,
+  const std::fs::path& output_file,
+  const T pattern_value,
+  const size_t num_threads
+);
+
+// ----------------------------------------------------------------------------
+// Definition of MappedFile
+// ----------------------------------------------------------------------------
+
+inline
+MappedFile::MappedFile(const std::fs::path& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("cannot open " + path.string());
+  }
+  struct stat st;
+  if(::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("cannot stat " + path.string());
+  }
+  _size = st.st_size;
+  if(_size > 0) {
+    void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("cannot map " + path.string());
+    }
+    ::madvise(p, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(p);
+  }
+  //the mapping outlives the descriptor
+  ::close(fd);
+}
+
+inline
+MappedFile::~MappedFile() {
+  if(_data != nullptr) {
+    ::munmap(const_cast<char*>(_data), _size);
+  }
+}
+
+inline
+const char* MappedFile::data() const {
+  return _data;
+}
+
+inline
+size_t MappedFile::size() const {
+  return _size;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of Matrix Market functions
+// ----------------------------------------------------------------------------
+
+inline
+MtxHeader parse_mtx_header(const char* data, const size_t size, const std::string& name) {
+  MtxHeader header;
+  const char* end = data + size;
+  const char* p = data;
+
+  auto next_line = [&]() {
+    const char* beg = p;
+    p = std::find(p, end, '\n');
+    std::string line(beg, p);
+    if(p < end) {
+      ++p;
+    }
+    return line;
+  };
+
+  std::string banner = next_line();
+  std::transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c){ return std::tolower(c); });
+  std::istringstream tokens(banner);
+  std::string magic, object, format, field, symmetry;
+  tokens >> magic >> object >> format >> field >> symmetry;
+  if(magic != "%%matrixmarket" || object != "matrix") {
+    throw std::runtime_error(name + " is not a Matrix Market matrix");
+  }
+  if(format != "coordinate") {
+    throw std::runtime_error(name + " is a dense " + format + " matrix, only coordinate matrices are imported");
+  }
+
+  if(field == "real" || field == "double") {
+    header.field = MtxField::real;
+  }
+  else if(field == "integer") {
+    header.field = MtxField::integer;
+  }
+  else if(field == "pattern") {
+    header.field = MtxField::pattern;
+  }
+  else {
+    throw std::runtime_error(name + " has " + field + " entries, only real, integer, and pattern are imported");
+  }
+
+  if(symmetry == "general") {
+    header.symmetry = MtxSymmetry::general;
+  }
+  else if(symmetry == "symmetric") {
+    header.symmetry = MtxSymmetry::symmetric;
+  }
+  else if(symmetry == "skew-symmetric") {
+    header.symmetry = MtxSymmetry::skew_symmetric;
+  }
+  else {
+    throw std::runtime_error(name + " is " + symmetry + ", only general, symmetric, and skew-symmetric are imported");
+  }
+
+  //comments and blank lines up to the size line
+  std::string line;
+  do {
+    if(p == end) {
+      throw std::runtime_error(name + " has no size line");
+    }
+    line = next_line();
+  } while(line.empty() || line[0] == '%' || line.find_first_not_of(" \t\r") == std::string::npos);
+
+  std::istringstream sizes(line);
+  if(!(sizes >> header.rows >> header.cols >> header.num_entries)) {
+    throw std::runtime_error(name + " has a malformed size line: " + line);
+  }
+  if(header.symmetry != MtxSymmetry::general && header.rows != header.cols) {
+    throw std::runtime_error(name + " is symmetric but not square");
+  }
+  header.data_offset = p - data;
+  return header;
+}
+
+template <typename T, typename F>
+void parse_mtx_entries(
+  const MappedFile& file,
+  const MtxHeader& header,
+  const T pattern_value,
+  const size_t num_threads,
+  F&& f
+) {
+  const char* data = file.data();
+  const char* end = data + file.size();
+  const char* beg = data + header.data_offset;
+
+  //ranges of whole lines, each starting after a newline
+  std::vector<const char*> bounds(num_threads + 1);
+  bounds[0] = beg;
+  bounds[num_threads] = end;
+  for(size_t t = 1; t < num_threads; ++t) {
+    const char* b = beg + (end - beg) * t / num_threads;
+    b = std::find(std::max(b, bounds[t - 1]), end, '\n');
+    bounds[t] = b < end ? b + 1 : end;
+  }
+
+  std::vector<size_t> num_entries(num_threads, 0);
+  std::vector<std::string> errors(num_threads);
+
+  #pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+  for(size_t t = 0; t < num_threads; ++t) {
+    const char* p = bounds[t];
+    const char* range_end = bounds[t + 1];
+
+    auto skip_blanks = [&]() {
+      while(p < range_end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        ++p;
+      }
+    };
+
+    auto parse_id = [&](size_t& id) {
+      skip_blanks();
+      const char* first = p;
+      id = 0;
+      while(p < range_end && *p >= '0' && *p <= '9') {
+        id = id * 10 + (*p++ - '0');
+      }
+      return p != first;
+    };
+
+    while(p < range_end && errors[t].empty()) {
+      const char* line = p;
+      skip_blanks();
+      //blank lines and comments between entries
+      if(p == range_end || *p == '\n' || *p == '%') {
+        p = std::find(p, range_end, '\n');
+        p += (p < range_end);
+        continue;
+      }
+
+      size_t r;
+      size_t c;
+      T value = pattern_value;
+      bool is_valid = parse_id(r) && parse_id(c);
+      if(is_valid && header.field != MtxField::pattern) {
+        //the value ends at whitespace, before the end of the mapping
+        skip_blanks();
+        char buf[64];
+        size_t len = std::find_if(p, range_end, [](char ch){ return std::isspace((unsigned char)ch); }) - p;
+        if(len == 0 || len >= sizeof(buf)) {
+          is_valid = false;
+        }
+        else {
+          std::memcpy(buf, p, len);
+          buf[len] = '\0';
+          char* next;
+          value = T(std::strtod(buf, &next));
+          is_valid = next == buf + len;
+          p += len;
+        }
+      }
+      is_valid = is_valid && r >= 1 && r <= header.rows && c >= 1 && c <= header.cols;
+      if(!is_valid) {
+        errors[t] = "malformed or out of range entry: " + std::string(line, std::find(line, range_end, '\n'));
+        break;
+      }
+      p = std::find(p, range_end, '\n');
+      p += (p < range_end);
+
+      ++num_entries[t];
+      f(t, r - 1, c - 1, value);
+      if(r != c && header.symmetry == MtxSymmetry::symmetric) {
+        f(t, c - 1, r - 1, value);
+      }
+      else if(r != c && header.symmetry == MtxSymmetry::skew_symmetric) {
+        f(t, c - 1, r - 1, T(-value));
+      }
+    }
+  }
+
+  for(auto& e : errors) {
+    if(!e.empty()) {
+      throw std::runtime_error(e);
+    }
+  }
+  size_t total = std::accumulate(num_entries.begin(), num_entries.end(), size_t(0));
+  if(total != header.num_entries) {
+    throw std::runtime_error(
+      "found " + std::to_string(total) + " entries, the size line says " + std::to_string(header.num_entries)
+    );
+  }
+}
+
+inline
+MtxManifest read_mtx_manifest(const std::fs::path& path) {
+  std::ifstream in(path);
+  if(!in) {
+    throw std::runtime_error("cannot open " + path.string());
+  }
+  const auto dir = path.parent_path();
+  auto resolve = [&](const std::string& p) {
+    std::fs::path f(p);
+    return f.is_absolute() ? f : dir / f;
+  };
+
+  MtxManifest manifest;
+  std::vector<bool> is_given;
+  std::string line;
+  size_t line_number{0};
+  while(std::getline(in, line)) {
+    ++line_number;
+    std::istringstream tokens(line);
+    std::string key;
+    if(!(tokens >> key) || key[0] == '#') {
+      continue;
+    }
+    auto where = path.string() + ":" + std::to_string(line_number);
+
+    if(key == "layer") {
+      size_t index;
+      std::string file;
+      std::string option;
+      if(!(tokens >> index >> file) || index == 0) {
+        throw std::runtime_error(where + ": expected layer <index> <path> [transposed]");
+      }
+      ManifestLayer layer;
+      layer.path = resolve(file);
+      if(tokens >> option) {
+        if(option != "transposed") {
+          throw std::runtime_error(where + ": unknown layer option " + option);
+        }
+        layer.is_transposed = true;
+      }
+      if(index > manifest.layers.size()) {
+        manifest.layers.resize(index);
+        is_given.resize(index, false);
+      }
+      if(is_given[index - 1]) {
+        throw std::runtime_error(where + ": layer " + std::to_string(index) + " is given twice");
+      }
+      manifest.layers[index - 1] = layer;
+      is_given[index - 1] = true;
+    }
+    else if(key == "input") {
+      std::string file;
+      if(!(tokens >> file)) {
+        throw std::runtime_error(where + ": expected input <path>");
+      }
+      manifest.input = resolve(file);
+    }
+    else {
+      throw std::runtime_error(where + ": unknown key " + key);
+    }
+  }
+
+  auto missing = std::find(is_given.begin(), is_given.end(), false);
+  if(missing != is_given.end()) {
+    throw std::runtime_error(path.string() + " has no layer " + std::to_string(missing - is_given.begin() + 1));
+  }
+  if(manifest.layers.empty()) {
+    throw std::runtime_error(path.string() + " has no layers");
+  }
+  return manifest;
+}
+
+template <typename T>
+void mtx_file_to_packed_binary_file(
+  const std::fs::path& mtx_path,
+  const std::fs::path& output_file,
+  const SectionLayout& layout,
+  const bool is_transposed,
+  const T pattern_value,
+  const size_t num_threads
+) {
+  MappedFile file(mtx_path);
+  MtxHeader header = parse_mtx_header(file.data(), file.size(), mtx_path.string());
+
+  const size_t num_neurons = layout.num_neurons();
+  const size_t num_secs = layout.num_secs();
+  if(header.rows != num_neurons || header.cols != num_neurons) {
+    throw std::runtime_error(
+      mtx_path.string() + " is " + std::to_string(header.rows) + "x" + std::to_string(header.cols)
+      + ", the model has " + std::to_string(num_neurons) + " neurons"
+    );
+  }
+
+  //column c of the packed layer is (section of the output neuron, input neuron)
+  std::vector<int> section_of(num_neurons);
+  for(size_t s = 0; s < num_secs; ++s) {
+    std::fill(section_of.begin() + layout.offsets[s], section_of.begin() + layout.offsets[s + 1], int(s));
+  }
+  const size_t num_cols = num_neurons * num_secs;
+
+  //entries in file order per thread, then a counting sort by packed column
+  struct Entry {
+    int col;
+    int out;
+    T value;
+  };
+  std::vector<std::vector<Entry> > entries(num_threads);
+  const size_t max_entries = header.num_entries * (header.symmetry == MtxSymmetry::general ? 1 : 2);
+  for(auto& e : entries) {
+    e.reserve(max_entries / num_threads + 1);
+  }
+
+  try {
+    parse_mtx_entries<T>(file, header, pattern_value, num_threads, [&](size_t t, size_t r, size_t c, T v) {
+      size_t in = is_transposed ? c : r;
+      size_t out = is_transposed ? r : c;
+      entries[t].push_back(Entry{int(section_of[out] * num_neurons + in), int(out), v});
+    });
+  }
+  catch(const std::exception& e) {
+    throw std::runtime_error(mtx_path.string() + ": " + e.what());
+  }
+
+  std::vector<int> col_w(num_cols + 1, 0);
+  for(const auto& thread_entries : entries) {
+    for(const auto& e : thread_entries) {
+      ++col_w[e.col + 1];
+    }
+  }
+  std::partial_sum(col_w.begin(), col_w.end(), col_w.begin());
+  const size_t nnz = col_w.back();
+
+  std::vector<int> row_w(nnz);
+  std::vector<T> val_w(nnz);
+  {
+    std::vector<int> cursor(col_w.begin(), col_w.end() - 1);
+    for(auto& thread_entries : entries) {
+      for(const auto& e : thread_entries) {
+        int k = cursor[e.col]++;
+        row_w[k] = e.out;
+        val_w[k] = e.value;
+      }
+      std::vector<Entry>().swap(thread_entries);
+    }
+  }
+
+  //order every column by output neuron, whatever the order of the file
+  #pragma omp parallel num_threads(num_threads)
+  {
+    std::vector<std::pair<int, T> > column;
+    #pragma omp for schedule(dynamic, 256)
+    for(size_t c = 0; c < num_cols; ++c) {
+      const int beg = col_w[c];
+      const int end = col_w[c + 1];
+      if(std::is_sorted(row_w.begin() + beg, row_w.begin() + end)) {
+        continue;
+      }
+      column.clear();
+      for(int k = beg; k < end; ++k) {
+        column.emplace_back(row_w[k], val_w[k]);
+      }
+      std::sort(column.begin(), column.end(), [](const std::pair<int, T>& a, const std::pair<int, T>& b) {
+        return a.first < b.first;
+      });
+      for(int k = beg; k < end; ++k) {
+        row_w[k] = column[k - beg].first;
+        val_w[k] = column[k - beg].second;
+      }
+    }
+  }
+
+  std::ofstream out(output_file, std::ios::out | std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("cannot write " + output_file.string());
+  }
+  out.write((char*)&num_neurons, sizeof(size_t));
+  out.write((char*)&nnz, sizeof(size_t));
+  out.write((char*)col_w.data(), sizeof(int) * (num_cols + 1));
+  out.write((char*)row_w.data(), sizeof(int) * nnz);
+  out.write((char*)val_w.data(), sizeof(T) * nnz);
+}
+
+template <typename T>
+void mtx_manifest_to_binary_files(
+  const MtxManifest& manifest,
+  const std::fs::path& weight_dir,
+  const SectionLayout& layout,
+  const T pattern_value,
+  const size_t num_threads
+) {
+  const size_t num_neurons = layout.num_neurons();
+  std::fs::create_directories(weight_dir);
+
+  for(size_t i = 0; i < manifest.layers.size(); ++i) {
+    std::fs::path output_file = weight_dir;
+    output_file /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(i + 1) + ".b";
+    mtx_file_to_packed_binary_file<T>(
+      manifest.layers[i].path,
+      output_file,
+      layout,
+      manifest.layers[i].is_transposed,
+      pattern_value,
+      num_threads
+    );
+  }
+
+  //equal sections need no header, drop one left by an earlier import
+  auto header_path = model_header_path(weight_dir, num_neurons);
+  if(!layout.is_uniform()) {
+    write_model_header(header_path, layout);
+  }
+  else if(std::fs::exists(header_path)) {
+    std::fs::remove(header_path);
+  }
+}
+
+template <typename T>
+void mtx_file_to_input_binary_file(
+  const std::fs::path& mtx_path,
+  const std::fs::path& output_file,
+  const T pattern_value,
+  const size_t num_threads
+) {
+  MappedFile file(mtx_path);
+  MtxHeader header = parse_mtx_header(file.data(), file.size(), mtx_path.string());
+
+  const size_t rows = header.rows;
+  const size_t cols = header.cols;
+  std::vector<T> data_array(rows * cols, T(0));
+
+  //every entry has its own place in the dense array
+  try {
+    parse_mtx_entries<T>(file, header, pattern_value, num_threads, [&](size_t, size_t r, size_t c, T v) {
+      data_array[r * cols + c] = v;
+    });
+  }
+  catch(const std::exception& e) {
+    throw std::runtime_error(mtx_path.string() + ": " + e.what());
+  }
+
+  std::ofstream out(output_file, std::ios::out | std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("cannot write " + output_file.string());
+  }
+  out.write((char*)&rows, sizeof(size_t));
+  out.write((char*)&cols, sizeof(size_t));
+  out.write((char*)data_array.data(), sizeof(T) * (rows * cols));
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,223 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace snig {
+
+// Occupancy and stall statistics of one stage of a staged engine
+// (a device of SNIG or a layer range of GPipe)
+struct StageStats {
+  std::string name;
+
+  //layers [first_layer, last_layer) computed by this stage
+  size_t first_layer{0};
+  size_t last_layer{0};
+
+  //number of batches processed
+  size_t num_batches{0};
+
+  //time spent computing batches
+  double busy_ms{0};
+
+  //time blocked because the input queue was empty (starved by the producer)
+  double producer_wait_ms{0};
+
+  //time blocked handing a batch to the next stage (backed up by the consumer)
+  double consumer_wait_ms{0};
+
+  //depth of the input queue, sampled at every push and pop
+  size_t num_depth_samples{0};
+  size_t sum_depth{0};
+  size_t max_depth{0};
+
+  double average_depth() const;
+
+  double utilization(const double wall_ms) const;
+};
+
+// Collects StageStats of all stages of a staged engine
+//
+// Each field of a stage has a single writer at a time:
+// busy and wait times are written by the thread running the stage
+// and depth samples are taken under the mutex guarding the queue.
+class PipelineStats {
+
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    void reset(const size_t num_stages);
+
+    void start();
+
+    void stop();
+
+    StageStats& operator [] (const size_t stage);
+
+    const StageStats& operator [] (const size_t stage) const;
+
+    void add_busy(const size_t stage, const clock::time_point& beg);
+
+    void add_producer_wait(const size_t stage, const clock::time_point& beg);
+
+    void add_consumer_wait(const size_t stage, const clock::time_point& beg);
+
+    void sample_depth(const size_t stage, const size_t depth);
+
+    const std::vector<StageStats>& stages() const;
+
+    size_t num_stages() const;
+
+    double wall_ms() const;
+
+    //utilization of each stage over the wall time of the run
+    std::vector<double> utilization() const;
+
+    //index of the stage with the highest utilization
+    size_t bottleneck() const;
+
+    void dump(JSONWriter& json) const;
+
+  private:
+
+    std::vector<StageStats> _stages;
+
+    clock::time_point _beg;
+    clock::time_point _end;
+
+    static double _ms_since(const clock::time_point& beg);
+};
+
+// ----------------------------------------------------------------------------
+// Definition of StageStats
+// ----------------------------------------------------------------------------
+
+inline
+double StageStats::average_depth() const {
+  return num_depth_samples == 0 ? 0.0 : double(sum_depth) / num_depth_samples;
+}
+
+inline
+double StageStats::utilization(const double wall_ms) const {
+  return wall_ms <= 0 ? 0.0 : busy_ms / wall_ms;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of PipelineStats
+// ----------------------------------------------------------------------------
+
+inline
+void PipelineStats::reset(const size_t num_stages) {
+  _stages.assign(num_stages, StageStats{});
+  _beg = _end = clock::now();
+}
+
+inline
+void PipelineStats::start() {
+  _beg = clock::now();
+}
+
+inline
+void PipelineStats::stop() {
+  _end = clock::now();
+}
+
+inline
+StageStats& PipelineStats::operator [] (const size_t stage) {
+  return _stages[stage];
+}
+
+inline
+const StageStats& PipelineStats::operator [] (const size_t stage) const {
+  return _stages[stage];
+}
+
+inline
+void PipelineStats::add_busy(const size_t stage, const clock::time_point& beg) {
+  _stages[stage].busy_ms += _ms_since(beg);
+}
+
+inline
+void PipelineStats::add_producer_wait(const size_t stage, const clock::time_point& beg) {
+  _stages[stage].producer_wait_ms += _ms_since(beg);
+}
+
+inline
+void PipelineStats::add_consumer_wait(const size_t stage, const clock::time_point& beg) {
+  _stages[stage].consumer_wait_ms += _ms_since(beg);
+}
+
+inline
+void PipelineStats::sample_depth(const size_t stage, const size_t depth) {
+  auto& s = _stages[stage];
+  ++s.num_depth_samples;
+  s.sum_depth += depth;
+  s.max_depth = std::max(s.max_depth, depth);
+}
+
+inline
+const std::vector<StageStats>& PipelineStats::stages() const {
+  return _stages;
+}
+
+inline
+size_t PipelineStats::num_stages() const {
+  return _stages.size();
+}
+
+inline
+double PipelineStats::wall_ms() const {
+  return std::chrono::duration<double, std::milli>(_end - _beg).count();
+}
+
+inline
+std::vector<double> PipelineStats::utilization() const {
+  std::vector<double> u;
+  u.reserve(_stages.size());
+  for(const auto& s : _stages) {
+    u.push_back(s.utilization(wall_ms()));
+  }
+  return u;
+}
+
+inline
+size_t PipelineStats::bottleneck() const {
+  auto u = utilization();
+  return std::distance(u.begin(), std::max_element(u.begin(), u.end()));
+}
+
+inline
+void PipelineStats::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("wall_ms", wall_ms());
+  if(!_stages.empty()) {
+    json.field("bottleneck", _stages[bottleneck()].name);
+  }
+  json.key("stages").begin_array();
+  for(const auto& s : _stages) {
+    json.begin_object();
+    json.field("name", s.name);
+    json.field("first_layer", s.first_layer);
+    json.field("last_layer", s.last_layer);
+    json.field("num_batches", s.num_batches);
+    json.field("busy_ms", s.busy_ms);
+    json.field("producer_wait_ms", s.producer_wait_ms);
+    json.field("consumer_wait_ms", s.consumer_wait_ms);
+    json.field("utilization", s.utilization(wall_ms()));
+    json.field("average_queue_depth", s.average_depth());
+    json.field("max_queue_depth", s.max_depth);
+    json.end_object();
+  }
+  json.end_array();
+  json.end_object();
+}
+
+inline
+double PipelineStats::_ms_since(const clock::time_point& beg) {
+  return std::chrono::duration<double, std::milli>(clock::now() - beg).count();
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -8,8 +8,10 @@
 #include <Eigen/Dense>
 #include <vector>
 #include <string>
+#include <stdexcept>
 #include <SNIG/utility/matrix_format.h>
 #include <SNIG/utility/matrix_operation.hpp>
+#include <SNIG/utility/category_bitset.hpp>
 
 namespace std {
   namespace fs = experimental::filesystem;
@@ -183,6 +185,12 @@ void read_input_binary(
   bool* rowsY
 );
 
+// reads the dense binary input one row at a time into a row-major CSR matrix
+template <typename T>
+Eigen::SparseMatrix<T, Eigen::RowMajor> read_input_binary_to_CSR(
+  const std::fs::path& input_path
+);
+
 inline
 Eigen::Matrix<int, Eigen::Dynamic, 1> read_golden(
   const std::fs::path& golden_path,
@@ -220,6 +228,15 @@ size_t find_max_nnz_binary(
   const size_t num_neurons_per_layer
 );
 
+// number of output sections of a packed layer file,
+// derived from its size so no device has to be queried
+template <typename T>
+size_t num_secs_of_layer_binary(const std::fs::path& layer_path);
+
+// reads a whole packed layer, checking its geometry and every read
+template <typename T>
+PackedLayer<T> read_packed_layer_binary(const std::fs::path& layer_path);
+
 inline
 size_t count_nnz(const std::string& s);
 
@@ -234,6 +251,16 @@ void tsv_file_to_binary_file(
   const size_t estimate_nnz
 );
 
+// sorts the triplets of a layer, rows already offset by their section,
+// and writes them as a packed layer file
+template <typename T>
+void write_packed_layer_binary(
+  const std::fs::path& output_file,
+  std::vector<Triplet<T> >& triplets,
+  const size_t rows,
+  const size_t N_SLAB
+);
+
 template <typename T>
 void tsv_file_to_binary_file(
   std::fs::path file_path,
@@ -724,6 +751,41 @@ void read_input_binary(
   }
 }
 
+template <typename T>
+Eigen::SparseMatrix<T, Eigen::RowMajor> read_input_binary_to_CSR(
+  const std::fs::path& input_path
+) {
+  //T is either float or double type
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  std::ifstream in(input_path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + input_path.string());
+  }
+  size_t num_inputs;
+  size_t num_features;
+  in.read((char*)&num_inputs, sizeof(size_t));
+  in.read((char*)&num_features, sizeof(size_t));
+
+  Eigen::SparseMatrix<T, Eigen::RowMajor> mat(num_inputs, num_features);
+  std::vector<T> row(num_features);
+  for(size_t i = 0; i < num_inputs; ++i) {
+    in.read((char*)row.data(), sizeof(T) * num_features);
+    mat.startVec(i);
+    for(size_t j = 0; j < num_features; ++j) {
+      if(row[j] != 0) {
+        mat.insertBack(i, j) = row[j];
+      }
+    }
+  }
+  mat.finalize();
+
+  return mat;
+}
+
 inline
 Eigen::Matrix<int, Eigen::Dynamic, 1> read_golden(
   const std::fs::path& golden_path,
@@ -743,14 +805,8 @@ inline
 Eigen::Matrix<int, Eigen::Dynamic, 1> read_golden_binary(
   const std::fs::path& golden_path
 ) {
-  std::ifstream in(golden_path, std::ios::in | std::ios::binary);
-
-  size_t rows;
-  in.read((char*)&rows, sizeof(size_t));
-
-  Eigen::Matrix<int, Eigen::Dynamic, 1> golden(rows, 1);
-  in.read((char*)golden.data(), sizeof(Eigen::Matrix<int, Eigen::Dynamic, 1>::Scalar) * rows);
-  return golden;
+  //bitset and int golden files alike
+  return read_category_bitset(golden_path).to_Eigen();
 }
 
 inline
@@ -837,11 +893,91 @@ size_t find_max_nnz_binary(
     size_t rows;
     in.read((char*)&rows, sizeof(size_t));
     in.read((char*)&nnz, sizeof(size_t));
+    if(!in) {
+      throw std::runtime_error("cannot read the header of " + p.string());
+    }
     max_nnz = std::max(max_nnz, nnz);
   }
 
   return max_nnz;
 }
+
+namespace detail {
+
+// number of sections implied by the size of a packed layer file
+// header, col_w (rows * num_secs + 1), row_w (nnz), val_w (nnz)
+template <typename T>
+size_t packed_layer_num_secs(
+  const std::fs::path& layer_path,
+  const size_t rows,
+  const size_t nnz
+) {
+  const size_t file_size = std::fs::file_size(layer_path);
+  const size_t fixed_bytes = 2 * sizeof(size_t) + (sizeof(int) + sizeof(T)) * nnz + sizeof(int);
+  if(
+    rows == 0 ||
+    file_size < fixed_bytes ||
+    (file_size - fixed_bytes) % (sizeof(int) * rows) != 0
+  ) {
+    throw std::runtime_error(layer_path.string() + " is not a packed layer of data type size " + std::to_string(sizeof(T)));
+  }
+  return (file_size - fixed_bytes) / (sizeof(int) * rows);
+}
+
+}// end of namespace detail
+
+template <typename T>
+size_t num_secs_of_layer_binary(const std::fs::path& layer_path) {
+  std::ifstream in(layer_path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + layer_path.string());
+  }
+  size_t rows;
+  size_t nnz;
+  in.read((char*)&rows, sizeof(size_t));
+  in.read((char*)&nnz, sizeof(size_t));
+  if(!in) {
+    throw std::runtime_error(layer_path.string() + " is truncated");
+  }
+  return detail::packed_layer_num_secs<T>(layer_path, rows, nnz);
+}
+
+template <typename T>
+PackedLayer<T> read_packed_layer_binary(const std::fs::path& layer_path) {
+  std::ifstream in(layer_path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + layer_path.string());
+  }
+
+  PackedLayer<T> layer;
+  size_t nnz;
+  in.read((char*)&layer.rows, sizeof(size_t));
+  in.read((char*)&nnz, sizeof(size_t));
+  if(!in) {
+    throw std::runtime_error(layer_path.string() + " is truncated");
+  }
+  layer.num_secs = detail::packed_layer_num_secs<T>(layer_path, layer.rows, nnz);
+
+  layer.col_w.resize(layer.rows * layer.num_secs + 1);
+  layer.row_w.resize(nnz);
+  layer.val_w.resize(nnz);
+  in.read((char*)layer.col_w.data(), sizeof(int) * layer.col_w.size());
+  in.read((char*)layer.row_w.data(), sizeof(int) * nnz);
+  in.read((char*)layer.val_w.data(), sizeof(T) * nnz);
+  if(!in) {
+    throw std::runtime_error(layer_path.string() + " is truncated");
+  }
+  //a file short by whole columns still fits the size check with fewer sections
+  if(
+    layer.col_w.front() != 0 ||
+    size_t(layer.col_w.back()) != nnz ||
+    !std::is_sorted(layer.col_w.begin(), layer.col_w.end())
+  ) {
+    throw std::runtime_error(layer_path.string() + " has column offsets that do not match its " + std::to_string(nnz) + " weights");
+  }
+  return layer;
+}
+
 inline
 size_t count_nnz(const std::string& s) {
   return std::count(s.begin(), s.end(), '\n');
@@ -889,38 +1025,48 @@ void tsv_file_to_binary_file(
       );
     }
 
-    std::sort(triplets.begin(), triplets.end());
-    size_t nnz = triplets.size();
-
-    auto row_array = std::make_unique<int[]>(rows * N_SLAB + 1);
-    auto col_array = std::make_unique<int[]>(nnz);
-    auto data_array = std::make_unique<T[]>(nnz);
-    
-    std::memset(row_array.get(), 0, sizeof(int) * (rows * N_SLAB + 1));
-    
-    for(size_t j = 0 ; j < nnz; ++j) {
-      ++row_array.get()[triplets[j].row + 1];
-      col_array.get()[j] = triplets[j].col;
-      data_array.get()[j] = triplets[j].value;
-    }
-
-    std::partial_sum(row_array.get(), row_array.get() + rows * N_SLAB + 1, row_array.get());
-
     std::fs::path output_file = weight_dir;
     output_file /= "n" + std::to_string(cols) + "-l"
       + std::to_string(i + 1) + ".b";
 
-    std::ofstream out(output_file, std::ios::out | std::ios::binary);
-    out.write((char*)&rows, sizeof(size_t));
-    out.write((char*)&nnz, sizeof(size_t));
-    out.write((char*)row_array.get(), sizeof(int) * (rows * N_SLAB + 1));
-    out.write((char*)col_array.get(), sizeof(int) * (nnz));
-    out.write((char*)data_array.get(), sizeof(T) * (nnz));
+    write_packed_layer_binary<T>(output_file, triplets, rows, N_SLAB);
   }
 
   
 }
 
+template <typename T>
+void write_packed_layer_binary(
+  const std::fs::path& output_file,
+  std::vector<Triplet<T> >& triplets,
+  const size_t rows,
+  const size_t N_SLAB
+) {
+  std::sort(triplets.begin(), triplets.end());
+  size_t nnz = triplets.size();
+
+  auto row_array = std::make_unique<int[]>(rows * N_SLAB + 1);
+  auto col_array = std::make_unique<int[]>(nnz);
+  auto data_array = std::make_unique<T[]>(nnz);
+  
+  std::memset(row_array.get(), 0, sizeof(int) * (rows * N_SLAB + 1));
+  
+  for(size_t j = 0 ; j < nnz; ++j) {
+    ++row_array.get()[triplets[j].row + 1];
+    col_array.get()[j] = triplets[j].col;
+    data_array.get()[j] = triplets[j].value;
+  }
+
+  std::partial_sum(row_array.get(), row_array.get() + rows * N_SLAB + 1, row_array.get());
+
+  std::ofstream out(output_file, std::ios::out | std::ios::binary);
+  out.write((char*)&rows, sizeof(size_t));
+  out.write((char*)&nnz, sizeof(size_t));
+  out.write((char*)row_array.get(), sizeof(int) * (rows * N_SLAB + 1));
+  out.write((char*)col_array.get(), sizeof(int) * (nnz));
+  out.write((char*)data_array.get(), sizeof(T) * (nnz));
+}
+
 template <typename T>
 void tsv_file_to_binary_file(
   std::fs::path input_path,
@@ -973,23 +1119,16 @@ void tsv_file_to_binary_file(
   golden_path /= "neuron" + std::to_string(num_features) + "-l" + std::to_string(num_layers) + "-categories.tsv";
   std::stringstream read_s = read_file_to_sstream(golden_path);
 
-  Eigen::Matrix<int, Eigen::Dynamic, 1> golden = Eigen::Matrix<int, Eigen::Dynamic, 1>::Zero(rows, 1);
+  CategoryBitset golden(rows);
 
   while(std::getline(read_s, line)) {
-    golden(std::stoi(line) - 1, 0) = 1;
+    golden.set(std::stoi(line) - 1, true);
   }   
 
   auto p = golden_path.parent_path();
   p /= "neuron" + std::to_string(num_features) + "-l" + std::to_string(num_layers) + "-categories.b";
 
-  std::ofstream out(p, std::ios::out | std::ios::binary);
-
-  out.write((char*)&rows, sizeof(size_t));
-  out.write(
-    (char*) golden.data(),
-    sizeof(Eigen::Matrix<int, Eigen::Dynamic, 1>::Scalar) * rows
-  );
-  
+  write_category_bitset(p, golden);
 }
 
 template <typename T>
@@ -1071,23 +1210,16 @@ void diagonal_to_binary_file(
   std::string line;
   size_t min_diagonal = std::min(rows, num_features);
 
-  Eigen::Matrix<int, Eigen::Dynamic, 1> golden = Eigen::Matrix<int, Eigen::Dynamic, 1>::Zero(rows, 1);
+  CategoryBitset golden(rows);
   for(size_t i = 0; i < min_diagonal; ++i) {
-    golden(i, 0) = 1;
+    golden.set(i, true);
   }
 
 
   auto p = golden_path;
   p /= "neuron" + std::to_string(num_features) + "-l" + std::to_string(num_layers) + "-categories.b";
 
-  std::ofstream out(p, std::ios::out | std::ios::binary);
-
-  out.write((char*)&rows, sizeof(size_t));
-  out.write(
-    (char*) golden.data(),
-    sizeof(Eigen::Matrix<int, Eigen::Dynamic, 1>::Scalar) * rows
-  );
-  
+  write_category_bitset(p, golden);
 }
 
 } // end of namespace snig-----------------------------------------------
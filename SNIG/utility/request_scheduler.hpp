@@ -0,0 +1,475 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace snig {
+
+// Order in which pending requests are served
+//   fifo     : arrival order, the first-come batch fetch of the engines
+//   deadline : lower priority class first, earliest deadline first within a class
+enum class RequestOrder {
+  fifo,
+  deadline
+};
+
+// What submit does when the queue is full
+//   reject : refuse the request at once
+//   block  : wait for room, up to block_timeout, which backs up the producer
+enum class AdmissionPolicy {
+  reject,
+  block
+};
+
+enum class Admission {
+  accepted,
+  rejected_full,
+  rejected_deadline,
+  closed
+};
+
+inline
+RequestOrder to_request_order(const std::string& name);
+
+inline
+AdmissionPolicy to_admission_policy(const std::string& name);
+
+inline
+std::string to_string(const Admission admission);
+
+// latency below which p percent of latencies fall, the nearest rank,
+// 0 if there are none; shared by the server report and replay
+inline
+double latency_percentile(const std::vector<double>& latency_ms, const double p);
+
+struct SchedulerOptions {
+  RequestOrder order{RequestOrder::deadline};
+  AdmissionPolicy policy{AdmissionPolicy::reject};
+
+  //priority classes 0 (most urgent) to num_classes - 1
+  size_t num_classes{2};
+
+  //pending rows (inputs) beyond which submit rejects or blocks
+  size_t capacity{120000};
+
+  std::chrono::milliseconds block_timeout{1000};
+
+  //requests are handed out in units of at most unit_rows rows,
+  //so a large job yields to urgent requests between its units
+  size_t unit_rows{256};
+
+  //reject requests whose deadline cannot be met given the rows ahead of them
+  //and the measured time per row over num_workers workers
+  bool reject_infeasible{true};
+  size_t num_workers{1};
+};
+
+// Counters of one priority class
+struct ClassStats {
+  size_t num_submitted{0};
+  size_t num_accepted{0};
+  size_t num_rejected_full{0};
+  size_t num_rejected_deadline{0};
+  size_t num_completed{0};
+  size_t num_deadline_misses{0};
+
+  //time producers of this class spent blocked on a full queue
+  double blocked_ms{0};
+
+  //arrival to completion of every completed request
+  std::vector<double> latency_ms;
+
+  double latency_percentile(const double p) const;
+};
+
+// Deadline- and priority-aware queue of inference requests
+//
+// Producers submit requests of num_rows inputs. Workers pop units of at most
+// unit_rows rows of the most urgent request and call complete when a unit
+// is done; the call that completes the last unit of a request returns true.
+// P is the payload the caller attaches to a request (inputs, results, promise).
+//
+// All members are guarded by one mutex; workers wait on _not_empty
+// and blocked producers on _not_full.
+template <typename P>
+class RequestScheduler {
+
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    struct Request {
+      size_t id;
+      size_t priority;
+      size_t num_rows;
+      clock::time_point arrival;
+      clock::time_point deadline;
+      P payload;
+
+      //rows handed out and rows finished, guarded by the scheduler
+      size_t next_row{0};
+      size_t finished_rows{0};
+
+      bool has_deadline() const { return deadline != clock::time_point::max(); }
+    };
+
+    struct Unit {
+      std::shared_ptr<Request> request;
+      size_t beg;
+      size_t end;
+      clock::time_point start;
+    };
+
+    explicit RequestScheduler(const SchedulerOptions& options);
+
+    //deadline of clock::time_point::max() means none
+    //the request (with its payload) is only kept if accepted,
+    //otherwise it is handed back through rejected
+    Admission submit(
+      P&& payload,
+      const size_t num_rows,
+      const size_t priority,
+      const clock::time_point deadline,
+      P* rejected = nullptr
+    );
+
+    //blocks until a unit is available, false once closed and drained
+    bool pop(Unit& unit);
+
+    //true if unit was the last one of its request
+    bool complete(const Unit& unit);
+
+    //wakes every waiting worker and producer, later submits are refused
+    void close();
+
+    size_t pending_rows() const;
+
+    const SchedulerOptions& options() const;
+
+    std::vector<ClassStats> stats() const;
+
+    void dump(JSONWriter& json) const;
+
+  private:
+
+    struct Urgency {
+      RequestOrder order;
+      bool operator () (const std::shared_ptr<Request>& a, const std::shared_ptr<Request>& b) const;
+    };
+
+    SchedulerOptions _options;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    bool _closed{false};
+
+    //requests with rows left to hand out
+    std::set<std::shared_ptr<Request>, Urgency> _pending;
+    size_t _pending_rows{0};
+    size_t _max_pending_rows{0};
+
+    size_t _next_id{0};
+
+    //moving average of the seconds a worker spends per row
+    double _seconds_per_row{0};
+
+    std::vector<ClassStats> _stats;
+
+    bool _is_feasible(const size_t priority, const size_t num_rows, const clock::time_point deadline) const;
+};
+
+// ----------------------------------------------------------------------------
+// Definition of RequestScheduler
+// ----------------------------------------------------------------------------
+
+inline
+RequestOrder to_request_order(const std::string& name) {
+  if(name == "fifo") {
+    return RequestOrder::fifo;
+  }
+  if(name == "deadline") {
+    return RequestOrder::deadline;
+  }
+  throw std::runtime_error("unknown request order " + name + " (fifo or deadline)");
+}
+
+inline
+AdmissionPolicy to_admission_policy(const std::string& name) {
+  if(name == "reject") {
+    return AdmissionPolicy::reject;
+  }
+  if(name == "block") {
+    return AdmissionPolicy::block;
+  }
+  throw std::runtime_error("unknown admission policy " + name + " (reject or block)");
+}
+
+inline
+std::string to_string(const Admission admission) {
+  switch(admission) {
+    case Admission::accepted:
+      return "accepted";
+    case Admission::rejected_full:
+      return "rejected_full";
+    case Admission::rejected_deadline:
+      return "rejected_deadline";
+    default:
+      return "closed";
+  }
+}
+
+inline
+double latency_percentile(const std::vector<double>& latency_ms, const double p) {
+  if(latency_ms.empty()) {
+    return 0;
+  }
+  std::vector<double> sorted(latency_ms);
+  size_t k = std::min(sorted.size() - 1, size_t(p / 100 * sorted.size()));
+  std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+  return sorted[k];
+}
+
+inline
+double ClassStats::latency_percentile(const double p) const {
+  return snig::latency_percentile(latency_ms, p);
+}
+
+template <typename P>
+bool RequestScheduler<P>::Urgency::operator () (
+  const std::shared_ptr<Request>& a,
+  const std::shared_ptr<Request>& b
+) const {
+  if(order == RequestOrder::deadline) {
+    if(a->priority != b->priority) {
+      return a->priority < b->priority;
+    }
+    if(a->deadline != b->deadline) {
+      return a->deadline < b->deadline;
+    }
+  }
+  return a->id < b->id;
+}
+
+template <typename P>
+RequestScheduler<P>::RequestScheduler(const SchedulerOptions& options):
+  _options{options},
+  _pending{Urgency{options.order}},
+  _stats(options.num_classes)
+{
+  if(_options.num_classes == 0 || _options.unit_rows == 0 || _options.num_workers == 0) {
+    throw std::runtime_error("scheduler needs at least one class, one row per unit, and one worker");
+  }
+}
+
+template <typename P>
+Admission RequestScheduler<P>::submit(
+  P&& payload,
+  const size_t num_rows,
+  const size_t priority,
+  const clock::time_point deadline,
+  P* rejected
+) {
+  if(priority >= _options.num_classes) {
+    throw std::runtime_error(
+      "priority " + std::to_string(priority) + " of " + std::to_string(_options.num_classes) + " classes"
+    );
+  }
+
+  auto arrival = clock::now();
+  std::unique_lock<std::mutex> lock(_mutex);
+  auto& stats = _stats[priority];
+  ++stats.num_submitted;
+
+  auto refuse = [&](Admission a) {
+    if(rejected) {
+      *rejected = std::move(payload);
+    }
+    return a;
+  };
+
+  if(_closed) {
+    return refuse(Admission::closed);
+  }
+
+  //a request larger than the whole queue is let in alone
+  auto has_room = [&]{
+    return _closed || _pending_rows == 0 || _pending_rows + num_rows <= _options.capacity;
+  };
+  if(!has_room()) {
+    if(_options.policy == AdmissionPolicy::reject) {
+      ++stats.num_rejected_full;
+      return refuse(Admission::rejected_full);
+    }
+    bool has_waited = _not_full.wait_for(lock, _options.block_timeout, has_room);
+    stats.blocked_ms += std::chrono::duration<double, std::milli>(clock::now() - arrival).count();
+    if(_closed) {
+      return refuse(Admission::closed);
+    }
+    if(!has_waited) {
+      ++stats.num_rejected_full;
+      return refuse(Admission::rejected_full);
+    }
+  }
+
+  if(_options.reject_infeasible && !_is_feasible(priority, num_rows, deadline)) {
+    ++stats.num_rejected_deadline;
+    return refuse(Admission::rejected_deadline);
+  }
+
+  auto request = std::make_shared<Request>(
+    Request{_next_id++, priority, num_rows, arrival, deadline, std::move(payload)}
+  );
+  _pending.insert(request);
+  _pending_rows += num_rows;
+  _max_pending_rows = std::max(_max_pending_rows, _pending_rows);
+  ++stats.num_accepted;
+
+  lock.unlock();
+  _not_empty.notify_all();
+  return Admission::accepted;
+}
+
+template <typename P>
+bool RequestScheduler<P>::pop(Unit& unit) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _not_empty.wait(lock, [&]{ return _closed || !_pending.empty(); });
+  if(_pending.empty()) {
+    return false;
+  }
+
+  //the most urgent request stays at the front until all its rows are out
+  auto request = *_pending.begin();
+  unit.request = request;
+  unit.beg = request->next_row;
+  unit.end = std::min(request->num_rows, unit.beg + _options.unit_rows);
+  unit.start = clock::now();
+  request->next_row = unit.end;
+  _pending_rows -= unit.end - unit.beg;
+  if(request->next_row == request->num_rows) {
+    _pending.erase(_pending.begin());
+  }
+
+  lock.unlock();
+  _not_full.notify_all();
+  return true;
+}
+
+template <typename P>
+bool RequestScheduler<P>::complete(const Unit& unit) {
+  auto now = clock::now();
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if(unit.end > unit.beg) {
+    double seconds = std::chrono::duration<double>(now - unit.start).count() / (unit.end - unit.beg);
+    _seconds_per_row = _seconds_per_row == 0 ? seconds : 0.9 * _seconds_per_row + 0.1 * seconds;
+  }
+
+  auto& request = *unit.request;
+  request.finished_rows += unit.end - unit.beg;
+  if(request.finished_rows < request.num_rows) {
+    return false;
+  }
+
+  auto& stats = _stats[request.priority];
+  ++stats.num_completed;
+  stats.latency_ms.push_back(std::chrono::duration<double, std::milli>(now - request.arrival).count());
+  if(now > request.deadline) {
+    ++stats.num_deadline_misses;
+  }
+  return true;
+}
+
+template <typename P>
+void RequestScheduler<P>::close() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+  }
+  _not_empty.notify_all();
+  _not_full.notify_all();
+}
+
+template <typename P>
+size_t RequestScheduler<P>::pending_rows() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _pending_rows;
+}
+
+template <typename P>
+const SchedulerOptions& RequestScheduler<P>::options() const {
+  return _options;
+}
+
+template <typename P>
+std::vector<ClassStats> RequestScheduler<P>::stats() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+template <typename P>
+void RequestScheduler<P>::dump(JSONWriter& json) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  json.begin_object();
+  json.field("order", _options.order == RequestOrder::fifo ? "fifo" : "deadline");
+  json.field("admission", _options.policy == AdmissionPolicy::reject ? "reject" : "block");
+  json.field("capacity", _options.capacity);
+  json.field("unit_rows", _options.unit_rows);
+  json.field("reject_infeasible", _options.reject_infeasible);
+  json.field("max_pending_rows", _max_pending_rows);
+  json.field("ms_per_row", 1000 * _seconds_per_row);
+  json.key("classes").begin_array();
+  for(size_t c = 0; c < _stats.size(); ++c) {
+    const auto& s = _stats[c];
+    json.begin_object();
+    json.field("priority", c);
+    json.field("num_submitted", s.num_submitted);
+    json.field("num_accepted", s.num_accepted);
+    json.field("num_rejected_full", s.num_rejected_full);
+    json.field("num_rejected_deadline", s.num_rejected_deadline);
+    json.field("num_completed", s.num_completed);
+    json.field("num_deadline_misses", s.num_deadline_misses);
+    json.field("blocked_ms", s.blocked_ms);
+    json.field("p50_latency_ms", s.latency_percentile(50));
+    json.field("p99_latency_ms", s.latency_percentile(99));
+    json.field("max_latency_ms", s.latency_percentile(100));
+    json.end_object();
+  }
+  json.end_array();
+  json.end_object();
+}
+
+template <typename P>
+bool RequestScheduler<P>::_is_feasible(
+  const size_t priority,
+  const size_t num_rows,
+  const clock::time_point deadline
+) const {
+  if(deadline == clock::time_point::max() || _seconds_per_row == 0) {
+    return true;
+  }
+
+  //rows served before this request: pending rows of requests at least as urgent
+  size_t rows_ahead{0};
+  for(const auto& r : _pending) {
+    bool is_ahead = _options.order == RequestOrder::fifo ||
+                    r->priority < priority ||
+                    (r->priority == priority && r->deadline <= deadline);
+    if(is_ahead) {
+      rows_ahead += r->num_rows - r->next_row;
+    }
+  }
+  //a unit is the smallest piece the workers hand over
+  double rows = rows_ahead + num_rows;
+  double seconds = _seconds_per_row * std::max(rows / _options.num_workers, double(std::min(num_rows, _options.unit_rows)));
+  return clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds)) <= deadline;
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,326 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <SNIG/utility/affinity.hpp>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include <omp.h>
+
+namespace snig {
+
+// Work done by the CPU kernels for one layer, summed over all batches
+struct LayerCounter {
+  double flops{0};
+
+  //bytes read and written by the kernel (not DRAM traffic)
+  double bytes{0};
+
+  //thread-seconds spent in the layer
+  double seconds{0};
+
+  //weight index and value bytes used by the kernel,
+  //and the cache lines they were spread over
+  double weight_bytes{0};
+  double weight_lines{0};
+
+  LayerCounter& operator += (const LayerCounter& rhs);
+
+  double intensity() const;
+
+  //fraction of every fetched weight cache line the kernel used
+  double line_utilization() const;
+};
+
+constexpr size_t cache_line_size = 64;
+
+// number of cache lines spanned by bytes starting at p
+inline
+size_t cache_lines(const void* p, const size_t bytes);
+
+// Sustained bandwidth and arithmetic throughput of the host
+// measured by STREAM-like kernels
+struct HostCalibration {
+  size_t num_threads{1};
+  size_t array_bytes{0};
+
+  //GB/s of all threads
+  double read_gbps{0};
+  double write_gbps{0};
+  double copy_gbps{0};
+  double triad_gbps{0};
+
+  //GFLOP/s of fused multiply-adds in the engine's data type
+  double peak_gflops_per_core{0};
+  double peak_gflops{0};
+
+  //attainable GFLOP/s at arithmetic intensity (flops per byte)
+  double attainable_gflops(const double intensity) const;
+
+  void dump(JSONWriter& json) const;
+};
+
+// measure the host with num_threads threads on arrays of array_bytes each
+// threads are pinned as pool "omp" if a placement is given,
+// so the roofline matches the placement of the engine
+template <typename T>
+HostCalibration calibrate_host(
+  const size_t num_threads,
+  const size_t array_bytes = (size_t(64) << 20),
+  const size_t num_trials = 5,
+  ThreadPlacement* placement = nullptr
+);
+
+// per-layer and overall achieved versus attainable performance
+// seconds of counters are thread-seconds of num_threads threads
+inline
+void dump_roofline(
+  JSONWriter& json,
+  const HostCalibration& host,
+  const std::vector<LayerCounter>& layers,
+  const size_t num_threads
+);
+
+//-----------------------------------------------------------------------------
+//Definition of LayerCounter and HostCalibration
+//-----------------------------------------------------------------------------
+
+inline
+LayerCounter& LayerCounter::operator += (const LayerCounter& rhs) {
+  flops += rhs.flops;
+  bytes += rhs.bytes;
+  seconds += rhs.seconds;
+  weight_bytes += rhs.weight_bytes;
+  weight_lines += rhs.weight_lines;
+  return *this;
+}
+
+inline
+double LayerCounter::intensity() const {
+  return bytes > 0 ? flops / bytes : 0;
+}
+
+inline
+double LayerCounter::line_utilization() const {
+  return weight_lines > 0 ? weight_bytes / (weight_lines * cache_line_size) : 0;
+}
+
+inline
+size_t cache_lines(const void* p, const size_t bytes) {
+  if(bytes == 0) {
+    return 0;
+  }
+  size_t beg = reinterpret_cast<size_t>(p);
+  return (beg + bytes - 1) / cache_line_size - beg / cache_line_size + 1;
+}
+
+inline
+double HostCalibration::attainable_gflops(const double intensity) const {
+  return std::min(peak_gflops, intensity * triad_gbps);
+}
+
+inline
+void HostCalibration::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("num_threads", num_threads);
+  json.field("array_bytes", array_bytes);
+  json.field("read_gbps", read_gbps);
+  json.field("write_gbps", write_gbps);
+  json.field("copy_gbps", copy_gbps);
+  json.field("triad_gbps", triad_gbps);
+  json.field("peak_gflops_per_core", peak_gflops_per_core);
+  json.field("peak_gflops", peak_gflops);
+  //intensity where the roofline turns from memory to compute bound
+  json.field("ridge_intensity", triad_gbps > 0 ? peak_gflops / triad_gbps : 0);
+  json.end_object();
+}
+
+//-----------------------------------------------------------------------------
+//Definition of calibration function
+//-----------------------------------------------------------------------------
+
+namespace detail {
+
+// best time of num_trials runs of f in seconds
+template <typename F>
+double best_seconds(const size_t num_trials, F&& f) {
+  double best = std::numeric_limits<double>::max();
+  for(size_t t = 0; t < num_trials; ++t) {
+    auto beg = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - beg).count());
+  }
+  return best;
+}
+
+// FMA throughput of the calling thread in flops per second
+// independent accumulators hide the FMA latency
+template <typename T>
+double fma_flops(const size_t num_iterations, T& sink) {
+  constexpr size_t num_acc = 64;
+  alignas(64) T acc[num_acc];
+  for(size_t k = 0; k < num_acc; ++k) {
+    acc[k] = T(k);
+  }
+  const T m = T(0.999999);
+  const T a = T(1e-7);
+  auto beg = std::chrono::steady_clock::now();
+  for(size_t i = 0; i < num_iterations; ++i) {
+    #pragma omp simd aligned(acc : 64)
+    for(size_t k = 0; k < num_acc; ++k) {
+      acc[k] = acc[k] * m + a;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  for(size_t k = 0; k < num_acc; ++k) {
+    sink += acc[k];
+  }
+  return 2.0 * num_acc * num_iterations / std::chrono::duration<double>(end - beg).count();
+}
+
+}// end of namespace detail
+
+template <typename T>
+HostCalibration calibrate_host(
+  const size_t num_threads,
+  const size_t array_bytes,
+  const size_t num_trials,
+  ThreadPlacement* placement
+) {
+  HostCalibration host;
+  host.num_threads = num_threads;
+  host.array_bytes = array_bytes;
+
+  const size_t n = array_bytes / sizeof(T);
+  auto a = std::make_unique<T[]>(n);
+  auto b = std::make_unique<T[]>(n);
+  auto c = std::make_unique<T[]>(n);
+  T* pa = a.get();
+  T* pb = b.get();
+  T* pc = c.get();
+
+  if(placement) {
+    #pragma omp parallel num_threads(num_threads)
+    placement->pin("omp", omp_get_thread_num());
+  }
+
+  //first touch by the threads that use the arrays
+  #pragma omp parallel for num_threads(num_threads) schedule(static)
+  for(size_t i = 0; i < n; ++i) {
+    pa[i] = T(1);
+    pb[i] = T(2);
+    pc[i] = T(0);
+  }
+
+  const double gb = double(n) * sizeof(T) / 1e9;
+  const T s = T(3);
+  T sum{0};
+
+  double t = detail::best_seconds(num_trials, [&](){
+    T local{0};
+    #pragma omp parallel for simd num_threads(num_threads) schedule(static) reduction(+:local)
+    for(size_t i = 0; i < n; ++i) {
+      local += pa[i];
+    }
+    sum += local;
+  });
+  host.read_gbps = gb / t;
+
+  t = detail::best_seconds(num_trials, [&](){
+    #pragma omp parallel for num_threads(num_threads) schedule(static)
+    for(size_t i = 0; i < n; ++i) {
+      pc[i] = s;
+    }
+  });
+  host.write_gbps = gb / t;
+
+  t = detail::best_seconds(num_trials, [&](){
+    #pragma omp parallel for num_threads(num_threads) schedule(static)
+    for(size_t i = 0; i < n; ++i) {
+      pc[i] = pa[i];
+    }
+  });
+  host.copy_gbps = 2 * gb / t;
+
+  t = detail::best_seconds(num_trials, [&](){
+    #pragma omp parallel for num_threads(num_threads) schedule(static)
+    for(size_t i = 0; i < n; ++i) {
+      pa[i] = pb[i] + s * pc[i];
+    }
+  });
+  host.triad_gbps = 3 * gb / t;
+
+  const size_t num_iterations = size_t(1) << 22;
+  host.peak_gflops_per_core = detail::fma_flops<T>(num_iterations, sum) / 1e9;
+
+  double total{0};
+  #pragma omp parallel num_threads(num_threads) reduction(+:total)
+  {
+    T local{0};
+    total += detail::fma_flops<T>(num_iterations, local) / 1e9;
+    #pragma omp critical
+    sum += local;
+  }
+  host.peak_gflops = total;
+
+  //keep the compiler from removing the kernels
+  if(sum == T(-1)) {
+    std::cout << sum;
+  }
+
+  return host;
+}
+
+inline
+void dump_roofline(
+  JSONWriter& json,
+  const HostCalibration& host,
+  const std::vector<LayerCounter>& layers,
+  const size_t num_threads
+) {
+  auto dump_counter = [&](const LayerCounter& c) {
+    //thread-seconds of num_threads threads running side by side
+    double seconds = c.seconds / num_threads;
+    double achieved = seconds > 0 ? c.flops / seconds / 1e9 : 0;
+    double attainable = host.attainable_gflops(c.intensity());
+    json.field("flops", c.flops);
+    json.field("bytes", c.bytes);
+    json.field("seconds", seconds);
+    json.field("intensity", c.intensity());
+    json.field("achieved_gflops", achieved);
+    json.field("attainable_gflops", attainable);
+    json.field("efficiency", attainable > 0 ? achieved / attainable : 0);
+    json.field("weight_bytes", c.weight_bytes);
+    json.field("weight_lines", c.weight_lines);
+    json.field("line_utilization", c.line_utilization());
+    json.field("bound", c.intensity() * host.triad_gbps < host.peak_gflops ? "memory" : "compute");
+  };
+
+  LayerCounter total;
+  for(const auto& l : layers) {
+    total += l;
+  }
+
+  json.begin_object();
+  json.key("host");
+  host.dump(json);
+
+  json.key("overall").begin_object();
+  dump_counter(total);
+  json.end_object();
+
+  json.key("layers").begin_array();
+  for(size_t i = 0; i < layers.size(); ++i) {
+    json.begin_object();
+    json.field("layer", i);
+    dump_counter(layers[i]);
+    json.end_object();
+  }
+  json.end_array();
+  json.end_object();
+}
+
+}// end of namespace snig ----------------------------------------------
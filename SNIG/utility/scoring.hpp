@@ -3,6 +3,7 @@
 #include <Eigen/SparseCore>
 #include <Eigen/Dense>
 #include <SNIG/utility/matrix_format.h>
+#include <SNIG/utility/category_bitset.hpp>
 
 namespace snig {
 
@@ -34,12 +35,25 @@ Eigen::Matrix<int, Eigen::Dynamic, 1> get_score(
   const size_t cols
 );
 
+inline
+size_t num_different_categories(
+  const Eigen::Matrix<int, Eigen::Dynamic, 1>& output,
+  const Eigen::Matrix<int, Eigen::Dynamic, 1>& golden
+);
+
 inline
 bool is_passed(
   const Eigen::Matrix<int, Eigen::Dynamic, 1>& output,
   const Eigen::Matrix<int, Eigen::Dynamic, 1>& golden
 );
 
+// also prints the first inputs whose categories differ
+inline
+bool is_passed(
+  const CategoryBitset& output,
+  const CategoryBitset& golden
+);
+
 
 //-----------------------------------------------------------------------------
 //Definition of scoring function
@@ -113,14 +127,39 @@ Eigen::Matrix<int, Eigen::Dynamic, 1> get_score(
   return score;
 }
 
+inline
+size_t num_different_categories(
+  const Eigen::Matrix<int, Eigen::Dynamic, 1>& output,
+  const Eigen::Matrix<int, Eigen::Dynamic, 1>& golden
+) {
+  return output.rows() - output.cwiseEqual(golden).count();
+}
+
 inline
 bool is_passed(
   const Eigen::Matrix<int, Eigen::Dynamic, 1>& output,
   const Eigen::Matrix<int, Eigen::Dynamic, 1>& golden
 ) {
-  int check = output.rows() - output.cwiseEqual(golden).count();
+  size_t check = num_different_categories(output, golden);
   std::cout << "\nNumber of different categories: " << check << std::endl;
   return (check == 0);
 }
 
+inline
+bool is_passed(
+  const CategoryBitset& output,
+  const CategoryBitset& golden
+) {
+  size_t check = num_different_categories(output, golden);
+  std::cout << "\nNumber of different categories: " << check << std::endl;
+  if(check != 0) {
+    std::cout << "First different inputs:";
+    for(auto i : different_categories(output, golden, 10)) {
+      std::cout << ' ' << i;
+    }
+    std::cout << std::endl;
+  }
+  return (check == 0);
+}
+
 }// end of namespace snig ----------------------------------------------
@@ -0,0 +1,341 @@
+#pragma once
+#include <experimental/filesystem>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <SNIG/utility/reader.hpp>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// boundaries of the output sections of a model
+//
+// Section s holds the neurons [offsets[s], offsets[s + 1]).
+// Equal sections of num_neurons / num_secs neurons are the default;
+// sections balanced by nnz have different widths and are recorded in the
+// model header next to the layer files.
+// Input and output sections of every layer share the boundaries,
+// since the section flags of a layer are the input flags of the next.
+struct SectionLayout {
+  std::vector<int> offsets;
+
+  size_t num_secs() const;
+
+  size_t num_neurons() const;
+
+  size_t size(const size_t s) const;
+
+  //scratch a kernel needs for one section
+  size_t max_size() const;
+
+  bool is_uniform() const;
+
+  //section holding neuron
+  size_t section_of(const size_t neuron) const;
+};
+
+inline
+SectionLayout uniform_sections(const size_t num_neurons, const size_t num_secs);
+
+// contiguous sections of no more than max_sec_size neurons that minimize the
+// largest sum of work per section, work holding one entry per neuron
+inline
+SectionLayout balance_sections(
+  const std::vector<size_t>& work,
+  const size_t num_secs,
+  const size_t max_sec_size
+);
+
+// nnz of every output neuron summed over all packed (.b) layers
+template <typename T>
+std::vector<size_t> count_output_nnz_binary(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers
+);
+
+// rewrites every packed (.b) layer with the sections of layout,
+// the number of sections of a layer file stays num_secs of layout
+template <typename T>
+void repack_binary_sections(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers,
+  const SectionLayout& layout
+);
+
+// model header holding the section boundaries:
+// num_neurons, num_secs (size_t), then num_secs + 1 offsets (int)
+inline
+std::fs::path model_header_path(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons
+);
+
+inline
+void write_model_header(const std::fs::path& path, const SectionLayout& layout);
+
+// sections of the model in weight_dir,
+// equal sections of num_secs if it has no header
+inline
+SectionLayout read_model_header(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_secs
+);
+
+//-----------------------------------------------------------------------------
+//Definition of SectionLayout
+//-----------------------------------------------------------------------------
+
+inline
+size_t SectionLayout::num_secs() const {
+  return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+inline
+size_t SectionLayout::num_neurons() const {
+  return offsets.empty() ? 0 : offsets.back();
+}
+
+inline
+size_t SectionLayout::size(const size_t s) const {
+  return offsets[s + 1] - offsets[s];
+}
+
+inline
+size_t SectionLayout::max_size() const {
+  size_t max_size{0};
+  for(size_t s = 0; s < num_secs(); ++s) {
+    max_size = std::max(max_size, size(s));
+  }
+  return max_size;
+}
+
+inline
+bool SectionLayout::is_uniform() const {
+  for(size_t s = 0; s < num_secs(); ++s) {
+    if(size(s) != size(0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline
+size_t SectionLayout::section_of(const size_t neuron) const {
+  return std::upper_bound(offsets.begin(), offsets.end(), int(neuron)) - offsets.begin() - 1;
+}
+
+//-----------------------------------------------------------------------------
+//Definition of section functions
+//-----------------------------------------------------------------------------
+
+inline
+SectionLayout uniform_sections(const size_t num_neurons, const size_t num_secs) {
+  if(num_secs == 0 || num_neurons % num_secs != 0) {
+    throw std::runtime_error(
+      std::to_string(num_neurons) + " neurons cannot be split into " + std::to_string(num_secs) + " equal sections"
+    );
+  }
+  SectionLayout layout;
+  layout.offsets.resize(num_secs + 1);
+  for(size_t s = 0; s <= num_secs; ++s) {
+    layout.offsets[s] = s * (num_neurons / num_secs);
+  }
+  return layout;
+}
+
+inline
+SectionLayout balance_sections(
+  const std::vector<size_t>& work,
+  const size_t num_secs,
+  const size_t max_sec_size
+) {
+  const size_t num_neurons = work.size();
+  if(num_secs == 0 || num_secs > num_neurons || max_sec_size * num_secs < num_neurons) {
+    throw std::runtime_error(
+      "cannot split " + std::to_string(num_neurons) + " neurons into " + std::to_string(num_secs)
+      + " sections of at most " + std::to_string(max_sec_size)
+    );
+  }
+
+  //greedy cut at the largest bound: the fewest sections of work <= bound
+  auto cut = [&](const size_t bound, std::vector<int>& offsets) {
+    offsets.assign(1, 0);
+    size_t load{0};
+    for(size_t i = 0; i < num_neurons; ++i) {
+      if(work[i] > bound) {
+        return false;
+      }
+      if(load + work[i] > bound || i - offsets.back() == max_sec_size) {
+        offsets.push_back(i);
+        load = 0;
+      }
+      load += work[i];
+    }
+    offsets.push_back(num_neurons);
+    return offsets.size() - 1 <= num_secs;
+  };
+
+  //binary search the smallest feasible bound
+  std::vector<int> offsets;
+  size_t lo = *std::max_element(work.begin(), work.end());
+  size_t hi = std::accumulate(work.begin(), work.end(), size_t(0));
+  while(lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if(cut(mid, offsets)) {
+      hi = mid;
+    }
+    else {
+      lo = mid + 1;
+    }
+  }
+  cut(lo, offsets);
+
+  //fewer sections than asked for: halving the widest keeps both bounds
+  while(offsets.size() - 1 < num_secs) {
+    size_t widest{0};
+    for(size_t s = 1; s + 1 < offsets.size(); ++s) {
+      if(offsets[s + 1] - offsets[s] > offsets[widest + 1] - offsets[widest]) {
+        widest = s;
+      }
+    }
+    offsets.insert(offsets.begin() + widest + 1, (offsets[widest] + offsets[widest + 1]) / 2);
+  }
+
+  SectionLayout layout;
+  layout.offsets = std::move(offsets);
+  return layout;
+}
+
+template <typename T>
+std::vector<size_t> count_output_nnz_binary(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers
+) {
+  std::vector<size_t> nnz_per_neuron(num_neurons, 0);
+  for(size_t i = 0; i < num_layers; ++i) {
+    std::fs::path p = weight_dir;
+    p /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(i + 1) + ".b";
+    auto layer = read_packed_layer_binary<T>(p);
+    for(auto r : layer.row_w) {
+      ++nnz_per_neuron[r];
+    }
+  }
+  return nnz_per_neuron;
+}
+
+template <typename T>
+void repack_binary_sections(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers,
+  const SectionLayout& layout
+) {
+  const size_t num_secs = layout.num_secs();
+
+  for(size_t i = 0; i < num_layers; ++i) {
+    std::fs::path p = weight_dir;
+    p /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(i + 1) + ".b";
+    auto layer = read_packed_layer_binary<T>(p);
+    const auto& col_w = layer.col_w;
+    const auto& row_w = layer.row_w;
+    const auto& val_w = layer.val_w;
+    const size_t rows = layer.rows;
+    const size_t nnz = row_w.size();
+    const size_t old_num_secs = layer.num_secs;
+
+    //entries of an input neuron are ordered by output neuron across the old
+    //sections, so splitting them at the new boundaries keeps that order
+    std::vector<int> new_col_w(rows * num_secs + 1, 0);
+    std::vector<int> new_row_w;
+    std::vector<T> new_val_w;
+    new_row_w.reserve(nnz);
+    new_val_w.reserve(nnz);
+    for(size_t s = 0; s < num_secs; ++s) {
+      for(size_t j = 0; j < rows; ++j) {
+        for(size_t s_old = 0; s_old < old_num_secs; ++s_old) {
+          for(int k = col_w[s_old * rows + j]; k < col_w[s_old * rows + j + 1]; ++k) {
+            if(row_w[k] >= layout.offsets[s] && row_w[k] < layout.offsets[s + 1]) {
+              new_row_w.push_back(row_w[k]);
+              new_val_w.push_back(val_w[k]);
+            }
+          }
+        }
+        new_col_w[s * rows + j + 1] = new_row_w.size();
+      }
+    }
+
+    std::ofstream out(p, std::ios::out | std::ios::binary);
+    out.write((char*)&rows, sizeof(size_t));
+    out.write((char*)&nnz, sizeof(size_t));
+    out.write((char*)new_col_w.data(), sizeof(int) * new_col_w.size());
+    out.write((char*)new_row_w.data(), sizeof(int) * nnz);
+    out.write((char*)new_val_w.data(), sizeof(T) * nnz);
+  }
+}
+
+inline
+std::fs::path model_header_path(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons
+) {
+  return weight_dir / ("n" + std::to_string(num_neurons) + "-sections.b");
+}
+
+inline
+void write_model_header(const std::fs::path& path, const SectionLayout& layout) {
+  std::ofstream out(path, std::ios::out | std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("cannot write " + path.string());
+  }
+  size_t num_neurons = layout.num_neurons();
+  size_t num_secs = layout.num_secs();
+  out.write((char*)&num_neurons, sizeof(size_t));
+  out.write((char*)&num_secs, sizeof(size_t));
+  out.write((char*)layout.offsets.data(), sizeof(int) * (num_secs + 1));
+}
+
+inline
+SectionLayout read_model_header(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_secs
+) {
+  auto path = model_header_path(weight_dir, num_neurons);
+  if(!std::fs::exists(path)) {
+    return uniform_sections(num_neurons, num_secs);
+  }
+
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  size_t header_neurons;
+  size_t header_secs;
+  in.read((char*)&header_neurons, sizeof(size_t));
+  in.read((char*)&header_secs, sizeof(size_t));
+  if(header_neurons != num_neurons || header_secs != num_secs) {
+    throw std::runtime_error(
+      path.string() + " has " + std::to_string(header_secs) + " sections of " + std::to_string(header_neurons)
+      + " neurons, the layers have " + std::to_string(num_secs) + " of " + std::to_string(num_neurons)
+    );
+  }
+
+  SectionLayout layout;
+  layout.offsets.resize(num_secs + 1);
+  in.read((char*)layout.offsets.data(), sizeof(int) * (num_secs + 1));
+  if(!in || layout.offsets.front() != 0 || size_t(layout.offsets.back()) != num_neurons
+     || std::adjacent_find(layout.offsets.begin(), layout.offsets.end(), std::greater_equal<int>()) != layout.offsets.end()) {
+    throw std::runtime_error(path.string() + " is not a valid section header");
+  }
+  return layout;
+}
+
+}// end of namespace snig ----------------------------------------------
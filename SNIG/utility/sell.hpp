@@ -0,0 +1,278 @@
+#pragma once
+#include <experimental/filesystem>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <SNIG/utility/reader.hpp>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// SELL-C-sigma layout of one packed layer
+//
+// Every output section is cut into chunks of C output neurons.
+// Within windows of sigma neurons, neurons are sorted by their number of
+// weights so a chunk holds neurons of similar length,
+// and every chunk is padded to its longest neuron.
+// Weights of a chunk are stored slot-major: slot k of lane c is at
+// chunk_ptr[q] + k * C + c, so one SIMD instruction covers C neurons.
+// Padding slots point at input neuron 0 with value 0.
+//
+// Sorting only permutes neurons inside their section,
+// so every chunk still writes a single output section.
+template <typename T>
+struct SELLLayer {
+  size_t num_neurons{0};
+  size_t num_secs{0};
+  size_t C{0};
+  size_t sigma{0};
+
+  //real weights, without padding
+  size_t nnz{0};
+
+  //num_neurons / C chunks, chunks of section s are contiguous
+  std::vector<int> chunk_ptr;
+  std::vector<int> chunk_len;
+  std::vector<int> chunk_nnz;
+
+  //output neuron of every lane, num_neurons entries
+  std::vector<int> perm;
+
+  //input neuron and value of every slot
+  std::vector<int> col;
+  std::vector<T> val;
+
+  size_t num_chunks() const;
+
+  size_t num_slots() const;
+
+  //padding slots per real weight
+  double padding_overhead() const;
+};
+
+// builds the SELL-C-sigma layout from the packed (.b) arrays of a layer
+// sigma is rounded to a multiple of C and capped at sec_size,
+// 0 sorts whole sections
+template <typename T>
+SELLLayer<T> packed_to_sell(
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const size_t C,
+  const size_t sigma
+);
+
+inline
+std::fs::path sell_layer_path(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t layer
+);
+
+template <typename T>
+void write_sell_binary(const std::fs::path& path, const SELLLayer<T>& layer);
+
+template <typename T>
+SELLLayer<T> read_sell_binary(const std::fs::path& path);
+
+// writes n{num_neurons}-l{i}.sell next to every packed n{num_neurons}-l{i}.b
+template <typename T>
+void packed_binary_to_sell_file(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers,
+  const size_t C,
+  const size_t sigma
+);
+
+//-----------------------------------------------------------------------------
+//Definition of SELLLayer
+//-----------------------------------------------------------------------------
+
+template <typename T>
+size_t SELLLayer<T>::num_chunks() const {
+  return chunk_len.size();
+}
+
+template <typename T>
+size_t SELLLayer<T>::num_slots() const {
+  return col.size();
+}
+
+template <typename T>
+double SELLLayer<T>::padding_overhead() const {
+  return nnz > 0 ? double(num_slots() - nnz) / nnz : 0;
+}
+
+template <typename T>
+SELLLayer<T> packed_to_sell(
+  const int* col_w,
+  const int* row_w,
+  const T* val_w,
+  const size_t num_neurons,
+  const size_t num_secs,
+  const size_t C,
+  const size_t sigma
+) {
+  const size_t sec_size = num_neurons / num_secs;
+  if(C == 0 || sec_size % C != 0) {
+    throw std::runtime_error(
+      "SELL chunk size " + std::to_string(C) + " must divide the section size " + std::to_string(sec_size)
+    );
+  }
+  const size_t window = sigma == 0 ? sec_size : std::min(sec_size, std::max(C, sigma / C * C));
+
+  SELLLayer<T> layer;
+  layer.num_neurons = num_neurons;
+  layer.num_secs = num_secs;
+  layer.C = C;
+  layer.sigma = window;
+  layer.nnz = col_w[num_neurons * num_secs];
+
+  //transpose to one list of (input neuron, value) per output neuron,
+  //in ascending input order as the packed kernel accumulates them
+  std::vector<std::vector<std::pair<int, T> > > rows(num_neurons);
+  for(size_t s = 0; s < num_secs; ++s) {
+    for(size_t j = 0; j < num_neurons; ++j) {
+      for(int k = col_w[s * num_neurons + j]; k < col_w[s * num_neurons + j + 1]; ++k) {
+        rows[row_w[k]].emplace_back(int(j), val_w[k]);
+      }
+    }
+  }
+
+  layer.perm.resize(num_neurons);
+  std::iota(layer.perm.begin(), layer.perm.end(), 0);
+  for(size_t s = 0; s < num_secs; ++s) {
+    const size_t sec_end = (s + 1) * sec_size;
+    for(size_t beg = s * sec_size; beg < sec_end; beg += window) {
+      std::stable_sort(
+        layer.perm.begin() + beg,
+        layer.perm.begin() + std::min(beg + window, sec_end),
+        [&](int a, int b){ return rows[a].size() > rows[b].size(); }
+      );
+    }
+  }
+
+  layer.chunk_ptr.push_back(0);
+  for(size_t beg = 0; beg < num_neurons; beg += C) {
+    size_t len{0};
+    size_t chunk_nnz{0};
+    for(size_t c = 0; c < C; ++c) {
+      len = std::max(len, rows[layer.perm[beg + c]].size());
+      chunk_nnz += rows[layer.perm[beg + c]].size();
+    }
+    for(size_t k = 0; k < len; ++k) {
+      for(size_t c = 0; c < C; ++c) {
+        const auto& r = rows[layer.perm[beg + c]];
+        layer.col.push_back(k < r.size() ? r[k].first : 0);
+        layer.val.push_back(k < r.size() ? r[k].second : T(0));
+      }
+    }
+    layer.chunk_len.push_back(len);
+    layer.chunk_nnz.push_back(chunk_nnz);
+    layer.chunk_ptr.push_back(layer.col.size());
+  }
+
+  return layer;
+}
+
+inline
+std::fs::path sell_layer_path(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t layer
+) {
+  std::fs::path p = weight_dir;
+  p /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(layer + 1) + ".sell";
+  return p;
+}
+
+template <typename T>
+void write_sell_binary(const std::fs::path& path, const SELLLayer<T>& layer) {
+  std::ofstream out(path, std::ios::out | std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("cannot write " + path.string());
+  }
+
+  size_t header[6] = {
+    layer.num_neurons, layer.num_secs, layer.C, layer.sigma, layer.nnz, layer.num_slots()
+  };
+  out.write((char*)header, sizeof(header));
+  out.write((char*)layer.chunk_ptr.data(), sizeof(int) * layer.chunk_ptr.size());
+  out.write((char*)layer.chunk_len.data(), sizeof(int) * layer.chunk_len.size());
+  out.write((char*)layer.chunk_nnz.data(), sizeof(int) * layer.chunk_nnz.size());
+  out.write((char*)layer.perm.data(), sizeof(int) * layer.perm.size());
+  out.write((char*)layer.col.data(), sizeof(int) * layer.col.size());
+  out.write((char*)layer.val.data(), sizeof(T) * layer.val.size());
+}
+
+template <typename T>
+SELLLayer<T> read_sell_binary(const std::fs::path& path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + path.string() + ", convert the model with --sell_c first");
+  }
+
+  size_t header[6];
+  in.read((char*)header, sizeof(header));
+
+  SELLLayer<T> layer;
+  layer.num_neurons = header[0];
+  layer.num_secs = header[1];
+  layer.C = header[2];
+  layer.sigma = header[3];
+  layer.nnz = header[4];
+  const size_t num_slots = header[5];
+  const size_t num_chunks = layer.num_neurons / layer.C;
+
+  layer.chunk_ptr.resize(num_chunks + 1);
+  layer.chunk_len.resize(num_chunks);
+  layer.chunk_nnz.resize(num_chunks);
+  layer.perm.resize(layer.num_neurons);
+  layer.col.resize(num_slots);
+  layer.val.resize(num_slots);
+  in.read((char*)layer.chunk_ptr.data(), sizeof(int) * layer.chunk_ptr.size());
+  in.read((char*)layer.chunk_len.data(), sizeof(int) * layer.chunk_len.size());
+  in.read((char*)layer.chunk_nnz.data(), sizeof(int) * layer.chunk_nnz.size());
+  in.read((char*)layer.perm.data(), sizeof(int) * layer.perm.size());
+  in.read((char*)layer.col.data(), sizeof(int) * layer.col.size());
+  in.read((char*)layer.val.data(), sizeof(T) * layer.val.size());
+  if(!in) {
+    throw std::runtime_error(path.string() + " is truncated");
+  }
+
+  return layer;
+}
+
+template <typename T>
+void packed_binary_to_sell_file(
+  const std::fs::path& weight_dir,
+  const size_t num_neurons,
+  const size_t num_layers,
+  const size_t C,
+  const size_t sigma
+) {
+  for(size_t i = 0; i < num_layers; ++i) {
+    std::fs::path p = weight_dir;
+    p /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(i + 1) + ".b";
+    auto layer = read_packed_layer_binary<T>(p);
+
+    write_sell_binary(
+      sell_layer_path(weight_dir, num_neurons, i),
+      packed_to_sell(
+        layer.col_w.data(), layer.row_w.data(), layer.val_w.data(),
+        layer.rows, layer.num_secs, C, sigma
+      )
+    );
+  }
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -0,0 +1,830 @@
+#pragma once
+#include <SNIG/utility/json.hpp>
+#include <SNIG/utility/roofline.hpp>
+#include <experimental/filesystem>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Discrete-event simulation of the multi-device schedules
+//
+// The task graphs of SNIG, GPipe, and BF are rebuilt with the same tasks and
+// dependencies as the engines (weight copies, kernels, input fetches,
+// handovers, and barriers), each task run by the compute engine or the copy
+// engine of a device. Kernel times come from per-row layer costs, measured by
+// SNIG_CPU or given as a table, and copy times from link bandwidths,
+// so scaling curves can be drawn on hosts without the devices.
+
+enum class SimulatedSchedule {
+  snig,
+  gpipe,
+  bf
+};
+
+inline
+std::string to_string(const SimulatedSchedule schedule);
+
+inline
+SimulatedSchedule to_simulated_schedule(const std::string& name);
+
+// seconds one input row spends in each layer on one device
+struct LayerCosts {
+  std::vector<double> seconds_per_row;
+
+  size_t num_layers() const;
+};
+
+// per-row costs of a run of SNIG_CPU: thread-seconds of a layer over the inputs
+inline
+LayerCosts layer_costs(const std::vector<LayerCounter>& counters, const size_t num_inputs);
+
+// text table of one line per layer: <layer> <seconds per row>
+// lines starting with # are comments
+inline
+LayerCosts read_layer_costs(const std::fs::path& path);
+
+inline
+void write_layer_costs(const std::fs::path& path, const LayerCosts& costs);
+
+// links between the host and the devices and between devices
+// a bandwidth of 0 makes the transfers on that link free
+struct TransferModel {
+  //GB/s of the link of each device to the host
+  double host_gbps{12};
+
+  //GB/s between neighbouring devices
+  double peer_gbps{25};
+
+  //fixed cost of every transfer
+  double transfer_us{10};
+
+  //fixed cost of every kernel launch
+  double launch_us{5};
+
+  double host_seconds(const size_t bytes) const;
+
+  double peer_seconds(const size_t bytes) const;
+
+  void dump(JSONWriter& json) const;
+};
+
+struct SimulationConfig {
+  SimulatedSchedule schedule{SimulatedSchedule::snig};
+  size_t num_devices{1};
+  size_t num_inputs{60000};
+  size_t batch_size{5000};
+
+  //weight buffers of a SNIG device, the depth of its copy prefetch
+  size_t num_weight_buffers{2};
+
+  //bytes of one padded layer, the unit of every weight copy
+  size_t layer_bytes{0};
+
+  //bytes of the activations of one input row
+  size_t row_bytes{0};
+
+  //how much faster a device runs a layer than the cost table says,
+  //e.g. a GPU over the one CPU thread that measured the costs
+  double device_speedup{1};
+
+  void dump(JSONWriter& json) const;
+};
+
+// what one device did over the simulated run
+//
+// Compute idle time is split into fill (before the first kernel),
+// bubbles (between the first and the last kernel), and drain (after the last
+// kernel, waiting for the slowest device).
+struct DeviceTimeline {
+  std::string name;
+  size_t num_batches{0};
+  size_t num_kernels{0};
+  size_t num_copies{0};
+
+  double compute_seconds{0};
+  double copy_seconds{0};
+
+  double first_kernel{0};
+  double last_kernel_end{0};
+
+  double fill_seconds() const;
+
+  double bubble_seconds() const;
+
+  double drain_seconds(const double makespan) const;
+
+  double utilization(const double makespan) const;
+};
+
+struct SimulationResult {
+  double makespan{0};
+  size_t num_tasks{0};
+  size_t num_events{0};
+  std::vector<DeviceTimeline> devices;
+
+  double average_utilization() const;
+
+  double inputs_per_second(const size_t num_inputs) const;
+
+  void dump(JSONWriter& json) const;
+};
+
+// Discrete-event engine of task graphs on serial resources
+//
+// A task becomes ready when its predecessors finish and runs on its resource
+// in the order tasks became ready (ties by task id). Tasks without a resource
+// (barriers, host bookkeeping) run as soon as they are ready.
+// A callback of a finishing task may add tasks and edges, which is how
+// the dynamic fetch of SNIG grows the graph.
+class EventSimulator {
+
+  public:
+
+    static constexpr size_t no_resource = std::numeric_limits<size_t>::max();
+
+    static constexpr size_t no_task = std::numeric_limits<size_t>::max();
+
+    struct Task {
+      size_t resource{no_resource};
+      double seconds{0};
+      double start{0};
+      double finish{0};
+      size_t num_pending{0};
+      bool is_released{false};
+      bool is_finished{false};
+      std::vector<size_t> successors;
+      std::function<void()> on_finish;
+    };
+
+    size_t add_resource(const std::string& name);
+
+    size_t add_task(const size_t resource, const double seconds);
+
+    void precede(const size_t before, const size_t after);
+
+    void on_finish(const size_t task, std::function<void()> callback);
+
+    //runs to completion and returns the makespan
+    double run();
+
+    double now() const;
+
+    size_t num_events() const;
+
+    const Task& task(const size_t task) const;
+
+    size_t num_tasks() const;
+
+    const std::string& resource_name(const size_t resource) const;
+
+  private:
+
+    struct Resource {
+      std::string name;
+      bool is_busy{false};
+
+      //(ready time, task) of the waiting tasks, earliest first
+      std::priority_queue<
+        std::pair<double, size_t>,
+        std::vector<std::pair<double, size_t> >,
+        std::greater<std::pair<double, size_t> >
+      > queue;
+    };
+
+    std::vector<Task> _tasks;
+    std::vector<Resource> _resources;
+
+    //(finish time, task) of the running tasks, earliest first
+    std::priority_queue<
+      std::pair<double, size_t>,
+      std::vector<std::pair<double, size_t> >,
+      std::greater<std::pair<double, size_t> >
+    > _events;
+
+    //tasks added since the last release scan
+    size_t _num_scanned{0};
+
+    double _now{0};
+    size_t _num_events{0};
+
+    void _release(const size_t task);
+
+    void _start(const size_t task);
+
+    void _dispatch(const size_t resource);
+
+    void _release_new_tasks();
+};
+
+inline
+SimulationResult simulate_schedule(
+  const SimulationConfig& config,
+  const LayerCosts& costs,
+  const TransferModel& transfer
+);
+
+// ----------------------------------------------------------------------------
+// Definition of SimulatedSchedule
+// ----------------------------------------------------------------------------
+
+inline
+std::string to_string(const SimulatedSchedule schedule) {
+  switch(schedule) {
+    case SimulatedSchedule::snig:  return "snig";
+    case SimulatedSchedule::gpipe: return "gpipe";
+    case SimulatedSchedule::bf:    return "bf";
+  }
+  return "unknown";
+}
+
+inline
+SimulatedSchedule to_simulated_schedule(const std::string& name) {
+  if(name == "snig" || name == "SNIG") {
+    return SimulatedSchedule::snig;
+  }
+  if(name == "gpipe" || name == "GPipe") {
+    return SimulatedSchedule::gpipe;
+  }
+  if(name == "bf" || name == "BF") {
+    return SimulatedSchedule::bf;
+  }
+  throw std::runtime_error("unknown schedule " + name + " (snig, gpipe, or bf)");
+}
+
+// ----------------------------------------------------------------------------
+// Definition of LayerCosts
+// ----------------------------------------------------------------------------
+
+inline
+size_t LayerCosts::num_layers() const {
+  return seconds_per_row.size();
+}
+
+inline
+LayerCosts layer_costs(const std::vector<LayerCounter>& counters, const size_t num_inputs) {
+  LayerCosts costs;
+  for(const auto& c : counters) {
+    costs.seconds_per_row.push_back(num_inputs == 0 ? 0.0 : c.seconds / num_inputs);
+  }
+  return costs;
+}
+
+inline
+LayerCosts read_layer_costs(const std::fs::path& path) {
+  std::ifstream in(path);
+  if(!in) {
+    throw std::runtime_error("cannot open " + path.string());
+  }
+  LayerCosts costs;
+  std::string line;
+  while(std::getline(in, line)) {
+    if(line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream iss(line);
+    size_t layer;
+    double seconds;
+    if(!(iss >> layer >> seconds) || layer != costs.num_layers() || seconds < 0) {
+      throw std::runtime_error(
+        path.string() + ": expected \"" + std::to_string(costs.num_layers()) + " <seconds per row>\", got \"" + line + "\""
+      );
+    }
+    costs.seconds_per_row.push_back(seconds);
+  }
+  return costs;
+}
+
+inline
+void write_layer_costs(const std::fs::path& path, const LayerCosts& costs) {
+  std::ofstream out(path);
+  if(!out) {
+    throw std::runtime_error("cannot write " + path.string());
+  }
+  out << "# layer seconds_per_row\n";
+  out.precision(9);
+  for(size_t l = 0; l < costs.num_layers(); ++l) {
+    out << l << ' ' << costs.seconds_per_row[l] << '\n';
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Definition of TransferModel
+// ----------------------------------------------------------------------------
+
+inline
+double TransferModel::host_seconds(const size_t bytes) const {
+  return host_gbps <= 0 ? 0.0 : transfer_us * 1e-6 + bytes / (host_gbps * 1e9);
+}
+
+inline
+double TransferModel::peer_seconds(const size_t bytes) const {
+  return peer_gbps <= 0 ? 0.0 : transfer_us * 1e-6 + bytes / (peer_gbps * 1e9);
+}
+
+inline
+void TransferModel::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("host_gbps", host_gbps);
+  json.field("peer_gbps", peer_gbps);
+  json.field("transfer_us", transfer_us);
+  json.field("launch_us", launch_us);
+  json.end_object();
+}
+
+// ----------------------------------------------------------------------------
+// Definition of SimulationConfig
+// ----------------------------------------------------------------------------
+
+inline
+void SimulationConfig::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("schedule", to_string(schedule));
+  json.field("num_devices", num_devices);
+  json.field("num_inputs", num_inputs);
+  json.field("batch_size", batch_size);
+  json.field("num_weight_buffers", num_weight_buffers);
+  json.field("layer_bytes", layer_bytes);
+  json.field("row_bytes", row_bytes);
+  json.field("device_speedup", device_speedup);
+  json.end_object();
+}
+
+// ----------------------------------------------------------------------------
+// Definition of DeviceTimeline
+// ----------------------------------------------------------------------------
+
+inline
+double DeviceTimeline::fill_seconds() const {
+  return first_kernel;
+}
+
+inline
+double DeviceTimeline::bubble_seconds() const {
+  //back-to-back kernels leave rounding error, not bubbles
+  double bubble = last_kernel_end - first_kernel - compute_seconds;
+  return num_kernels == 0 || bubble < 1e-9 * last_kernel_end ? 0.0 : bubble;
+}
+
+inline
+double DeviceTimeline::drain_seconds(const double makespan) const {
+  return num_kernels == 0 ? makespan : makespan - last_kernel_end;
+}
+
+inline
+double DeviceTimeline::utilization(const double makespan) const {
+  return makespan <= 0 ? 0.0 : compute_seconds / makespan;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of SimulationResult
+// ----------------------------------------------------------------------------
+
+inline
+double SimulationResult::average_utilization() const {
+  double sum{0};
+  for(const auto& d : devices) {
+    sum += d.utilization(makespan);
+  }
+  return devices.empty() ? 0.0 : sum / devices.size();
+}
+
+inline
+double SimulationResult::inputs_per_second(const size_t num_inputs) const {
+  return makespan <= 0 ? 0.0 : num_inputs / makespan;
+}
+
+inline
+void SimulationResult::dump(JSONWriter& json) const {
+  json.begin_object();
+  json.field("makespan_ms", makespan * 1000);
+  json.field("average_utilization", average_utilization());
+  json.field("num_tasks", num_tasks);
+  json.field("num_events", num_events);
+  json.key("devices").begin_array();
+  for(const auto& d : devices) {
+    json.begin_object();
+    json.field("name", d.name);
+    json.field("num_batches", d.num_batches);
+    json.field("num_kernels", d.num_kernels);
+    json.field("num_copies", d.num_copies);
+    json.field("compute_ms", d.compute_seconds * 1000);
+    json.field("copy_ms", d.copy_seconds * 1000);
+    json.field("fill_ms", d.fill_seconds() * 1000);
+    json.field("bubble_ms", d.bubble_seconds() * 1000);
+    json.field("drain_ms", d.drain_seconds(makespan) * 1000);
+    json.field("utilization", d.utilization(makespan));
+    json.end_object();
+  }
+  json.end_array();
+  json.end_object();
+}
+
+// ----------------------------------------------------------------------------
+// Definition of EventSimulator
+// ----------------------------------------------------------------------------
+
+inline
+size_t EventSimulator::add_resource(const std::string& name) {
+  _resources.emplace_back();
+  _resources.back().name = name;
+  return _resources.size() - 1;
+}
+
+inline
+size_t EventSimulator::add_task(const size_t resource, const double seconds) {
+  _tasks.emplace_back();
+  _tasks.back().resource = resource;
+  _tasks.back().seconds = seconds;
+  return _tasks.size() - 1;
+}
+
+inline
+void EventSimulator::precede(const size_t before, const size_t after) {
+  if(_tasks[after].is_released) {
+    throw std::runtime_error("cannot add a predecessor to a released task");
+  }
+  _tasks[before].successors.push_back(after);
+  //an edge from a finished task is already satisfied
+  if(!_tasks[before].is_finished) {
+    ++_tasks[after].num_pending;
+  }
+}
+
+inline
+void EventSimulator::on_finish(const size_t task, std::function<void()> callback) {
+  _tasks[task].on_finish = std::move(callback);
+}
+
+inline
+double EventSimulator::run() {
+  _release_new_tasks();
+
+  double makespan{0};
+  while(!_events.empty()) {
+    auto event = _events.top();
+    _events.pop();
+    ++_num_events;
+    _now = event.first;
+
+    auto& t = _tasks[event.second];
+    t.is_finished = true;
+    makespan = std::max(makespan, _now);
+    if(t.resource != no_resource) {
+      _resources[t.resource].is_busy = false;
+    }
+
+    for(auto s : t.successors) {
+      if(--_tasks[s].num_pending == 0) {
+        _release(s);
+      }
+    }
+    if(t.on_finish) {
+      //may add tasks, which invalidates t
+      auto callback = std::move(t.on_finish);
+      callback();
+    }
+    _release_new_tasks();
+
+    if(_tasks[event.second].resource != no_resource) {
+      _dispatch(_tasks[event.second].resource);
+    }
+  }
+
+  for(const auto& t : _tasks) {
+    if(!t.is_finished) {
+      throw std::runtime_error("task graph has a cycle or a task waits on a task that never runs");
+    }
+  }
+  return makespan;
+}
+
+inline
+double EventSimulator::now() const {
+  return _now;
+}
+
+inline
+size_t EventSimulator::num_events() const {
+  return _num_events;
+}
+
+inline
+const EventSimulator::Task& EventSimulator::task(const size_t task) const {
+  return _tasks[task];
+}
+
+inline
+size_t EventSimulator::num_tasks() const {
+  return _tasks.size();
+}
+
+inline
+const std::string& EventSimulator::resource_name(const size_t resource) const {
+  return _resources[resource].name;
+}
+
+inline
+void EventSimulator::_release(const size_t task) {
+  auto& t = _tasks[task];
+  t.is_released = true;
+  if(t.resource == no_resource) {
+    _start(task);
+    return;
+  }
+  _resources[t.resource].queue.emplace(_now, task);
+  _dispatch(t.resource);
+}
+
+inline
+void EventSimulator::_start(const size_t task) {
+  auto& t = _tasks[task];
+  t.start = _now;
+  t.finish = _now + t.seconds;
+  _events.emplace(t.finish, task);
+}
+
+inline
+void EventSimulator::_dispatch(const size_t resource) {
+  auto& r = _resources[resource];
+  if(r.is_busy || r.queue.empty()) {
+    return;
+  }
+  r.is_busy = true;
+  size_t task = r.queue.top().second;
+  r.queue.pop();
+  _start(task);
+}
+
+inline
+void EventSimulator::_release_new_tasks() {
+  for(; _num_scanned < _tasks.size(); ++_num_scanned) {
+    if(_tasks[_num_scanned].num_pending == 0 && !_tasks[_num_scanned].is_released) {
+      _release(_num_scanned);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Definition of simulate_schedule
+// ----------------------------------------------------------------------------
+
+namespace detail {
+
+// compute and copy engine of every device, and what kind each task is
+struct SimulatedDevices {
+  EventSimulator sim;
+  std::vector<size_t> compute;
+  std::vector<size_t> copy;
+  std::vector<size_t> num_batches;
+
+  SimulatedDevices(const size_t num_devices) : num_batches(num_devices, 0) {
+    for(size_t dev = 0; dev < num_devices; ++dev) {
+      compute.push_back(sim.add_resource("gpu" + std::to_string(dev)));
+      copy.push_back(sim.add_resource("gpu" + std::to_string(dev) + ".copy"));
+    }
+  }
+
+  SimulationResult result() const {
+    SimulationResult result;
+    result.num_tasks = sim.num_tasks();
+    result.num_events = sim.num_events();
+    result.devices.resize(compute.size());
+    for(size_t dev = 0; dev < compute.size(); ++dev) {
+      result.devices[dev].name = sim.resource_name(compute[dev]);
+      result.devices[dev].num_batches = num_batches[dev];
+      result.devices[dev].first_kernel = std::numeric_limits<double>::max();
+    }
+    for(size_t i = 0; i < sim.num_tasks(); ++i) {
+      const auto& t = sim.task(i);
+      result.makespan = std::max(result.makespan, t.finish);
+      if(t.resource == EventSimulator::no_resource) {
+        continue;
+      }
+      //resources alternate compute and copy of each device
+      auto& d = result.devices[t.resource / 2];
+      if(t.resource % 2 == 0) {
+        ++d.num_kernels;
+        d.compute_seconds += t.seconds;
+        d.first_kernel = std::min(d.first_kernel, t.start);
+        d.last_kernel_end = std::max(d.last_kernel_end, t.finish);
+      }
+      else {
+        ++d.num_copies;
+        d.copy_seconds += t.seconds;
+      }
+    }
+    for(auto& d : result.devices) {
+      if(d.num_kernels == 0) {
+        d.first_kernel = 0;
+      }
+    }
+    return result;
+  }
+};
+
+// SNIG: a device fetches the next batch as soon as it is free and streams
+// every layer through num_weight_buffers buffers:
+// copy l precedes kernel l, kernel l precedes copy l + num_weight_buffers
+inline
+SimulationResult simulate_snig(
+  const SimulationConfig& config,
+  const LayerCosts& costs,
+  const TransferModel& transfer
+) {
+  const size_t num_layers = costs.num_layers();
+  const size_t num_buffers = std::max<size_t>(1, config.num_weight_buffers);
+  SimulatedDevices devs(config.num_devices);
+  size_t finished_inputs{0};
+
+  std::function<void(size_t)> fetch = [&](const size_t dev) {
+    if(finished_inputs >= config.num_inputs) {
+      return;
+    }
+    size_t num_rows = std::min(config.batch_size, config.num_inputs - finished_inputs);
+    finished_inputs += config.batch_size;
+    ++devs.num_batches[dev];
+
+    auto& sim = devs.sim;
+    size_t input = sim.add_task(devs.copy[dev], transfer.host_seconds(num_rows * config.row_bytes));
+
+    std::vector<size_t> copies(num_layers);
+    std::vector<size_t> kernels(num_layers);
+    for(size_t l = 0; l < num_layers; ++l) {
+      copies[l] = sim.add_task(devs.copy[dev], transfer.host_seconds(config.layer_bytes));
+      kernels[l] = sim.add_task(
+        devs.compute[dev],
+        transfer.launch_us * 1e-6 + num_rows * costs.seconds_per_row[l] / config.device_speedup
+      );
+      sim.precede(copies[l], kernels[l]);
+      if(l >= num_buffers) {
+        sim.precede(kernels[l - num_buffers], copies[l]);
+      }
+      if(l == 0) {
+        sim.precede(input, kernels[l]);
+      }
+      else {
+        sim.precede(kernels[l - 1], kernels[l]);
+      }
+    }
+
+    //identify, then the fetch task of the device
+    size_t ident = sim.add_task(devs.compute[dev], transfer.launch_us * 1e-6);
+    sim.precede(num_layers == 0 ? input : kernels[num_layers - 1], ident);
+    sim.on_finish(ident, [&fetch, dev](){ fetch(dev); });
+  };
+
+  for(size_t dev = 0; dev < config.num_devices; ++dev) {
+    fetch(dev);
+  }
+  devs.sim.run();
+  return devs.result();
+}
+
+// GPipe: device d keeps layers [d * L / D, (d + 1) * L / D) resident and
+// runs one batch at a time through them, then hands the batch to device d + 1
+inline
+SimulationResult simulate_gpipe(
+  const SimulationConfig& config,
+  const LayerCosts& costs,
+  const TransferModel& transfer
+) {
+  const size_t num_devices = config.num_devices;
+  const size_t num_layers_per_gpu = costs.num_layers() / num_devices;
+  const size_t num_batches = config.num_inputs / config.batch_size;
+  SimulatedDevices devs(num_devices);
+  auto& sim = devs.sim;
+
+  std::vector<size_t> weights(num_devices);
+  for(size_t dev = 0; dev < num_devices; ++dev) {
+    weights[dev] = sim.add_task(devs.copy[dev], transfer.host_seconds(config.layer_bytes * num_layers_per_gpu));
+    devs.num_batches[dev] = num_batches;
+  }
+
+  //last kernel of the previous batch on every device
+  std::vector<size_t> last(num_devices, size_t(EventSimulator::no_task));
+  for(size_t b = 0; b < num_batches; ++b) {
+    size_t handover{EventSimulator::no_task};
+    for(size_t dev = 0; dev < num_devices; ++dev) {
+      //the first device pulls the batch from the host, the others from their neighbour
+      size_t input = dev == 0
+        ? sim.add_task(devs.copy[dev], transfer.host_seconds(config.batch_size * config.row_bytes))
+        : sim.add_task(devs.copy[dev], transfer.peer_seconds(config.batch_size * config.row_bytes));
+      if(dev != 0) {
+        sim.precede(handover, input);
+      }
+
+      size_t prev = input;
+      for(size_t l = dev * num_layers_per_gpu; l < (dev + 1) * num_layers_per_gpu; ++l) {
+        size_t kernel = sim.add_task(
+          devs.compute[dev],
+          transfer.launch_us * 1e-6 + config.batch_size * costs.seconds_per_row[l] / config.device_speedup
+        );
+        sim.precede(prev, kernel);
+        if(prev == input) {
+          sim.precede(weights[dev], kernel);
+          //a device runs its layers of one batch before taking the next
+          if(last[dev] != EventSimulator::no_task) {
+            sim.precede(last[dev], kernel);
+          }
+        }
+        prev = kernel;
+      }
+      if(dev == num_devices - 1) {
+        size_t ident = sim.add_task(devs.compute[dev], transfer.launch_us * 1e-6);
+        sim.precede(prev, ident);
+        prev = ident;
+      }
+      last[dev] = prev;
+      handover = prev;
+    }
+  }
+  sim.run();
+  return devs.result();
+}
+
+// BF: device d owns a fixed share of the inputs and runs all of them through
+// every layer, copying the next layer meanwhile; all devices meet at a barrier
+// after every layer
+inline
+SimulationResult simulate_bf(
+  const SimulationConfig& config,
+  const LayerCosts& costs,
+  const TransferModel& transfer
+) {
+  const size_t num_devices = config.num_devices;
+  const size_t num_layers = costs.num_layers();
+  SimulatedDevices devs(num_devices);
+  auto& sim = devs.sim;
+
+  //the last device takes the remainder
+  std::vector<size_t> num_rows(num_devices, config.num_inputs / num_devices);
+  num_rows[num_devices - 1] += config.num_inputs % num_devices;
+
+  size_t barrier = sim.add_task(EventSimulator::no_resource, 0);
+  for(size_t l = 0; l < num_layers; ++l) {
+    size_t next_barrier = sim.add_task(EventSimulator::no_resource, 0);
+    for(size_t dev = 0; dev < num_devices; ++dev) {
+      if(l + 1 < num_layers) {
+        size_t copy = sim.add_task(devs.copy[dev], transfer.host_seconds(config.layer_bytes));
+        sim.precede(barrier, copy);
+        sim.precede(copy, next_barrier);
+      }
+      size_t kernel = sim.add_task(
+        devs.compute[dev],
+        transfer.launch_us * 1e-6 + num_rows[dev] * costs.seconds_per_row[l] / config.device_speedup
+      );
+      sim.precede(barrier, kernel);
+      sim.precede(kernel, next_barrier);
+    }
+    barrier = next_barrier;
+  }
+  for(size_t dev = 0; dev < num_devices; ++dev) {
+    size_t ident = sim.add_task(devs.compute[dev], transfer.launch_us * 1e-6);
+    sim.precede(barrier, ident);
+    devs.num_batches[dev] = 1;
+  }
+  sim.run();
+  return devs.result();
+}
+
+}// end of namespace detail ----------------------------------------------
+
+inline
+SimulationResult simulate_schedule(
+  const SimulationConfig& config,
+  const LayerCosts& costs,
+  const TransferModel& transfer
+) {
+  if(config.num_devices == 0 || config.batch_size == 0 || config.device_speedup <= 0) {
+    throw std::runtime_error("simulation needs at least one device, a batch size, and a positive device speedup");
+  }
+  switch(config.schedule) {
+    case SimulatedSchedule::snig:
+      return detail::simulate_snig(config, costs, transfer);
+    case SimulatedSchedule::gpipe:
+      if(costs.num_layers() % config.num_devices != 0) {
+        throw std::runtime_error(
+          "GPipe splits " + std::to_string(costs.num_layers()) + " layers evenly, not over "
+          + std::to_string(config.num_devices) + " devices"
+        );
+      }
+      return detail::simulate_gpipe(config, costs, transfer);
+    case SimulatedSchedule::bf:
+      return detail::simulate_bf(config, costs, transfer);
+  }
+  throw std::runtime_error("unknown schedule");
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -8,12 +8,15 @@
 #include <vector>
 #include <queue>
 
+#include <SNIG/utility/affinity.hpp>
+
 class ThreadPool {
 
 
   public:
 
-    ThreadPool(size_t num_workers);
+    //workers are pinned as pool "thread_pool" if a placement is given
+    ThreadPool(size_t num_workers, snig::ThreadPlacement* placement = nullptr);
     ~ThreadPool();
 
     // study universal/forwarding reference
@@ -31,13 +34,16 @@ class ThreadPool {
 };
 
 inline
-ThreadPool::ThreadPool(size_t num_workers)
+ThreadPool::ThreadPool(size_t num_workers, snig::ThreadPlacement* placement)
 : _stop(false)
 {
   _workers.reserve(num_workers);
   for(size_t i=0; i<num_workers; ++i){
     _workers.emplace_back(
-        [this] {
+        [this, i, placement] {
+          if(placement){
+            placement->pin("thread_pool", i);
+          }
           while(true){
             std::function<void()> job;
             {
@@ -0,0 +1,333 @@
+#pragma once
+#include <experimental/filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Binary log of a stream of inference requests,
+// written by a server with capture on and read back by replay
+//
+// "SNIGTRAF", num_neurons (size_t), then one record per request in the order
+// the requests were submitted, every integer an LEB128 varint:
+//   arrival  : ns after the first request of the log
+//   priority
+//   deadline : ns after the arrival, 0 if none
+//   num_rows
+//   then every row : nnz << 1 | (1 if all values are equal),
+//                    the columns in increasing order as gaps
+//                    (the first column, then each one less its predecessor plus one),
+//                    and the nonzero values as floats, only one if all are equal
+//
+// Sparse rows of binary images take a byte or two per nonzero.
+// A record cut short by a server that did not stop is dropped by the reader.
+constexpr char traffic_log_magic[8] = {'S', 'N', 'I', 'G', 'T', 'R', 'A', 'F'};
+
+struct TrafficRequest {
+  uint64_t arrival_ns;
+  size_t priority;
+
+  //0 if none
+  uint64_t deadline_ns;
+
+  //rows [row_beg, row_beg + num_rows) of the log
+  size_t row_beg;
+  size_t num_rows;
+};
+
+// All requests of a log, their rows kept as one CSR matrix in arrival order
+struct TrafficLog {
+  size_t num_neurons{0};
+  std::vector<TrafficRequest> requests;
+  std::vector<size_t> row_ptr{0};
+  std::vector<int> col_idx;
+  std::vector<float> values;
+
+  //a record was cut short and dropped
+  bool is_truncated{false};
+
+  size_t num_rows() const { return row_ptr.size() - 1; }
+
+  //dense rows of a request, num_rows x num_neurons
+  template <typename T>
+  std::vector<T> dense_rows(const size_t request) const;
+};
+
+// Appends requests to a log, from any number of producer threads
+//
+// The rows of a request are encoded outside the lock,
+// only the write of the record is serialized.
+class TrafficWriter {
+
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    TrafficWriter(const std::fs::path& path, const size_t num_neurons);
+
+    //rows holds num_rows x num_neurons dense activations,
+    //a deadline of clock::time_point::max() means none
+    template <typename T>
+    void append(
+      const clock::time_point arrival,
+      const T* rows,
+      const size_t num_rows,
+      const size_t priority,
+      const clock::time_point deadline
+    );
+
+    void flush();
+
+    size_t num_requests() const;
+
+    size_t bytes() const;
+
+  private:
+
+    std::fs::path _path;
+    size_t _num_neurons;
+    std::ofstream _out;
+
+    mutable std::mutex _mutex;
+    bool _has_start{false};
+    clock::time_point _start;
+    size_t _num_requests{0};
+    size_t _bytes{0};
+};
+
+inline
+TrafficLog read_traffic_log(const std::fs::path& path);
+
+namespace detail {
+
+inline
+void append_varint(std::string& buf, uint64_t v) {
+  while(v >= 0x80) {
+    buf.push_back(char(v | 0x80));
+    v >>= 7;
+  }
+  buf.push_back(char(v));
+}
+
+//false if the varint runs past end
+inline
+bool read_varint(const char*& p, const char* end, uint64_t& v) {
+  v = 0;
+  for(int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    v |= uint64_t(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}// end of namespace detail ----------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Definition of TrafficLog
+// ----------------------------------------------------------------------------
+
+template <typename T>
+std::vector<T> TrafficLog::dense_rows(const size_t request) const {
+  const auto& r = requests[request];
+  std::vector<T> rows(r.num_rows * num_neurons, T(0));
+  for(size_t i = 0; i < r.num_rows; ++i) {
+    for(size_t k = row_ptr[r.row_beg + i]; k < row_ptr[r.row_beg + i + 1]; ++k) {
+      rows[i * num_neurons + col_idx[k]] = values[k];
+    }
+  }
+  return rows;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of TrafficWriter
+// ----------------------------------------------------------------------------
+
+inline
+TrafficWriter::TrafficWriter(const std::fs::path& path, const size_t num_neurons):
+  _path{path},
+  _num_neurons{num_neurons},
+  _out{path, std::ios::out | std::ios::binary}
+{
+  if(!_out) {
+    throw std::runtime_error("cannot write " + path.string());
+  }
+  _out.write(traffic_log_magic, sizeof(traffic_log_magic));
+  _out.write((char*)&_num_neurons, sizeof(size_t));
+  _bytes = sizeof(traffic_log_magic) + sizeof(size_t);
+}
+
+template <typename T>
+void TrafficWriter::append(
+  const clock::time_point arrival,
+  const T* rows,
+  const size_t num_rows,
+  const size_t priority,
+  const clock::time_point deadline
+) {
+  std::string body;
+  std::vector<uint32_t> cols;
+  for(size_t i = 0; i < num_rows; ++i) {
+    const T* row = rows + i * _num_neurons;
+    cols.clear();
+    for(size_t c = 0; c < _num_neurons; ++c) {
+      if(row[c] != 0) {
+        cols.push_back(c);
+      }
+    }
+    bool is_constant = std::all_of(cols.begin(), cols.end(), [&](uint32_t c){ return row[c] == row[cols[0]]; });
+    detail::append_varint(body, cols.size() << 1 | (is_constant ? 1 : 0));
+    for(size_t k = 0; k < cols.size(); ++k) {
+      detail::append_varint(body, k == 0 ? cols[0] : cols[k] - cols[k - 1] - 1);
+    }
+    for(size_t k = 0; k < (is_constant ? std::min<size_t>(cols.size(), 1) : cols.size()); ++k) {
+      float v = row[cols[k]];
+      body.append((const char*)&v, sizeof(float));
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if(!_has_start) {
+    _start = arrival;
+    _has_start = true;
+  }
+  //producers racing to the lock may append slightly out of arrival order
+  uint64_t arrival_ns = arrival > _start ?
+    std::chrono::duration_cast<std::chrono::nanoseconds>(arrival - _start).count() : 0;
+  uint64_t deadline_ns{0};
+  if(deadline != clock::time_point::max()) {
+    deadline_ns = deadline > arrival ?
+      std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - arrival).count() : 1;
+  }
+
+  std::string head;
+  detail::append_varint(head, arrival_ns);
+  detail::append_varint(head, priority);
+  detail::append_varint(head, deadline_ns);
+  detail::append_varint(head, num_rows);
+  _out.write(head.data(), head.size());
+  _out.write(body.data(), body.size());
+  if(!_out) {
+    throw std::runtime_error("cannot write " + _path.string());
+  }
+  ++_num_requests;
+  _bytes += head.size() + body.size();
+}
+
+inline
+void TrafficWriter::flush() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _out.flush();
+}
+
+inline
+size_t TrafficWriter::num_requests() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _num_requests;
+}
+
+inline
+size_t TrafficWriter::bytes() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _bytes;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of traffic log functions
+// ----------------------------------------------------------------------------
+
+inline
+TrafficLog read_traffic_log(const std::fs::path& path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  if(!in) {
+    throw std::runtime_error("cannot open " + path.string());
+  }
+  std::string buf{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+  TrafficLog log;
+  if(buf.size() < sizeof(traffic_log_magic) + sizeof(size_t) ||
+     std::memcmp(buf.data(), traffic_log_magic, sizeof(traffic_log_magic)) != 0) {
+    throw std::runtime_error(path.string() + " is not a traffic log");
+  }
+  std::memcpy(&log.num_neurons, buf.data() + sizeof(traffic_log_magic), sizeof(size_t));
+
+  const char* p = buf.data() + sizeof(traffic_log_magic) + sizeof(size_t);
+  const char* end = buf.data() + buf.size();
+
+  //reads one record, false if it is cut short
+  auto read_record = [&]() {
+    TrafficRequest r;
+    uint64_t priority, num_rows;
+    if(!detail::read_varint(p, end, r.arrival_ns) || !detail::read_varint(p, end, priority) ||
+       !detail::read_varint(p, end, r.deadline_ns) || !detail::read_varint(p, end, num_rows)) {
+      return false;
+    }
+    r.priority = priority;
+    r.num_rows = num_rows;
+    r.row_beg = log.num_rows();
+
+    for(size_t i = 0; i < r.num_rows; ++i) {
+      uint64_t head;
+      if(!detail::read_varint(p, end, head)) {
+        return false;
+      }
+      const size_t nnz = head >> 1;
+      const bool is_constant = head & 1;
+      uint64_t c{0};
+      for(size_t k = 0; k < nnz; ++k) {
+        uint64_t gap;
+        if(!detail::read_varint(p, end, gap)) {
+          return false;
+        }
+        c = k == 0 ? gap : c + gap + 1;
+        if(c >= log.num_neurons) {
+          throw std::runtime_error(path.string() + " holds column " + std::to_string(c) + " of a row");
+        }
+        log.col_idx.push_back(c);
+      }
+      const size_t num_values = is_constant ? std::min<size_t>(nnz, 1) : nnz;
+      if(size_t(end - p) < sizeof(float) * num_values) {
+        return false;
+      }
+      for(size_t k = 0; k < nnz; ++k) {
+        float v;
+        std::memcpy(&v, p + sizeof(float) * (is_constant ? 0 : k), sizeof(float));
+        log.values.push_back(v);
+      }
+      p += sizeof(float) * num_values;
+      log.row_ptr.push_back(log.col_idx.size());
+    }
+    log.requests.push_back(r);
+    return true;
+  };
+
+  while(p < end) {
+    if(!read_record()) {
+      //drop the rows of the partial record
+      size_t num_rows = log.requests.empty() ? 0 : log.requests.back().row_beg + log.requests.back().num_rows;
+      log.row_ptr.resize(num_rows + 1);
+      log.col_idx.resize(log.row_ptr.back());
+      log.values.resize(log.row_ptr.back());
+      log.is_truncated = true;
+      break;
+    }
+  }
+
+  return log;
+}
+
+}// end of namespace snig ----------------------------------------------
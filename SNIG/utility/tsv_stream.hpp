@@ -0,0 +1,655 @@
+#pragma once
+#include <SNIG/utility/reader.hpp>
+#include <experimental/filesystem>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace std {
+  namespace fs = experimental::filesystem;
+}
+
+namespace snig {
+
+// Inflates every member of a gzip stream into sink(data, size) with zlib,
+// which checks the CRC-32 and length of every member; returns the bytes of text
+//
+//   std::ifstream in("data.tsv.gz", std::ios::binary);
+//   snig::gunzip(in, [](const char* data, size_t size) { ... });
+template <typename Sink>
+size_t gunzip(std::istream& in, Sink&& sink);
+
+// Whole lines of one file of a compressed TSV stream
+struct TextChunk {
+  //file name, the tar entry or the .tsv.gz without .gz
+  std::string name;
+
+  //whole lines, the last one ends with a newline
+  std::vector<char> text;
+
+  //last chunk of the file
+  bool is_last{false};
+};
+
+// Splits a ustar/GNU tar stream into its regular files
+//
+// Bytes are fed in pieces of any size; on_begin(name) opens a file,
+// on_data(data, size) gets its contents in order, and on_end() closes it.
+class TarReader {
+
+  public:
+
+    TarReader(
+      std::function<void(const std::string&)> on_begin,
+      std::function<void(const char*, size_t)> on_data,
+      std::function<void()> on_end
+    );
+
+    void feed(const char* data, size_t size);
+
+    //the two zero blocks closing the archive were seen
+    bool is_finished() const;
+
+  private:
+
+    static constexpr size_t block_size = 512;
+
+    std::function<void(const std::string&)> _on_begin;
+    std::function<void(const char*, size_t)> _on_data;
+    std::function<void()> _on_end;
+
+    char _header[block_size];
+    size_t _header_len{0};
+
+    //bytes left of the current entry and of its padding
+    size_t _data_left{0};
+    size_t _padding_left{0};
+
+    //regular file, GNU long name, or an entry to skip
+    enum class Entry {file, long_name, skip} _entry{Entry::skip};
+    std::string _long_name;
+
+    bool _is_finished{false};
+
+    void _parse_header();
+};
+
+// Inflates a .tsv.gz file, or every file of a .tar.gz (.tgz) archive,
+// on its own thread into chunks of whole lines
+//
+// Chunks are handed over through a bounded queue, so parsing overlaps
+// inflating and no more than queue_capacity chunks of text are in memory.
+class GzipTsvStream {
+
+  public:
+
+    GzipTsvStream(
+      const std::fs::path& path,
+      const size_t chunk_bytes = 4 << 20,
+      const size_t queue_capacity = 4
+    );
+
+    ~GzipTsvStream();
+
+    //next chunk in file order, false after the last one;
+    //rethrows an error of the inflating thread
+    bool next(TextChunk& chunk);
+
+    //bytes of text inflated so far
+    size_t text_bytes() const;
+
+    //time the inflating thread was blocked on a full queue
+    double producer_wait_seconds() const;
+
+    //time next was blocked on an empty queue
+    double consumer_wait_seconds() const;
+
+  private:
+
+    using clock = std::chrono::steady_clock;
+
+    struct Cancelled {};
+
+    std::fs::path _path;
+    size_t _chunk_bytes;
+    size_t _queue_capacity;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    std::queue<TextChunk> _queue;
+    bool _is_done{false};
+    bool _is_cancelled{false};
+    std::exception_ptr _error;
+
+    size_t _text_bytes{0};
+    double _producer_wait{0};
+    double _consumer_wait{0};
+
+    std::thread _thread;
+
+    void _inflate();
+
+    void _push(TextChunk&& chunk);
+};
+
+// calls f(row, col, value) for every "row\tcol\tvalue" line of [beg, end),
+// ids are passed as written (1-based)
+template <typename T, typename F>
+void parse_tsv_triplets(const char* beg, const char* end, F&& f);
+
+// Converts the weight files of an archive (the challenge neuron<cols>.tar.gz)
+// straight to packed layer files in weight_dir, like the tsv_file_to_binary_file
+// of a weight directory, without extracting the archive
+template <typename T>
+void tsv_gz_file_to_binary_file(
+  const std::fs::path& weight_archive,
+  const std::fs::path& weight_dir,
+  const size_t num_layers,
+  const size_t rows,
+  const size_t cols,
+  const size_t COL_BLK,
+  const size_t N_SLAB,
+  const size_t estimate_nnz
+);
+
+// Converts sparse-images-<cols>.tsv.gz in input_path to sparse-images-<cols>.b,
+// like the tsv_file_to_binary_file of an input
+template <typename T>
+void tsv_gz_file_to_binary_file(
+  std::fs::path input_path,
+  const size_t rows,
+  const size_t cols
+);
+
+// ----------------------------------------------------------------------------
+// Definition of gunzip
+// ----------------------------------------------------------------------------
+
+template <typename Sink>
+size_t gunzip(std::istream& in, Sink&& sink) {
+  z_stream zs{};
+  //16 + MAX_WBITS reads a gzip header and trailer around the deflate data
+  if(inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+    throw std::runtime_error("inflate: cannot initialize zlib");
+  }
+  //released as well when the sink throws
+  std::unique_ptr<z_stream, int(*)(z_stream*)> guard(&zs, inflateEnd);
+
+  std::vector<unsigned char> input(1 << 18);
+  std::vector<unsigned char> output(1 << 20);
+
+  auto refill = [&]() {
+    in.read(reinterpret_cast<char*>(input.data()), input.size());
+    zs.next_in = input.data();
+    zs.avail_in = static_cast<uInt>(in.gcount());
+    return zs.avail_in > 0;
+  };
+
+  size_t total{0};
+  bool is_member_done{false};
+
+  while(zs.avail_in > 0 || refill()) {
+    zs.next_out = output.data();
+    zs.avail_out = static_cast<uInt>(output.size());
+    int ret = inflate(&zs, Z_NO_FLUSH);
+    size_t size = output.size() - zs.avail_out;
+    if(size > 0) {
+      sink(reinterpret_cast<const char*>(output.data()), size);
+      total += size;
+    }
+
+    if(ret == Z_STREAM_END) {
+      //a multi-member file goes on with the next gzip header
+      if(zs.avail_in == 0 && !refill()) {
+        is_member_done = true;
+        break;
+      }
+      if(zs.next_in[0] != 0x1f) {
+        throw std::runtime_error("inflate: trailing garbage after gzip stream");
+      }
+      inflateReset(&zs);
+    }
+    else if(ret != Z_OK) {
+      throw std::runtime_error(std::string("inflate: ") + (zs.msg ? zs.msg : "invalid gzip stream"));
+    }
+  }
+
+  if(!is_member_done) {
+    throw std::runtime_error("inflate: unexpected end of stream");
+  }
+  return total;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of TarReader
+// ----------------------------------------------------------------------------
+
+inline
+TarReader::TarReader(
+  std::function<void(const std::string&)> on_begin,
+  std::function<void(const char*, size_t)> on_data,
+  std::function<void()> on_end
+) :
+  _on_begin{std::move(on_begin)},
+  _on_data{std::move(on_data)},
+  _on_end{std::move(on_end)}
+{
+}
+
+inline
+void TarReader::feed(const char* data, size_t size) {
+  while(size > 0 && !_is_finished) {
+    if(_data_left > 0) {
+      size_t n = std::min(size, _data_left);
+      if(_entry == Entry::file) {
+        _on_data(data, n);
+      }
+      else if(_entry == Entry::long_name) {
+        _long_name.append(data, n);
+      }
+      data += n;
+      size -= n;
+      _data_left -= n;
+      if(_data_left == 0 && _entry == Entry::file) {
+        _on_end();
+      }
+    }
+    else if(_padding_left > 0) {
+      size_t n = std::min(size, _padding_left);
+      data += n;
+      size -= n;
+      _padding_left -= n;
+    }
+    else {
+      size_t n = std::min(size, block_size - _header_len);
+      std::memcpy(_header + _header_len, data, n);
+      data += n;
+      size -= n;
+      _header_len += n;
+      if(_header_len == block_size) {
+        _header_len = 0;
+        _parse_header();
+      }
+    }
+  }
+}
+
+inline
+bool TarReader::is_finished() const {
+  return _is_finished;
+}
+
+inline
+void TarReader::_parse_header() {
+  if(std::all_of(_header, _header + block_size, [](char c){ return c == 0; })) {
+    _is_finished = true;
+    return;
+  }
+
+  //octal, or base-256 with the top bit set for sizes of 8 GB and more
+  size_t size{0};
+  const auto* field = reinterpret_cast<const unsigned char*>(_header + 124);
+  if(field[0] & 0x80) {
+    size = field[0] & 0x7f;
+    for(int i = 1; i < 12; ++i) {
+      size = (size << 8) | field[i];
+    }
+  }
+  else {
+    for(int i = 0; i < 12 && field[i] >= '0' && field[i] <= '7'; ++i) {
+      size = (size << 3) | (field[i] - '0');
+    }
+  }
+
+  std::string name;
+  if(!_long_name.empty()) {
+    //the name of a GNU long name entry is zero terminated
+    name = _long_name.c_str();
+    _long_name.clear();
+  }
+  else {
+    //POSIX ustar splits long names into a prefix, GNU tar keeps other fields there
+    std::string prefix(_header + 345, strnlen(_header + 345, 155));
+    name.assign(_header, strnlen(_header, 100));
+    if(std::memcmp(_header + 257, "ustar\0", 6) == 0 && !prefix.empty()) {
+      name = prefix + "/" + name;
+    }
+  }
+
+  const char type = _header[156];
+  if(type == 'L') {
+    _entry = Entry::long_name;
+  }
+  else if(type == '0' || type == '\0') {
+    _entry = Entry::file;
+    _on_begin(name);
+    if(size == 0) {
+      _on_end();
+    }
+  }
+  else {
+    //directories, links, and pax headers
+    _entry = Entry::skip;
+  }
+  _data_left = size;
+  _padding_left = (block_size - size % block_size) % block_size;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of GzipTsvStream
+// ----------------------------------------------------------------------------
+
+inline
+GzipTsvStream::GzipTsvStream(
+  const std::fs::path& path,
+  const size_t chunk_bytes,
+  const size_t queue_capacity
+) :
+  _path{path},
+  _chunk_bytes{std::max<size_t>(chunk_bytes, 1)},
+  _queue_capacity{std::max<size_t>(queue_capacity, 1)}
+{
+  if(!std::fs::exists(path)) {
+    throw std::runtime_error("cannot open " + path.string());
+  }
+  _thread = std::thread([this](){ _inflate(); });
+}
+
+inline
+GzipTsvStream::~GzipTsvStream() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _is_cancelled = true;
+  }
+  _not_full.notify_all();
+  _thread.join();
+}
+
+inline
+void GzipTsvStream::_push(TextChunk&& chunk) {
+  auto beg = clock::now();
+  std::unique_lock<std::mutex> lock(_mutex);
+  _not_full.wait(lock, [&](){ return _is_cancelled || _queue.size() < _queue_capacity; });
+  _producer_wait += std::chrono::duration<double>(clock::now() - beg).count();
+  if(_is_cancelled) {
+    throw Cancelled{};
+  }
+  _text_bytes += chunk.text.size();
+  _queue.push(std::move(chunk));
+  lock.unlock();
+  _not_empty.notify_one();
+}
+
+inline
+void GzipTsvStream::_inflate() {
+  std::string name;
+  std::vector<char> pending;
+
+  auto on_begin = [&](const std::string& entry) {
+    name = std::fs::path(entry).filename().string();
+    pending.clear();
+  };
+
+  //cut at the last newline once a chunk is full, the rest goes to the next
+  auto on_data = [&](const char* data, size_t size) {
+    pending.insert(pending.end(), data, data + size);
+    if(pending.size() < _chunk_bytes) {
+      return;
+    }
+    auto last = std::find(pending.rbegin(), pending.rend(), '\n');
+    if(last == pending.rend()) {
+      return;
+    }
+    size_t cut = last.base() - pending.begin();
+    TextChunk chunk;
+    chunk.name = name;
+    chunk.text = std::move(pending);
+    pending.reserve(_chunk_bytes + (1 << 20));
+    pending.assign(chunk.text.begin() + cut, chunk.text.end());
+    chunk.text.resize(cut);
+    _push(std::move(chunk));
+  };
+
+  auto on_end = [&]() {
+    if(!pending.empty() && pending.back() != '\n') {
+      pending.push_back('\n');
+    }
+    TextChunk chunk;
+    chunk.name = name;
+    chunk.text = std::move(pending);
+    chunk.is_last = true;
+    pending.clear();
+    _push(std::move(chunk));
+  };
+
+  try {
+    std::ifstream in(_path, std::ios::in | std::ios::binary);
+    if(!in) {
+      throw std::runtime_error("cannot open " + _path.string());
+    }
+    const std::string file = _path.filename().string();
+    auto ends_with = [&](const std::string& suffix) {
+      return file.size() >= suffix.size() && file.compare(file.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+
+    if(ends_with(".tar.gz") || ends_with(".tgz")) {
+      TarReader tar(on_begin, on_data, on_end);
+      gunzip(in, [&](const char* data, size_t size){ tar.feed(data, size); });
+    }
+    else {
+      on_begin(_path.stem().string());
+      gunzip(in, on_data);
+      on_end();
+    }
+  }
+  catch(const Cancelled&) {
+  }
+  catch(...) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _error = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _is_done = true;
+  }
+  _not_empty.notify_all();
+}
+
+inline
+bool GzipTsvStream::next(TextChunk& chunk) {
+  auto beg = clock::now();
+  std::unique_lock<std::mutex> lock(_mutex);
+  _not_empty.wait(lock, [&](){ return !_queue.empty() || _is_done; });
+  _consumer_wait += std::chrono::duration<double>(clock::now() - beg).count();
+  if(_queue.empty()) {
+    if(_error) {
+      std::rethrow_exception(_error);
+    }
+    return false;
+  }
+  chunk = std::move(_queue.front());
+  _queue.pop();
+  lock.unlock();
+  _not_full.notify_one();
+  return true;
+}
+
+inline
+size_t GzipTsvStream::text_bytes() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _text_bytes;
+}
+
+inline
+double GzipTsvStream::producer_wait_seconds() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _producer_wait;
+}
+
+inline
+double GzipTsvStream::consumer_wait_seconds() const {
+  return _consumer_wait;
+}
+
+// ----------------------------------------------------------------------------
+// Definition of TSV stream conversions
+// ----------------------------------------------------------------------------
+
+template <typename T, typename F>
+void parse_tsv_triplets(const char* beg, const char* end, F&& f) {
+  const char* p = beg;
+
+  auto parse_id = [&]() {
+    int id{0};
+    const char* first = p;
+    while(p < end && *p >= '0' && *p <= '9') {
+      id = id * 10 + (*p++ - '0');
+    }
+    if(p == first || p == end || *p != '\t') {
+      throw std::runtime_error("malformed TSV line: " + std::string(first, std::find(first, end, '\n')));
+    }
+    ++p;
+    return id;
+  };
+
+  while(p < end) {
+    const char* line = p;
+    int row = parse_id();
+    int col = parse_id();
+    //chunks end with a newline, so strtod stops within the chunk
+    char* next;
+    T value = T(std::strtod(p, &next));
+    if(next == p) {
+      throw std::runtime_error("malformed TSV line: " + std::string(line, std::find(line, end, '\n')));
+    }
+    p = std::find(static_cast<const char*>(next), end, '\n') + 1;
+    f(row, col, value);
+  }
+}
+
+template <typename T>
+void tsv_gz_file_to_binary_file(
+  const std::fs::path& weight_archive,
+  const std::fs::path& weight_dir,
+  const size_t num_layers,
+  const size_t rows,
+  const size_t cols,
+  const size_t COL_BLK,
+  const size_t N_SLAB,
+  const size_t estimate_nnz
+) {
+  //T is either float or double type
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  const std::string prefix = "n" + std::to_string(cols) + "-l";
+
+  std::vector<Triplet<T> > triplets;
+  triplets.reserve(estimate_nnz);
+  std::vector<bool> is_written(num_layers, false);
+  size_t num_written{0};
+
+  GzipTsvStream stream(weight_archive);
+  TextChunk chunk;
+  size_t layer{0};
+
+  //the archive holds layers of every depth, stop once those asked for are written
+  while(num_written < num_layers && stream.next(chunk)) {
+    //layer files are n<cols>-l<layer>.tsv, everything else is skipped
+    const auto& name = chunk.name;
+    layer = 0;
+    if(name.compare(0, prefix.size(), prefix) == 0 && name.size() > prefix.size() + 4 &&
+       name.compare(name.size() - 4, 4, ".tsv") == 0) {
+      layer = std::strtoul(name.c_str() + prefix.size(), nullptr, 10);
+    }
+    if(layer == 0 || layer > num_layers) {
+      continue;
+    }
+
+    parse_tsv_triplets<T>(chunk.text.data(), chunk.text.data() + chunk.text.size(), [&](int r, int c, T v) {
+      triplets.emplace_back(r - 1 + rows * ((c - 1) / COL_BLK), c - 1, v);
+    });
+
+    if(chunk.is_last) {
+      std::fs::path output_file = weight_dir;
+      output_file /= prefix + std::to_string(layer) + ".b";
+      write_packed_layer_binary<T>(output_file, triplets, rows, N_SLAB);
+      triplets.clear();
+      if(!is_written[layer - 1]) {
+        is_written[layer - 1] = true;
+        ++num_written;
+      }
+    }
+  }
+
+  if(num_written < num_layers) {
+    auto missing = std::find(is_written.begin(), is_written.end(), false) - is_written.begin();
+    throw std::runtime_error(
+      weight_archive.string() + " has no " + prefix + std::to_string(missing + 1) + ".tsv"
+    );
+  }
+
+  std::cout << "  inflated " << stream.text_bytes() / (1 << 20) << " MB of text, parsing waited "
+            << stream.consumer_wait_seconds() << " s for inflate, inflate waited "
+            << stream.producer_wait_seconds() << " s for parsing\n";
+}
+
+template <typename T>
+void tsv_gz_file_to_binary_file(
+  std::fs::path input_path,
+  const size_t rows,
+  const size_t cols
+) {
+  //T is either float or double type
+  static_assert(
+    std::is_same<T, float>::value || std::is_same<T, double>::value,
+    "data type must be either float or double"
+  );
+
+  input_path /= "sparse-images-" + std::to_string(cols) + ".tsv.gz";
+
+  auto data_array = std::make_unique<T[]>(rows * cols);
+  std::memset(data_array.get(), 0, sizeof(T) * rows * cols);
+
+  GzipTsvStream stream(input_path);
+  TextChunk chunk;
+  while(stream.next(chunk)) {
+    parse_tsv_triplets<T>(chunk.text.data(), chunk.text.data() + chunk.text.size(), [&](int r, int c, T v) {
+      if(r < 1 || size_t(r) > rows || c < 1 || size_t(c) > cols) {
+        throw std::runtime_error(
+          input_path.string() + " has input " + std::to_string(r) + ", feature " + std::to_string(c)
+          + " outside " + std::to_string(rows) + "x" + std::to_string(cols)
+        );
+      }
+      data_array[(r - 1) * cols + c - 1] = v;
+    });
+  }
+
+  std::fs::path p = input_path.parent_path();
+  p /= "sparse-images-" + std::to_string(cols) + ".b";
+
+  std::ofstream out(p, std::ios::out | std::ios::binary);
+  out.write((char*)&rows, sizeof(size_t));
+  out.write((char*)&cols, sizeof(size_t));
+  out.write((char*)data_array.get(), sizeof(T) * (rows * cols));
+}
+
+}// end of namespace snig ----------------------------------------------
@@ -1,5 +1,6 @@
 #usage: 
 #       $1 num_neurons,  --all , or -h
+#       $2 --no_extract keeps the weights and inputs compressed for to_binary
 
 bold=$(tput bold)
 normal=$(tput sgr0)
@@ -7,10 +8,11 @@ normal=$(tput sgr0)
 get_command() {
   # help message
   if [[ "$1" == "-h" ]]; then
-    echo "usage : ./get_dataset.sh (num_neurons, --all, or -h)"
+    echo "usage : ./get_dataset.sh (num_neurons, --all, or -h) [--no_extract]"
     echo ""
     echo "\"./get_dataset.sh 1024\" would download and extract benchmarks with 1024 neurons"
     echo "\"./get_dataset.sh --all\" would download and extract all benchmarks"
+    echo "\"./get_dataset.sh 1024 --no_extract\" would keep them compressed, to_binary reads them as they are"
     echo "All files would be stored in ../dataset"
     exit
   fi
@@ -31,11 +33,11 @@ get_command() {
     for (( k = 0; k < 4; ++k ))
     do
       download ${num_neurons[k]}
-      extract ${num_neurons[k]}
+      extract ${num_neurons[k]} $2
     done
   elif [[ $1 == 1024 || $1 == 4096 || $1 == 16384 || $1 == 65536 ]]; then
     download $1
-    extract $1
+    extract $1 $2
   else
     echo "wrong format!"
     echo "usage : ./get_dataset (num_neurons, --all, or -h)"
@@ -60,6 +62,11 @@ download() {
 }
 
 extract() {
+  if [[ "$2" == "--no_extract" ]]; then
+    echo "${bold}Keeping compressed files...${normal}"
+    return
+  fi
+
   echo "${bold}Extracting files...${normal}"
   tar -xzf ../dataset/weight/neuron$1.tar.gz -C ../dataset/weight
   gunzip ../dataset/MNIST/sparse-images-$1.tsv.gz
@@ -68,4 +75,4 @@ extract() {
   rm ../dataset/weight/neuron$1.tar.gz
 }
 
-get_command $1
+get_command $1 $2
@@ -0,0 +1,137 @@
+#include <CLI11/CLI11.hpp>
+#include <SNIG/utility/inspector.hpp>
+#include <SNIG/utility/json.hpp>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+
+  //  ***All files should be converted to binary first***
+
+  // usage:
+  //        --weight(-w)                 :  path of weight directory
+  //        --input(-i)                  :  path of input file, optional
+  //        --num_neurons(-n)            :  number of neurons 1024, 4096, 16384, or 65536
+  //        --num_layers(-l)             :  number of layers 120, 480, or 1920
+  //        --output(-o)                 :  path of JSON output, default is stdout
+
+  // example1:
+  //        ./inspect
+
+  // example2:
+  //        ./inspect -w ../sample_data/weight/neuron1024/ -i ../sample_data/MNIST/sparse-images-1024.b -n 1024 -l 120 -o model.json
+
+  // sec_size, num_secs are taken from the binary files, which were packed for the GPU of to_binary.
+
+  CLI::App app{"Inspector"};
+
+  std::fs::path weight_path("../sample_data/weight/neuron1024/");
+  app.add_option(
+    "-w, --weight",
+    weight_path,
+    "weight directory path, default is ../sample_data/weight/neuron1024/"
+  )->check(CLI::ExistingDirectory);
+
+  std::fs::path input_path;
+  app.add_option(
+    "-i, --input",
+    input_path,
+    "input binary file path, default is no input"
+  )->check(CLI::ExistingFile);
+
+  size_t num_neurons = 1024;
+  app.add_option(
+    "-n, --num_neurons",
+    num_neurons,
+    "total number of neurons, default is 1024"
+  );
+
+  size_t num_layers = 120;
+  app.add_option(
+    "-l, --num_layers",
+    num_layers,
+    "total number of layers, default is 120"
+  );
+
+  std::fs::path output_path;
+  app.add_option(
+    "-o, --output",
+    output_path,
+    "JSON output path, default is stdout"
+  );
+
+  CLI11_PARSE(app, argc, argv);
+
+  auto layer_path = [&](const size_t layer) {
+    std::fs::path p = weight_path;
+    p /= "n" + std::to_string(num_neurons) + "-l" + std::to_string(layer + 1) + ".b";
+    return p;
+  };
+
+  size_t num_secs = snig::num_secs_of_layer_binary<float>(layer_path(0));
+  size_t sec_size = num_neurons / num_secs;
+
+  std::vector<snig::LayerProfile> layers;
+  layers.reserve(num_layers);
+  for(size_t l = 0; l < num_layers; ++l) {
+    layers.push_back(snig::inspect_layer_binary<float>(layer_path(l), l, num_neurons, num_secs));
+  }
+
+  std::ofstream file;
+  if(!output_path.empty()) {
+    file.open(output_path);
+  }
+  snig::JSONWriter json(output_path.empty() ? std::cout : file);
+
+  size_t total_nnz{0};
+  size_t min_nnz{layers.empty() ? 0 : layers[0].nnz};
+  size_t max_nnz{0};
+  for(const auto& l : layers) {
+    total_nnz += l.nnz;
+    min_nnz = std::min(min_nnz, l.nnz);
+    max_nnz = std::max(max_nnz, l.nnz);
+  }
+
+  json.begin_object();
+  json.field("weight", weight_path.string());
+  json.field("num_neurons", num_neurons);
+  json.field("num_layers", num_layers);
+  json.field("num_secs", num_secs);
+  json.field("sec_size", sec_size);
+  json.field("total_nnz", total_nnz);
+  json.field("min_nnz", min_nnz);
+  json.field("max_nnz", max_nnz);
+
+  auto dump_groups = [&](const std::vector<std::vector<size_t> >& groups) {
+    json.begin_array();
+    for(const auto& g : groups) {
+      json.begin_array();
+      for(auto l : g) {
+        json.value(l);
+      }
+      json.end_array();
+    }
+    json.end_array();
+  };
+
+  //layers grouped by 64-bit hashes of their packed arrays
+  json.key("duplicate_patterns");
+  dump_groups(snig::duplicate_layers(layers, false));
+  json.key("duplicate_layers");
+  dump_groups(snig::duplicate_layers(layers, true));
+
+  json.key("layers").begin_array();
+  for(const auto& l : layers) {
+    snig::dump_layer_profile(json, l);
+  }
+  json.end_array();
+
+  if(!input_path.empty()) {
+    json.key("input");
+    snig::dump_input_profile(json, snig::inspect_input_binary<float>(input_path, sec_size));
+  }
+  json.end_object();
+
+  return 0;
+}
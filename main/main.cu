@@ -2,14 +2,23 @@
 #include <SNIG/SNIG.hpp>
 #include <SNIG/utility/reader.hpp>
 #include <SNIG/utility/scoring.hpp>
+#include <SNIG/utility/category_writer.hpp>
+#include <SNIG/utility/json.hpp>
+#include <SNIG/utility/metrics.hpp>
 #include <iostream>
+#include <fstream>
+#include <thread>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <future>
 
 int main(int argc, char* argv[]) {
 
   //  ***All files should be converted to binary first***
 
   // usage: 
-  //        --mode(-m)                   :  mode (SNIG, GPipe, BF)
+  //        --mode(-m)                   :  mode (SNIG, GPipe, BF, SNIG_CPU, Sequential, CPUParallel, Server, Hybrid)
   //        --weight(-w)                 :  path of weight directory
   //        --input(-i)                  :  path of input file
   //        --golden(-g)                 :  path of golden file
@@ -20,6 +29,31 @@ int main(int argc, char* argv[]) {
   //        --input_batch_size           :  input batch size, must be a factor of num_inputs (60000)
   //        --num_weight_buffers         :  number of weight buffers, must be an even number
   //        --thread_dimension           :  thread dimsion for inference kernel, constrained by the maximum number of threads (typically 1024)
+  //        --report                     :  path of JSON run report (configuration, memory usage, results)
+  //        --metrics_file               :  path of metrics file in Prometheus text format
+  //        --metrics_port               :  serve metrics in Prometheus text format on localhost:port
+  //        --num_threads                :  number of host threads of SNIG_CPU and CPUParallel
+  //        --roofline                   :  calibrate host bandwidth and FMA throughput and place each layer of SNIG_CPU on the roofline
+  //        --affinity                   :  placement of worker threads (none, compact, scatter, numa, no_smt)
+  //        --weight_layout              :  layout of the weight nonzeros of SNIG_CPU (split, interleaved, sell, bsr, blocked)
+  //        --cache_blocking             :  sub-block and row block of the blocked layout (auto or <sub_size>x<row_block>)
+  //        --fixed_point_bits           :  run SNIG_CPU with uint16 activations of this many fractional bits (0-10), split layout and batch schedule only
+  //        --threshold                  :  approximate SNIG_CPU, zero activations below one threshold or one per layer
+  //        --schedule                   :  how SNIG_CPU spreads a run over its threads (batch, section)
+  //        --switch_row_ratio           :  Hybrid: fraction of surviving inputs at or below which a batch switches from BF to SNIG
+  //        --switch_section_ratio       :  Hybrid: fraction of active sections at or below which a batch switches from BF to SNIG
+  //        --order                      :  Server: order of pending requests (fifo, deadline)
+  //        --admission                  :  Server: what a full queue does to new requests (reject, block)
+  //        --queue_capacity             :  Server: pending inputs beyond which requests are rejected or blocked
+  //        --unit_rows                  :  Server: inputs a worker takes from a request at a time
+  //        --bulk_jobs                  :  Server: number of low-priority jobs over the whole input file
+  //        --interactive_requests       :  Server: number of high-priority requests with a deadline
+  //        --interactive_rows           :  Server: inputs per interactive request
+  //        --interactive_rate           :  Server: mean arrival rate of interactive requests (per second)
+  //        --deadline_ms                :  Server: deadline of interactive requests after their arrival
+  //        --capture                    :  Server: path of a log of the submitted requests for replay
+  //        --categories_output          :  path of the categories of the run
+  //        --categories_format          :  format of the categories output (tsv, binary, bitset)
 
   //example1:  
   //        ./snig
@@ -33,7 +67,7 @@ int main(int argc, char* argv[]) {
   app.add_option(
     "-m, --mode", 
     mode, 
-    "select mode(SNIG, GPipe, or BF), default is SNIG"
+    "select mode(SNIG, GPipe, BF, SNIG_CPU, Sequential, CPUParallel, Server, or Hybrid), default is SNIG"
   );
 
   std::fs::path weight_path("../sample_data/weight/neuron1024/");
@@ -113,12 +147,234 @@ int main(int argc, char* argv[]) {
     "thread dimension for inference kernel, need 3 parameters, default is 2 512 1, constrained by the maximum number of threads (typically 1024)"
   )->expected(3);
 
+  std::fs::path report_path;
+  app.add_option(
+    "--report",
+    report_path,
+    "JSON run report path, default is no report"
+  );
+
+  std::fs::path metrics_path;
+  app.add_option(
+    "--metrics_file",
+    metrics_path,
+    "Prometheus text format metrics file path, default is no file"
+  );
+
+  int metrics_port = -1;
+  app.add_option(
+    "--metrics_port",
+    metrics_port,
+    "serve Prometheus metrics on localhost at this port while running, default is no listener"
+  );
+
+  size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  app.add_option(
+    "--num_threads",
+    num_threads,
+    "number of host threads of SNIG_CPU and CPUParallel, default is the number of hardware threads"
+  );
+
+  bool roofline = false;
+  app.add_flag(
+    "--roofline",
+    roofline,
+    "calibrate host memory bandwidth and FMA throughput and report achieved versus attainable performance of each layer (SNIG_CPU only), default is false"
+  );
+
+  std::string affinity = "none";
+  app.add_option(
+    "--affinity",
+    affinity,
+    "placement of executor, OpenMP, and thread pool workers (none, compact, scatter, numa, or no_smt), default is none"
+  );
+
+  std::string weight_layout = "split";
+  app.add_option(
+    "--weight_layout",
+    weight_layout,
+    "layout of the weight nonzeros of SNIG_CPU (split, interleaved (index, value) pairs with index-only constant-valued layers, sell (SELL-C-sigma files written by to_binary --sell_c), bsr (block sparse files written by to_binary --bsr_min_fill), or blocked (sections cut into L1-sized sub-blocks, see --cache_blocking)), default is split"
+  );
+
+  std::string cache_blocking = "auto";
+  app.add_option(
+    "--cache_blocking",
+    cache_blocking,
+    "sub-block of output neurons and rows per row block of the blocked weight layout as <sub_size>x<row_block>, or auto to time the candidates fitting the L1 and L2 of this host on the first inputs, default is auto"
+  );
+
+  int fixed_point_bits = -1;
+  app.add_option(
+    "--fixed_point_bits",
+    fixed_point_bits,
+    "run SNIG_CPU with uint16 fixed-point activations of this many fractional bits (0 to 10) and int16 weights, and check whether the scale is exact against the golden categories, cannot be combined with --weight_layout, --cache_blocking, --threshold, --schedule, or --roofline, default is -1 (floating point)"
+  );
+
+  std::vector<float> thresholds;
+  app.add_option(
+    "--threshold",
+    thresholds,
+    "approximate SNIG_CPU: zero activations below this threshold before the next layer, one value for all layers or one per layer, default is exact inference"
+  );
+
+  std::string schedule = "batch";
+  app.add_option(
+    "--schedule",
+    schedule,
+    "how SNIG_CPU spreads a run over its threads (batch: one batch per thread, or section: all threads split every layer of one batch by output section, for small batches), default is batch"
+  );
+
+  double switch_row_ratio = -1;
+  app.add_option(
+    "--switch_row_ratio",
+    switch_row_ratio,
+    "Hybrid: a batch moves from BF to SNIG at the first layer whose surviving inputs are at most this fraction of the batch and whose active sections are within --switch_section_ratio, default is -1 (calibrate both on the first batch)"
+  );
+
+  double switch_section_ratio = -1;
+  app.add_option(
+    "--switch_section_ratio",
+    switch_section_ratio,
+    "Hybrid: fraction of active (input, section) pairs at or below which a batch moves from BF to SNIG, default is -1 (calibrate both on the first batch)"
+  );
+
+  std::string order = "deadline";
+  app.add_option(
+    "--order",
+    order,
+    "Server: order of pending requests (fifo, or deadline: priority class first, earliest deadline first within a class), default is deadline"
+  );
+
+  std::string admission = "reject";
+  app.add_option(
+    "--admission",
+    admission,
+    "Server: what a full queue does to new requests (reject, or block the producer for up to a second), default is reject"
+  );
+
+  size_t queue_capacity = 120000;
+  app.add_option(
+    "--queue_capacity",
+    queue_capacity,
+    "Server: pending inputs beyond which new requests are rejected or blocked, default is 120000"
+  );
+
+  size_t unit_rows = 256;
+  app.add_option(
+    "--unit_rows",
+    unit_rows,
+    "Server: inputs a worker takes from a request at a time, default is 256"
+  );
+
+  size_t bulk_jobs = 1;
+  app.add_option(
+    "--bulk_jobs",
+    bulk_jobs,
+    "Server: number of low-priority jobs over all 60000 inputs, submitted first, default is 1"
+  );
+
+  size_t interactive_requests = 1000;
+  app.add_option(
+    "--interactive_requests",
+    interactive_requests,
+    "Server: number of high-priority requests with a deadline, default is 1000"
+  );
+
+  size_t interactive_rows = 4;
+  app.add_option(
+    "--interactive_rows",
+    interactive_rows,
+    "Server: inputs per interactive request, default is 4"
+  );
+
+  double interactive_rate = 100;
+  app.add_option(
+    "--interactive_rate",
+    interactive_rate,
+    "Server: mean arrival rate of interactive requests per second (Poisson), default is 100"
+  );
+
+  double deadline_ms = 100;
+  app.add_option(
+    "--deadline_ms",
+    deadline_ms,
+    "Server: deadline of interactive requests after their arrival, default is 100"
+  );
+
+  std::fs::path capture_path;
+  app.add_option(
+    "--capture",
+    capture_path,
+    "Server: path of a log of the submitted requests (inputs, arrival times, priorities, deadlines) for replay, default is no log"
+  );
+
+  std::fs::path categories_output_path;
+  app.add_option(
+    "--categories_output",
+    categories_output_path,
+    "path of the categories of the run, default is no file"
+  );
+
+  std::string categories_format = "tsv";
+  app.add_option(
+    "--categories_format",
+    categories_format,
+    "format of the categories output (tsv: 1-based ids of the active inputs like neuron1024-l120-categories.tsv, binary: the int golden format, bitset: the bitset golden format), default is tsv"
+  );
+
   CLI11_PARSE(app, argc, argv);
 
+  //the fixed-point engine only has the split layout and the batch schedule
+  if(mode == "SNIG_CPU" && fixed_point_bits >= 0) {
+    for(auto option : {"--weight_layout", "--cache_blocking", "--threshold", "--schedule", "--roofline"}) {
+      if(app.count(option) > 0) {
+        std::cerr << "--fixed_point_bits cannot be combined with " << option << "\n";
+        return 1;
+      }
+    }
+  }
+
+  auto affinity_policy = snig::to_affinity_policy(affinity);
+  auto weight_layout_option = snig::to_weight_layout(weight_layout);
+  auto cache_blocking_option = snig::to_cache_blocking(cache_blocking);
+  auto schedule_option = snig::to_cpu_schedule(schedule);
+  auto categories_format_option = snig::to_category_format(categories_format);
+
   Eigen::Matrix<int, Eigen::Dynamic, 1> result;
 
   dim3 thread_dimension{thread_vector[0], thread_vector[1], thread_vector[2]};
 
+  //golden and result categories are compared as bitsets
+  auto golden = snig::read_category_bitset(golden_path);
+
+  snig::MetricsRegistry metrics;
+  std::unique_ptr<snig::MetricsServer> metrics_server;
+  if(metrics_port >= 0) {
+    metrics_server = std::make_unique<snig::MetricsServer>(metrics, metrics_port);
+    std::cout << "Serving metrics on localhost:" << metrics_server->port() << std::endl;
+  }
+
+  //write the run report while the engine still holds its memory
+  auto report = [&](const auto& engine, std::function<void(snig::JSONWriter&)> extra = nullptr) {
+    if(report_path.empty()) {
+      return;
+    }
+    std::ofstream out(report_path);
+    snig::JSONWriter json(out);
+    json.begin_object();
+    json.field("mode", mode);
+    json.key("engine").begin_object();
+    engine.report(json);
+    json.end_object();
+    if(extra) {
+      extra(json);
+    }
+    size_t num_diffs = snig::num_different_categories(snig::CategoryBitset(result), golden);
+    json.field("num_different_categories", num_diffs);
+    json.field("passed", num_diffs == 0);
+    json.end_object();
+  };
+
   std::cout << "Current mode: " << mode << std::endl;
 
   if(mode == "SNIG") {
@@ -129,7 +385,10 @@ int main(int argc, char* argv[]) {
       num_neurons, 
       num_layers
     );
+    snig.attach_metrics(metrics);
+    snig.set_affinity(affinity_policy);
     result = snig.infer(input_path, 60000, input_batch_size, num_weight_buffers, num_gpus);
+    report(snig);
   }
   else if(mode == "GPipe") {
     snig::GPipe<float> gpipe(
@@ -139,7 +398,10 @@ int main(int argc, char* argv[]) {
       num_neurons, 
       num_layers
     );
+    gpipe.attach_metrics(metrics);
+    gpipe.set_affinity(affinity_policy);
     result = gpipe.infer(input_path, 60000, input_batch_size, num_gpus);
+    report(gpipe);
   }
   else if(mode == "BF") {
     //only perform initial partition since we don't have NVLink 
@@ -150,19 +412,229 @@ int main(int argc, char* argv[]) {
       num_neurons, 
       num_layers
     );
+    bf.attach_metrics(metrics);
+    bf.set_affinity(affinity_policy);
     result = bf.infer(input_path, 60000, num_gpus);
+    report(bf);
+  }
+  else if(mode == "SNIG_CPU" && fixed_point_bits >= 0) {
+    snig::SNIGCPUFixed<float> snig_cpu_fixed(
+      weight_path,
+      bias,
+      num_neurons,
+      num_layers,
+      fixed_point_bits
+    );
+    snig_cpu_fixed.attach_metrics(metrics);
+    snig_cpu_fixed.set_affinity(affinity_policy);
+    result = snig_cpu_fixed.infer(input_path, 60000, input_batch_size, num_threads);
+    //the scale is exact for this model if no category changes
+    bool is_exact = snig::num_different_categories(snig::CategoryBitset(result), golden) == 0;
+    std::cout << "Fixed point with " << fixed_point_bits << " activation / "
+              << snig_cpu_fixed.format().weight_frac_bits << " weight fractional bits is "
+              << (is_exact ? "exact" : "NOT exact") << " on this model\n";
+    report(snig_cpu_fixed, [&](snig::JSONWriter& json) {
+      json.field("fixed_point_exact", is_exact);
+    });
+  }
+  else if(mode == "SNIG_CPU") {
+    snig::SNIGCPU<float> snig_cpu(
+      weight_path,
+      bias,
+      num_neurons,
+      num_layers
+    );
+    snig_cpu.attach_metrics(metrics);
+    snig_cpu.set_affinity(affinity_policy);
+    snig_cpu.set_weight_layout(weight_layout_option);
+    snig_cpu.set_cache_blocking(cache_blocking_option);
+    snig_cpu.set_thresholds(thresholds);
+    snig_cpu.set_schedule(schedule_option);
+    result = snig_cpu.infer(input_path, 60000, input_batch_size, num_threads);
+    {
+      snig::LayerCounter total;
+      for(const auto& c : snig_cpu.layer_counters()) {
+        total += c;
+      }
+      std::cout << "Weight layout " << weight_layout << ": "
+                << total.weight_lines << " cache lines, "
+                << 100 * total.line_utilization() << "% utilized\n";
+      if(weight_layout_option == snig::WeightLayout::blocked) {
+        std::cout << "Cache blocking " << snig::to_string(snig_cpu.cache_blocking())
+                  << " (sub-block x row block)\n";
+      }
+      const auto& latencies = snig_cpu.batch_latencies();
+      std::cout << "Schedule " << schedule << ": mean latency of a batch of " << input_batch_size << " is "
+                << 1000 * std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size()
+                << " ms on " << num_threads << " threads\n";
+    }
+    if(roofline) {
+      std::cout << "Calibrating host......" << std::flush;
+      auto host = snig::calibrate_host<float>(num_threads, size_t(64) << 20, 5, &snig_cpu.placement());
+      std::cout << " triad " << host.triad_gbps << " GB/s, peak " << host.peak_gflops << " GFLOP/s\n";
+      snig::LayerCounter total;
+      for(const auto& c : snig_cpu.layer_counters()) {
+        total += c;
+      }
+      double seconds = total.seconds / num_threads;
+      double achieved = seconds > 0 ? total.flops / seconds / 1e9 : 0;
+      std::cout << "Achieved " << achieved << " GFLOP/s of attainable "
+                << host.attainable_gflops(total.intensity()) << " GFLOP/s"
+                << " at " << total.intensity() << " flop/byte\n";
+      report(snig_cpu, [&](snig::JSONWriter& json) {
+        json.key("roofline");
+        snig::dump_roofline(json, host, snig_cpu.layer_counters(), num_threads);
+      });
+    }
+    else {
+      report(snig_cpu);
+    }
+  }
+  else if(mode == "Sequential") {
+    snig::Sequential<float> sequential(
+      weight_path,
+      bias,
+      num_neurons,
+      num_layers
+    );
+    sequential.attach_metrics(metrics);
+    sequential.set_affinity(affinity_policy);
+    result = sequential.infer(input_path, 60000);
+    report(sequential);
+  }
+  else if(mode == "CPUParallel") {
+    snig::CPUParallel<float> cpu_parallel(
+      weight_path,
+      bias,
+      num_neurons,
+      num_layers
+    );
+    cpu_parallel.attach_metrics(metrics);
+    cpu_parallel.set_affinity(affinity_policy);
+    result = cpu_parallel.infer(input_path, 60000, input_batch_size, num_threads);
+    report(cpu_parallel);
+  }
+  else if(mode == "Hybrid") {
+    snig::HybridCPU<float> hybrid(
+      weight_path,
+      bias,
+      num_neurons,
+      num_layers
+    );
+    hybrid.attach_metrics(metrics);
+    hybrid.set_affinity(affinity_policy);
+    if(switch_row_ratio < 0 || switch_section_ratio < 0) {
+      hybrid.set_auto_calibrate(true);
+    }
+    else {
+      hybrid.set_switch_thresholds(switch_row_ratio, switch_section_ratio);
+    }
+    result = hybrid.infer(input_path, 60000, input_batch_size, num_threads);
+    report(hybrid);
+  }
+  else if(mode == "Server") {
+    snig::SNIGCPUServer<float> server(
+      weight_path,
+      bias,
+      num_neurons,
+      num_layers
+    );
+    server.attach_metrics(metrics);
+    server.set_affinity(affinity_policy);
+
+    snig::SchedulerOptions options;
+    options.order = snig::to_request_order(order);
+    options.policy = snig::to_admission_policy(admission);
+    options.capacity = queue_capacity;
+    options.unit_rows = unit_rows;
+    options.num_workers = num_threads;
+
+    const size_t num_inputs = 60000;
+    std::vector<float> input(num_inputs * num_neurons);
+    snig::read_input_binary<float>(input_path, input.data());
+
+    if(!capture_path.empty()) {
+      server.capture(capture_path);
+    }
+    server.start(options);
+
+    //bulk jobs first, then interactive requests arriving while they run
+    std::vector<std::future<snig::InferenceResponse> > bulk;
+    for(size_t j = 0; j < bulk_jobs; ++j) {
+      bulk.push_back(server.submit(std::vector<float>(input), 1));
+    }
+
+    std::mt19937 gen(0);
+    std::exponential_distribution<double> gap(interactive_rate);
+    std::vector<std::future<snig::InferenceResponse> > interactive;
+    std::vector<size_t> interactive_beg;
+    auto arrival = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < interactive_requests; ++i) {
+      arrival += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(gap(gen))
+      );
+      std::this_thread::sleep_until(arrival);
+      size_t beg = (i * interactive_rows) % (num_inputs - interactive_rows + 1);
+      interactive_beg.push_back(beg);
+      interactive.push_back(server.submit(
+        std::vector<float>(input.begin() + beg * num_neurons, input.begin() + (beg + interactive_rows) * num_neurons),
+        0,
+        std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double, std::milli>(deadline_ms)
+        )
+      ));
+    }
+
+    //categories of every input, from the first bulk job or else the interactive requests
+    std::vector<int> categories(num_inputs, -1);
+    size_t num_interactive_diffs{0};
+    for(size_t i = 0; i < interactive.size(); ++i) {
+      auto response = interactive[i].get();
+      for(size_t r = 0; r < response.categories.size(); ++r) {
+        categories[interactive_beg[i] + r] = response.categories[r];
+        num_interactive_diffs += response.categories[r] != int(golden.test(interactive_beg[i] + r));
+      }
+    }
+    for(size_t j = 0; j < bulk.size(); ++j) {
+      auto response = bulk[j].get();
+      if(j == 0 && response.admission == snig::Admission::accepted) {
+        categories = std::move(response.categories);
+      }
+    }
+    server.stop();
+    result = snig::arr_to_Eigen_int(categories.data(), num_inputs);
+
+    const char* names[] = {"interactive", "bulk"};
+    auto stats = server.scheduler().stats();
+    for(size_t c = 0; c < stats.size(); ++c) {
+      std::cout << names[c] << ": " << stats[c].num_completed << " of " << stats[c].num_submitted << " completed, "
+                << stats[c].num_rejected_full + stats[c].num_rejected_deadline << " rejected, "
+                << stats[c].num_deadline_misses << " deadline misses, p99 latency "
+                << stats[c].latency_percentile(99) << " ms\n";
+    }
+    std::cout << "Interactive categories different from golden: " << num_interactive_diffs << '\n';
+
+    report(server);
   }
   else {
     using namespace std::literals::string_literals;
     throw std::runtime_error("Error mode. Please correct your mode name"s);
   }
 
-  auto golden = snig::read_golden_binary(golden_path);
-  if(snig::is_passed(result, golden)) {
+  if(!metrics_path.empty()) {
+    metrics.write_file(metrics_path);
+  }
+
+  snig::CategoryBitset categories(result);
+  if(snig::is_passed(categories, golden)) {
     std::cout << "CHALLENGE PASSED\n";
   }
   else{
     std::cout << "CHALLENGE FAILED\n";
   }
+
+  if(!categories_output_path.empty()) {
+    snig::write_categories(categories_output_path, categories, categories_format_option, num_threads);
+  }
   return 0;
 }
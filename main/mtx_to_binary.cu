@@ -0,0 +1,168 @@
+#include <CLI11/CLI11.hpp>
+#include <SNIG/utility/mtx.hpp>
+#include <SNIG/utility/sections.hpp>
+#include <SNIG/utility/utility.hpp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+
+  // usage: ./mtx_to_binary
+  //          --manifest(-m)     :  manifest of the layer (and input) files
+  //          --output(-o)       :  weight directory of the packed model
+  //          --input_output     :  path of the packed input, default is sparse-images-<neurons>.b in the weight directory
+  //          --num_secs         :  number of equal sections (0 : as many as the GPU section size gives)
+  //          --section_offsets  :  section boundaries 0 ... num_neurons, sections of any width
+  //          --balance_sections :  cut sections of different widths that balance nnz (true, false)
+  //          --max_sec_size     :  widest balanced section (0 : twice the equal section size)
+  //          --pattern_value    :  value of the entries of pattern files
+  //          --num_threads      :  number of parsing threads
+
+  // example1:
+  //        ./mtx_to_binary -m ../dataset/mtx/model.manifest -o ../dataset/weight/mtx1024/
+  // example2:
+  //        ./mtx_to_binary -m model.manifest -o model/ --section_offsets 0 100 400 1024
+
+  // A manifest holds one line per layer, "layer <index> <path> [transposed]",
+  // and optionally "input <path>"; paths are relative to the manifest.
+  // Layers are square coordinate matrices of input by output neurons
+  // (output by input if transposed) in real, integer, or pattern entries,
+  // general, symmetric, or skew-symmetric.
+
+  CLI::App app{"Matrix Market importer"};
+
+  std::fs::path manifest_path;
+  app.add_option(
+    "-m, --manifest",
+    manifest_path,
+    "manifest of the layer and input files, one \"layer <index> <path> [transposed]\" or \"input <path>\" line each"
+  )->required()->check(CLI::ExistingFile);
+
+  std::fs::path weight_path;
+  app.add_option(
+    "-o, --output",
+    weight_path,
+    "weight directory of the packed model"
+  )->required();
+
+  std::fs::path input_output_path;
+  app.add_option(
+    "--input_output",
+    input_output_path,
+    "path of the packed input, default is sparse-images-<num_neurons>.b in the weight directory"
+  );
+
+  size_t num_secs = 0;
+  app.add_option(
+    "--num_secs",
+    num_secs,
+    "number of equal sections, default is 0 (the GPU section size, as to_binary)"
+  );
+
+  std::vector<int> section_offsets;
+  app.add_option(
+    "--section_offsets",
+    section_offsets,
+    "section boundaries from 0 to num_neurons, sections of any width for the CPU engines, default is equal sections"
+  );
+
+  bool balance_sections = false;
+  app.add_option(
+    "--balance_sections",
+    balance_sections,
+    "cut the output neurons into sections of different widths holding about the same nnz over all layers, default is false"
+  );
+
+  size_t max_sec_size = 0;
+  app.add_option(
+    "--max_sec_size",
+    max_sec_size,
+    "widest balanced section in neurons, default is 0 (twice the equal section size)"
+  );
+
+  float pattern_value = 1.0f;
+  app.add_option(
+    "--pattern_value",
+    pattern_value,
+    "value of the entries of pattern files, default is 1"
+  );
+
+  size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  app.add_option(
+    "--num_threads",
+    num_threads,
+    "number of parsing threads, default is the number of hardware threads"
+  );
+
+  CLI11_PARSE(app, argc, argv);
+
+  if(balance_sections && !section_offsets.empty()) {
+    std::cerr << "--balance_sections cuts its own sections, drop --section_offsets\n";
+    return 1;
+  }
+
+  auto manifest = snig::read_mtx_manifest(manifest_path);
+
+  //the first layer gives the width of the model
+  size_t num_neurons;
+  {
+    snig::MappedFile first(manifest.layers[0].path);
+    num_neurons = snig::parse_mtx_header(first.data(), first.size(), manifest.layers[0].path.string()).rows;
+  }
+  const size_t num_layers = manifest.layers.size();
+
+  snig::SectionLayout layout;
+  if(!section_offsets.empty()) {
+    layout.offsets = section_offsets;
+    if(section_offsets.front() != 0 || size_t(section_offsets.back()) != num_neurons ||
+       !std::is_sorted(section_offsets.begin(), section_offsets.end()) ||
+       std::adjacent_find(section_offsets.begin(), section_offsets.end()) != section_offsets.end()) {
+      std::cerr << "section offsets must rise strictly from 0 to " << num_neurons << '\n';
+      return 1;
+    }
+  }
+  else {
+    if(num_secs == 0) {
+      num_secs = num_neurons / snig::get_sec_size<float>(num_neurons);
+    }
+    layout = snig::uniform_sections(num_neurons, num_secs);
+  }
+
+  std::cout << "Importing " << num_layers << " layers of " << num_neurons << " neurons, "
+            << layout.num_secs() << " sections, " << num_threads << " threads...\n";
+
+  auto beg = std::chrono::steady_clock::now();
+  snig::mtx_manifest_to_binary_files<float>(manifest, weight_path, layout, pattern_value, num_threads);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+
+  size_t mtx_bytes{0};
+  for(const auto& layer : manifest.layers) {
+    mtx_bytes += std::fs::file_size(layer.path);
+  }
+  std::cout << "Imported " << (mtx_bytes >> 20) << " MB in " << seconds << " s ("
+            << mtx_bytes / seconds / (1 << 20) << " MB/s)\n";
+
+  if(balance_sections) {
+    auto nnz_per_neuron = snig::count_output_nnz_binary<float>(weight_path, num_neurons, num_layers);
+    auto balanced = snig::balance_sections(
+      nnz_per_neuron,
+      layout.num_secs(),
+      max_sec_size > 0 ? max_sec_size : std::min(num_neurons, 2 * layout.max_size())
+    );
+    std::cout << "Balancing sections... widest section " << balanced.max_size() << " neurons\n";
+    snig::repack_binary_sections<float>(weight_path, num_neurons, num_layers, balanced);
+    snig::write_model_header(snig::model_header_path(weight_path, num_neurons), balanced);
+  }
+
+  if(!manifest.input.empty()) {
+    if(input_output_path.empty()) {
+      input_output_path = weight_path / ("sparse-images-" + std::to_string(num_neurons) + ".b");
+    }
+    std::cout << "Importing input " << manifest.input.string() << "...\n";
+    snig::mtx_file_to_input_binary_file<float>(manifest.input, input_output_path, pattern_value, num_threads);
+  }
+
+  return 0;
+}
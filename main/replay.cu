@@ -0,0 +1,427 @@
+#include <CLI11/CLI11.hpp>
+#include <SNIG/snig_cpu/snig_cpu.hpp>
+#include <SNIG/snig_cpu/snig_cpu_server.hpp>
+#include <SNIG/hybrid_cpu/hybrid_cpu.hpp>
+#include <SNIG/utility/traffic_log.hpp>
+#include <SNIG/utility/request_scheduler.hpp>
+#include <SNIG/utility/json.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+
+  // usage:
+  //        --log                        :  path of a traffic log captured by ./snig -m Server --capture
+  //        --mode(-m)                   :  CPU engine serving the requests (Server, SNIG_CPU, Hybrid)
+  //        --weight(-w)                 :  path of weight directory
+  //        --num_neurons(-n)            :  number of neurons 1024, 4096, 16384, or 65536
+  //        --num_layers(-l)             :  number of layers 120, 480, or 1920
+  //        --bias(-b)                   :  bias
+  //        --pace                       :  arrival of the requests (open: at their captured times, fast: all at once)
+  //        --speed                      :  open pace: factor the captured times are sped up by
+  //        --deadlines                  :  keep the captured deadlines (true, false)
+  //        --num_threads                :  number of host threads (Server workers, SNIG_CPU or Hybrid threads)
+  //        --input_batch_size           :  SNIG_CPU, Hybrid: most inputs of one run, queued requests are run together
+  //        --weight_layout              :  SNIG_CPU: layout of the weight nonzeros (split, interleaved, sell, bsr, blocked)
+  //        --schedule                   :  SNIG_CPU: how a run is spread over the threads (batch, section)
+  //        --switch_row_ratio           :  Hybrid: fraction of surviving inputs at or below which a batch switches from BF to SNIG
+  //        --switch_section_ratio       :  Hybrid: fraction of active sections at or below which a batch switches from BF to SNIG
+  //        --order                      :  Server: order of pending requests (fifo, deadline)
+  //        --admission                  :  Server: what a full queue does to new requests (reject, block)
+  //        --queue_capacity             :  Server: pending inputs beyond which requests are rejected or blocked
+  //        --unit_rows                  :  Server: inputs a worker takes from a request at a time
+  //        --output(-o)                 :  path of JSON output, default is no file
+
+  // example1:
+  //        ./snig -m Server --capture traffic.log && ./replay --log traffic.log
+
+  // example2:
+  //        ./replay --log traffic.log -m SNIG_CPU --input_batch_size 256 --schedule section --pace open --speed 2 -o replay.json
+
+  // The latency of a request runs from the time it is due, its captured arrival
+  // (or the start with --pace fast), to its completion, so a replay that falls
+  // behind counts the time requests wait to be submitted.
+  //
+  // Only the CPU engines are replayed. The GPU engines read their inputs from
+  // a file and allocate their device buffers on every call, which is not a
+  // serving path worth timing request by request.
+
+  CLI::App app{"Traffic replay"};
+
+  std::fs::path log_path;
+  app.add_option(
+    "--log",
+    log_path,
+    "path of a traffic log captured by ./snig -m Server --capture"
+  )->required()->check(CLI::ExistingFile);
+
+  std::string mode = "Server";
+  app.add_option(
+    "-m, --mode",
+    mode,
+    "CPU engine serving the requests (Server, or SNIG_CPU or Hybrid running the queued requests together), default is Server"
+  );
+
+  std::fs::path weight_path("../sample_data/weight/neuron1024/");
+  app.add_option(
+    "-w, --weight",
+    weight_path,
+    "weight directory path, default is ../sample_data/weight/neuron1024/"
+  )->check(CLI::ExistingDirectory);
+
+  size_t num_neurons = 1024;
+  app.add_option(
+    "-n, --num_neurons",
+    num_neurons,
+    "total number of neurons, default is 1024"
+  );
+
+  size_t num_layers = 120;
+  app.add_option(
+    "-l, --num_layers",
+    num_layers,
+    "total number of layers, default is 120"
+  );
+
+  float bias = -0.3f;
+  app.add_option(
+    "-b, --bias",
+    bias,
+    "bias, default is -0.3"
+  );
+
+  std::string pace = "open";
+  app.add_option(
+    "--pace",
+    pace,
+    "arrival of the requests (open: at their captured times whatever the engine does, fast: all at once), default is open"
+  );
+
+  double speed = 1;
+  app.add_option(
+    "--speed",
+    speed,
+    "open pace: factor the captured arrival times are sped up by, default is 1"
+  );
+
+  bool keep_deadlines = true;
+  app.add_option(
+    "--deadlines",
+    keep_deadlines,
+    "keep the captured deadlines of the requests, default is true"
+  );
+
+  size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  app.add_option(
+    "--num_threads",
+    num_threads,
+    "number of Server workers or SNIG_CPU and Hybrid threads, default is the number of hardware threads"
+  );
+
+  size_t input_batch_size = 5000;
+  app.add_option(
+    "--input_batch_size",
+    input_batch_size,
+    "SNIG_CPU and Hybrid: most inputs of one run, requests queued behind a run are run together up to it, default is 5000"
+  );
+
+  std::string weight_layout = "split";
+  app.add_option(
+    "--weight_layout",
+    weight_layout,
+    "SNIG_CPU: layout of the weight nonzeros (split, interleaved, sell, bsr, or blocked), default is split"
+  );
+
+  std::string schedule = "batch";
+  app.add_option(
+    "--schedule",
+    schedule,
+    "SNIG_CPU: how a run is spread over the threads (batch or section), default is batch"
+  );
+
+  double switch_row_ratio = -1;
+  app.add_option(
+    "--switch_row_ratio",
+    switch_row_ratio,
+    "Hybrid: fraction of surviving inputs at or below which a batch moves from BF to SNIG, default is -1 (calibrate both on the first run)"
+  );
+
+  double switch_section_ratio = -1;
+  app.add_option(
+    "--switch_section_ratio",
+    switch_section_ratio,
+    "Hybrid: fraction of active (input, section) pairs at or below which a batch moves from BF to SNIG, default is -1 (calibrate both on the first run)"
+  );
+
+  std::string order = "deadline";
+  app.add_option(
+    "--order",
+    order,
+    "Server: order of pending requests (fifo, or deadline), default is deadline"
+  );
+
+  std::string admission = "reject";
+  app.add_option(
+    "--admission",
+    admission,
+    "Server: what a full queue does to new requests (reject, or block), default is reject"
+  );
+
+  size_t queue_capacity = 120000;
+  app.add_option(
+    "--queue_capacity",
+    queue_capacity,
+    "Server: pending inputs beyond which new requests are rejected or blocked, default is 120000"
+  );
+
+  size_t unit_rows = 256;
+  app.add_option(
+    "--unit_rows",
+    unit_rows,
+    "Server: inputs a worker takes from a request at a time, default is 256"
+  );
+
+  std::fs::path output_path;
+  app.add_option(
+    "-o, --output",
+    output_path,
+    "JSON output path, default is no file"
+  );
+
+  CLI11_PARSE(app, argc, argv);
+
+  using clock = std::chrono::steady_clock;
+
+  if(pace != "open" && pace != "fast") {
+    std::cerr << "unknown pace " << pace << " (open or fast)\n";
+    return 1;
+  }
+  const bool is_open = pace == "open";
+
+  auto log = snig::read_traffic_log(log_path);
+  if(log.num_neurons != num_neurons) {
+    std::cerr << log_path << " holds rows of " << log.num_neurons << " neurons, the model has " << num_neurons << '\n';
+    return 1;
+  }
+  if(log.is_truncated) {
+    std::cout << "The last record of " << log_path << " is cut short and dropped\n";
+  }
+  const size_t num_requests = log.requests.size();
+  std::cout << "Replaying " << num_requests << " requests of " << log.num_rows() << " inputs on " << mode
+            << ", " << pace << " pace";
+  if(is_open) {
+    std::cout << " x" << speed;
+  }
+  std::cout << "...\n";
+
+  auto to_duration = [](const double ns) {
+    return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::nano>(ns));
+  };
+  auto to_ms = [](const clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  };
+
+  //latency of every completed request, due to completion
+  std::vector<double> latency_ms;
+  size_t num_rejected{0};
+  size_t num_deadline_misses{0};
+  size_t num_completed_inputs{0};
+  size_t num_active{0};
+
+  std::ofstream file;
+  if(!output_path.empty()) {
+    file.open(output_path);
+  }
+  //the JSON goes nowhere without --output
+  std::ostringstream discard;
+  snig::JSONWriter json(output_path.empty() ? static_cast<std::ostream&>(discard) : file);
+  json.begin_object();
+  json.field("log", log_path.string());
+  json.field("mode", mode);
+  json.field("pace", pace);
+  json.field("speed", speed);
+  json.field("num_threads", num_threads);
+
+  clock::time_point start;
+  clock::time_point end;
+
+  if(mode == "Server") {
+    snig::SNIGCPUServer<float> server(weight_path, bias, num_neurons, num_layers);
+
+    snig::SchedulerOptions options;
+    options.order = snig::to_request_order(order);
+    options.policy = snig::to_admission_policy(admission);
+    options.capacity = queue_capacity;
+    options.unit_rows = unit_rows;
+    options.num_workers = num_threads;
+    for(const auto& r : log.requests) {
+      options.num_classes = std::max(options.num_classes, r.priority + 1);
+    }
+    server.start(options);
+
+    std::vector<std::future<snig::InferenceResponse> > futures;
+    std::vector<clock::time_point> due(num_requests);
+    std::vector<clock::time_point> submitted(num_requests);
+
+    start = clock::now();
+    for(size_t i = 0; i < num_requests; ++i) {
+      const auto& r = log.requests[i];
+      //the rows are built before the request is due
+      auto rows = log.dense_rows<float>(i);
+      due[i] = is_open ? start + to_duration(r.arrival_ns / speed) : start;
+      std::this_thread::sleep_until(due[i]);
+      submitted[i] = clock::now();
+      futures.push_back(server.submit(
+        std::move(rows),
+        r.priority,
+        keep_deadlines && r.deadline_ns > 0 ? submitted[i] + to_duration(r.deadline_ns) : clock::time_point::max()
+      ));
+    }
+
+    end = start;
+    for(size_t i = 0; i < num_requests; ++i) {
+      auto response = futures[i].get();
+      if(response.admission != snig::Admission::accepted) {
+        ++num_rejected;
+        continue;
+      }
+      auto done = submitted[i] + to_duration(response.latency_ms * 1e6);
+      end = std::max(end, done);
+      latency_ms.push_back(to_ms(done - due[i]));
+      num_deadline_misses += response.is_deadline_missed;
+      num_completed_inputs += response.categories.size();
+      num_active += std::count(response.categories.begin(), response.categories.end(), 1);
+    }
+    server.stop();
+
+    json.key("engine").begin_object();
+    server.report(json);
+    json.end_object();
+  }
+  else if(mode == "SNIG_CPU" || mode == "Hybrid") {
+    start = clock::now();
+    auto due = [&](const size_t i) {
+      return is_open ? start + to_duration(log.requests[i].arrival_ns / speed) : start;
+    };
+
+    //one run at a time, each takes the first pending request and the
+    //requests due behind it while they fit in a batch; consecutive requests
+    //are consecutive rows of the log, run(row_beg, num_rows) infers them
+    //and returns the number of active inputs
+    auto replay = [&](auto&& run) {
+      for(size_t next = 0; next < num_requests; ) {
+        std::this_thread::sleep_until(due(next));
+        const auto now = clock::now();
+        size_t last = next + 1;
+        size_t num_rows = log.requests[next].num_rows;
+        while(last < num_requests && due(last) <= now && num_rows + log.requests[last].num_rows <= input_batch_size) {
+          num_rows += log.requests[last++].num_rows;
+        }
+
+        num_active += run(log.requests[next].row_beg, num_rows);
+        const auto done = clock::now();
+        end = done;
+
+        for(size_t i = next; i < last; ++i) {
+          const auto& r = log.requests[i];
+          latency_ms.push_back(to_ms(done - due(i)));
+          num_deadline_misses += keep_deadlines && r.deadline_ns > 0 && done > due(i) + to_duration(r.deadline_ns);
+        }
+        num_completed_inputs += num_rows;
+        next = last;
+      }
+    };
+
+    json.field("input_batch_size", input_batch_size);
+    json.key("engine").begin_object();
+    if(mode == "SNIG_CPU") {
+      snig::SNIGCPU<float> snig_cpu(weight_path, bias, num_neurons, num_layers);
+      snig_cpu.set_weight_layout(snig::to_weight_layout(weight_layout));
+      snig_cpu.set_schedule(snig::to_cpu_schedule(schedule));
+      //one run per group of requests, too many to log
+      snig_cpu.set_quiet(true);
+
+      //the log's rows are read in place
+      replay([&](const size_t row_beg, const size_t num_rows) {
+        return snig_cpu.infer_csr(
+          log.row_ptr.data() + row_beg,
+          log.col_idx.data(),
+          log.values.data(),
+          num_rows,
+          input_batch_size,
+          num_threads
+        ).count();
+      });
+      snig_cpu.report(json);
+    }
+    else {
+      snig::HybridCPU<float> hybrid(weight_path, bias, num_neurons, num_layers);
+      hybrid.set_quiet(true);
+      if(switch_row_ratio >= 0 && switch_section_ratio >= 0) {
+        hybrid.set_switch_thresholds(switch_row_ratio, switch_section_ratio);
+      }
+      else {
+        hybrid.set_auto_calibrate(true);
+      }
+
+      //both kernels take dense rows, scattered from the log into one buffer
+      std::vector<float> rows;
+      replay([&](const size_t row_beg, const size_t num_rows) {
+        rows.assign(num_rows * num_neurons, 0.0f);
+        for(size_t r = 0; r < num_rows; ++r) {
+          for(size_t k = log.row_ptr[row_beg + r]; k < log.row_ptr[row_beg + r + 1]; ++k) {
+            rows[r * num_neurons + log.col_idx[k]] = log.values[k];
+          }
+        }
+        size_t count = hybrid.infer_dense(rows.data(), num_rows, input_batch_size, num_threads).count();
+        //the first run calibrates the switch, the later ones keep it
+        hybrid.set_switch_thresholds(hybrid.row_ratio_threshold(), hybrid.section_ratio_threshold());
+        return count;
+      });
+      hybrid.report(json);
+    }
+    json.end_object();
+  }
+  else {
+    std::cerr << "unknown mode " << mode << " (Server, SNIG_CPU, or Hybrid)\n";
+    return 1;
+  }
+
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  const double percentiles[] = {50, 90, 99, 99.9, 100};
+  const char* names[] = {"p50", "p90", "p99", "p999", "max"};
+
+  std::cout << latency_ms.size() << " of " << num_requests << " requests completed, "
+            << num_rejected << " rejected, " << num_deadline_misses << " deadline misses in " << seconds << " s\n"
+            << "Throughput " << (seconds > 0 ? num_completed_inputs / seconds : 0) << " inputs/s, "
+            << (seconds > 0 ? latency_ms.size() / seconds : 0) << " requests/s\n"
+            << "Latency (ms)";
+  for(size_t p = 0; p < 5; ++p) {
+    std::cout << ' ' << names[p] << ' ' << snig::latency_percentile(latency_ms, percentiles[p]);
+  }
+  std::cout << "\nActive inputs " << num_active << " of " << num_completed_inputs << '\n';
+
+  json.field("num_requests", num_requests);
+  json.field("num_inputs", log.num_rows());
+  json.field("num_completed", latency_ms.size());
+  json.field("num_rejected", num_rejected);
+  json.field("num_deadline_misses", num_deadline_misses);
+  json.field("num_active_inputs", num_active);
+  json.field("seconds", seconds);
+  json.field("inputs_per_second", seconds > 0 ? num_completed_inputs / seconds : 0);
+  json.field("requests_per_second", seconds > 0 ? latency_ms.size() / seconds : 0);
+  json.key("latency_ms").begin_object();
+  for(size_t p = 0; p < 5; ++p) {
+    json.field(names[p], snig::latency_percentile(latency_ms, percentiles[p]));
+  }
+  json.end_object();
+  json.end_object();
+
+  return 0;
+}
@@ -0,0 +1,345 @@
+#include <CLI11/CLI11.hpp>
+#include <SNIG/snig_cpu/snig_cpu.hpp>
+#include <SNIG/utility/simulator.hpp>
+#include <SNIG/utility/json.hpp>
+#include <SNIG/utility/metrics.hpp>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <cmath>
+
+int main(int argc, char* argv[]) {
+
+  //  ***All files should be converted to binary first***
+
+  // usage:
+  //        --weight(-w)                 :  path of weight directory
+  //        --input(-i)                  :  path of input file
+  //        --num_neurons(-n)            :  number of neurons 1024, 4096, 16384, or 65536
+  //        --num_layers(-l)             :  number of layers 120, 480, or 1920
+  //        --bias(-b)                   :  bias
+  //        --schedules                  :  simulated schedules (snig, gpipe, bf)
+  //        --num_devices                :  simulated device counts
+  //        --input_batch_size           :  input batch size of SNIG and GPipe
+  //        --num_weight_buffers         :  number of weight buffers of SNIG
+  //        --host_gbps                  :  GB/s of the link of each device to the host, 0 for free copies
+  //        --peer_gbps                  :  GB/s between devices, 0 for free handovers
+  //        --transfer_us                :  fixed cost of every transfer
+  //        --launch_us                  :  fixed cost of every kernel launch
+  //        --device_speedup             :  how much faster a device runs a layer than the cost table says
+  //        --cost_table                 :  per-layer costs (<layer> <seconds per row> per line) instead of measuring them
+  //        --write_cost_table           :  save the measured costs as a table
+  //        --validate                   :  run SNIG_CPU with one thread per simulated device and compare
+  //        --output(-o)                 :  path of JSON output, default is no file
+
+  // example1:
+  //        ./simulate
+
+  // example2:
+  //        ./simulate -w ../sample_data/weight/neuron1024/ -i ../sample_data/MNIST/sparse-images-1024.b -n 1024 -l 120 --schedules snig gpipe bf --num_devices 1 2 4 8 --device_speedup 40 -o simulate.json
+
+  // The layer costs are measured by a one-thread run of SNIG_CPU unless a
+  // table is given. --validate treats every SNIG_CPU thread as a device with
+  // free transfers, which is what the SNIG schedule is on the host, and
+  // reports the simulated against the measured time of each device count.
+  // Threads beyond the hardware threads are simulated as slower devices.
+
+  CLI::App app{"Multi-device schedule simulator"};
+
+  std::fs::path weight_path("../sample_data/weight/neuron1024/");
+  app.add_option(
+    "-w, --weight",
+    weight_path,
+    "weight directory path, default is ../sample_data/weight/neuron1024/"
+  )->check(CLI::ExistingDirectory);
+
+  std::fs::path input_path("../sample_data/MNIST/sparse-images-1024.b");
+  app.add_option(
+    "-i, --input",
+    input_path,
+    "input binary file path, default is ../sample_data/MNIST/sparse-images-1024.b"
+  )->check(CLI::ExistingFile);
+
+  size_t num_neurons = 1024;
+  app.add_option(
+    "-n, --num_neurons",
+    num_neurons,
+    "total number of neurons, default is 1024"
+  );
+
+  size_t num_layers = 120;
+  app.add_option(
+    "-l, --num_layers",
+    num_layers,
+    "total number of layers, default is 120"
+  );
+
+  float bias = -0.3f;
+  app.add_option(
+    "-b, --bias",
+    bias,
+    "bias, default is -0.3"
+  );
+
+  std::vector<std::string> schedules{"snig", "gpipe", "bf"};
+  app.add_option(
+    "--schedules",
+    schedules,
+    "simulated schedules (snig, gpipe, bf), default is all three"
+  );
+
+  std::vector<size_t> device_counts{1, 2, 4, 8};
+  app.add_option(
+    "--num_devices",
+    device_counts,
+    "simulated device counts, default is 1 2 4 8"
+  );
+
+  size_t input_batch_size = 5000;
+  app.add_option(
+    "--input_batch_size",
+    input_batch_size,
+    "number of input bath size, default is 5000"
+  );
+
+  size_t num_weight_buffers = 2;
+  app.add_option(
+    "--num_weight_buffers",
+    num_weight_buffers,
+    "number of weight buffers of SNIG, default is 2"
+  );
+
+  snig::TransferModel transfer;
+  app.add_option(
+    "--host_gbps",
+    transfer.host_gbps,
+    "GB/s of the link of each device to the host, 0 for free copies, default is 12"
+  );
+  app.add_option(
+    "--peer_gbps",
+    transfer.peer_gbps,
+    "GB/s between devices, 0 for free handovers, default is 25"
+  );
+  app.add_option(
+    "--transfer_us",
+    transfer.transfer_us,
+    "fixed cost of every transfer in microseconds, default is 10"
+  );
+  app.add_option(
+    "--launch_us",
+    transfer.launch_us,
+    "fixed cost of every kernel launch in microseconds, default is 5"
+  );
+
+  double device_speedup = 1;
+  app.add_option(
+    "--device_speedup",
+    device_speedup,
+    "how much faster a device runs a layer than the cost table says, default is 1"
+  );
+
+  std::fs::path cost_table_path;
+  app.add_option(
+    "--cost_table",
+    cost_table_path,
+    "per-layer costs, one \"<layer> <seconds per row>\" line each, default is to measure them"
+  )->check(CLI::ExistingFile);
+
+  std::fs::path write_cost_table_path;
+  app.add_option(
+    "--write_cost_table",
+    write_cost_table_path,
+    "save the measured per-layer costs as a table"
+  );
+
+  bool is_validated{false};
+  app.add_flag(
+    "--validate",
+    is_validated,
+    "run SNIG_CPU with one thread per simulated device and compare"
+  );
+
+  std::fs::path output_path;
+  app.add_option(
+    "-o, --output",
+    output_path,
+    "JSON output path, default is no file"
+  );
+
+  CLI11_PARSE(app, argc, argv);
+
+  const size_t num_inputs = 60000;
+
+  snig::SNIGCPU<float> snig_cpu(
+    weight_path,
+    bias,
+    num_neurons,
+    num_layers
+  );
+
+  snig::LayerCosts costs;
+  if(!cost_table_path.empty()) {
+    costs = snig::read_layer_costs(cost_table_path);
+  }
+  else {
+    std::cout << "measuring layer costs with one thread......\n";
+    snig_cpu.infer(input_path, num_inputs, input_batch_size, 1);
+    costs = snig::layer_costs(snig_cpu.layer_counters(), num_inputs);
+  }
+  if(costs.num_layers() != num_layers) {
+    std::cerr << "cost table has " << costs.num_layers() << " layers, the model has " << num_layers << '\n';
+    return 1;
+  }
+  if(!write_cost_table_path.empty()) {
+    snig::write_layer_costs(write_cost_table_path, costs);
+  }
+
+  std::ofstream file;
+  if(!output_path.empty()) {
+    file.open(output_path);
+  }
+  //the JSON goes nowhere without --output
+  std::ostringstream discard;
+  snig::JSONWriter json(output_path.empty() ? static_cast<std::ostream&>(discard) : file);
+  json.begin_object();
+  json.field("weight", weight_path.string());
+  json.field("num_neurons", num_neurons);
+  json.field("num_layers", num_layers);
+  json.field("cost_table", cost_table_path.empty() ? std::string("measured") : cost_table_path.string());
+  json.key("seconds_per_row").begin_array();
+  for(auto s : costs.seconds_per_row) {
+    json.value(s);
+  }
+  json.end_array();
+  json.key("transfer");
+  transfer.dump(json);
+
+  snig::SimulationConfig config;
+  config.num_inputs = num_inputs;
+  config.batch_size = input_batch_size;
+  config.num_weight_buffers = num_weight_buffers;
+  config.layer_bytes = snig_cpu.layer_bytes();
+  config.row_bytes = sizeof(float) * num_neurons;
+  config.device_speedup = device_speedup;
+
+  std::cout << std::setw(8) << "schedule"
+            << std::setw(9) << "devices"
+            << std::setw(14) << "makespan(ms)"
+            << std::setw(14) << "inputs/s"
+            << std::setw(9) << "scaling"
+            << std::setw(13) << "utilization"
+            << std::setw(11) << "fill(ms)"
+            << std::setw(12) << "bubble(ms)"
+            << std::setw(11) << "drain(ms)" << '\n';
+
+  json.key("simulations").begin_array();
+  for(const auto& name : schedules) {
+    config.schedule = snig::to_simulated_schedule(name);
+    //scaling is over the first device count
+    double base_makespan{0};
+    for(auto num_devices : device_counts) {
+      config.num_devices = num_devices;
+      snig::SimulationResult result;
+      try {
+        result = snig::simulate_schedule(config, costs, transfer);
+      }
+      catch(const std::exception& e) {
+        std::cout << std::setw(8) << name << std::setw(9) << num_devices << "  " << e.what() << '\n';
+        continue;
+      }
+      if(base_makespan == 0) {
+        base_makespan = result.makespan;
+      }
+
+      //worst device of each kind of idle time
+      double fill{0};
+      double bubble{0};
+      double drain{0};
+      for(const auto& d : result.devices) {
+        fill = std::max(fill, d.fill_seconds());
+        bubble = std::max(bubble, d.bubble_seconds());
+        drain = std::max(drain, d.drain_seconds(result.makespan));
+      }
+
+      std::cout << std::setw(8) << name
+                << std::setw(9) << num_devices
+                << std::setw(14) << result.makespan * 1000
+                << std::setw(14) << result.inputs_per_second(num_inputs)
+                << std::setw(9) << base_makespan / result.makespan
+                << std::setw(13) << result.average_utilization()
+                << std::setw(11) << fill * 1000
+                << std::setw(12) << bubble * 1000
+                << std::setw(11) << drain * 1000 << '\n';
+
+      json.begin_object();
+      json.key("config");
+      config.dump(json);
+      json.key("result");
+      result.dump(json);
+      json.end_object();
+    }
+  }
+  json.end_array();
+
+  if(is_validated) {
+    //threads of SNIG_CPU fetch batches like SNIG devices and share host memory
+    snig::TransferModel host_memory;
+    host_memory.host_gbps = 0;
+    host_memory.peer_gbps = 0;
+    host_memory.transfer_us = 0;
+    host_memory.launch_us = 0;
+
+    snig::SimulationConfig cpu_config = config;
+    cpu_config.schedule = snig::SimulatedSchedule::snig;
+    cpu_config.device_speedup = 1;
+
+    snig::MetricsRegistry registry;
+    snig_cpu.attach_metrics(registry);
+    auto& infer_seconds = registry.counter("snig_infer_seconds_total", "time spent in inference");
+
+    std::cout << "\nvalidation against SNIG_CPU, one thread per device\n"
+              << std::setw(9) << "devices"
+              << std::setw(15) << "simulated(ms)"
+              << std::setw(14) << "measured(ms)"
+              << std::setw(10) << "error" << '\n';
+
+    //threads beyond the hardware threads take turns on them
+    const size_t num_cores = std::max(1u, std::thread::hardware_concurrency());
+
+    json.key("validation").begin_array();
+    for(auto num_devices : device_counts) {
+      cpu_config.num_devices = num_devices;
+      cpu_config.device_speedup = std::min(1.0, double(num_cores) / num_devices);
+      auto result = snig::simulate_schedule(cpu_config, costs, host_memory);
+
+      //inference time of the engine, without reading the input
+      double beg = infer_seconds.value();
+      snig_cpu.infer(input_path, num_inputs, input_batch_size, num_devices);
+      double ms = (infer_seconds.value() - beg) * 1000;
+      double error = (result.makespan * 1000 - ms) / ms;
+
+      std::cout << std::setw(9) << num_devices
+                << std::setw(15) << result.makespan * 1000
+                << std::setw(14) << ms
+                << std::setw(9) << error * 100 << "%\n";
+
+      json.begin_object();
+      json.field("num_threads", num_devices);
+      json.field("num_hardware_threads", num_cores);
+      json.field("simulated_ms", result.makespan * 1000);
+      json.field("measured_ms", ms);
+      json.field("relative_error", error);
+      json.key("simulated");
+      result.dump(json);
+      json.end_object();
+    }
+    json.end_array();
+  }
+
+  json.end_object();
+
+  return 0;
+}
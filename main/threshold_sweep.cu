@@ -0,0 +1,254 @@
+#include <CLI11/CLI11.hpp>
+#include <SNIG/snig_cpu/snig_cpu.hpp>
+#include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/scoring.hpp>
+#include <SNIG/utility/json.hpp>
+#include <SNIG/utility/metrics.hpp>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+
+  //  ***All files should be converted to binary first***
+
+  // usage:
+  //        --weight(-w)                 :  path of weight directory
+  //        --input(-i)                  :  path of input file
+  //        --golden(-g)                 :  path of golden file
+  //        --num_neurons(-n)            :  number of neurons 1024, 4096, 16384, or 65536
+  //        --num_layers(-l)             :  number of layers 120, 480, or 1920
+  //        --bias(-b)                   :  bias
+  //        --input_batch_size           :  input batch size of SNIG_CPU
+  //        --num_threads                :  number of host threads of SNIG_CPU
+  //        --weight_layout              :  layout of the weight nonzeros of SNIG_CPU (split, interleaved, sell, bsr)
+  //        --thresholds                 :  sweep points, one threshold applied to every layer
+  //        --threshold_file             :  more sweep points, one line of per-layer thresholds each
+  //        --output(-o)                 :  path of JSON output, default is no file
+
+  // example1:
+  //        ./threshold_sweep
+
+  // example2:
+  //        ./threshold_sweep -w ../sample_data/weight/neuron1024/ -i ../sample_data/MNIST/sparse-images-1024.b -g ../sample_data/MNIST/neuron1024-l120-categories.b -n 1024 -l 120 -b -0.3 --thresholds 0.5 1 2 4 -o sweep.json
+
+  // Every sweep point runs SNIG_CPU in approximate mode and is compared with
+  // the exact run (threshold 0) for throughput and with the golden file for categories.
+
+  CLI::App app{"Threshold sweep"};
+
+  std::fs::path weight_path("../sample_data/weight/neuron1024/");
+  app.add_option(
+    "-w, --weight",
+    weight_path,
+    "weight directory path, default is ../sample_data/weight/neuron1024/"
+  )->check(CLI::ExistingDirectory);
+
+  std::fs::path input_path("../sample_data/MNIST/sparse-images-1024.b");
+  app.add_option(
+    "-i, --input",
+    input_path,
+    "input binary file path, default is ../sample_data/MNIST/sparse-images-1024.b"
+  )->check(CLI::ExistingFile);
+
+  std::fs::path golden_path("../sample_data/MNIST/neuron1024-l120-categories.b");
+  app.add_option(
+    "-g, --golden",
+    golden_path,
+    "golden binary file path, default is ../sample_data/MNIST/neuron1024-l120-categories.b"
+  )->check(CLI::ExistingFile);
+
+  size_t num_neurons = 1024;
+  app.add_option(
+    "-n, --num_neurons",
+    num_neurons,
+    "total number of neurons, default is 1024"
+  );
+
+  size_t num_layers = 120;
+  app.add_option(
+    "-l, --num_layers",
+    num_layers,
+    "total number of layers, default is 120"
+  );
+
+  float bias = -0.3f;
+  app.add_option(
+    "-b, --bias",
+    bias,
+    "bias, default is -0.3"
+  );
+
+  size_t input_batch_size = 5000;
+  app.add_option(
+    "--input_batch_size",
+    input_batch_size,
+    "number of input bath size, default is 5000"
+  );
+
+  size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  app.add_option(
+    "--num_threads",
+    num_threads,
+    "number of host threads, default is the number of hardware threads"
+  );
+
+  std::string weight_layout = "split";
+  app.add_option(
+    "--weight_layout",
+    weight_layout,
+    "layout of the weight nonzeros (split, interleaved, sell, or bsr), default is split"
+  );
+
+  std::vector<float> uniform_thresholds{0.25f, 0.5f, 1.0f, 2.0f, 4.0f};
+  app.add_option(
+    "--thresholds",
+    uniform_thresholds,
+    "sweep points applied to every layer, default is 0.25 0.5 1 2 4"
+  );
+
+  std::fs::path threshold_path;
+  app.add_option(
+    "--threshold_file",
+    threshold_path,
+    "text file of more sweep points, one line of num_layers whitespace-separated thresholds each"
+  )->check(CLI::ExistingFile);
+
+  std::fs::path output_path;
+  app.add_option(
+    "-o, --output",
+    output_path,
+    "JSON output path, default is no file"
+  );
+
+  CLI11_PARSE(app, argc, argv);
+
+  const size_t num_inputs = 60000;
+
+  //the exact run comes first and is the baseline of every speedup
+  std::vector<std::vector<float> > points{{}};
+  for(auto t : uniform_thresholds) {
+    points.push_back({t});
+  }
+  if(!threshold_path.empty()) {
+    std::ifstream in(threshold_path);
+    std::string line;
+    for(size_t line_number = 1; std::getline(in, line); ++line_number) {
+      std::istringstream iss(line);
+      std::vector<float> p{std::istream_iterator<float>(iss), std::istream_iterator<float>()};
+      if(p.empty() && iss.eof()) {
+        continue;
+      }
+      //a token that is not a number stops the iterator before the end
+      if(!iss.eof() || p.size() != num_layers) {
+        std::cerr << threshold_path.string() << ':' << line_number
+                  << ": expect " << num_layers << " thresholds, one per layer\n";
+        return 1;
+      }
+      points.push_back(std::move(p));
+    }
+  }
+
+  auto golden = snig::read_category_bitset(golden_path);
+
+  //read once, every sweep point infers the same rows in place
+  std::vector<float> input(num_inputs * num_neurons);
+  snig::read_input_binary<float>(input_path, input.data());
+
+  snig::SNIGCPU<float> snig_cpu(
+    weight_path,
+    bias,
+    num_neurons,
+    num_layers
+  );
+  snig_cpu.set_weight_layout(snig::to_weight_layout(weight_layout));
+
+  snig::MetricsRegistry registry;
+  snig_cpu.attach_metrics(registry);
+  auto& infer_seconds = registry.counter("snig_infer_seconds_total", "time spent in inference");
+
+  auto describe = [](const std::vector<float>& p) {
+    if(p.empty()) {
+      return std::string("exact");
+    }
+    if(p.size() == 1) {
+      std::ostringstream oss;
+      oss << p[0];
+      return oss.str();
+    }
+    return std::string("per-layer");
+  };
+
+  std::ofstream file;
+  if(!output_path.empty()) {
+    file.open(output_path);
+  }
+  //the JSON goes nowhere without --output
+  std::ostringstream discard;
+  snig::JSONWriter json(output_path.empty() ? static_cast<std::ostream&>(discard) : file);
+  json.begin_object();
+  json.field("weight", weight_path.string());
+  json.field("num_neurons", num_neurons);
+  json.field("num_layers", num_layers);
+  json.field("input_batch_size", input_batch_size);
+  json.field("num_threads", num_threads);
+  json.field("weight_layout", weight_layout);
+  json.key("points").begin_array();
+
+  std::cout << std::setw(12) << "threshold"
+            << std::setw(14) << "time(ms)"
+            << std::setw(16) << "inputs/s"
+            << std::setw(10) << "speedup"
+            << std::setw(14) << "mismatches"
+            << std::setw(10) << "passed" << '\n';
+
+  double exact_ms{0};
+  for(const auto& p : points) {
+    snig_cpu.set_thresholds(p);
+
+    //inference time of the engine, without preparing its buffers
+    double beg = infer_seconds.value();
+    snig_cpu.infer_dense(input.data(), num_inputs, input_batch_size, num_threads);
+    double ms = (infer_seconds.value() - beg) * 1000;
+    if(p.empty()) {
+      exact_ms = ms;
+    }
+
+    //the counting of is_passed, without its printout for every point
+    size_t num_diffs = snig::num_different_categories(snig_cpu.categories(), golden);
+    double throughput = num_inputs / (ms / 1000);
+    double speedup = exact_ms / ms;
+
+    std::cout << std::setw(12) << describe(p)
+              << std::setw(14) << ms
+              << std::setw(16) << throughput
+              << std::setw(10) << speedup
+              << std::setw(14) << num_diffs
+              << std::setw(10) << (num_diffs == 0 ? "yes" : "no") << '\n';
+
+    json.begin_object();
+    json.key("thresholds").begin_array();
+    for(auto t : p) {
+      json.value(t);
+    }
+    json.end_array();
+    json.field("ms", ms);
+    json.field("inputs_per_second", throughput);
+    json.field("speedup", speedup);
+    json.field("num_different_categories", num_diffs);
+    json.field("passed", num_diffs == 0);
+    json.key("engine").begin_object();
+    snig_cpu.report(json);
+    json.end_object();
+    json.end_object();
+  }
+
+  json.end_array();
+  json.end_object();
+
+  return 0;
+}
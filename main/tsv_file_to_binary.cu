@@ -1,6 +1,10 @@
 #include <CLI11/CLI11.hpp>
 #include <SNIG/utility/reader.hpp>
+#include <SNIG/utility/tsv_stream.hpp>
 #include <SNIG/utility/utility.hpp>
+#include <SNIG/utility/sell.hpp>
+#include <SNIG/utility/bsr.hpp>
+#include <SNIG/utility/sections.hpp>
 #include <vector>
 
 void convert_to_binary(
@@ -10,7 +14,12 @@ void convert_to_binary(
   const size_t num_neurons,
   const size_t sec_size,
   const size_t num_secs,
-  const size_t num_layers=1920
+  const size_t num_layers=1920,
+  const size_t sell_c=0,
+  const size_t sell_sigma=0,
+  const double bsr_min_fill=0,
+  const bool balance_sections=false,
+  const size_t max_sec_size=0
 );
 
 int main(int argc, char* argv[]) {
@@ -19,6 +28,11 @@ int main(int argc, char* argv[]) {
   //          --neurons(-n) :  1024, 4096, or 16384
   //          --convert_all :  convert all files (true, false)
   //          --sample_data :  use sample_data (true, false)
+  //          --sell_c      :  also write SELL-C-sigma layers with chunks of sell_c neurons (0 : none)
+  //          --sell_sigma  :  sorting window of SELL-C-sigma (0 : whole section)
+  //          --bsr_min_fill:  also write BSR layers, blocks must be at least this full (0 : none)
+  //          --balance_sections : cut sections of different widths that balance nnz (true, false)
+  //          --max_sec_size:  widest balanced section (0 : twice the equal section size)
 
   // example1:
   //        ./to_binary --sample_data true
@@ -29,6 +43,10 @@ int main(int argc, char* argv[]) {
 
   // sec_size, num_secs would be caculated automatically based on GPU architecture.
 
+  // Weights and inputs still compressed as downloaded (weight/neuron<n>.tar.gz,
+  // MNIST/sparse-images-<n>.tsv.gz, see get_dataset.sh --no_extract) are converted
+  // straight from the archives when their extracted .tsv files are missing.
+
   CLI::App app{"Converter"};
 
   size_t num_neurons = 1024;
@@ -52,6 +70,41 @@ int main(int argc, char* argv[]) {
     "convert sample data to binary file, default is false"
   );
 
+  size_t sell_c = 0;
+  app.add_option(
+    "--sell_c", 
+    sell_c, 
+    "also write SELL-C-sigma layers (.sell) with chunks of sell_c neurons, must divide the section size, default is 0 (none)"
+  );
+
+  size_t sell_sigma = 0;
+  app.add_option(
+    "--sell_sigma", 
+    sell_sigma, 
+    "sorting window of SELL-C-sigma layers in neurons, default is 0 (whole section)"
+  );
+
+  double bsr_min_fill = 0;
+  app.add_option(
+    "--bsr_min_fill", 
+    bsr_min_fill, 
+    "also write block sparse layers (.bsr) with the block shape storing the fewest entries at this fill ratio or more, layers below it stay packed, default is 0 (none)"
+  );
+
+  bool balance_sections = false;
+  app.add_option(
+    "--balance_sections", 
+    balance_sections, 
+    "cut the output neurons into sections of different widths holding about the same nnz over all layers, and record them in the model header, CPU engines only, default is false"
+  );
+
+  size_t max_sec_size = 0;
+  app.add_option(
+    "--max_sec_size", 
+    max_sec_size, 
+    "widest balanced section in neurons, the scratch of a CPU thread, default is 0 (twice the equal section size)"
+  );
+
   std::fs::path weight_path;
 
   std::fs::path input_path;
@@ -60,6 +113,11 @@ int main(int argc, char* argv[]) {
 
   CLI11_PARSE(app, argc, argv);
 
+  if(balance_sections && (sell_c > 0 || bsr_min_fill > 0)) {
+    std::cerr << "SELL and BSR layers need equal sections, drop --balance_sections\n";
+    return 1;
+  }
+
   size_t sec_size;
   size_t num_secs;
 
@@ -81,9 +139,14 @@ int main(int argc, char* argv[]) {
       neuron,
       sec_size,
       num_secs,
-      120
+      120,
+      sell_c,
+      sell_sigma,
+      bsr_min_fill,
+      balance_sections,
+      max_sec_size
     );
-    return;
+    return 0;
   }
 
   //convert all benchmarks
@@ -101,10 +164,16 @@ int main(int argc, char* argv[]) {
         golden_path,
         neuron,
         sec_size,
-        num_secs
+        num_secs,
+        1920,
+        sell_c,
+        sell_sigma,
+        bsr_min_fill,
+        balance_sections,
+        max_sec_size
       );
     }
-    return;
+    return 0;
   }
 
   //convert benchmarks with num_neurons neruons
@@ -120,11 +189,15 @@ int main(int argc, char* argv[]) {
     golden_path,
     num_neurons,
     sec_size,
-    num_secs
+    num_secs,
+    1920,
+    sell_c,
+    sell_sigma,
+    bsr_min_fill,
+    balance_sections,
+    max_sec_size
   );
 
-
-
 }
 
 void convert_to_binary(
@@ -134,29 +207,118 @@ void convert_to_binary(
   const size_t num_neurons,
   const size_t sec_size,
   const size_t num_secs,
-  const size_t num_layers
+  const size_t num_layers,
+  const size_t sell_c,
+  const size_t sell_sigma,
+  const double bsr_min_fill,
+  const bool balance_sections,
+  const size_t max_sec_size
 ) {
 
   std::cout << "num_neurons : " << num_neurons << std::endl;
 
-  std::cout << "Transforming weight files... \n";
-  snig::tsv_file_to_binary_file<float>(
-    weight_path,
-    num_layers,
-    num_neurons,
-    num_neurons,
-    sec_size,
-    num_secs,
-    num_neurons * 32
-  ); 
+  //the archive get_dataset.sh downloads next to the weight directory,
+  //which need not exist yet
+  auto weight_dir = weight_path.filename() == "." ? weight_path.parent_path() : weight_path;
+  auto weight_archive = weight_dir.parent_path() / ("neuron" + std::to_string(num_neurons) + ".tar.gz");
+  auto first_layer_path = weight_path / ("n" + std::to_string(num_neurons) + "-l1.tsv");
 
-  std::cout << "Transforming input files...\n";
+  if(!std::fs::exists(first_layer_path) && std::fs::exists(weight_archive)) {
+    std::cout << "Transforming weight files from " << weight_archive.string() << "...\n";
+    std::fs::create_directories(weight_path);
+    snig::tsv_gz_file_to_binary_file<float>(
+      weight_archive,
+      weight_path,
+      num_layers,
+      num_neurons,
+      num_neurons,
+      sec_size,
+      num_secs,
+      num_neurons * 32
+    );
+  }
+  else {
+    std::cout << "Transforming weight files... \n";
+    snig::tsv_file_to_binary_file<float>(
+      weight_path,
+      num_layers,
+      num_neurons,
+      num_neurons,
+      sec_size,
+      num_secs,
+      num_neurons * 32
+    ); 
+  }
 
-  snig::tsv_file_to_binary_file<float>(
-    input_path,
-    60000,
-    num_neurons
-  );
+  //equal sections need no header, drop one left by an earlier conversion
+  auto header_path = snig::model_header_path(weight_path, num_neurons);
+  if(balance_sections) {
+    auto nnz_per_neuron = snig::count_output_nnz_binary<float>(weight_path, num_neurons, num_layers);
+    auto layout = snig::balance_sections(
+      nnz_per_neuron,
+      num_secs,
+      max_sec_size > 0 ? max_sec_size : std::min(num_neurons, 2 * sec_size)
+    );
+
+    auto max_section_nnz = [&](const snig::SectionLayout& l) {
+      size_t max_nnz{0};
+      for(size_t s = 0; s < l.num_secs(); ++s) {
+        max_nnz = std::max(max_nnz, std::accumulate(
+          nnz_per_neuron.begin() + l.offsets[s], nnz_per_neuron.begin() + l.offsets[s + 1], size_t(0)
+        ));
+      }
+      return max_nnz;
+    };
+    std::cout << "Balancing sections... largest section nnz "
+              << max_section_nnz(snig::uniform_sections(num_neurons, num_secs)) << " -> "
+              << max_section_nnz(layout) << ", widest section " << layout.max_size() << " neurons\n";
+
+    snig::repack_binary_sections<float>(weight_path, num_neurons, num_layers, layout);
+    snig::write_model_header(header_path, layout);
+  }
+  else if(std::fs::exists(header_path)) {
+    std::fs::remove(header_path);
+  }
+
+  if(sell_c > 0) {
+    std::cout << "Writing SELL-" << sell_c << "-" << sell_sigma << " weight files...\n";
+    snig::packed_binary_to_sell_file<float>(
+      weight_path,
+      num_neurons,
+      num_layers,
+      sell_c,
+      sell_sigma
+    );
+  }
+
+  if(bsr_min_fill > 0) {
+    std::cout << "Writing BSR weight files with blocks at least " << bsr_min_fill << " full...\n";
+    snig::packed_binary_to_bsr_file<float>(
+      weight_path,
+      num_neurons,
+      num_layers,
+      bsr_min_fill
+    );
+  }
+
+  auto input_tsv_path = input_path / ("sparse-images-" + std::to_string(num_neurons) + ".tsv");
+  if(!std::fs::exists(input_tsv_path) && std::fs::exists(input_tsv_path.string() + ".gz")) {
+    std::cout << "Transforming input files from " << input_tsv_path.string() << ".gz...\n";
+    snig::tsv_gz_file_to_binary_file<float>(
+      input_path,
+      60000,
+      num_neurons
+    );
+  }
+  else {
+    std::cout << "Transforming input files...\n";
+
+    snig::tsv_file_to_binary_file<float>(
+      input_path,
+      60000,
+      num_neurons
+    );
+  }
 
   std::cout << "Transforming golden files...\n";
 
@@ -0,0 +1,114 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <SNIG/utility/category_bitset.hpp>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+TEST_CASE("bitset_words") {
+  //130 inputs span three words, the last holding two bits
+  std::vector<int> ints(130, 0);
+  ints[0] = 1;
+  ints[63] = 5;
+  ints[64] = -1;
+  ints[129] = 1;
+  snig::CategoryBitset bits(ints.data(), ints.size());
+
+  CHECK(bits.num_inputs() == 130);
+  CHECK(bits.num_words() == 3);
+  CHECK(bits.count() == 4);
+  CHECK(bits.words()[0] == ((uint64_t(1) << 63) | 1));
+  CHECK(bits.words()[1] == 1);
+  CHECK(bits.words()[2] == 2);
+  for(size_t i = 0; i < ints.size(); ++i) {
+    CHECK(bits.test(i) == (ints[i] != 0));
+  }
+
+  //set, clear, and set_atomic touch only their own bit
+  bits.set(64, false);
+  bits.set(100, true);
+  bits.set_atomic(1);
+  CHECK_FALSE(bits.test(64));
+  CHECK(bits.test(100));
+  CHECK(bits.test(1));
+  CHECK(bits.count() == 5);
+
+  auto eigen = bits.to_Eigen();
+  CHECK(snig::CategoryBitset(eigen).num_inputs() == 130);
+  CHECK(snig::num_different_categories(snig::CategoryBitset(eigen), bits) == 0);
+}
+
+TEST_CASE("bitset_mismatch") {
+  const size_t num_inputs = 130;
+  snig::CategoryBitset golden(num_inputs);
+  for(size_t i = 0; i < num_inputs; i += 3) {
+    golden.set(i, true);
+  }
+
+  snig::CategoryBitset output(golden);
+  CHECK(snig::num_different_categories(output, golden) == 0);
+  CHECK(snig::different_categories(output, golden).empty());
+
+  //first and last bit of a word, first bit of the next, and the last input
+  std::vector<size_t> flipped{0, 63, 64, num_inputs - 1};
+  for(auto i : flipped) {
+    output.set(i, !golden.test(i));
+  }
+  CHECK(snig::num_different_categories(output, golden) == 4);
+  CHECK(snig::different_categories(output, golden) == flipped);
+  CHECK(snig::different_categories(golden, output) == flipped);
+
+  //the list stops at max_mismatches
+  CHECK(snig::different_categories(output, golden, 2) == std::vector<size_t>{0, 63});
+  CHECK(snig::different_categories(output, golden, 0).empty());
+
+  //every input differs
+  snig::CategoryBitset inverse(num_inputs);
+  for(size_t i = 0; i < num_inputs; ++i) {
+    inverse.set(i, !golden.test(i));
+  }
+  CHECK(snig::num_different_categories(inverse, golden) == num_inputs);
+  CHECK(snig::different_categories(inverse, golden).size() == num_inputs);
+  CHECK(snig::different_categories(inverse, golden).back() == num_inputs - 1);
+
+  CHECK_THROWS_AS(snig::num_different_categories(snig::CategoryBitset(129), golden), std::runtime_error);
+  CHECK_THROWS_AS(snig::different_categories(snig::CategoryBitset(131), golden), std::runtime_error);
+}
+
+TEST_CASE("bitset_file") {
+  const std::fs::path path = std::fs::temp_directory_path() / "snig_category_bitset_test.b";
+
+  snig::CategoryBitset bits(70);
+  bits.set(0, true);
+  bits.set(69, true);
+  snig::write_category_bitset(path, bits);
+  auto read = snig::read_category_bitset(path);
+  CHECK(read.num_inputs() == 70);
+  CHECK(snig::num_different_categories(read, bits) == 0);
+
+  //golden files of an int per input still read
+  {
+    std::vector<int> ints(70, 0);
+    ints[0] = 1;
+    ints[69] = 1;
+    size_t num_inputs = ints.size();
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out.write((char*)&num_inputs, sizeof(size_t));
+    out.write((char*)ints.data(), sizeof(int) * ints.size());
+  }
+  read = snig::read_category_bitset(path);
+  CHECK(snig::num_different_categories(read, bits) == 0);
+
+  //truncated bitset
+  {
+    size_t num_inputs = 70;
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out.write(snig::category_bitset_magic, sizeof(snig::category_bitset_magic));
+    out.write((char*)&num_inputs, sizeof(size_t));
+    out.write((char*)bits.words(), sizeof(uint64_t));
+  }
+  CHECK_THROWS_AS(snig::read_category_bitset(path), std::runtime_error);
+
+  std::fs::remove(path);
+}
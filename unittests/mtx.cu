@@ -0,0 +1,231 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <SNIG/utility/mtx.hpp>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+
+const std::fs::path mtx_path = std::fs::temp_directory_path() / "snig_mtx_test.mtx";
+
+void write_file(const std::fs::path& path, const std::string& text) {
+  std::ofstream out(path, std::ios::out | std::ios::binary);
+  out << text;
+}
+
+snig::MtxHeader parse_header(const std::string& text) {
+  return snig::parse_mtx_header(text.data(), text.size(), "test.mtx");
+}
+
+//every entry parsed from text by num_threads threads, keyed by (row, col),
+//the number of calls in count
+std::map<std::pair<size_t, size_t>, float> parse_entries(
+  const std::string& text,
+  const size_t num_threads,
+  size_t& count,
+  const float pattern_value = 1
+) {
+  write_file(mtx_path, text);
+  snig::MappedFile file(mtx_path);
+  auto header = snig::parse_mtx_header(file.data(), file.size(), mtx_path.string());
+  std::vector<std::vector<std::tuple<size_t, size_t, float>>> found(num_threads);
+  snig::parse_mtx_entries<float>(file, header, pattern_value, num_threads, [&](size_t t, size_t r, size_t c, float v) {
+    found[t].emplace_back(r, c, v);
+  });
+  std::map<std::pair<size_t, size_t>, float> entries;
+  count = 0;
+  for(const auto& thread_found : found) {
+    for(const auto& e : thread_found) {
+      entries[{std::get<0>(e), std::get<1>(e)}] = std::get<2>(e);
+      ++count;
+    }
+  }
+  return entries;
+}
+
+TEST_CASE("mtx_header") {
+  auto header = parse_header(
+    "%%MatrixMarket Matrix Coordinate REAL General\n"
+    "% a comment\n"
+    "\n"
+    "%another\n"
+    "  3 4 5\n"
+    "1 1 1.0\n"
+  );
+  CHECK(header.rows == 3);
+  CHECK(header.cols == 4);
+  CHECK(header.num_entries == 5);
+  CHECK(header.field == snig::MtxField::real);
+  CHECK(header.symmetry == snig::MtxSymmetry::general);
+  CHECK(header.data_offset == std::string("%%MatrixMarket Matrix Coordinate REAL General\n% a comment\n\n%another\n  3 4 5\n").size());
+
+  header = parse_header("%%MatrixMarket matrix coordinate integer symmetric\n2 2 1\n");
+  CHECK(header.field == snig::MtxField::integer);
+  CHECK(header.symmetry == snig::MtxSymmetry::symmetric);
+
+  header = parse_header("%%MatrixMarket matrix coordinate pattern skew-symmetric\n2 2 1\n");
+  CHECK(header.field == snig::MtxField::pattern);
+  CHECK(header.symmetry == snig::MtxSymmetry::skew_symmetric);
+
+  //not Matrix Market, dense, complex, hermitian, non-square symmetric, no or bad size line
+  CHECK_THROWS_AS(parse_header("%%NotMarket matrix coordinate real general\n1 1 0\n"), std::runtime_error);
+  CHECK_THROWS_AS(parse_header("%%MatrixMarket matrix array real general\n1 1\n"), std::runtime_error);
+  CHECK_THROWS_AS(parse_header("%%MatrixMarket matrix coordinate complex general\n1 1 0\n"), std::runtime_error);
+  CHECK_THROWS_AS(parse_header("%%MatrixMarket matrix coordinate real hermitian\n1 1 0\n"), std::runtime_error);
+  CHECK_THROWS_AS(parse_header("%%MatrixMarket matrix coordinate real symmetric\n2 3 0\n"), std::runtime_error);
+  CHECK_THROWS_AS(parse_header("%%MatrixMarket matrix coordinate real general\n% only comments\n"), std::runtime_error);
+  CHECK_THROWS_AS(parse_header("%%MatrixMarket matrix coordinate real general\n3 x 1\n"), std::runtime_error);
+}
+
+TEST_CASE("mtx_symmetry") {
+  const std::string general =
+    "%%MatrixMarket matrix coordinate real general\n"
+    "3 3 4\n"
+    "1 1 2.5\n"
+    "3 1 -1\n"
+    "% between entries\n"
+    "\n"
+    "1 3 4e-1\n"
+    "2 2 7\r\n";
+  const std::string symmetric =
+    "%%MatrixMarket matrix coordinate real symmetric\n"
+    "3 3 3\n"
+    "1 1 2.5\n"
+    "3 1 -1\n"
+    "3 2 0.5\n";
+  const std::string skew =
+    "%%MatrixMarket matrix coordinate integer skew-symmetric\n"
+    "3 3 2\n"
+    "2 1 3\n"
+    "3 2 -4\n";
+
+  //the same entries whatever the number of threads
+  for(size_t num_threads : {1, 2, 3, 8}) {
+    size_t count;
+    auto entries = parse_entries(general, num_threads, count);
+    CHECK(count == 4);
+    CHECK(entries == std::map<std::pair<size_t, size_t>, float>{
+      {{0, 0}, 2.5f}, {{2, 0}, -1.f}, {{0, 2}, 0.4f}, {{1, 1}, 7.f}
+    });
+
+    //off-diagonal entries mirrored, the diagonal once
+    entries = parse_entries(symmetric, num_threads, count);
+    CHECK(count == 5);
+    CHECK(entries == std::map<std::pair<size_t, size_t>, float>{
+      {{0, 0}, 2.5f}, {{2, 0}, -1.f}, {{0, 2}, -1.f}, {{2, 1}, 0.5f}, {{1, 2}, 0.5f}
+    });
+
+    //mirrored entries negated
+    entries = parse_entries(skew, num_threads, count);
+    CHECK(count == 4);
+    CHECK(entries == std::map<std::pair<size_t, size_t>, float>{
+      {{1, 0}, 3.f}, {{0, 1}, -3.f}, {{2, 1}, -4.f}, {{1, 2}, 4.f}
+    });
+  }
+}
+
+TEST_CASE("mtx_pattern") {
+  const std::string pattern =
+    "%%MatrixMarket matrix coordinate pattern symmetric\n"
+    "4 4 3\n"
+    "1 1\n"
+    "4 2\n"
+    "3 1\n";
+  for(size_t num_threads : {1, 2}) {
+    size_t count;
+    auto entries = parse_entries(pattern, num_threads, count, 0.0625f);
+    CHECK(count == 5);
+    CHECK(entries == std::map<std::pair<size_t, size_t>, float>{
+      {{0, 0}, 0.0625f}, {{3, 1}, 0.0625f}, {{1, 3}, 0.0625f}, {{2, 0}, 0.0625f}, {{0, 2}, 0.0625f}
+    });
+  }
+
+  //a value on a pattern line is not read as a column
+  size_t count;
+  CHECK_THROWS_AS(
+    parse_entries("%%MatrixMarket matrix coordinate pattern general\n2 2 1\n1\n", 1, count),
+    std::runtime_error
+  );
+
+  //entry count, range, and value errors
+  CHECK_THROWS_AS(
+    parse_entries("%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 1\n", 1, count),
+    std::runtime_error
+  );
+  CHECK_THROWS_AS(
+    parse_entries("%%MatrixMarket matrix coordinate real general\n2 2 1\n3 1 1\n", 1, count),
+    std::runtime_error
+  );
+  CHECK_THROWS_AS(
+    parse_entries("%%MatrixMarket matrix coordinate real general\n2 2 1\n0 1 1\n", 1, count),
+    std::runtime_error
+  );
+  CHECK_THROWS_AS(
+    parse_entries("%%MatrixMarket matrix coordinate real general\n2 2 1\n1 1 x\n", 1, count),
+    std::runtime_error
+  );
+
+  std::fs::remove(mtx_path);
+}
+
+TEST_CASE("mtx_packed_layer") {
+  //input by output neurons, packed into two sections of 2
+  write_file(mtx_path,
+    "%%MatrixMarket matrix coordinate real general\n"
+    "4 4 5\n"
+    "1 4 4\n"
+    "1 1 1\n"
+    "2 3 3\n"
+    "4 2 2\n"
+    "1 3 5\n"
+  );
+  const std::fs::path layer_path = std::fs::temp_directory_path() / "snig_mtx_test.b";
+  auto layout = snig::uniform_sections(4, 2);
+
+  for(bool is_transposed : {false, true}) {
+    snig::mtx_file_to_packed_binary_file<float>(mtx_path, layer_path, layout, is_transposed, 1, 2);
+    auto layer = snig::read_packed_layer_binary<float>(layer_path);
+    CHECK(layer.rows == 4);
+    CHECK(layer.num_secs == 2);
+    REQUIRE(layer.col_w.size() == 9);
+    CHECK(layer.col_w.back() == 5);
+
+    //every (in, out) lands in column section_of(out) * 4 + in, ordered by out
+    for(size_t c = 0; c < 8; ++c) {
+      for(int k = layer.col_w[c]; k + 1 < layer.col_w[c + 1]; ++k) {
+        CHECK(layer.row_w[k] < layer.row_w[k + 1]);
+      }
+    }
+    std::map<std::pair<int, int>, float> entries;
+    for(size_t c = 0; c < 8; ++c) {
+      for(int k = layer.col_w[c]; k < layer.col_w[c + 1]; ++k) {
+        int in = c % 4;
+        int out = layer.row_w[k];
+        CHECK(size_t(out / 2) == c / 4);
+        entries[{in, out}] = layer.val_w[k];
+      }
+    }
+    std::map<std::pair<int, int>, float> expected{
+      {{0, 3}, 4.f}, {{0, 0}, 1.f}, {{1, 2}, 3.f}, {{3, 1}, 2.f}, {{0, 2}, 5.f}
+    };
+    if(is_transposed) {
+      std::map<std::pair<int, int>, float> transposed;
+      for(const auto& e : expected) {
+        transposed[{e.first.second, e.first.first}] = e.second;
+      }
+      expected = transposed;
+    }
+    CHECK(entries == expected);
+  }
+
+  //the model must have the size of the matrix
+  CHECK_THROWS_AS(
+    snig::mtx_file_to_packed_binary_file<float>(mtx_path, layer_path, snig::uniform_sections(8, 2), false, 1, 1),
+    std::runtime_error
+  );
+
+  std::fs::remove(layer_path);
+  std::fs::remove(mtx_path);
+}
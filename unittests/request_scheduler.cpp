@@ -0,0 +1,203 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <SNIG/utility/request_scheduler.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using Scheduler = snig::RequestScheduler<int>;
+using clock_type = Scheduler::clock;
+
+const auto no_deadline = clock_type::time_point::max();
+
+//payloads of the units in the order workers get them
+std::vector<int> drain(Scheduler& scheduler) {
+  std::vector<int> order;
+  scheduler.close();
+  Scheduler::Unit unit;
+  while(scheduler.pop(unit)) {
+    order.push_back(unit.request->payload);
+    scheduler.complete(unit);
+  }
+  return order;
+}
+
+TEST_CASE("scheduler_order") {
+  snig::SchedulerOptions options;
+  options.num_classes = 3;
+  options.unit_rows = 10;
+
+  //deadline: lower class first, then earliest deadline, then arrival
+  {
+    Scheduler scheduler(options);
+    auto now = clock_type::now();
+    scheduler.submit(0, 5, 2, no_deadline);
+    scheduler.submit(1, 5, 1, now + std::chrono::seconds(20));
+    scheduler.submit(2, 5, 1, now + std::chrono::seconds(10));
+    scheduler.submit(3, 5, 0, no_deadline);
+    scheduler.submit(4, 5, 1, now + std::chrono::seconds(10));
+    CHECK(drain(scheduler) == std::vector<int>{3, 2, 4, 1, 0});
+  }
+
+  //fifo: arrival order whatever the class and deadline
+  {
+    options.order = snig::RequestOrder::fifo;
+    Scheduler scheduler(options);
+    auto now = clock_type::now();
+    scheduler.submit(0, 5, 2, no_deadline);
+    scheduler.submit(1, 5, 0, now + std::chrono::seconds(10));
+    scheduler.submit(2, 5, 1, now + std::chrono::seconds(5));
+    CHECK(drain(scheduler) == std::vector<int>{0, 1, 2});
+    options.order = snig::RequestOrder::deadline;
+  }
+
+  //a large request is split into units, and an urgent one goes between them
+  {
+    Scheduler scheduler(options);
+    scheduler.submit(0, 25, 1, no_deadline);
+
+    Scheduler::Unit unit;
+    REQUIRE(scheduler.pop(unit));
+    CHECK(unit.beg == 0);
+    CHECK(unit.end == 10);
+    CHECK_FALSE(scheduler.complete(unit));
+    CHECK(scheduler.pending_rows() == 15);
+
+    scheduler.submit(1, 3, 0, no_deadline);
+    REQUIRE(scheduler.pop(unit));
+    CHECK(unit.request->payload == 1);
+    CHECK(scheduler.complete(unit));
+
+    REQUIRE(scheduler.pop(unit));
+    CHECK(unit.request->payload == 0);
+    CHECK(unit.beg == 10);
+    CHECK(unit.end == 20);
+    CHECK_FALSE(scheduler.complete(unit));
+    REQUIRE(scheduler.pop(unit));
+    CHECK(unit.beg == 20);
+    CHECK(unit.end == 25);
+    CHECK(scheduler.complete(unit));
+    CHECK(scheduler.pending_rows() == 0);
+
+    auto stats = scheduler.stats();
+    CHECK(stats[0].num_completed == 1);
+    CHECK(stats[1].num_completed == 1);
+    CHECK(stats[1].latency_ms.size() == 1);
+  }
+}
+
+TEST_CASE("scheduler_admission") {
+  snig::SchedulerOptions options;
+  options.capacity = 10;
+  options.block_timeout = std::chrono::milliseconds(20);
+
+  //reject: a full queue refuses at once and hands the payload back
+  {
+    Scheduler scheduler(options);
+    CHECK(scheduler.submit(0, 8, 1, no_deadline) == snig::Admission::accepted);
+    CHECK(scheduler.submit(1, 2, 1, no_deadline) == snig::Admission::accepted);
+    int rejected{-1};
+    CHECK(scheduler.submit(2, 1, 0, no_deadline, &rejected) == snig::Admission::rejected_full);
+    CHECK(rejected == 2);
+    CHECK(scheduler.pending_rows() == 10);
+
+    auto stats = scheduler.stats();
+    CHECK(stats[0].num_submitted == 1);
+    CHECK(stats[0].num_rejected_full == 1);
+    CHECK(stats[1].num_accepted == 2);
+  }
+
+  //a request larger than the queue is let in alone
+  {
+    Scheduler scheduler(options);
+    CHECK(scheduler.submit(0, 50, 1, no_deadline) == snig::Admission::accepted);
+    CHECK(scheduler.submit(1, 1, 1, no_deadline) == snig::Admission::rejected_full);
+  }
+
+  //block: gives up after block_timeout and counts the time waited
+  {
+    options.policy = snig::AdmissionPolicy::block;
+    Scheduler scheduler(options);
+    CHECK(scheduler.submit(0, 10, 1, no_deadline) == snig::Admission::accepted);
+    CHECK(scheduler.submit(1, 1, 1, no_deadline) == snig::Admission::rejected_full);
+    CHECK(scheduler.stats()[1].blocked_ms >= 15);
+  }
+
+  //block: a worker making room lets the producer in
+  {
+    options.block_timeout = std::chrono::seconds(10);
+    Scheduler scheduler(options);
+    CHECK(scheduler.submit(0, 10, 1, no_deadline) == snig::Admission::accepted);
+    std::thread worker([&]{
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      Scheduler::Unit unit;
+      scheduler.pop(unit);
+      scheduler.complete(unit);
+    });
+    CHECK(scheduler.submit(1, 5, 1, no_deadline) == snig::Admission::accepted);
+    worker.join();
+    CHECK(scheduler.pending_rows() == 5);
+  }
+
+  //block: closing wakes the producer
+  {
+    Scheduler scheduler(options);
+    CHECK(scheduler.submit(0, 10, 1, no_deadline) == snig::Admission::accepted);
+    std::thread closer([&]{
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      scheduler.close();
+    });
+    int rejected{-1};
+    CHECK(scheduler.submit(1, 5, 1, no_deadline, &rejected) == snig::Admission::closed);
+    CHECK(rejected == 1);
+    closer.join();
+    CHECK(scheduler.submit(2, 1, 1, no_deadline) == snig::Admission::closed);
+  }
+
+  CHECK_THROWS_AS(Scheduler(snig::SchedulerOptions{}).submit(0, 1, 2, no_deadline), std::runtime_error);
+}
+
+TEST_CASE("scheduler_infeasible_deadline") {
+  snig::SchedulerOptions options;
+  options.unit_rows = 4;
+
+  Scheduler scheduler(options);
+
+  //nothing measured yet, so every deadline is taken as feasible
+  CHECK(scheduler.submit(0, 4, 1, clock_type::now()) == snig::Admission::accepted);
+
+  //one unit of 4 rows in about 40 ms: about 10 ms per row
+  Scheduler::Unit unit;
+  REQUIRE(scheduler.pop(unit));
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  CHECK(scheduler.complete(unit));
+
+  auto now = clock_type::now();
+  int rejected{-1};
+  CHECK(scheduler.submit(1, 100, 1, now + std::chrono::milliseconds(50), &rejected) == snig::Admission::rejected_deadline);
+  CHECK(rejected == 1);
+  CHECK(scheduler.submit(2, 100, 1, now + std::chrono::seconds(60)) == snig::Admission::accepted);
+  CHECK(scheduler.submit(3, 100, 1, no_deadline) == snig::Admission::accepted);
+
+  //rows of more urgent requests count against the deadline, later ones do not
+  CHECK(scheduler.submit(4, 200, 0, no_deadline) == snig::Admission::accepted);
+  CHECK(scheduler.submit(5, 1, 1, clock_type::now() + std::chrono::seconds(1)) == snig::Admission::rejected_deadline);
+  CHECK(scheduler.submit(6, 1, 0, clock_type::now() + std::chrono::seconds(1)) == snig::Admission::accepted);
+
+  auto stats = scheduler.stats();
+  CHECK(stats[1].num_rejected_deadline == 2);
+
+  //with the check off the request is taken and misses its deadline
+  options.reject_infeasible = false;
+  Scheduler lenient(options);
+  CHECK(lenient.submit(0, 4, 1, no_deadline) == snig::Admission::accepted);
+  REQUIRE(lenient.pop(unit));
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  lenient.complete(unit);
+  CHECK(lenient.submit(1, 4, 1, clock_type::now() + std::chrono::milliseconds(1)) == snig::Admission::accepted);
+  REQUIRE(lenient.pop(unit));
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  CHECK(lenient.complete(unit));
+  CHECK(lenient.stats()[1].num_deadline_misses == 1);
+}
@@ -0,0 +1,140 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <SNIG/utility/sections.hpp>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+//sections of layout cover [0, num_neurons) in increasing, non-empty steps
+void check_layout(const snig::SectionLayout& layout, const size_t num_neurons, const size_t num_secs) {
+  REQUIRE(layout.num_secs() == num_secs);
+  CHECK(layout.offsets.front() == 0);
+  CHECK(layout.num_neurons() == num_neurons);
+  for(size_t s = 0; s < num_secs; ++s) {
+    CHECK(layout.offsets[s] < layout.offsets[s + 1]);
+  }
+}
+
+//largest sum of work over the sections of layout
+size_t max_load(const std::vector<size_t>& work, const snig::SectionLayout& layout) {
+  size_t max_load{0};
+  for(size_t s = 0; s < layout.num_secs(); ++s) {
+    size_t load{0};
+    for(int i = layout.offsets[s]; i < layout.offsets[s + 1]; ++i) {
+      load += work[i];
+    }
+    max_load = std::max(max_load, load);
+  }
+  return max_load;
+}
+
+//smallest largest load of num_secs non-empty sections of at most max_sec_size,
+//by exhaustive dynamic programming
+size_t optimal_load(const std::vector<size_t>& work, const size_t num_secs, const size_t max_sec_size) {
+  const size_t n = work.size();
+  const size_t inf = std::numeric_limits<size_t>::max();
+  //best[k][i]: first i neurons in k sections
+  std::vector<std::vector<size_t>> best(num_secs + 1, std::vector<size_t>(n + 1, inf));
+  best[0][0] = 0;
+  for(size_t k = 1; k <= num_secs; ++k) {
+    for(size_t i = 1; i <= n; ++i) {
+      size_t load{0};
+      for(size_t j = i; j > 0 && i - j < max_sec_size; --j) {
+        load += work[j - 1];
+        if(best[k - 1][j - 1] != inf) {
+          best[k][i] = std::min(best[k][i], std::max(best[k - 1][j - 1], load));
+        }
+      }
+    }
+  }
+  return best[num_secs][n];
+}
+
+TEST_CASE("balance_sections_bounds") {
+  std::vector<size_t> work(16, 1);
+
+  //no sections, more sections than neurons, or too narrow to cover them all
+  CHECK_THROWS_AS(snig::balance_sections(work, 0, 16), std::runtime_error);
+  CHECK_THROWS_AS(snig::balance_sections(work, 17, 16), std::runtime_error);
+  CHECK_THROWS_AS(snig::balance_sections(work, 4, 3), std::runtime_error);
+
+  //as many sections as neurons
+  auto layout = snig::balance_sections(work, 16, 1);
+  check_layout(layout, 16, 16);
+  CHECK(layout.max_size() == 1);
+
+  //uniform work gives equal sections
+  layout = snig::balance_sections(work, 4, 16);
+  check_layout(layout, 16, 4);
+  CHECK(layout.is_uniform());
+  CHECK(layout.offsets == snig::uniform_sections(16, 4).offsets);
+
+  //a heavy neuron gets a section of its own
+  work.assign(8, 1);
+  work[5] = 100;
+  layout = snig::balance_sections(work, 3, 8);
+  check_layout(layout, 8, 3);
+  CHECK(max_load(work, layout) == 100);
+  CHECK(layout.size(layout.section_of(5)) == 1);
+
+  //no work at all still makes num_secs sections
+  work.assign(10, 0);
+  layout = snig::balance_sections(work, 4, 10);
+  check_layout(layout, 10, 4);
+
+  //the largest load is the smallest possible
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<size_t> dist(0, 20);
+  for(size_t trial = 0; trial < 50; ++trial) {
+    work.resize(1 + trial % 24);
+    for(auto& w : work) {
+      w = dist(gen);
+    }
+    const size_t num_secs = 1 + trial % work.size();
+    layout = snig::balance_sections(work, num_secs, work.size());
+    check_layout(layout, work.size(), num_secs);
+    CHECK(max_load(work, layout) == optimal_load(work, num_secs, work.size()));
+  }
+}
+
+TEST_CASE("balance_sections_cap") {
+  //all work at the front would pull the back into one wide section
+  std::vector<size_t> work(32, 0);
+  for(size_t i = 0; i < 4; ++i) {
+    work[i] = 10;
+  }
+  auto layout = snig::balance_sections(work, 8, 6);
+  check_layout(layout, 32, 8);
+  CHECK(layout.max_size() <= 6);
+  CHECK(max_load(work, layout) == 10);
+
+  //cap at exactly num_neurons / num_secs leaves equal sections
+  layout = snig::balance_sections(work, 4, 8);
+  check_layout(layout, 32, 4);
+  CHECK(layout.offsets == snig::uniform_sections(32, 4).offsets);
+
+  //halving the widest section to reach num_secs keeps the cap and the load
+  work.assign(12, 1);
+  layout = snig::balance_sections(work, 6, 5);
+  check_layout(layout, 12, 6);
+  CHECK(layout.max_size() <= 5);
+  CHECK(max_load(work, layout) == optimal_load(work, 6, 5));
+
+  //the cap holds against the optimum with random work
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<size_t> dist(0, 9);
+  for(size_t trial = 0; trial < 50; ++trial) {
+    work.resize(8 + trial % 17);
+    for(auto& w : work) {
+      w = dist(gen);
+    }
+    const size_t num_secs = 2 + trial % 5;
+    const size_t max_sec_size = (work.size() + num_secs - 1) / num_secs + trial % 3;
+    layout = snig::balance_sections(work, num_secs, max_sec_size);
+    check_layout(layout, work.size(), num_secs);
+    CHECK(layout.max_size() <= max_sec_size);
+    CHECK(max_load(work, layout) == optimal_load(work, num_secs, max_sec_size));
+  }
+}
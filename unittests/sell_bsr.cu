@@ -0,0 +1,325 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <SNIG/utility/sell.hpp>
+#include <SNIG/utility/bsr.hpp>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <vector>
+
+using Dense = std::vector<std::vector<float>>;
+
+//num_neurons x num_neurons weights of output (row) by input (column),
+//each nonzero with probability density; every weight of a block of
+//R x C is nonzero if the block is picked, when tile_r and tile_c are given
+Dense random_weights(
+  const size_t num_neurons,
+  const double density,
+  const unsigned seed,
+  const size_t tile_r = 1,
+  const size_t tile_c = 1
+) {
+  std::mt19937 gen(seed);
+  std::bernoulli_distribution pick(density);
+  std::uniform_real_distribution<float> value(0.5f, 2.f);
+  Dense w(num_neurons, std::vector<float>(num_neurons, 0));
+  for(size_t i = 0; i < num_neurons; i += tile_r) {
+    for(size_t j = 0; j < num_neurons; j += tile_c) {
+      if(!pick(gen)) {
+        continue;
+      }
+      for(size_t r = i; r < i + tile_r; ++r) {
+        for(size_t c = j; c < j + tile_c; ++c) {
+          w[r][c] = value(gen);
+        }
+      }
+    }
+  }
+  return w;
+}
+
+//packed layer of w with num_secs equal sections: column s * num_neurons + j
+//holds the weights of input j to outputs of section s, ordered by output
+snig::PackedLayer<float> pack(const Dense& w, const size_t num_secs) {
+  const size_t num_neurons = w.size();
+  const size_t sec_size = num_neurons / num_secs;
+  snig::PackedLayer<float> layer;
+  layer.rows = num_neurons;
+  layer.num_secs = num_secs;
+  layer.col_w.push_back(0);
+  for(size_t s = 0; s < num_secs; ++s) {
+    for(size_t j = 0; j < num_neurons; ++j) {
+      for(size_t i = s * sec_size; i < (s + 1) * sec_size; ++i) {
+        if(w[i][j] != 0) {
+          layer.row_w.push_back(i);
+          layer.val_w.push_back(w[i][j]);
+        }
+      }
+      layer.col_w.push_back(layer.row_w.size());
+    }
+  }
+  return layer;
+}
+
+void write_packed(const std::fs::path& path, const snig::PackedLayer<float>& layer, const size_t cut = 0) {
+  std::string buf;
+  size_t nnz = layer.row_w.size();
+  buf.append((const char*)&layer.rows, sizeof(size_t));
+  buf.append((const char*)&nnz, sizeof(size_t));
+  buf.append((const char*)layer.col_w.data(), sizeof(int) * layer.col_w.size());
+  buf.append((const char*)layer.row_w.data(), sizeof(int) * nnz);
+  buf.append((const char*)layer.val_w.data(), sizeof(float) * nnz);
+  std::ofstream out(path, std::ios::out | std::ios::binary);
+  out.write(buf.data(), buf.size() - cut);
+}
+
+Dense sell_to_dense(const snig::SELLLayer<float>& layer) {
+  Dense w(layer.num_neurons, std::vector<float>(layer.num_neurons, 0));
+  for(size_t q = 0; q < layer.num_chunks(); ++q) {
+    for(int k = layer.chunk_ptr[q]; k < layer.chunk_ptr[q + 1]; ++k) {
+      int out = layer.perm[q * layer.C + (k - layer.chunk_ptr[q]) % layer.C];
+      w[out][layer.col[k]] += layer.val[k];
+    }
+  }
+  return w;
+}
+
+Dense bsr_to_dense(const snig::BSRLayer<float>& layer) {
+  const size_t R = layer.R;
+  const size_t C = layer.C;
+  Dense w(layer.num_neurons, std::vector<float>(layer.num_neurons, 0));
+  for(size_t ib = 0; ib < layer.num_neurons / R; ++ib) {
+    for(int b = layer.block_row_ptr[ib]; b < layer.block_row_ptr[ib + 1]; ++b) {
+      for(size_t c = 0; c < C; ++c) {
+        for(size_t r = 0; r < R; ++r) {
+          w[ib * R + r][layer.block_col[b] * C + c] = layer.val[b * R * C + c * R + r];
+        }
+      }
+    }
+  }
+  return w;
+}
+
+TEST_CASE("packed_layer_file") {
+  const std::fs::path path = std::fs::temp_directory_path() / "snig_sell_bsr_test.b";
+  auto w = random_weights(32, 0.2, 1);
+  auto packed = pack(w, 4);
+  write_packed(path, packed);
+
+  auto read = snig::read_packed_layer_binary<float>(path);
+  CHECK(read.rows == 32);
+  CHECK(read.num_secs == 4);
+  CHECK(read.col_w == packed.col_w);
+  CHECK(read.row_w == packed.row_w);
+  CHECK(read.val_w == packed.val_w);
+  CHECK(snig::num_secs_of_layer_binary<float>(path) == 4);
+
+  //a cut file is not a packed layer of any number of sections
+  for(size_t cut : {size_t(1), sizeof(float), sizeof(int) * 32, read.val_w.size() * sizeof(float)}) {
+    write_packed(path, packed, cut);
+    CHECK_THROWS_AS(snig::read_packed_layer_binary<float>(path), std::runtime_error);
+  }
+  //the header alone
+  write_packed(path, packed, sizeof(int) * packed.col_w.size() + (sizeof(int) + sizeof(float)) * packed.row_w.size() + 1);
+  CHECK_THROWS_AS(snig::read_packed_layer_binary<float>(path), std::runtime_error);
+
+  std::fs::remove(path);
+}
+
+TEST_CASE("packed_to_sell") {
+  const size_t num_neurons = 64;
+  const size_t num_secs = 4;
+  const size_t sec_size = num_neurons / num_secs;
+  auto w = random_weights(num_neurons, 0.15, 2);
+  auto packed = pack(w, num_secs);
+  const size_t nnz = packed.row_w.size();
+
+  for(size_t C : {1, 4, 8, 16}) {
+    for(size_t sigma : {size_t(0), C, size_t(8), size_t(1000)}) {
+      auto sell = snig::packed_to_sell(
+        packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, C, sigma
+      );
+      CHECK(sell.nnz == nnz);
+      CHECK(sell.sigma % C == 0);
+      CHECK(sell.sigma <= sec_size);
+      CHECK(sell.num_chunks() == num_neurons / C);
+      CHECK(sell_to_dense(sell) == w);
+
+      //lanes only move inside their section, sorted longest first per window
+      std::vector<size_t> length(num_neurons, 0);
+      for(size_t i = 0; i < num_neurons; ++i) {
+        length[i] = std::count_if(w[i].begin(), w[i].end(), [](float v){ return v != 0; });
+      }
+      auto perm = sell.perm;
+      for(size_t s = 0; s < num_secs; ++s) {
+        std::sort(perm.begin() + s * sec_size, perm.begin() + (s + 1) * sec_size);
+        for(size_t i = s * sec_size; i < (s + 1) * sec_size; ++i) {
+          CHECK(perm[i] == int(i));
+        }
+        for(size_t beg = s * sec_size; beg < (s + 1) * sec_size; beg += sell.sigma) {
+          for(size_t i = beg; i + 1 < beg + sell.sigma; ++i) {
+            CHECK(length[sell.perm[i]] >= length[sell.perm[i + 1]]);
+          }
+        }
+      }
+
+      //chunks padded to their longest lane with zeros
+      size_t total_nnz{0};
+      for(size_t q = 0; q < sell.num_chunks(); ++q) {
+        size_t longest{0};
+        size_t chunk_nnz{0};
+        for(size_t c = 0; c < C; ++c) {
+          longest = std::max(longest, length[sell.perm[q * C + c]]);
+          chunk_nnz += length[sell.perm[q * C + c]];
+        }
+        CHECK(size_t(sell.chunk_len[q]) == longest);
+        CHECK(size_t(sell.chunk_nnz[q]) == chunk_nnz);
+        CHECK(size_t(sell.chunk_ptr[q + 1] - sell.chunk_ptr[q]) == longest * C);
+        total_nnz += chunk_nnz;
+      }
+      CHECK(total_nnz == nnz);
+      CHECK(std::count_if(sell.val.begin(), sell.val.end(), [](float v){ return v != 0; }) == long(nnz));
+    }
+  }
+
+  CHECK_THROWS_AS(
+    snig::packed_to_sell(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, 3, 0),
+    std::runtime_error
+  );
+  CHECK_THROWS_AS(
+    snig::packed_to_sell(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, 0, 0),
+    std::runtime_error
+  );
+}
+
+TEST_CASE("packed_to_bsr") {
+  const size_t num_neurons = 64;
+  const size_t num_secs = 4;
+
+  //scattered weights: every shape is tried, the chosen one stores the fewest entries
+  auto w = random_weights(num_neurons, 0.1, 3);
+  auto packed = pack(w, num_secs);
+  const size_t nnz = packed.row_w.size();
+  auto bsr = snig::packed_to_bsr(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, 0);
+  REQUIRE(bsr.is_blocked());
+  CHECK(bsr.nnz == nnz);
+  CHECK(bsr_to_dense(bsr) == w);
+  CHECK(bsr.num_blocks() == snig::count_blocks(packed.col_w.data(), packed.row_w.data(), num_neurons, num_secs, bsr.R, bsr.C));
+  for(const auto& shape : snig::bsr_block_shapes()) {
+    CHECK(bsr.num_blocks() * bsr.R * bsr.C <=
+      snig::count_blocks(packed.col_w.data(), packed.row_w.data(), num_neurons, num_secs, shape.first, shape.second)
+      * shape.first * shape.second);
+  }
+  //block columns increase within a block row
+  for(size_t ib = 0; ib < num_neurons / bsr.R; ++ib) {
+    for(int b = bsr.block_row_ptr[ib]; b + 1 < bsr.block_row_ptr[ib + 1]; ++b) {
+      CHECK(bsr.block_col[b] < bsr.block_col[b + 1]);
+    }
+  }
+
+  //scattered weights fill no block well enough
+  bsr = snig::packed_to_bsr(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, 0.9);
+  CHECK_FALSE(bsr.is_blocked());
+  CHECK(bsr.num_blocks() == 0);
+
+  //full 8 x 4 tiles take the largest shape, filled completely
+  w = random_weights(num_neurons, 0.3, 4, 8, 4);
+  packed = pack(w, num_secs);
+  bsr = snig::packed_to_bsr(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, 0.9);
+  REQUIRE(bsr.is_blocked());
+  CHECK(bsr.R == 8);
+  CHECK(bsr.C == 4);
+  CHECK(bsr.fill_ratio() == 1.0);
+  CHECK(bsr_to_dense(bsr) == w);
+
+  //full 4 x 1 tiles take 4 x 1 over the larger shapes
+  w = random_weights(num_neurons, 0.3, 5, 4, 1);
+  packed = pack(w, num_secs);
+  bsr = snig::packed_to_bsr(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, 0.9);
+  REQUIRE(bsr.is_blocked());
+  CHECK(bsr.R * bsr.C == 4);
+  CHECK(bsr.fill_ratio() == 1.0);
+  CHECK(bsr_to_dense(bsr) == w);
+
+  //sections of 4 neurons rule out blocks of 8 rows
+  w = random_weights(16, 0.5, 6, 8, 4);
+  packed = pack(w, 4);
+  bsr = snig::packed_to_bsr(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), 16, 4, 0);
+  REQUIRE(bsr.is_blocked());
+  CHECK(bsr.R <= 4);
+  CHECK(bsr_to_dense(bsr) == w);
+
+  //no weights at all
+  w = Dense(num_neurons, std::vector<float>(num_neurons, 0));
+  packed = pack(w, num_secs);
+  bsr = snig::packed_to_bsr(packed.col_w.data(), packed.row_w.data(), packed.val_w.data(), num_neurons, num_secs, 0);
+  CHECK_FALSE(bsr.is_blocked());
+}
+
+TEST_CASE("sell_bsr_files") {
+  const size_t num_neurons = 32;
+  const auto dir = std::fs::temp_directory_path() / "snig_sell_bsr_test";
+  std::fs::create_directories(dir);
+
+  std::vector<Dense> layers{random_weights(num_neurons, 0.2, 7), random_weights(num_neurons, 0.3, 8, 8, 4)};
+  for(size_t i = 0; i < layers.size(); ++i) {
+    write_packed(dir / ("n32-l" + std::to_string(i + 1) + ".b"), pack(layers[i], 2));
+  }
+
+  snig::packed_binary_to_sell_file<float>(dir, num_neurons, layers.size(), 8, 16);
+  snig::packed_binary_to_bsr_file<float>(dir, num_neurons, layers.size(), 0.5);
+  for(size_t i = 0; i < layers.size(); ++i) {
+    auto sell = snig::read_sell_binary<float>(snig::sell_layer_path(dir, num_neurons, i));
+    CHECK(sell.num_secs == 2);
+    CHECK(sell.C == 8);
+    CHECK(sell_to_dense(sell) == layers[i]);
+
+    auto bsr = snig::read_bsr_binary<float>(snig::bsr_layer_path(dir, num_neurons, i), num_neurons, 2);
+    CHECK(bsr.num_secs == 2);
+    if(bsr.is_blocked()) {
+      CHECK(bsr_to_dense(bsr) == layers[i]);
+    }
+  }
+  const auto bsr_path = snig::bsr_layer_path(dir, num_neurons, 1);
+  const auto bsr = snig::read_bsr_binary<float>(bsr_path, num_neurons, 2);
+  CHECK(bsr.is_blocked());
+
+  //a model of other sections
+  CHECK_THROWS_AS(snig::read_bsr_binary<float>(bsr_path, num_neurons, 4), std::runtime_error);
+  CHECK_THROWS_AS(snig::read_bsr_binary<float>(bsr_path, 2 * num_neurons, 2), std::runtime_error);
+
+  //corrupt headers and block indices, each restored after its check
+  auto check_corrupt = [&](const size_t offset, const auto value) {
+    std::fstream f(bsr_path, std::ios::in | std::ios::out | std::ios::binary);
+    auto original = value;
+    f.seekg(offset);
+    f.read((char*)&original, sizeof(original));
+    f.seekp(offset);
+    f.write((char*)&value, sizeof(value));
+    f.close();
+    CHECK_THROWS_AS(snig::read_bsr_binary<float>(bsr_path, num_neurons, 2), std::runtime_error);
+    f.open(bsr_path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(offset);
+    f.write((char*)&original, sizeof(original));
+  };
+  const size_t header_bytes = 6 * sizeof(size_t);
+  const size_t block_col_offset = header_bytes + sizeof(int) * (num_neurons / bsr.R + 1);
+  check_corrupt(2 * sizeof(size_t), size_t(3));
+  check_corrupt(3 * sizeof(size_t), size_t(16));
+  check_corrupt(5 * sizeof(size_t), bsr.num_blocks() + 1);
+  check_corrupt(5 * sizeof(size_t), size_t(-1));
+  check_corrupt(header_bytes, int(1));
+  check_corrupt(block_col_offset - sizeof(int), int(bsr.num_blocks() - 1));
+  check_corrupt(block_col_offset, int(num_neurons / bsr.C));
+  check_corrupt(block_col_offset, int(-1));
+  CHECK(snig::read_bsr_binary<float>(bsr_path, num_neurons, 2).val == bsr.val);
+
+  //truncated converted files
+  std::fs::resize_file(snig::sell_layer_path(dir, num_neurons, 0), 100);
+  CHECK_THROWS_AS(snig::read_sell_binary<float>(snig::sell_layer_path(dir, num_neurons, 0)), std::runtime_error);
+  std::fs::resize_file(bsr_path, 100);
+  CHECK_THROWS_AS(snig::read_bsr_binary<float>(bsr_path, num_neurons, 2), std::runtime_error);
+
+  std::fs::remove_all(dir);
+}
@@ -0,0 +1,147 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <SNIG/utility/traffic_log.hpp>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+using clock_type = snig::TrafficWriter::clock;
+
+const std::fs::path log_path = std::fs::temp_directory_path() / "snig_traffic_log_test.log";
+
+//three requests of 4 neurons: constant rows, mixed values with an empty row,
+//and one value in the last column
+std::vector<std::vector<float>> test_rows() {
+  return {
+    {1, 0, 0, 1,   0, 1, 1, 1},
+    {0.5f, 0, -2, 0,   0, 0, 0, 0,   3, 0, 0, 0},
+    {0, 0, 0, 7}
+  };
+}
+
+//bytes of the log after each request
+std::vector<size_t> write_test_log(const size_t num_neurons) {
+  auto rows = test_rows();
+  auto start = clock_type::now();
+  snig::TrafficWriter writer(log_path, num_neurons);
+  std::vector<size_t> bytes;
+  writer.append(start, rows[0].data(), rows[0].size() / num_neurons, 0, clock_type::time_point::max());
+  bytes.push_back(writer.bytes());
+  writer.append(start + std::chrono::microseconds(5), rows[1].data(), rows[1].size() / num_neurons, 1, start + std::chrono::milliseconds(2));
+  bytes.push_back(writer.bytes());
+  writer.append(start + std::chrono::milliseconds(3), rows[2].data(), rows[2].size() / num_neurons, 0, clock_type::time_point::max());
+  bytes.push_back(writer.bytes());
+  writer.flush();
+  CHECK(writer.num_requests() == 3);
+  CHECK(bytes.back() == std::fs::file_size(log_path));
+  return bytes;
+}
+
+TEST_CASE("varint_round_trip") {
+  std::vector<uint64_t> values{
+    0, 1, 127, 128, 300, 16383, 16384, (uint64_t(1) << 32) + 5, std::numeric_limits<uint64_t>::max()
+  };
+  std::vector<size_t> sizes{1, 1, 1, 2, 2, 2, 3, 5, 10};
+
+  std::string buf;
+  for(size_t i = 0; i < values.size(); ++i) {
+    size_t before = buf.size();
+    snig::detail::append_varint(buf, values[i]);
+    CHECK(buf.size() - before == sizes[i]);
+  }
+
+  const char* p = buf.data();
+  const char* end = buf.data() + buf.size();
+  for(auto expected : values) {
+    uint64_t v;
+    REQUIRE(snig::detail::read_varint(p, end, v));
+    CHECK(v == expected);
+  }
+  CHECK(p == end);
+
+  //a varint whose last byte is missing
+  std::string cut;
+  snig::detail::append_varint(cut, 16384);
+  cut.pop_back();
+  p = cut.data();
+  uint64_t v;
+  CHECK_FALSE(snig::detail::read_varint(p, cut.data() + cut.size(), v));
+}
+
+TEST_CASE("traffic_log_round_trip") {
+  const size_t num_neurons = 4;
+  write_test_log(num_neurons);
+
+  auto log = snig::read_traffic_log(log_path);
+  CHECK_FALSE(log.is_truncated);
+  CHECK(log.num_neurons == num_neurons);
+  REQUIRE(log.requests.size() == 3);
+  CHECK(log.num_rows() == 6);
+
+  CHECK(log.requests[0].arrival_ns == 0);
+  CHECK(log.requests[0].deadline_ns == 0);
+  CHECK(log.requests[1].arrival_ns == 5000);
+  CHECK(log.requests[1].priority == 1);
+  CHECK(log.requests[1].deadline_ns == 2000000 - 5000);
+  CHECK(log.requests[2].arrival_ns == 3000000);
+  CHECK(log.requests[2].row_beg == 5);
+
+  auto rows = test_rows();
+  for(size_t r = 0; r < rows.size(); ++r) {
+    CHECK(log.dense_rows<float>(r) == rows[r]);
+  }
+
+  std::fs::remove(log_path);
+}
+
+TEST_CASE("traffic_log_truncated") {
+  const size_t num_neurons = 4;
+  auto bytes = write_test_log(num_neurons);
+  std::string full;
+  {
+    std::ifstream in(log_path, std::ios::binary);
+    full.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  auto complete = snig::read_traffic_log(log_path);
+
+  //every cut inside the last record drops it and keeps the others whole
+  for(size_t size = bytes[1] + 1; size < bytes[2]; ++size) {
+    {
+      std::ofstream out(log_path, std::ios::binary);
+      out.write(full.data(), size);
+    }
+    auto log = snig::read_traffic_log(log_path);
+    CHECK(log.is_truncated);
+    REQUIRE(log.requests.size() == 2);
+    CHECK(log.num_rows() == 5);
+    CHECK(log.row_ptr.size() == 6);
+    CHECK(log.col_idx.size() == log.row_ptr.back());
+    CHECK(log.values.size() == log.row_ptr.back());
+    CHECK(log.dense_rows<float>(1) == complete.dense_rows<float>(1));
+  }
+
+  //a header alone holds no requests
+  {
+    std::ofstream out(log_path, std::ios::binary);
+    out.write(full.data(), sizeof(snig::traffic_log_magic) + sizeof(size_t));
+  }
+  auto log = snig::read_traffic_log(log_path);
+  CHECK_FALSE(log.is_truncated);
+  CHECK(log.requests.empty());
+
+  //neither magic nor a whole header
+  {
+    std::ofstream out(log_path, std::ios::binary);
+    out.write(full.data(), sizeof(snig::traffic_log_magic));
+  }
+  CHECK_THROWS_AS(snig::read_traffic_log(log_path), std::runtime_error);
+  {
+    std::ofstream out(log_path, std::ios::binary);
+    out << "SNIGBITS and more";
+  }
+  CHECK_THROWS_AS(snig::read_traffic_log(log_path), std::runtime_error);
+
+  std::fs::remove(log_path);
+}
@@ -0,0 +1,102 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+
+#include <SNIG/utility/tsv_stream.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//gzip streams below were written by zlib at level 9 (level 0
+//for the stored block) with a zero mtime
+
+std::string gunzip_string(const std::vector<unsigned char>& gz) {
+  std::istringstream in(std::string(gz.begin(), gz.end()));
+  std::string out;
+  size_t n = snig::gunzip(in, [&](const char* data, size_t size) { out.append(data, size); });
+  CHECK(n == out.size());
+  return out;
+}
+
+TEST_CASE("gunzip_blocks") {
+  //fixed Huffman block
+  std::vector<unsigned char> fixed{
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcb, 0x48,
+    0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0x28, 0xcf, 0x2f, 0xca, 0x49, 0xe1, 0x02,
+    0x00, 0x53, 0x74, 0x24, 0xf4, 0x0d, 0x00, 0x00, 0x00
+  };
+  CHECK(gunzip_string(fixed) == "hello, world\n");
+
+  //stored block
+  std::vector<unsigned char> stored{
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x03, 0x01, 0x0d,
+    0x00, 0xf2, 0xff, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20, 0x62, 0x6c,
+    0x6f, 0x63, 0x6b, 0x0a, 0x6d, 0x75, 0x88, 0xc5, 0x0d, 0x00, 0x00, 0x00
+  };
+  CHECK(gunzip_string(stored) == "stored block\n");
+
+  //dynamic Huffman block
+  std::vector<unsigned char> dynamic{
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x9d, 0xc9,
+    0xb7, 0x01, 0x00, 0x20, 0x08, 0x00, 0xb0, 0x5b, 0xb1, 0x63, 0x45, 0xec,
+    0x5e, 0xef, 0x0f, 0x66, 0x0d, 0x08, 0xa9, 0xb4, 0xb1, 0x0e, 0x7d, 0x88,
+    0x29, 0x17, 0xaa, 0xdc, 0xfa, 0x98, 0x6b, 0x9f, 0x0b, 0x1f, 0x73, 0xcf,
+    0x5e, 0x73, 0xf4, 0xc6, 0x95, 0x4a, 0x4e, 0x31, 0x78, 0x74, 0xd6, 0x68,
+    0x25, 0x05, 0xfc, 0xcc, 0x03, 0xbe, 0x3d, 0xd2, 0x03, 0x9c, 0x00, 0x00,
+    0x00
+  };
+  std::string alphabet("abcdefghijklmnopqrstuvwxyz");
+  std::string expected;
+  for(int i = 0; i < 3; ++i) {
+    expected += alphabet;
+  }
+  for(int i = 0; i < 3; ++i) {
+    expected += std::string(alphabet.rbegin(), alphabet.rend());
+  }
+  CHECK(gunzip_string(dynamic) == expected);
+}
+
+TEST_CASE("gunzip_members") {
+  //two members decode to their concatenation
+  std::vector<unsigned char> two{
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x4b, 0x4c,
+    0x02, 0x00, 0x6d, 0x48, 0x83, 0x9e, 0x02, 0x00, 0x00, 0x00, 0x1f, 0x8b,
+    0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x4b, 0x4e, 0x01, 0x00,
+    0xda, 0x8f, 0xd6, 0x45, 0x02, 0x00, 0x00, 0x00
+  };
+  CHECK(gunzip_string(two) == "abcd");
+
+  std::vector<unsigned char> empty{
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x03, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+  };
+  CHECK(gunzip_string(empty).empty());
+}
+
+TEST_CASE("gunzip_errors") {
+  std::vector<unsigned char> gz{
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcb, 0x48,
+    0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0x28, 0xcf, 0x2f, 0xca, 0x49, 0xe1, 0x02,
+    0x00, 0x53, 0x74, 0x24, 0xf4, 0x0d, 0x00, 0x00, 0x00
+  };
+
+  auto bad_crc = gz;
+  bad_crc[25] ^= 1;
+  CHECK_THROWS_AS(gunzip_string(bad_crc), std::runtime_error);
+
+  auto bad_size = gz;
+  bad_size[29] += 1;
+  CHECK_THROWS_AS(gunzip_string(bad_size), std::runtime_error);
+
+  auto bad_magic = gz;
+  bad_magic[1] = 0x8c;
+  CHECK_THROWS_AS(gunzip_string(bad_magic), std::runtime_error);
+
+  //cut in the middle of the compressed data and of the trailer
+  CHECK_THROWS_AS(gunzip_string(std::vector<unsigned char>(gz.begin(), gz.begin() + 16)), std::runtime_error);
+  CHECK_THROWS_AS(gunzip_string(std::vector<unsigned char>(gz.begin(), gz.end() - 2)), std::runtime_error);
+
+  auto trailing = gz;
+  trailing.push_back(0);
+  CHECK_THROWS_AS(gunzip_string(trailing), std::runtime_error);
+}